@@ -29,6 +29,7 @@
 #include <linux/workqueue.h>
 #include <linux/cgroup.h>
 #include <linux/blk-cgroup.h>
+#include <linux/cpuhotplug.h>
 
 #include <trace/events/block.h>
 #include "blk.h"
@@ -58,6 +59,19 @@ static struct biovec_slab bvec_slabs[BVEC_POOL_NR] __read_mostly = {
 struct bio_set fs_bio_set;
 EXPORT_SYMBOL(fs_bio_set);
 
+/*
+ * Per-cpu cache of free bios, see bio_alloc_cached().  Bios are freed and
+ * allocated from both process and interrupt context, the cache is only
+ * touched with interrupts disabled.
+ */
+#define ALLOC_CACHE_MAX		512
+#define ALLOC_CACHE_SLACK	 64
+
+struct bio_alloc_cache {
+	struct bio_list		free_list;
+	unsigned int		nr;
+};
+
 /*
  * Our slab pool management
  */
@@ -248,6 +262,32 @@ void bio_uninit(struct bio *bio)
 }
 EXPORT_SYMBOL(bio_uninit);
 
+/* called with interrupts disabled, frees up to @nr bios to the mempool */
+static void bio_alloc_cache_prune(struct bio_set *bs,
+				  struct bio_alloc_cache *cache,
+				  unsigned int nr)
+{
+	struct bio *bio;
+
+	while (nr-- && (bio = bio_list_pop(&cache->free_list))) {
+		cache->nr--;
+		mempool_free((void *)bio - bs->front_pad, &bs->bio_pool);
+	}
+}
+
+static void bio_put_percpu_cache(struct bio_set *bs, struct bio *bio)
+{
+	struct bio_alloc_cache *cache;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(bs->cache);
+	bio_list_add_head(&cache->free_list, bio);
+	if (++cache->nr > ALLOC_CACHE_MAX + ALLOC_CACHE_SLACK)
+		bio_alloc_cache_prune(bs, cache, ALLOC_CACHE_SLACK);
+	local_irq_restore(flags);
+}
+
 static void bio_free(struct bio *bio)
 {
 	struct bio_set *bs = bio->bi_pool;
@@ -258,6 +298,11 @@ static void bio_free(struct bio *bio)
 	if (bs) {
 		bvec_free(&bs->bvec_pool, bio->bi_io_vec, BVEC_POOL_IDX(bio));
 
+		if (bio_flagged(bio, BIO_PERCPU_CACHE)) {
+			bio_put_percpu_cache(bs, bio);
+			return;
+		}
+
 		/*
 		 * If we have front padding, adjust the bio pointer before freeing
 		 */
@@ -302,6 +347,9 @@ void bio_reset(struct bio *bio)
 {
 	unsigned long flags = bio->bi_flags & (~0UL << BIO_RESET_BITS);
 
+	/* a reset bio still goes back where it was allocated from */
+	flags |= bio->bi_flags & (1U << BIO_PERCPU_CACHE);
+
 	bio_uninit(bio);
 
 	memset(bio, 0, BIO_RESET_BYTES);
@@ -532,6 +580,54 @@ struct bio *bio_alloc_bioset(gfp_t gfp_mask, unsigned int nr_iovecs,
 }
 EXPORT_SYMBOL(bio_alloc_bioset);
 
+/**
+ * bio_alloc_cached - allocate a bio through the per-cpu cache of a bio_set
+ * @gfp_mask:   the GFP_* mask given to the slab allocator
+ * @nr_iovecs:	number of iovecs to pre-allocate
+ * @bs:		the bio_set to allocate from
+ *
+ * Description:
+ *   Like bio_alloc_bioset(), but if @bs was set up with %BIOSET_PERCPU_CACHE
+ *   and the bio fits the inline vecs, it is taken from a per-cpu list of
+ *   free bios and goes back there when its last reference is put, skipping
+ *   the mempool and the slab allocator.  Meant for submitters of many small
+ *   bios, like direct IO.
+ *
+ *   RETURNS:
+ *   Pointer to new bio on success, NULL on failure.
+ */
+struct bio *bio_alloc_cached(gfp_t gfp_mask, unsigned int nr_iovecs,
+			     struct bio_set *bs)
+{
+	struct bio_alloc_cache *cache;
+	unsigned long flags;
+	struct bio *bio;
+
+	if (!bs->cache || nr_iovecs > BIO_INLINE_VECS)
+		return bio_alloc_bioset(gfp_mask, nr_iovecs, bs);
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(bs->cache);
+	bio = bio_list_pop(&cache->free_list);
+	if (bio)
+		cache->nr--;
+	local_irq_restore(flags);
+
+	if (bio) {
+		bio_init(bio, nr_iovecs ? bio->bi_inline_vecs : NULL,
+			 nr_iovecs);
+		bio->bi_pool = bs;
+	} else {
+		bio = bio_alloc_bioset(gfp_mask, nr_iovecs, bs);
+		if (unlikely(!bio))
+			return NULL;
+	}
+
+	bio_set_flag(bio, BIO_PERCPU_CACHE);
+	return bio;
+}
+EXPORT_SYMBOL(bio_alloc_cached);
+
 void zero_fill_bio_iter(struct bio *bio, struct bvec_iter start)
 {
 	unsigned long flags;
@@ -1873,6 +1969,32 @@ int biovec_init_pool(mempool_t *pool, int pool_entries)
 	return mempool_init_slab_pool(pool, pool_entries, bp->slab);
 }
 
+static int bio_cpu_dead(unsigned int cpu, struct hlist_node *node)
+{
+	struct bio_set *bs = hlist_entry_safe(node, struct bio_set, cpuhp_dead);
+	struct bio_alloc_cache *cache = per_cpu_ptr(bs->cache, cpu);
+	unsigned long flags;
+
+	local_irq_save(flags);
+	bio_alloc_cache_prune(bs, cache, UINT_MAX);
+	local_irq_restore(flags);
+	return 0;
+}
+
+static void bio_alloc_cache_destroy(struct bio_set *bs)
+{
+	int cpu;
+
+	if (!bs->cache)
+		return;
+
+	cpuhp_state_remove_instance_nocalls(CPUHP_BIO_DEAD, &bs->cpuhp_dead);
+	for_each_possible_cpu(cpu)
+		bio_cpu_dead(cpu, &bs->cpuhp_dead);
+	free_percpu(bs->cache);
+	bs->cache = NULL;
+}
+
 /*
  * bioset_exit - exit a bioset initialized with bioset_init()
  *
@@ -1881,6 +2003,8 @@ int biovec_init_pool(mempool_t *pool, int pool_entries)
  */
 void bioset_exit(struct bio_set *bs)
 {
+	bio_alloc_cache_destroy(bs);
+
 	if (bs->rescue_workqueue)
 		destroy_workqueue(bs->rescue_workqueue);
 	bs->rescue_workqueue = NULL;
@@ -1900,8 +2024,8 @@ EXPORT_SYMBOL(bioset_exit);
  * @bs:		pool to initialize
  * @pool_size:	Number of bio and bio_vecs to cache in the mempool
  * @front_pad:	Number of bytes to allocate in front of the returned bio
- * @flags:	Flags to modify behavior, currently %BIOSET_NEED_BVECS
- *              and %BIOSET_NEED_RESCUER
+ * @flags:	Flags to modify behavior, currently %BIOSET_NEED_BVECS,
+ *              %BIOSET_NEED_RESCUER and %BIOSET_PERCPU_CACHE
  *
  * Description:
  *    Set up a bio_set to be used with @bio_alloc_bioset. Allows the caller
@@ -1914,6 +2038,8 @@ EXPORT_SYMBOL(bioset_exit);
  *    for allocating iovecs.  This pool is not needed e.g. for bio_clone_fast().
  *    If %BIOSET_NEED_RESCUER is set, a workqueue is created which can be used to
  *    dispatch queued requests when the mempool runs out of space.
+ *    If %BIOSET_PERCPU_CACHE is set, bios allocated with bio_alloc_cached()
+ *    are recycled through per-cpu free lists.
  *
  */
 int bioset_init(struct bio_set *bs,
@@ -1940,6 +2066,14 @@ int bioset_init(struct bio_set *bs,
 	    biovec_init_pool(&bs->bvec_pool, pool_size))
 		goto bad;
 
+	if (flags & BIOSET_PERCPU_CACHE) {
+		bs->cache = alloc_percpu(struct bio_alloc_cache);
+		if (!bs->cache)
+			goto bad;
+		cpuhp_state_add_instance_nocalls(CPUHP_BIO_DEAD,
+						 &bs->cpuhp_dead);
+	}
+
 	if (!(flags & BIOSET_NEED_RESCUER))
 		return 0;
 
@@ -1967,6 +2101,8 @@ int bioset_init_from_src(struct bio_set *bs, struct bio_set *src)
 		flags |= BIOSET_NEED_BVECS;
 	if (src->rescue_workqueue)
 		flags |= BIOSET_NEED_RESCUER;
+	if (src->cache)
+		flags |= BIOSET_PERCPU_CACHE;
 
 	return bioset_init(bs, src->bio_pool.min_nr, src->front_pad, flags);
 }
@@ -2138,7 +2274,11 @@ static int __init init_bio(void)
 	bio_integrity_init();
 	biovec_init_slabs();
 
-	if (bioset_init(&fs_bio_set, BIO_POOL_SIZE, 0, BIOSET_NEED_BVECS))
+	cpuhp_setup_state_multi(CPUHP_BIO_DEAD, "block/bio:dead", NULL,
+				bio_cpu_dead);
+
+	if (bioset_init(&fs_bio_set, BIO_POOL_SIZE, 0,
+			BIOSET_NEED_BVECS | BIOSET_PERCPU_CACHE))
 		panic("bio: can't allocate bios\n");
 
 	if (bioset_integrity_create(&fs_bio_set, BIO_POOL_SIZE))
@@ -603,6 +603,7 @@ bool bio_attempt_back_merge(struct request_queue *q, struct request *req,
 		return false;
 
 	trace_block_bio_backmerge(q, req, bio);
+	rq_qos_merge(q, req, bio);
 
 	if ((req->cmd_flags & REQ_FAILFAST_MASK) != ff)
 		blk_rq_set_mixed_merge(req);
@@ -624,6 +625,7 @@ bool bio_attempt_front_merge(struct request_queue *q, struct request *req,
 		return false;
 
 	trace_block_bio_frontmerge(q, req, bio);
+	rq_qos_merge(q, req, bio);
 
 	if ((req->cmd_flags & REQ_FAILFAST_MASK) != ff)
 		blk_rq_set_mixed_merge(req);
@@ -649,6 +651,8 @@ bool bio_attempt_discard_merge(struct request_queue *q, struct request *req,
 	    blk_rq_get_max_sectors(req, blk_rq_pos(req)))
 		goto no_merge;
 
+	rq_qos_merge(q, req, bio);
+
 	req->biotail->bi_next = bio;
 	req->biotail = bio;
 	req->__data_len += bio->bi_iter.bi_size;
@@ -1705,6 +1709,23 @@ EXPORT_SYMBOL(kblockd_mod_delayed_work_on);
  *   this kind of deadlock.
  */
 void blk_start_plug(struct blk_plug *plug)
+{
+	blk_start_plug_nr_ios(plug, 1);
+}
+EXPORT_SYMBOL(blk_start_plug);
+
+/**
+ * blk_start_plug_nr_ios - start a plug for a batch of known size
+ * @plug:	The &struct blk_plug that needs to be initialized
+ * @nr_ios:	Number of I/Os the caller expects to submit under @plug
+ *
+ * Description:
+ *   Like blk_start_plug(), but lets blk-mq allocate requests, and the tags
+ *   backing them, for up to @nr_ios I/Os at once instead of one at a time.
+ *   Requests left over are freed again when the plug is finished or the
+ *   task goes to sleep.
+ */
+void blk_start_plug_nr_ios(struct blk_plug *plug, unsigned short nr_ios)
 {
 	struct task_struct *tsk = current;
 
@@ -1716,7 +1737,9 @@ void blk_start_plug(struct blk_plug *plug)
 
 	INIT_LIST_HEAD(&plug->mq_list);
 	INIT_LIST_HEAD(&plug->cb_list);
+	INIT_LIST_HEAD(&plug->cached_rqs);
 	plug->rq_count = 0;
+	plug->nr_ios = max_t(unsigned short, nr_ios, 1);
 	plug->multiple_queues = false;
 
 	/*
@@ -1725,7 +1748,7 @@ void blk_start_plug(struct blk_plug *plug)
 	 */
 	tsk->plug = plug;
 }
-EXPORT_SYMBOL(blk_start_plug);
+EXPORT_SYMBOL(blk_start_plug_nr_ios);
 
 static void flush_plug_callbacks(struct blk_plug *plug, bool from_schedule)
 {
@@ -1775,6 +1798,13 @@ void blk_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 
 	if (!list_empty(&plug->mq_list))
 		blk_mq_flush_plug_list(plug, from_schedule);
+
+	/*
+	 * Pre-allocated requests pin tags and a queue reference, don't hold
+	 * on to them while we sleep.
+	 */
+	if (unlikely(from_schedule && !list_empty(&plug->cached_rqs)))
+		blk_mq_free_plug_rqs(plug);
 }
 
 /**
@@ -1792,6 +1822,8 @@ void blk_finish_plug(struct blk_plug *plug)
 	if (plug != current->plug)
 		return;
 	blk_flush_plug_list(plug, false);
+	if (!list_empty(&plug->cached_rqs))
+		blk_mq_free_plug_rqs(plug);
 
 	current->plug = NULL;
 }
@@ -0,0 +1,1557 @@
+/* SPDX-License-Identifier: GPL-2.0
+ *
+ * IO cost model based controller.
+ *
+ * blk-throttle enforces absolute limits and blk-iolatency protects latency
+ * targets, but neither distributes the capacity of a device between cgroups
+ * in proportion to their weights.  This controller does that with very
+ * little per-IO overhead by charging each IO a cost against a per-cgroup
+ * virtual time budget.
+ *
+ * 1. IO Cost Model
+ *
+ * Every bio is assigned an absolute cost from a linear model of the device:
+ *
+ *	cost = (seq_io or rand_io) + pages * page
+ *
+ * where the three coefficients are derived, separately for reads and
+ * writes, from the sequential bandwidth and the sequential and random 4k
+ * IOPS of the device.  An IO is considered sequential if it starts within
+ * LCOEF_RANDIO_PAGES of where the previous IO of the same cgroup ended.
+ * The parameters are picked automatically depending on whether the device
+ * is rotational, or can be set through the root-only io.cost.model file:
+ *
+ *	MAJ:MIN ctrl=user model=linear rbps=B rseqiops=N rrandiops=N
+ *		wbps=B wseqiops=N wrandiops=N
+ *
+ * Writing ctrl=auto reverts to the built-in parameters.
+ *
+ * 2. Virtual Time and Weights
+ *
+ * Each device has a virtual clock, vtime, which runs at vrate times wall
+ * clock time; at a vrate of 100% a second of vtime is exactly the work the
+ * model says the device can do in a second.  Each cgroup has its own vtime
+ * which is advanced on every IO by the IO's absolute cost divided by the
+ * cgroup's share of the device, its hierarchical weight.  An IO can be
+ * issued as long as the cgroup's vtime doesn't go ahead of the device's;
+ * otherwise the issuer waits until enough vtime has passed.
+ *
+ * The hierarchical weight of a cgroup is the product, from the cgroup up
+ * to the root, of its io.weight over the sum of the weights of its active
+ * siblings.  A cgroup is active while it keeps issuing IOs and is dropped
+ * from the calculation once it stayed idle for a full period, so that idle
+ * cgroups don't hold on to their share.  An idle cgroup also can't bank
+ * more than MARGIN_PCT of a period worth of vtime.  Only leaf cgroups are
+ * controlled: IOs issued by a cgroup with active children are issued as if
+ * from the root, as are IOs which have to be issued by the root to avoid
+ * priority inversions.  The latter, and bios merged into existing
+ * requests, are charged without waiting, which puts the cgroup in debt.
+ *
+ * 3. QoS and vrate
+ *
+ * Every period the completion latencies of reads and writes are checked
+ * against the targets configured through the root-only io.cost.qos file:
+ *
+ *	MAJ:MIN enable=1 ctrl=user rpct=P rlat=USEC wpct=P wlat=USEC
+ *		min=P max=P
+ *
+ * If more than (100 - rpct)% of reads take longer than rlat, or likewise
+ * for writes, the device is saturated and vrate is lowered.  If latencies
+ * are fine and cgroups had to wait for budget, vrate is raised.  vrate
+ * stays within [min%, max%] of the model.  A zero pct disables the check
+ * for that direction, so min=max=100 with both disabled gives a fixed
+ * cost model.  The controller is off until enable=1 is written.
+ *
+ * The state of each device's controller is available in debugfs under
+ * block/<dev>/rqos/cost, and with blkcg_debug_stats set, the usage and
+ * wait times of each cgroup are appended to io.stat.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/time64.h>
+#include <linux/seqlock.h>
+#include <linux/sched/signal.h>
+#include <linux/blk-cgroup.h>
+#include "blk-rq-qos.h"
+#include "blk-stat.h"
+#include "blk.h"
+
+/* virtual time: one second of device time at vrate 100% */
+#define VTIME_PER_SEC_SHIFT	37
+#define VTIME_PER_SEC		(1LLU << VTIME_PER_SEC_SHIFT)
+#define VTIME_PER_USEC		(VTIME_PER_SEC / USEC_PER_SEC)
+
+/* hierarchical weights are fractions of HWEIGHT_WHOLE */
+#define HWEIGHT_WHOLE		(1 << 16)
+
+/* period bounds, in usecs */
+#define MIN_PERIOD		USEC_PER_MSEC
+#define MAX_PERIOD		USEC_PER_SEC
+#define DFL_PERIOD		(10 * USEC_PER_MSEC)
+
+/* idle cgroups can bank at most this much of a period */
+#define MARGIN_PCT		50
+
+/* seeks shorter than this are sequential */
+#define LCOEF_RANDIO_PAGES	4096
+
+#define IOC_PAGE_SHIFT		12
+#define IOC_SECT_TO_PAGE_SHIFT	(IOC_PAGE_SHIFT - SECTOR_SHIFT)
+
+/* vrate changes, in percent, by how many periods it has been busy or idle */
+static const u8 vrate_adj_pct[] = { 0, 1, 2, 4, 8, 16 };
+
+enum {
+	QOS_RPCT,
+	QOS_RLAT,
+	QOS_WPCT,
+	QOS_WLAT,
+	QOS_MIN,
+	QOS_MAX,
+	NR_QOS_PARAMS,
+};
+
+enum {
+	I_LCOEF_RBPS,
+	I_LCOEF_RSEQIOPS,
+	I_LCOEF_RRANDIOPS,
+	I_LCOEF_WBPS,
+	I_LCOEF_WSEQIOPS,
+	I_LCOEF_WRANDIOPS,
+	NR_I_LCOEFS,
+};
+
+enum {
+	LCOEF_RPAGE,
+	LCOEF_RSEQIO,
+	LCOEF_RRANDIO,
+	LCOEF_WPAGE,
+	LCOEF_WSEQIO,
+	LCOEF_WRANDIO,
+	NR_LCOEFS,
+};
+
+enum {
+	AUTOP_HDD,
+	AUTOP_SSD,
+	NR_AUTOP,
+};
+
+struct ioc_params {
+	u32 qos[NR_QOS_PARAMS];
+	u64 i_lcoefs[NR_I_LCOEFS];
+};
+
+static const struct ioc_params autop[NR_AUTOP] = {
+	[AUTOP_HDD] = {
+		.qos = {
+			[QOS_RPCT] = 95,
+			[QOS_RLAT] = 250000,
+			[QOS_WPCT] = 95,
+			[QOS_WLAT] = 250000,
+			[QOS_MIN] = 50,
+			[QOS_MAX] = 150,
+		},
+		.i_lcoefs = {
+			[I_LCOEF_RBPS] = 174019176,
+			[I_LCOEF_RSEQIOPS] = 41708,
+			[I_LCOEF_RRANDIOPS] = 370,
+			[I_LCOEF_WBPS] = 178075866,
+			[I_LCOEF_WSEQIOPS] = 42705,
+			[I_LCOEF_WRANDIOPS] = 378,
+		},
+	},
+	[AUTOP_SSD] = {
+		.qos = {
+			[QOS_RPCT] = 90,
+			[QOS_RLAT] = 25000,
+			[QOS_WPCT] = 90,
+			[QOS_WLAT] = 25000,
+			[QOS_MIN] = 75,
+			[QOS_MAX] = 150,
+		},
+		.i_lcoefs = {
+			[I_LCOEF_RBPS] = 488636629,
+			[I_LCOEF_RSEQIOPS] = 8932,
+			[I_LCOEF_RRANDIOPS] = 8518,
+			[I_LCOEF_WBPS] = 427891549,
+			[I_LCOEF_WSEQIOPS] = 28755,
+			[I_LCOEF_WRANDIOPS] = 21940,
+		},
+	},
+};
+
+static const char *autop_name[NR_AUTOP] = {
+	[AUTOP_HDD] = "hdd",
+	[AUTOP_SSD] = "ssd",
+};
+
+/* completion latencies checked against the qos targets */
+struct ioc_pcpu_stat {
+	u32 nr_met[2];
+	u32 nr_missed[2];
+};
+
+struct ioc {
+	struct rq_qos rqos;
+
+	bool enabled;
+	bool user_qos_params;
+	bool user_cost_model;
+	int autop_idx;
+
+	/* protects everything below but the atomics and the period */
+	spinlock_t lock;
+
+	struct ioc_params params;
+	u64 lcoefs[NR_LCOEFS];
+	u64 vrate_min;
+	u64 vrate_max;
+	u32 period_us;
+	u32 margin_us;
+
+	struct timer_list timer;
+	struct list_head active_iocgs;
+	bool running;
+	int busy_level;
+
+	/* period_at and period_at_vtime change together with vtime_rate */
+	seqcount_t period_seqcount;
+	u64 period_at;		/* wallclock start, usecs */
+	u64 period_at_vtime;	/* vtime at period_at */
+	atomic64_t vtime_rate;	/* vtime per usec */
+	atomic64_t cur_period;
+
+	/* bumped whenever active weights change, see current_hweight() */
+	atomic_t hweight_gen;
+
+	struct ioc_pcpu_stat __percpu *pcpu_stat;
+	u32 last_met[2];
+	u32 last_missed[2];
+	u32 missed_ppm[2];
+};
+
+/* per device-cgroup pair */
+struct ioc_gq {
+	struct blkg_policy_data pd;
+	struct ioc *ioc;
+
+	/* per-device weight, 0 if the cgroup default applies */
+	u32 cfg_weight;
+	u32 weight;
+
+	/*
+	 * @active is @weight while the group or any of its descendants is
+	 * active and 0 otherwise, @child_active_sum is the sum of the
+	 * children's @active.  Both are protected by ioc->lock.
+	 */
+	u32 active;
+	u32 child_active_sum;
+	struct list_head active_list;
+	atomic64_t active_period;
+
+	atomic64_t vtime;
+	sector_t cursor;
+
+	/* cached by current_hweight() */
+	int hweight_gen;
+	u32 hweight_active;
+
+	struct wait_queue_head waitq;
+	struct hrtimer waitq_timer;
+
+	/* stats, in usecs */
+	atomic64_t usage_us;
+	atomic64_t wait_us;
+};
+
+/* per cgroup */
+struct ioc_cgrp {
+	struct blkcg_policy_data cpd;
+	u32 dfl_weight;
+};
+
+struct ioc_now {
+	u64 now_ns;
+	u64 now;
+	u64 vnow;
+	u64 vrate;
+};
+
+struct iocg_wait {
+	struct wait_queue_entry wait;
+	struct bio *bio;
+	u64 abs_cost;
+	bool committed;
+};
+
+struct iocg_wake_ctx {
+	struct ioc_gq *iocg;
+	u32 hw_active;
+	s64 vbudget;
+};
+
+static struct blkcg_policy blkcg_policy_iocost;
+
+static inline struct ioc *rqos_to_ioc(struct rq_qos *rqos)
+{
+	return container_of(rqos, struct ioc, rqos);
+}
+
+static inline struct ioc *q_to_ioc(struct request_queue *q)
+{
+	return rqos_to_ioc(rq_qos_id(q, RQ_QOS_COST));
+}
+
+static inline struct ioc_gq *pd_to_iocg(struct blkg_policy_data *pd)
+{
+	return pd ? container_of(pd, struct ioc_gq, pd) : NULL;
+}
+
+static inline struct ioc_gq *blkg_to_iocg(struct blkcg_gq *blkg)
+{
+	return pd_to_iocg(blkg_to_pd(blkg, &blkcg_policy_iocost));
+}
+
+static inline struct blkcg_gq *iocg_to_blkg(struct ioc_gq *iocg)
+{
+	return pd_to_blkg(&iocg->pd);
+}
+
+static inline struct ioc_gq *iocg_parent(struct ioc_gq *iocg)
+{
+	struct blkcg_gq *parent = iocg_to_blkg(iocg)->parent;
+
+	return parent ? blkg_to_iocg(parent) : NULL;
+}
+
+static inline struct ioc_cgrp *blkcg_to_iocc(struct blkcg *blkcg)
+{
+	return container_of(blkcg_to_cpd(blkcg, &blkcg_policy_iocost),
+			    struct ioc_cgrp, cpd);
+}
+
+static u64 abs_cost_to_cost(u64 abs_cost, u32 hw_active)
+{
+	return DIV64_U64_ROUND_UP(abs_cost * HWEIGHT_WHOLE, hw_active);
+}
+
+static void calc_lcoefs(u64 bps, u64 seqiops, u64 randiops,
+			u64 *page, u64 *seqio, u64 *randio)
+{
+	u64 v;
+
+	*page = *seqio = *randio = 0;
+
+	if (bps)
+		*page = DIV64_U64_ROUND_UP(VTIME_PER_SEC,
+					   max_t(u64, bps >> IOC_PAGE_SHIFT, 1));
+
+	if (seqiops) {
+		v = DIV64_U64_ROUND_UP(VTIME_PER_SEC, seqiops);
+		if (v > *page)
+			*seqio = v - *page;
+	}
+
+	if (randiops) {
+		v = DIV64_U64_ROUND_UP(VTIME_PER_SEC, randiops);
+		if (v > *page)
+			*randio = v - *page;
+	}
+}
+
+/*
+ * Pick up the built-in parameters if the user didn't set any and derive
+ * everything that depends on them.  Called with ioc->lock held.
+ */
+static void ioc_refresh_params(struct ioc *ioc, bool force)
+{
+	const u64 *i = ioc->params.i_lcoefs;
+	u32 lat;
+	int idx;
+
+	idx = blk_queue_nonrot(ioc->rqos.q) ? AUTOP_SSD : AUTOP_HDD;
+	if (idx == ioc->autop_idx && !force)
+		return;
+	ioc->autop_idx = idx;
+
+	if (!ioc->user_qos_params)
+		memcpy(ioc->params.qos, autop[idx].qos,
+		       sizeof(ioc->params.qos));
+	if (!ioc->user_cost_model)
+		memcpy(ioc->params.i_lcoefs, autop[idx].i_lcoefs,
+		       sizeof(ioc->params.i_lcoefs));
+
+	calc_lcoefs(i[I_LCOEF_RBPS], i[I_LCOEF_RSEQIOPS], i[I_LCOEF_RRANDIOPS],
+		    &ioc->lcoefs[LCOEF_RPAGE], &ioc->lcoefs[LCOEF_RSEQIO],
+		    &ioc->lcoefs[LCOEF_RRANDIO]);
+	calc_lcoefs(i[I_LCOEF_WBPS], i[I_LCOEF_WSEQIOPS], i[I_LCOEF_WRANDIOPS],
+		    &ioc->lcoefs[LCOEF_WPAGE], &ioc->lcoefs[LCOEF_WSEQIO],
+		    &ioc->lcoefs[LCOEF_WRANDIO]);
+
+	ioc->vrate_min = div_u64(VTIME_PER_USEC * ioc->params.qos[QOS_MIN],
+				 100);
+	ioc->vrate_max = div_u64(VTIME_PER_USEC * ioc->params.qos[QOS_MAX],
+				 100);
+
+	/*
+	 * A period has to be long enough to collect meaningful latency
+	 * samples; a couple of the longer latency target does.
+	 */
+	lat = max(ioc->params.qos[QOS_RLAT], ioc->params.qos[QOS_WLAT]);
+	ioc->period_us = lat ? clamp_t(u32, 2 * lat, MIN_PERIOD, MAX_PERIOD) :
+			       DFL_PERIOD;
+	ioc->margin_us = ioc->period_us * MARGIN_PCT / 100;
+}
+
+static void ioc_now(struct ioc *ioc, struct ioc_now *now)
+{
+	unsigned int seq;
+
+	now->now_ns = ktime_get_ns();
+	now->now = div_u64(now->now_ns, NSEC_PER_USEC);
+
+	do {
+		seq = read_seqcount_begin(&ioc->period_seqcount);
+		now->vrate = atomic64_read(&ioc->vtime_rate);
+		now->vnow = ioc->period_at_vtime +
+			(now->now - ioc->period_at) * now->vrate;
+	} while (read_seqcount_retry(&ioc->period_seqcount, seq));
+}
+
+/* called with ioc->lock held */
+static void ioc_start_period(struct ioc *ioc, struct ioc_now *now, u64 vrate)
+{
+	write_seqcount_begin(&ioc->period_seqcount);
+	ioc->period_at = now->now;
+	ioc->period_at_vtime = now->vnow;
+	atomic64_set(&ioc->vtime_rate, vrate);
+	write_seqcount_end(&ioc->period_seqcount);
+
+	now->vrate = vrate;
+	atomic64_inc(&ioc->cur_period);
+	ioc->running = true;
+	mod_timer(&ioc->timer, jiffies + usecs_to_jiffies(ioc->period_us));
+}
+
+/*
+ * Update @iocg's active weight and propagate the change upwards for as long
+ * as it changes the parents' active weights.  Called with ioc->lock held,
+ * the caller has to commit_active_weights() afterwards.
+ */
+static void propagate_active_weight(struct ioc_gq *iocg, u32 active)
+{
+	struct ioc_gq *parent;
+
+	while ((parent = iocg_parent(iocg))) {
+		u32 parent_active = 0;
+
+		parent->child_active_sum += (s32)(active - iocg->active);
+		iocg->active = active;
+
+		if (parent->child_active_sum)
+			parent_active = parent->weight;
+		if (parent_active == parent->active)
+			return;
+
+		iocg = parent;
+		active = parent_active;
+	}
+
+	iocg->active = active;
+}
+
+static void commit_active_weights(struct ioc *ioc)
+{
+	/* paired with the smp_rmb() in current_hweight() */
+	smp_wmb();
+	atomic_inc(&ioc->hweight_gen);
+}
+
+/*
+ * Return @iocg's share of the device in HWEIGHT_WHOLE units.  The weights
+ * are read without ioc->lock; the result is cached until the next
+ * commit_active_weights().
+ */
+static u32 current_hweight(struct ioc_gq *iocg)
+{
+	int gen = atomic_read(&iocg->ioc->hweight_gen);
+	struct ioc_gq *child, *parent;
+	u64 hw = HWEIGHT_WHOLE;
+
+	if (gen == iocg->hweight_gen)
+		return iocg->hweight_active;
+
+	/* paired with the smp_wmb() in commit_active_weights() */
+	smp_rmb();
+
+	for (child = iocg; (parent = iocg_parent(child)); child = parent) {
+		u32 active_sum = READ_ONCE(parent->child_active_sum);
+		u32 active = READ_ONCE(child->active);
+
+		if (active_sum)
+			hw = div_u64(hw * active, active_sum);
+	}
+
+	iocg->hweight_active = max_t(u32, hw, 1);
+	iocg->hweight_gen = gen;
+	return iocg->hweight_active;
+}
+
+static void weight_updated(struct ioc_gq *iocg)
+{
+	struct ioc_cgrp *iocc = blkcg_to_iocc(iocg_to_blkg(iocg)->blkcg);
+	u32 weight = iocg->cfg_weight ?: iocc->dfl_weight;
+
+	lockdep_assert_held(&iocg->ioc->lock);
+
+	if (weight == iocg->weight)
+		return;
+
+	iocg->weight = weight;
+	if (iocg->active) {
+		propagate_active_weight(iocg, weight);
+		commit_active_weights(iocg->ioc);
+	}
+}
+
+/*
+ * Mark @iocg active for the current period, activating it first if needed.
+ * Returns false if @iocg shouldn't be controlled, i.e. it has active
+ * children.  On return @now is up to date.
+ */
+static bool iocg_activate(struct ioc_gq *iocg, struct ioc_now *now)
+{
+	struct ioc *ioc = iocg->ioc;
+	u64 cur_period, vtime, vmin;
+	struct ioc_gq *parent;
+
+	/*
+	 * If already active, just tell the timer we're still busy.  We
+	 * don't mind the occasional race.
+	 */
+	if (!list_empty(&iocg->active_list)) {
+		ioc_now(ioc, now);
+		cur_period = atomic64_read(&ioc->cur_period);
+		if (atomic64_read(&iocg->active_period) != cur_period)
+			atomic64_set(&iocg->active_period, cur_period);
+		return true;
+	}
+
+	/* racy check on internal node IOs, treat as root level IOs */
+	if (READ_ONCE(iocg->child_active_sum))
+		return false;
+
+	spin_lock_irq(&ioc->lock);
+
+	ioc_now(ioc, now);
+
+	if (!list_empty(&iocg->active_list))
+		goto succeed_unlock;
+
+	/* only leaves are controlled */
+	if (iocg->child_active_sum)
+		goto fail_unlock;
+	for (parent = iocg_parent(iocg); parent; parent = iocg_parent(parent))
+		if (!list_empty(&parent->active_list))
+			goto fail_unlock;
+
+	/* the first activation also starts the period */
+	if (!ioc->running)
+		ioc_start_period(ioc, now, atomic64_read(&ioc->vtime_rate));
+
+	/* don't let the idle time turn into a budget beyond the margin */
+	vtime = atomic64_read(&iocg->vtime);
+	vmin = now->vnow - ioc->margin_us * now->vrate;
+	if (time_before64(vtime, vmin))
+		atomic64_add(vmin - vtime, &iocg->vtime);
+
+	propagate_active_weight(iocg, iocg->weight);
+	commit_active_weights(ioc);
+	list_add(&iocg->active_list, &ioc->active_iocgs);
+
+succeed_unlock:
+	atomic64_set(&iocg->active_period, atomic64_read(&ioc->cur_period));
+	spin_unlock_irq(&ioc->lock);
+	return true;
+
+fail_unlock:
+	spin_unlock_irq(&ioc->lock);
+	return false;
+}
+
+/* called with ioc->lock held */
+static void iocg_deactivate(struct ioc_gq *iocg)
+{
+	propagate_active_weight(iocg, 0);
+	list_del_init(&iocg->active_list);
+}
+
+static int iocg_wake_fn(struct wait_queue_entry *wq_entry, unsigned int mode,
+			int flags, void *key)
+{
+	struct iocg_wait *wait = container_of(wq_entry, struct iocg_wait, wait);
+	struct iocg_wake_ctx *ctx = key;
+	u64 cost = abs_cost_to_cost(wait->abs_cost, ctx->hw_active);
+
+	ctx->vbudget -= cost;
+	if (ctx->vbudget < 0)
+		return -1;
+
+	atomic64_add(cost, &ctx->iocg->vtime);
+	atomic64_add(div64_u64(wait->abs_cost, VTIME_PER_USEC),
+		     &ctx->iocg->usage_us);
+
+	/*
+	 * The waiter's finish_wait() needs waitq.lock, which we hold, so
+	 * @wait stays around until we return.  Always remove the entry,
+	 * whether or not the task was still sleeping.
+	 */
+	list_del_init(&wq_entry->entry);
+	wait->committed = true;
+
+	default_wake_function(wq_entry, mode, flags, key);
+	return 0;
+}
+
+/*
+ * Issue as many waiters as the budget allows and arm the waitq timer for
+ * the first of the rest.  Called with iocg->waitq.lock held.
+ */
+static void iocg_kick_waitq(struct ioc_gq *iocg, struct ioc_now *now)
+{
+	struct iocg_wake_ctx ctx = { .iocg = iocg };
+	u64 vshortage, expires;
+
+	lockdep_assert_held(&iocg->waitq.lock);
+
+	ctx.hw_active = current_hweight(iocg);
+	ctx.vbudget = now->vnow - atomic64_read(&iocg->vtime);
+	__wake_up_locked_key(&iocg->waitq, TASK_NORMAL, &ctx);
+
+	if (!waitqueue_active(&iocg->waitq)) {
+		hrtimer_try_to_cancel(&iocg->waitq_timer);
+		return;
+	}
+
+	/* the first waiter's cost has been taken out of the budget */
+	vshortage = -ctx.vbudget;
+	expires = now->now_ns +
+		DIV64_U64_ROUND_UP(vshortage, now->vrate) * NSEC_PER_USEC;
+
+	hrtimer_start_range_ns(&iocg->waitq_timer, ns_to_ktime(expires),
+			       NSEC_PER_USEC, HRTIMER_MODE_ABS);
+}
+
+static enum hrtimer_restart iocg_waitq_timer_fn(struct hrtimer *timer)
+{
+	struct ioc_gq *iocg = container_of(timer, struct ioc_gq, waitq_timer);
+	struct ioc_now now;
+	unsigned long flags;
+
+	ioc_now(iocg->ioc, &now);
+
+	spin_lock_irqsave(&iocg->waitq.lock, flags);
+	iocg_kick_waitq(iocg, &now);
+	spin_unlock_irqrestore(&iocg->waitq.lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+/* issue everybody, used when the controller gets disabled */
+static void iocg_flush_waitq(struct ioc_gq *iocg)
+{
+	struct iocg_wake_ctx ctx = {
+		.iocg = iocg,
+		.hw_active = HWEIGHT_WHOLE,
+		.vbudget = S64_MAX,
+	};
+	unsigned long flags;
+
+	spin_lock_irqsave(&iocg->waitq.lock, flags);
+	__wake_up_locked_key(&iocg->waitq, TASK_NORMAL, &ctx);
+	spin_unlock_irqrestore(&iocg->waitq.lock, flags);
+}
+
+static void ioc_lat_stat(struct ioc *ioc, u32 *missed_ppm)
+{
+	int cpu, rw;
+
+	for (rw = READ; rw <= WRITE; rw++) {
+		u32 met = 0, missed = 0;
+
+		for_each_online_cpu(cpu) {
+			struct ioc_pcpu_stat *stat;
+
+			stat = per_cpu_ptr(ioc->pcpu_stat, cpu);
+			met += READ_ONCE(stat->nr_met[rw]);
+			missed += READ_ONCE(stat->nr_missed[rw]);
+		}
+
+		/* the counters wrap, only the deltas matter */
+		swap(met, ioc->last_met[rw]);
+		swap(missed, ioc->last_missed[rw]);
+		met = ioc->last_met[rw] - met;
+		missed = ioc->last_missed[rw] - missed;
+
+		if (met + missed)
+			missed_ppm[rw] = div_u64((u64)missed * 1000000,
+						 met + missed);
+		else
+			missed_ppm[rw] = 0;
+	}
+}
+
+static void ioc_timer_fn(struct timer_list *timer)
+{
+	struct ioc *ioc = container_of(timer, struct ioc, timer);
+	struct ioc_gq *iocg, *tiocg;
+	u32 ppm_rthr, ppm_wthr;
+	int nr_shortages = 0;
+	struct ioc_now now;
+	int max_level = ARRAY_SIZE(vrate_adj_pct) - 1;
+	u64 cur_period, vrate;
+	bool missed;
+	int adj;
+
+	spin_lock_irq(&ioc->lock);
+
+	ioc_refresh_params(ioc, false);
+	ioc_lat_stat(ioc, ioc->missed_ppm);
+
+	ioc_now(ioc, &now);
+	cur_period = atomic64_read(&ioc->cur_period);
+
+	/*
+	 * Kick the waiters, deactivate the groups which stayed idle for the
+	 * whole period and cap the budget banked by the others.
+	 */
+	list_for_each_entry_safe(iocg, tiocg, &ioc->active_iocgs, active_list) {
+		u64 vmin = now.vnow - ioc->margin_us * now.vrate;
+		u64 vtime = atomic64_read(&iocg->vtime);
+
+		spin_lock(&iocg->waitq.lock);
+		if (waitqueue_active(&iocg->waitq)) {
+			nr_shortages++;
+			iocg_kick_waitq(iocg, &now);
+		} else if (atomic64_read(&iocg->active_period) != cur_period ||
+			   !ioc->enabled) {
+			iocg_deactivate(iocg);
+		} else if (time_before64(vtime, vmin)) {
+			atomic64_add(vmin - vtime, &iocg->vtime);
+		}
+		spin_unlock(&iocg->waitq.lock);
+	}
+	commit_active_weights(ioc);
+
+	if (list_empty(&ioc->active_iocgs)) {
+		ioc->running = false;
+		ioc->busy_level = 0;
+		goto out_unlock;
+	}
+
+	/*
+	 * Missing the latency targets means the device is saturated, slow
+	 * down.  If the targets are met and some had to wait, speed up.
+	 */
+	ppm_rthr = (100 - ioc->params.qos[QOS_RPCT]) * 10000;
+	ppm_wthr = (100 - ioc->params.qos[QOS_WPCT]) * 10000;
+	missed = (ioc->params.qos[QOS_RPCT] &&
+		  ioc->missed_ppm[READ] > ppm_rthr) ||
+		 (ioc->params.qos[QOS_WPCT] &&
+		  ioc->missed_ppm[WRITE] > ppm_wthr);
+
+	if (missed)
+		ioc->busy_level = max(ioc->busy_level, 0) + 1;
+	else if (nr_shortages)
+		ioc->busy_level = min(ioc->busy_level, 0) - 1;
+	else
+		ioc->busy_level = 0;
+
+	ioc->busy_level = clamp(ioc->busy_level, -max_level, max_level);
+	adj = abs(ioc->busy_level);
+
+	vrate = now.vrate;
+	if (ioc->busy_level > 0)
+		vrate = div_u64(vrate * (100 - vrate_adj_pct[adj]), 100);
+	else if (ioc->busy_level < 0)
+		vrate = div_u64(vrate * (100 + vrate_adj_pct[adj]), 100);
+	vrate = clamp(vrate, ioc->vrate_min, ioc->vrate_max);
+
+	ioc_start_period(ioc, &now, vrate);
+
+out_unlock:
+	spin_unlock_irq(&ioc->lock);
+}
+
+static u64 calc_vtime_cost(struct bio *bio, struct ioc_gq *iocg, bool is_merge)
+{
+	struct ioc *ioc = iocg->ioc;
+	u64 coef_seqio, coef_randio, coef_page;
+	u64 pages = max_t(u64, bio_sectors(bio) >> IOC_SECT_TO_PAGE_SHIFT, 1);
+	u64 cost = 0;
+
+	switch (bio_op(bio)) {
+	case REQ_OP_READ:
+		coef_seqio	= ioc->lcoefs[LCOEF_RSEQIO];
+		coef_randio	= ioc->lcoefs[LCOEF_RRANDIO];
+		coef_page	= ioc->lcoefs[LCOEF_RPAGE];
+		break;
+	case REQ_OP_WRITE:
+		coef_seqio	= ioc->lcoefs[LCOEF_WSEQIO];
+		coef_randio	= ioc->lcoefs[LCOEF_WRANDIO];
+		coef_page	= ioc->lcoefs[LCOEF_WPAGE];
+		break;
+	default:
+		return 0;
+	}
+
+	if (!is_merge) {
+		s64 seek = bio->bi_iter.bi_sector - iocg->cursor;
+		u64 seek_pages = abs(seek) >> IOC_SECT_TO_PAGE_SHIFT;
+
+		if (iocg->cursor && seek_pages <= LCOEF_RANDIO_PAGES)
+			cost += coef_seqio;
+		else
+			cost += coef_randio;
+	}
+
+	return cost + pages * coef_page;
+}
+
+static void ioc_rqos_throttle(struct rq_qos *rqos, struct bio *bio)
+{
+	struct blkcg_gq *blkg = bio->bi_blkg;
+	struct ioc *ioc = rqos_to_ioc(rqos);
+	struct iocg_wait wait;
+	struct ioc_gq *iocg;
+	struct ioc_now now;
+	u64 abs_cost, cost, wait_start;
+
+	if (!ioc->enabled || !blkg || !blkg->parent)
+		return;
+
+	iocg = blkg_to_iocg(blkg);
+	if (!iocg)
+		return;
+
+	abs_cost = calc_vtime_cost(bio, iocg, false);
+	if (!abs_cost)
+		return;
+
+	iocg->cursor = bio_end_sector(bio);
+
+	if (!iocg_activate(iocg, &now))
+		return;
+
+	cost = abs_cost_to_cost(abs_cost, current_hweight(iocg));
+
+	/* in budget and nobody waiting ahead of us, issue right away */
+	if (!waitqueue_active(&iocg->waitq) &&
+	    time_before_eq64(atomic64_read(&iocg->vtime) + cost, now.vnow)) {
+		atomic64_add(cost, &iocg->vtime);
+		atomic64_add(div64_u64(abs_cost, VTIME_PER_USEC),
+			     &iocg->usage_us);
+		return;
+	}
+
+	/*
+	 * IOs issued on behalf of the root and those of dying tasks can't
+	 * wait.  Charge them anyway, the debt is paid by the following IOs.
+	 */
+	if (bio_issue_as_root_blkg(bio) || fatal_signal_pending(current)) {
+		atomic64_add(cost, &iocg->vtime);
+		atomic64_add(div64_u64(abs_cost, VTIME_PER_USEC),
+			     &iocg->usage_us);
+		return;
+	}
+
+	init_waitqueue_func_entry(&wait.wait, iocg_wake_fn);
+	wait.wait.private = current;
+	wait.bio = bio;
+	wait.abs_cost = abs_cost;
+	wait.committed = false;
+
+	spin_lock_irq(&iocg->waitq.lock);
+	__add_wait_queue_entry_tail(&iocg->waitq, &wait.wait);
+	iocg_kick_waitq(iocg, &now);
+	spin_unlock_irq(&iocg->waitq.lock);
+
+	wait_start = now.now_ns;
+	while (true) {
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		if (wait.committed)
+			break;
+		io_schedule();
+	}
+
+	/* waker already committed us, proceed */
+	finish_wait(&iocg->waitq, &wait.wait);
+	atomic64_add(div_u64(ktime_get_ns() - wait_start, NSEC_PER_USEC),
+		     &iocg->wait_us);
+}
+
+/*
+ * A bio merged into an existing request is issued without going through
+ * ->throttle() and can't sleep.  Charge its size so that it is paid for
+ * by the following IOs.
+ */
+static void ioc_rqos_merge(struct rq_qos *rqos, struct request *rq,
+			   struct bio *bio)
+{
+	struct blkcg_gq *blkg = bio->bi_blkg;
+	struct ioc *ioc = rqos_to_ioc(rqos);
+	struct ioc_gq *iocg;
+	u64 abs_cost;
+
+	if (!ioc->enabled || !blkg || !blkg->parent)
+		return;
+
+	iocg = blkg_to_iocg(blkg);
+	if (!iocg || list_empty(&iocg->active_list))
+		return;
+
+	abs_cost = calc_vtime_cost(bio, iocg, true);
+	if (!abs_cost)
+		return;
+
+	/* update the cursor if back merging */
+	if (blk_rq_pos(rq) + blk_rq_sectors(rq) == bio->bi_iter.bi_sector)
+		iocg->cursor = bio_end_sector(bio);
+
+	atomic64_add(abs_cost_to_cost(abs_cost, current_hweight(iocg)),
+		     &iocg->vtime);
+	atomic64_add(div64_u64(abs_cost, VTIME_PER_USEC), &iocg->usage_us);
+}
+
+static void ioc_rqos_done(struct rq_qos *rqos, struct request *rq)
+{
+	struct ioc *ioc = rqos_to_ioc(rqos);
+	u64 lat_ns;
+	int rw;
+
+	if (!ioc->enabled || !rq->io_start_time_ns)
+		return;
+
+	switch (req_op(rq)) {
+	case REQ_OP_READ:
+		rw = READ;
+		break;
+	case REQ_OP_WRITE:
+		rw = WRITE;
+		break;
+	default:
+		return;
+	}
+
+	lat_ns = ktime_get_ns() - rq->io_start_time_ns;
+	if (lat_ns <= (u64)ioc->params.qos[rw == READ ? QOS_RLAT : QOS_WLAT] *
+		      NSEC_PER_USEC)
+		this_cpu_inc(ioc->pcpu_stat->nr_met[rw]);
+	else
+		this_cpu_inc(ioc->pcpu_stat->nr_missed[rw]);
+}
+
+static void ioc_rqos_exit(struct rq_qos *rqos)
+{
+	struct ioc *ioc = rqos_to_ioc(rqos);
+
+	blkcg_deactivate_policy(rqos->q, &blkcg_policy_iocost);
+
+	spin_lock_irq(&ioc->lock);
+	ioc->running = false;
+	spin_unlock_irq(&ioc->lock);
+
+	del_timer_sync(&ioc->timer);
+	free_percpu(ioc->pcpu_stat);
+	kfree(ioc);
+}
+
+#ifdef CONFIG_BLK_DEBUG_FS
+static int ioc_params_show(void *data, struct seq_file *m)
+{
+	struct ioc *ioc = rqos_to_ioc(data);
+	const u32 *qos = ioc->params.qos;
+	const u64 *i = ioc->params.i_lcoefs;
+
+	seq_printf(m, "autop=%s qos=%s model=%s\n",
+		   autop_name[ioc->autop_idx],
+		   ioc->user_qos_params ? "user" : "auto",
+		   ioc->user_cost_model ? "user" : "auto");
+	seq_printf(m, "rpct=%u rlat=%u wpct=%u wlat=%u min=%u max=%u\n",
+		   qos[QOS_RPCT], qos[QOS_RLAT], qos[QOS_WPCT], qos[QOS_WLAT],
+		   qos[QOS_MIN], qos[QOS_MAX]);
+	seq_printf(m, "rbps=%llu rseqiops=%llu rrandiops=%llu\n",
+		   i[I_LCOEF_RBPS], i[I_LCOEF_RSEQIOPS], i[I_LCOEF_RRANDIOPS]);
+	seq_printf(m, "wbps=%llu wseqiops=%llu wrandiops=%llu\n",
+		   i[I_LCOEF_WBPS], i[I_LCOEF_WSEQIOPS], i[I_LCOEF_WRANDIOPS]);
+	seq_printf(m, "rpage=%llu rseqio=%llu rrandio=%llu\n",
+		   ioc->lcoefs[LCOEF_RPAGE], ioc->lcoefs[LCOEF_RSEQIO],
+		   ioc->lcoefs[LCOEF_RRANDIO]);
+	seq_printf(m, "wpage=%llu wseqio=%llu wrandio=%llu\n",
+		   ioc->lcoefs[LCOEF_WPAGE], ioc->lcoefs[LCOEF_WSEQIO],
+		   ioc->lcoefs[LCOEF_WRANDIO]);
+	return 0;
+}
+
+static int ioc_state_show(void *data, struct seq_file *m)
+{
+	struct ioc *ioc = rqos_to_ioc(data);
+	u64 vrate = atomic64_read(&ioc->vtime_rate);
+	struct ioc_gq *iocg;
+	int nr_active = 0;
+
+	spin_lock_irq(&ioc->lock);
+	list_for_each_entry(iocg, &ioc->active_iocgs, active_list)
+		nr_active++;
+	seq_printf(m, "enabled=%d running=%d period_us=%u margin_us=%u\n",
+		   ioc->enabled, ioc->running, ioc->period_us, ioc->margin_us);
+	seq_printf(m, "cur_period=%llu busy_level=%d nr_active=%d\n",
+		   (unsigned long long)atomic64_read(&ioc->cur_period),
+		   ioc->busy_level, nr_active);
+	seq_printf(m, "vrate=%llu%% rmissed_ppm=%u wmissed_ppm=%u\n",
+		   div64_u64(vrate * 100, VTIME_PER_USEC),
+		   ioc->missed_ppm[READ], ioc->missed_ppm[WRITE]);
+	spin_unlock_irq(&ioc->lock);
+	return 0;
+}
+
+static int ioc_active_show(void *data, struct seq_file *m)
+{
+	struct ioc *ioc = rqos_to_ioc(data);
+	struct ioc_gq *iocg;
+	struct ioc_now now;
+
+	ioc_now(ioc, &now);
+
+	spin_lock_irq(&ioc->lock);
+	list_for_each_entry(iocg, &ioc->active_iocgs, active_list) {
+		char path[64];
+
+		blkg_path(iocg_to_blkg(iocg), path, sizeof(path));
+		seq_printf(m, "%s weight=%u hweight=%u lag_us=%lld waiting=%d\n",
+			   path, iocg->weight,
+			   div_u64((u64)current_hweight(iocg) * 100,
+				   HWEIGHT_WHOLE),
+			   div64_s64((s64)(atomic64_read(&iocg->vtime) -
+					   now.vnow), now.vrate),
+			   waitqueue_active(&iocg->waitq));
+	}
+	spin_unlock_irq(&ioc->lock);
+	return 0;
+}
+
+static const struct blk_mq_debugfs_attr ioc_debugfs_attrs[] = {
+	{"params", 0400, ioc_params_show},
+	{"state", 0400, ioc_state_show},
+	{"active", 0400, ioc_active_show},
+	{},
+};
+#endif
+
+static struct rq_qos_ops ioc_rqos_ops = {
+	.throttle = ioc_rqos_throttle,
+	.merge = ioc_rqos_merge,
+	.done = ioc_rqos_done,
+	.exit = ioc_rqos_exit,
+#ifdef CONFIG_BLK_DEBUG_FS
+	.debugfs_attrs = ioc_debugfs_attrs,
+#endif
+};
+
+int blk_iocost_init(struct request_queue *q)
+{
+	struct ioc *ioc;
+	struct rq_qos *rqos;
+	int ret;
+
+	ioc = kzalloc(sizeof(*ioc), GFP_KERNEL);
+	if (!ioc)
+		return -ENOMEM;
+
+	ioc->pcpu_stat = alloc_percpu(struct ioc_pcpu_stat);
+	if (!ioc->pcpu_stat) {
+		kfree(ioc);
+		return -ENOMEM;
+	}
+
+	rqos = &ioc->rqos;
+	rqos->id = RQ_QOS_COST;
+	rqos->ops = &ioc_rqos_ops;
+	rqos->q = q;
+
+	spin_lock_init(&ioc->lock);
+	timer_setup(&ioc->timer, ioc_timer_fn, 0);
+	INIT_LIST_HEAD(&ioc->active_iocgs);
+	seqcount_init(&ioc->period_seqcount);
+	ioc->period_at = div_u64(ktime_get_ns(), NSEC_PER_USEC);
+	atomic64_set(&ioc->vtime_rate, VTIME_PER_USEC);
+	atomic64_set(&ioc->cur_period, 0);
+	atomic_set(&ioc->hweight_gen, 0);
+
+	ioc->autop_idx = -1;
+	spin_lock_irq(&ioc->lock);
+	ioc_refresh_params(ioc, true);
+	spin_unlock_irq(&ioc->lock);
+
+	rq_qos_add(q, rqos);
+
+	ret = blkcg_activate_policy(q, &blkcg_policy_iocost);
+	if (ret) {
+		rq_qos_del(q, rqos);
+		free_percpu(ioc->pcpu_stat);
+		kfree(ioc);
+		return ret;
+	}
+	return 0;
+}
+
+static struct blkcg_policy_data *ioc_cpd_alloc(gfp_t gfp)
+{
+	struct ioc_cgrp *iocc;
+
+	iocc = kzalloc(sizeof(struct ioc_cgrp), gfp);
+	if (!iocc)
+		return NULL;
+
+	iocc->dfl_weight = CGROUP_WEIGHT_DFL;
+	return &iocc->cpd;
+}
+
+static void ioc_cpd_free(struct blkcg_policy_data *cpd)
+{
+	kfree(container_of(cpd, struct ioc_cgrp, cpd));
+}
+
+static struct blkg_policy_data *ioc_pd_alloc(gfp_t gfp, int node)
+{
+	struct ioc_gq *iocg;
+
+	iocg = kzalloc_node(sizeof(*iocg), gfp, node);
+	if (!iocg)
+		return NULL;
+
+	return &iocg->pd;
+}
+
+static void ioc_pd_init(struct blkg_policy_data *pd)
+{
+	struct ioc_gq *iocg = pd_to_iocg(pd);
+	struct blkcg_gq *blkg = pd_to_blkg(&iocg->pd);
+	struct ioc *ioc = q_to_ioc(blkg->q);
+	struct ioc_now now;
+
+	ioc_now(ioc, &now);
+
+	iocg->ioc = ioc;
+	atomic64_set(&iocg->vtime, now.vnow);
+	atomic64_set(&iocg->active_period, atomic64_read(&ioc->cur_period));
+	INIT_LIST_HEAD(&iocg->active_list);
+	iocg->weight = blkcg_to_iocc(blkg->blkcg)->dfl_weight;
+	iocg->hweight_gen = atomic_read(&ioc->hweight_gen) - 1;
+
+	init_waitqueue_head(&iocg->waitq);
+	hrtimer_init(&iocg->waitq_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	iocg->waitq_timer.function = iocg_waitq_timer_fn;
+}
+
+static void ioc_pd_free(struct blkg_policy_data *pd)
+{
+	struct ioc_gq *iocg = pd_to_iocg(pd);
+	struct ioc *ioc = iocg->ioc;
+	unsigned long flags;
+
+	if (ioc) {
+		spin_lock_irqsave(&ioc->lock, flags);
+		if (!list_empty(&iocg->active_list)) {
+			iocg_deactivate(iocg);
+			commit_active_weights(ioc);
+		}
+		spin_unlock_irqrestore(&ioc->lock, flags);
+
+		hrtimer_cancel(&iocg->waitq_timer);
+	}
+	kfree(iocg);
+}
+
+static size_t ioc_pd_stat(struct blkg_policy_data *pd, char *buf, size_t size)
+{
+	struct ioc_gq *iocg = pd_to_iocg(pd);
+
+	if (!iocg->ioc->enabled)
+		return 0;
+
+	return scnprintf(buf, size, " cost.usage=%llu cost.wait=%llu",
+			 (unsigned long long)atomic64_read(&iocg->usage_us),
+			 (unsigned long long)atomic64_read(&iocg->wait_us));
+}
+
+static u64 ioc_weight_prfill(struct seq_file *sf, struct blkg_policy_data *pd,
+			     int off)
+{
+	const char *dname = blkg_dev_name(pd->blkg);
+	struct ioc_gq *iocg = pd_to_iocg(pd);
+
+	if (dname && iocg->cfg_weight)
+		seq_printf(sf, "%s %u\n", dname, iocg->cfg_weight);
+	return 0;
+}
+
+static int ioc_weight_show(struct seq_file *sf, void *v)
+{
+	struct blkcg *blkcg = css_to_blkcg(seq_css(sf));
+	struct ioc_cgrp *iocc = blkcg_to_iocc(blkcg);
+
+	seq_printf(sf, "default %u\n", iocc->dfl_weight);
+	blkcg_print_blkgs(sf, blkcg, ioc_weight_prfill,
+			  &blkcg_policy_iocost, seq_cft(sf)->private, false);
+	return 0;
+}
+
+static ssize_t ioc_weight_write(struct kernfs_open_file *of, char *buf,
+				size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	struct ioc_cgrp *iocc = blkcg_to_iocc(blkcg);
+	struct blkg_conf_ctx ctx;
+	struct ioc_gq *iocg;
+	u32 v;
+	int ret;
+
+	if (!strchr(buf, ':')) {
+		struct blkcg_gq *blkg;
+
+		if (sscanf(buf, "default %u", &v) != 1 &&
+		    sscanf(buf, "%u", &v) != 1)
+			return -EINVAL;
+
+		if (v < CGROUP_WEIGHT_MIN || v > CGROUP_WEIGHT_MAX)
+			return -EINVAL;
+
+		spin_lock_irq(&blkcg->lock);
+		iocc->dfl_weight = v;
+		hlist_for_each_entry(blkg, &blkcg->blkg_list, blkcg_node) {
+			iocg = blkg_to_iocg(blkg);
+			if (!iocg)
+				continue;
+
+			spin_lock(&iocg->ioc->lock);
+			weight_updated(iocg);
+			spin_unlock(&iocg->ioc->lock);
+		}
+		spin_unlock_irq(&blkcg->lock);
+
+		return nbytes;
+	}
+
+	ret = blkg_conf_prep(blkcg, &blkcg_policy_iocost, buf, &ctx);
+	if (ret)
+		return ret;
+
+	iocg = blkg_to_iocg(ctx.blkg);
+
+	if (!strncmp(ctx.body, "default", 7)) {
+		v = 0;
+	} else {
+		if (sscanf(ctx.body, "%u", &v) != 1)
+			goto einval;
+		if (v < CGROUP_WEIGHT_MIN || v > CGROUP_WEIGHT_MAX)
+			goto einval;
+	}
+
+	spin_lock(&iocg->ioc->lock);
+	iocg->cfg_weight = v;
+	weight_updated(iocg);
+	spin_unlock(&iocg->ioc->lock);
+
+	blkg_conf_finish(&ctx);
+	return nbytes;
+
+einval:
+	blkg_conf_finish(&ctx);
+	return -EINVAL;
+}
+
+static u64 ioc_qos_prfill(struct seq_file *sf, struct blkg_policy_data *pd,
+			  int off)
+{
+	const char *dname = blkg_dev_name(pd->blkg);
+	struct ioc *ioc = pd_to_iocg(pd)->ioc;
+	const u32 *qos = ioc->params.qos;
+
+	if (!dname)
+		return 0;
+
+	seq_printf(sf, "%s enable=%d ctrl=%s rpct=%u rlat=%u wpct=%u wlat=%u min=%u max=%u\n",
+		   dname, ioc->enabled, ioc->user_qos_params ? "user" : "auto",
+		   qos[QOS_RPCT], qos[QOS_RLAT], qos[QOS_WPCT], qos[QOS_WLAT],
+		   qos[QOS_MIN], qos[QOS_MAX]);
+	return 0;
+}
+
+static int ioc_qos_show(struct seq_file *sf, void *v)
+{
+	struct blkcg *blkcg = css_to_blkcg(seq_css(sf));
+
+	blkcg_print_blkgs(sf, blkcg, ioc_qos_prfill,
+			  &blkcg_policy_iocost, seq_cft(sf)->private, false);
+	return 0;
+}
+
+static const char * const qos_keys[NR_QOS_PARAMS] = {
+	[QOS_RPCT] = "rpct",
+	[QOS_RLAT] = "rlat",
+	[QOS_WPCT] = "wpct",
+	[QOS_WLAT] = "wlat",
+	[QOS_MIN] = "min",
+	[QOS_MAX] = "max",
+};
+
+static ssize_t ioc_qos_write(struct kernfs_open_file *of, char *input,
+			     size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	u32 qos[NR_QOS_PARAMS];
+	struct blkg_conf_ctx ctx;
+	struct ioc_gq *iocg;
+	bool enable, user;
+	struct ioc *ioc;
+	char *p, *tok;
+	int ret, i;
+
+	ret = blkg_conf_prep(blkcg, &blkcg_policy_iocost, input, &ctx);
+	if (ret)
+		return ret;
+
+	ioc = blkg_to_iocg(ctx.blkg)->ioc;
+
+	spin_lock(&ioc->lock);
+	memcpy(qos, ioc->params.qos, sizeof(qos));
+	enable = ioc->enabled;
+	user = ioc->user_qos_params;
+	spin_unlock(&ioc->lock);
+
+	p = ctx.body;
+	while ((tok = strsep(&p, " \t\n"))) {
+		char key[16];
+		char val[21];	/* 18446744073709551616 */
+		u32 v;
+
+		if (!*tok)
+			continue;
+
+		if (sscanf(tok, "%15[^=]=%20s", key, val) != 2)
+			goto einval;
+
+		if (!strcmp(key, "enable")) {
+			if (kstrtou32(val, 10, &v) || v > 1)
+				goto einval;
+			enable = v;
+			continue;
+		}
+		if (!strcmp(key, "ctrl")) {
+			if (!strcmp(val, "auto"))
+				user = false;
+			else if (!strcmp(val, "user"))
+				user = true;
+			else
+				goto einval;
+			continue;
+		}
+
+		for (i = 0; i < NR_QOS_PARAMS; i++)
+			if (!strcmp(key, qos_keys[i]))
+				break;
+		if (i == NR_QOS_PARAMS || kstrtou32(val, 10, &v))
+			goto einval;
+		qos[i] = v;
+		user = true;
+	}
+
+	if (qos[QOS_RPCT] > 100 || qos[QOS_WPCT] > 100 ||
+	    (qos[QOS_RPCT] && !qos[QOS_RLAT]) ||
+	    (qos[QOS_WPCT] && !qos[QOS_WLAT]) ||
+	    !qos[QOS_MIN] || qos[QOS_MIN] > qos[QOS_MAX] ||
+	    qos[QOS_MAX] > 10000)
+		goto einval;
+
+	spin_lock(&ioc->lock);
+	if (user)
+		memcpy(ioc->params.qos, qos, sizeof(qos));
+	ioc->user_qos_params = user;
+	ioc->enabled = enable;
+	ioc_refresh_params(ioc, true);
+
+	if (!enable)
+		list_for_each_entry(iocg, &ioc->active_iocgs, active_list)
+			iocg_flush_waitq(iocg);
+	spin_unlock(&ioc->lock);
+
+	/* latency targets are checked against the device issue time */
+	if (enable)
+		blk_stat_enable_accounting(ctx.disk->queue);
+
+	blkg_conf_finish(&ctx);
+	return nbytes;
+
+einval:
+	blkg_conf_finish(&ctx);
+	return -EINVAL;
+}
+
+static u64 ioc_cost_model_prfill(struct seq_file *sf,
+				 struct blkg_policy_data *pd, int off)
+{
+	const char *dname = blkg_dev_name(pd->blkg);
+	struct ioc *ioc = pd_to_iocg(pd)->ioc;
+	const u64 *u = ioc->params.i_lcoefs;
+
+	if (!dname)
+		return 0;
+
+	seq_printf(sf, "%s ctrl=%s model=linear "
+		   "rbps=%llu rseqiops=%llu rrandiops=%llu "
+		   "wbps=%llu wseqiops=%llu wrandiops=%llu\n",
+		   dname, ioc->user_cost_model ? "user" : "auto",
+		   u[I_LCOEF_RBPS], u[I_LCOEF_RSEQIOPS], u[I_LCOEF_RRANDIOPS],
+		   u[I_LCOEF_WBPS], u[I_LCOEF_WSEQIOPS], u[I_LCOEF_WRANDIOPS]);
+	return 0;
+}
+
+static int ioc_cost_model_show(struct seq_file *sf, void *v)
+{
+	struct blkcg *blkcg = css_to_blkcg(seq_css(sf));
+
+	blkcg_print_blkgs(sf, blkcg, ioc_cost_model_prfill,
+			  &blkcg_policy_iocost, seq_cft(sf)->private, false);
+	return 0;
+}
+
+static const char * const i_lcoef_keys[NR_I_LCOEFS] = {
+	[I_LCOEF_RBPS] = "rbps",
+	[I_LCOEF_RSEQIOPS] = "rseqiops",
+	[I_LCOEF_RRANDIOPS] = "rrandiops",
+	[I_LCOEF_WBPS] = "wbps",
+	[I_LCOEF_WSEQIOPS] = "wseqiops",
+	[I_LCOEF_WRANDIOPS] = "wrandiops",
+};
+
+static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
+				    size_t nbytes, loff_t off)
+{
+	struct blkcg *blkcg = css_to_blkcg(of_css(of));
+	u64 u[NR_I_LCOEFS];
+	struct blkg_conf_ctx ctx;
+	struct ioc *ioc;
+	char *p, *tok;
+	bool user;
+	int ret, i;
+
+	ret = blkg_conf_prep(blkcg, &blkcg_policy_iocost, input, &ctx);
+	if (ret)
+		return ret;
+
+	ioc = blkg_to_iocg(ctx.blkg)->ioc;
+
+	spin_lock(&ioc->lock);
+	memcpy(u, ioc->params.i_lcoefs, sizeof(u));
+	user = ioc->user_cost_model;
+	spin_unlock(&ioc->lock);
+
+	p = ctx.body;
+	while ((tok = strsep(&p, " \t\n"))) {
+		char key[16];
+		char val[21];	/* 18446744073709551616 */
+		u64 v;
+
+		if (!*tok)
+			continue;
+
+		if (sscanf(tok, "%15[^=]=%20s", key, val) != 2)
+			goto einval;
+
+		if (!strcmp(key, "ctrl")) {
+			if (!strcmp(val, "auto"))
+				user = false;
+			else if (!strcmp(val, "user"))
+				user = true;
+			else
+				goto einval;
+			continue;
+		}
+		if (!strcmp(key, "model")) {
+			if (strcmp(val, "linear"))
+				goto einval;
+			continue;
+		}
+
+		for (i = 0; i < NR_I_LCOEFS; i++)
+			if (!strcmp(key, i_lcoef_keys[i]))
+				break;
+		if (i == NR_I_LCOEFS || kstrtou64(val, 10, &v))
+			goto einval;
+		u[i] = v;
+		user = true;
+	}
+
+	spin_lock(&ioc->lock);
+	if (user)
+		memcpy(ioc->params.i_lcoefs, u, sizeof(u));
+	ioc->user_cost_model = user;
+	ioc_refresh_params(ioc, true);
+	spin_unlock(&ioc->lock);
+
+	blkg_conf_finish(&ctx);
+	return nbytes;
+
+einval:
+	blkg_conf_finish(&ctx);
+	return -EINVAL;
+}
+
+static struct cftype ioc_files[] = {
+	{
+		.name = "weight",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = ioc_weight_show,
+		.write = ioc_weight_write,
+	},
+	{
+		.name = "cost.qos",
+		.flags = CFTYPE_ONLY_ON_ROOT,
+		.seq_show = ioc_qos_show,
+		.write = ioc_qos_write,
+	},
+	{
+		.name = "cost.model",
+		.flags = CFTYPE_ONLY_ON_ROOT,
+		.seq_show = ioc_cost_model_show,
+		.write = ioc_cost_model_write,
+	},
+	{}
+};
+
+static struct blkcg_policy blkcg_policy_iocost = {
+	.dfl_cftypes	= ioc_files,
+	.cpd_alloc_fn	= ioc_cpd_alloc,
+	.cpd_free_fn	= ioc_cpd_free,
+	.pd_alloc_fn	= ioc_pd_alloc,
+	.pd_init_fn	= ioc_pd_init,
+	.pd_free_fn	= ioc_pd_free,
+	.pd_stat_fn	= ioc_pd_stat,
+};
+
+static int __init ioc_init(void)
+{
+	return blkcg_policy_register(&blkcg_policy_iocost);
+}
+
+static void __exit ioc_exit(void)
+{
+	return blkcg_policy_unregister(&blkcg_policy_iocost);
+}
+
+module_init(ioc_init);
+module_exit(ioc_exit);
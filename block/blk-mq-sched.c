@@ -450,8 +450,10 @@ static int blk_mq_sched_alloc_tags(struct request_queue *q,
 	struct blk_mq_tag_set *set = q->tag_set;
 	int ret;
 
+	/* scheduler tags stay per hardware queue */
 	hctx->sched_tags = blk_mq_alloc_rq_map(set, hctx_idx, q->nr_requests,
-					       set->reserved_tags);
+					       set->reserved_tags,
+					       set->flags & ~BLK_MQ_F_TAG_HCTX_SHARED);
 	if (!hctx->sched_tags)
 		return -ENOMEM;
 
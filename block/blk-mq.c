@@ -300,7 +300,7 @@ static struct request *blk_mq_rq_ctx_init(struct blk_mq_alloc_data *data,
 	} else {
 		if (data->hctx->flags & BLK_MQ_F_TAG_SHARED) {
 			rq_flags = RQF_MQ_INFLIGHT;
-			atomic_inc(&data->hctx->nr_active);
+			__blk_mq_inc_active_requests(data->hctx);
 		}
 		rq->tag = tag;
 		rq->internal_tag = -1;
@@ -347,12 +347,45 @@ static struct request *blk_mq_rq_ctx_init(struct blk_mq_alloc_data *data,
 	return rq;
 }
 
+/*
+ * Allocate data->nr_tags requests from one sbitmap word, return the first
+ * and park the others on data->cached_rqs. Each request holds a reference
+ * on q_usage_counter, the caller took the one for the first already.
+ */
+static struct request *blk_mq_get_request_batch(struct blk_mq_alloc_data *data)
+{
+	unsigned long tag_mask;
+	unsigned int tag_offset;
+	struct request *rq;
+	int i, nr = 0;
+
+	tag_mask = blk_mq_get_tags(data, data->nr_tags, &tag_offset);
+	if (unlikely(!tag_mask))
+		return NULL;
+
+	for (i = 0; tag_mask; i++) {
+		if (!(tag_mask & (1UL << i)))
+			continue;
+		tag_mask &= ~(1UL << i);
+		rq = blk_mq_rq_ctx_init(data, tag_offset + i, data->cmd_flags);
+		rq->elv.icq = NULL;
+		list_add_tail(&rq->queuelist, data->cached_rqs);
+		nr++;
+	}
+	percpu_ref_get_many(&data->q->q_usage_counter, nr - 1);
+	data->nr_tags = nr;
+
+	rq = list_first_entry(data->cached_rqs, struct request, queuelist);
+	list_del_init(&rq->queuelist);
+	return rq;
+}
+
 static struct request *blk_mq_get_request(struct request_queue *q,
 					  struct bio *bio,
 					  struct blk_mq_alloc_data *data)
 {
 	struct elevator_queue *e = q->elevator;
-	struct request *rq;
+	struct request *rq = NULL;
 	unsigned int tag;
 	bool put_ctx_on_error = false;
 
@@ -382,19 +415,24 @@ static struct request *blk_mq_get_request(struct request_queue *q,
 			e->type->ops.limit_depth(data->cmd_flags, data);
 	} else {
 		blk_mq_tag_busy(data->hctx);
+		if (data->nr_tags > 1)
+			rq = blk_mq_get_request_batch(data);
 	}
 
-	tag = blk_mq_get_tag(data);
-	if (tag == BLK_MQ_TAG_FAIL) {
-		if (put_ctx_on_error) {
-			blk_mq_put_ctx(data->ctx);
-			data->ctx = NULL;
+	if (!rq) {
+		tag = blk_mq_get_tag(data);
+		if (tag == BLK_MQ_TAG_FAIL) {
+			if (put_ctx_on_error) {
+				blk_mq_put_ctx(data->ctx);
+				data->ctx = NULL;
+			}
+			blk_queue_exit(q);
+			return NULL;
 		}
-		blk_queue_exit(q);
-		return NULL;
+		data->nr_tags = 1;
+		rq = blk_mq_rq_ctx_init(data, tag, data->cmd_flags);
 	}
 
-	rq = blk_mq_rq_ctx_init(data, tag, data->cmd_flags);
 	if (!op_is_flush(data->cmd_flags)) {
 		rq->elv.icq = NULL;
 		if (e && e->type->ops.prepare_request) {
@@ -516,7 +554,7 @@ void blk_mq_free_request(struct request *rq)
 
 	ctx->rq_completed[rq_is_sync(rq)]++;
 	if (rq->rq_flags & RQF_MQ_INFLIGHT)
-		atomic_dec(&hctx->nr_active);
+		__blk_mq_dec_active_requests(hctx);
 
 	if (unlikely(laptop_mode && !blk_rq_is_passthrough(rq)))
 		laptop_io_completion(q->backing_dev_info);
@@ -565,6 +603,84 @@ void blk_mq_end_request(struct request *rq, blk_status_t error)
 }
 EXPORT_SYMBOL(blk_mq_end_request);
 
+#define TAG_COMP_BATCH		32
+
+static void blk_mq_flush_tag_batch(struct blk_mq_hw_ctx *hctx, int *tag_array,
+				   int nr_tags)
+{
+	blk_mq_put_tags(hctx->tags, tag_array, nr_tags);
+	blk_mq_sched_restart(hctx);
+	percpu_ref_put_many(&hctx->queue->q_usage_counter, nr_tags);
+}
+
+/**
+ * blk_mq_end_request_batch - end a batch of successfully completed requests
+ * @rqs:	requests to end
+ * @nr:		number of entries in @rqs
+ *
+ * Description:
+ *     Like calling blk_mq_end_request(rq, BLK_STS_OK) on each request, but
+ *     the driver tags of plain requests are returned with one atomic
+ *     operation per sbitmap word instead of one per request. Requests that
+ *     need more than that (an ->end_io callback, a scheduler tag, a reserved
+ *     tag) are ended one by one.
+ */
+void blk_mq_end_request_batch(struct request **rqs, unsigned int nr)
+{
+	struct blk_mq_hw_ctx *cur_hctx = NULL;
+	int tags[TAG_COMP_BATCH], nr_tags = 0;
+	u64 now = 0;
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		struct request *rq = rqs[i];
+		struct blk_mq_hw_ctx *hctx = rq->mq_hctx;
+
+		if (blk_update_request(rq, BLK_STS_OK, blk_rq_bytes(rq)))
+			BUG();
+
+		if (rq->end_io || rq->internal_tag != -1 || rq->tag == -1 ||
+		    blk_bidi_rq(rq) || (rq->rq_flags & RQF_ELVPRIV) ||
+		    blk_mq_tag_is_reserved(hctx->tags, rq->tag)) {
+			__blk_mq_end_request(rq, BLK_STS_OK);
+			continue;
+		}
+
+		if (!now && blk_mq_need_time_stamp(rq))
+			now = ktime_get_ns();
+		if (rq->rq_flags & RQF_STATS) {
+			blk_mq_poll_stats_start(rq->q);
+			blk_stat_add(rq, now);
+		}
+		blk_account_io_done(rq, now);
+
+		rq->mq_ctx->rq_completed[rq_is_sync(rq)]++;
+		if (rq->rq_flags & RQF_MQ_INFLIGHT)
+			__blk_mq_dec_active_requests(hctx);
+		if (unlikely(laptop_mode && !blk_rq_is_passthrough(rq)))
+			laptop_io_completion(rq->q->backing_dev_info);
+		rq_qos_done(rq->q, rq);
+
+		WRITE_ONCE(rq->state, MQ_RQ_IDLE);
+		if (!refcount_dec_and_test(&rq->ref))
+			continue;
+
+		blk_pm_mark_last_busy(rq);
+		rq->mq_hctx = NULL;
+		if (nr_tags == TAG_COMP_BATCH ||
+		    (nr_tags && cur_hctx != hctx)) {
+			blk_mq_flush_tag_batch(cur_hctx, tags, nr_tags);
+			nr_tags = 0;
+		}
+		cur_hctx = hctx;
+		tags[nr_tags++] = rq->tag;
+	}
+
+	if (nr_tags)
+		blk_mq_flush_tag_batch(cur_hctx, tags, nr_tags);
+}
+EXPORT_SYMBOL_GPL(blk_mq_end_request_batch);
+
 static void __blk_mq_complete_request_remote(void *data)
 {
 	struct request *rq = data;
@@ -1059,7 +1175,7 @@ bool blk_mq_get_driver_tag(struct request *rq)
 	if (rq->tag >= 0) {
 		if (shared) {
 			rq->rq_flags |= RQF_MQ_INFLIGHT;
-			atomic_inc(&data.hctx->nr_active);
+			__blk_mq_inc_active_requests(data.hctx);
 		}
 		data.hctx->tags->rqs[rq->tag] = rq;
 	}
@@ -1096,7 +1212,12 @@ static bool blk_mq_mark_tag_wait(struct blk_mq_hw_ctx *hctx,
 	wait_queue_entry_t *wait;
 	bool ret;
 
-	if (!(hctx->flags & BLK_MQ_F_TAG_SHARED)) {
+	/*
+	 * A RESTART only triggers when this hardware queue frees a tag, with
+	 * a tag space shared between hardware queues we have to wait on the
+	 * bitmap like shared tag users do.
+	 */
+	if (!(hctx->flags & (BLK_MQ_F_TAG_SHARED | BLK_MQ_F_TAG_HCTX_SHARED))) {
 		if (!test_bit(BLK_MQ_S_SCHED_RESTART, &hctx->state))
 			set_bit(BLK_MQ_S_SCHED_RESTART, &hctx->state);
 
@@ -1115,7 +1236,7 @@ static bool blk_mq_mark_tag_wait(struct blk_mq_hw_ctx *hctx,
 	if (!list_empty_careful(&wait->entry))
 		return false;
 
-	wq = &bt_wait_ptr(&hctx->tags->bitmap_tags, hctx)->wait;
+	wq = &bt_wait_ptr(hctx->tags->bitmap_tags, hctx)->wait;
 
 	spin_lock_irq(&wq->lock);
 	spin_lock(&hctx->dispatch_wait_lock);
@@ -1226,7 +1347,8 @@ bool blk_mq_dispatch_rq_list(struct request_queue *q, struct list_head *list,
 				 * For non-shared tags, the RESTART check
 				 * will suffice.
 				 */
-				if (hctx->flags & BLK_MQ_F_TAG_SHARED)
+				if (hctx->flags & (BLK_MQ_F_TAG_SHARED |
+						   BLK_MQ_F_TAG_HCTX_SHARED))
 					no_tag = true;
 				break;
 			}
@@ -1910,6 +2032,57 @@ static void blk_add_rq_to_plug(struct blk_plug *plug, struct request *rq)
 	}
 }
 
+/*
+ * Take a request pre-allocated by blk_mq_get_request_batch() off the plug,
+ * if it was allocated for this queue and the hardware queue the bio would
+ * be mapped to from the current CPU.
+ */
+static struct request *blk_mq_get_cached_request(struct request_queue *q,
+						 struct blk_plug *plug,
+						 struct blk_mq_alloc_data *data)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+
+	if (!plug || list_empty(&plug->cached_rqs))
+		return NULL;
+
+	rq = list_first_entry(&plug->cached_rqs, struct request, queuelist);
+	if (rq->q != q)
+		return NULL;
+
+	ctx = blk_mq_get_ctx(q);
+	hctx = blk_mq_map_queue(q, data->cmd_flags, ctx->cpu);
+	if (hctx != rq->mq_hctx) {
+		blk_mq_put_ctx(ctx);
+		return NULL;
+	}
+
+	list_del_init(&rq->queuelist);
+	data->q = q;
+	data->ctx = ctx;
+	data->hctx = hctx;
+
+	rq->cmd_flags = data->cmd_flags;
+	if (blk_mq_need_time_stamp(rq))
+		rq->start_time_ns = ktime_get_ns();
+	hctx->queued++;
+	return rq;
+}
+
+void blk_mq_free_plug_rqs(struct blk_plug *plug)
+{
+	struct request *rq;
+
+	while (!list_empty(&plug->cached_rqs)) {
+		rq = list_first_entry(&plug->cached_rqs, struct request,
+				      queuelist);
+		list_del_init(&rq->queuelist);
+		blk_mq_free_request(rq);
+	}
+}
+
 static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 {
 	const int is_sync = op_is_sync(bio->bi_opf);
@@ -1937,12 +2110,28 @@ static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	rq_qos_throttle(q, bio);
 
 	data.cmd_flags = bio->bi_opf;
-	rq = blk_mq_get_request(q, bio, &data);
-	if (unlikely(!rq)) {
-		rq_qos_cleanup(q, bio);
-		if (bio->bi_opf & REQ_NOWAIT)
-			bio_wouldblock_error(bio);
-		return BLK_QC_T_NONE;
+	plug = current->plug;
+	rq = blk_mq_get_cached_request(q, plug, &data);
+	if (!rq) {
+		/*
+		 * The submitter told us how many I/Os to expect, allocate
+		 * requests for as many of them as we can in one go.
+		 */
+		if (plug && plug->nr_ios > 1 &&
+		    list_empty(&plug->cached_rqs)) {
+			data.nr_tags = plug->nr_ios;
+			data.cached_rqs = &plug->cached_rqs;
+		}
+		rq = blk_mq_get_request(q, bio, &data);
+		if (unlikely(!rq)) {
+			rq_qos_cleanup(q, bio);
+			if (bio->bi_opf & REQ_NOWAIT)
+				bio_wouldblock_error(bio);
+			return BLK_QC_T_NONE;
+		}
+		if (data.cached_rqs)
+			plug->nr_ios -= min_t(unsigned short, plug->nr_ios - 1,
+					      data.nr_tags);
 	}
 
 	trace_block_getrq(q, bio, bio->bi_opf);
@@ -1951,7 +2140,6 @@ static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 
 	cookie = request_to_qc_t(data.hctx, rq);
 
-	plug = current->plug;
 	if (unlikely(is_flush_fua)) {
 		blk_mq_put_ctx(data.ctx);
 		blk_mq_bio_to_request(rq, bio);
@@ -2064,7 +2252,8 @@ void blk_mq_free_rq_map(struct blk_mq_tags *tags)
 struct blk_mq_tags *blk_mq_alloc_rq_map(struct blk_mq_tag_set *set,
 					unsigned int hctx_idx,
 					unsigned int nr_tags,
-					unsigned int reserved_tags)
+					unsigned int reserved_tags,
+					unsigned int flags)
 {
 	struct blk_mq_tags *tags;
 	int node;
@@ -2073,11 +2262,15 @@ struct blk_mq_tags *blk_mq_alloc_rq_map(struct blk_mq_tag_set *set,
 	if (node == NUMA_NO_NODE)
 		node = set->numa_node;
 
-	tags = blk_mq_init_tags(nr_tags, reserved_tags, node,
-				BLK_MQ_FLAG_TO_ALLOC_POLICY(set->flags));
+	tags = blk_mq_init_tags(nr_tags, reserved_tags, node, flags);
 	if (!tags)
 		return NULL;
 
+	if (blk_mq_is_sbitmap_shared(flags)) {
+		tags->bitmap_tags = &set->__bitmap_tags;
+		tags->breserved_tags = &set->__breserved_tags;
+	}
+
 	tags->rqs = kcalloc_node(nr_tags, sizeof(struct request *),
 				 GFP_NOIO | __GFP_NOWARN | __GFP_NORETRY,
 				 node);
@@ -2376,7 +2569,8 @@ static bool __blk_mq_alloc_rq_map(struct blk_mq_tag_set *set, int hctx_idx)
 	int ret = 0;
 
 	set->tags[hctx_idx] = blk_mq_alloc_rq_map(set, hctx_idx,
-					set->queue_depth, set->reserved_tags);
+					set->queue_depth, set->reserved_tags,
+					set->flags);
 	if (!set->tags[hctx_idx])
 		return false;
 
@@ -3048,11 +3242,21 @@ int blk_mq_alloc_tag_set(struct blk_mq_tag_set *set)
 	if (ret)
 		goto out_free_mq_map;
 
+	/* after blk_mq_alloc_rq_maps(), which may have cut the depth */
+	if (blk_mq_is_sbitmap_shared(set->flags)) {
+		ret = blk_mq_init_shared_sbitmap(set);
+		if (ret)
+			goto out_free_mq_rq_maps;
+	}
+
 	mutex_init(&set->tag_list_lock);
 	INIT_LIST_HEAD(&set->tag_list);
 
 	return 0;
 
+out_free_mq_rq_maps:
+	for (i = 0; i < set->nr_hw_queues; i++)
+		blk_mq_free_map_and_requests(set, i);
 out_free_mq_map:
 	for (i = 0; i < set->nr_maps; i++) {
 		kfree(set->map[i].mq_map);
@@ -3071,6 +3275,9 @@ void blk_mq_free_tag_set(struct blk_mq_tag_set *set)
 	for (i = 0; i < nr_hw_queues(set); i++)
 		blk_mq_free_map_and_requests(set, i);
 
+	if (blk_mq_is_sbitmap_shared(set->flags))
+		blk_mq_exit_shared_sbitmap(set);
+
 	for (j = 0; j < set->nr_maps; j++) {
 		kfree(set->map[j].mq_map);
 		set->map[j].mq_map = NULL;
@@ -30,6 +30,9 @@ struct nullb_queue {
 	unsigned int requeue_selection;
 
 	struct nullb_cmd *cmds;
+
+	/* irqmode=0 commands waiting for the end of the dispatch batch */
+	struct llist_head comp_list;
 };
 
 struct nullb_device {
@@ -152,6 +152,10 @@ static bool shared_tags;
 module_param(shared_tags, bool, 0444);
 MODULE_PARM_DESC(shared_tags, "Share tag set between devices for blk-mq");
 
+static bool g_shared_tag_bitmap;
+module_param_named(shared_tag_bitmap, g_shared_tag_bitmap, bool, 0444);
+MODULE_PARM_DESC(shared_tag_bitmap, "Use a host-wide tag bitmap shared by all hardware queues");
+
 static int g_irqmode = NULL_IRQ_SOFTIRQ;
 
 static int null_set_irqmode(const char *str, const struct kernel_param *kp)
@@ -1230,7 +1234,11 @@ static blk_status_t null_handle_cmd(struct nullb_cmd *cmd)
 		}
 		break;
 	case NULL_IRQ_NONE:
-		end_cmd(cmd);
+		/* blk-mq commands are ended in batches by null_commit_rqs() */
+		if (dev->queue_mode == NULL_Q_MQ)
+			llist_add(&cmd->ll_list, &cmd->nq->comp_list);
+		else
+			end_cmd(cmd);
 		break;
 	case NULL_IRQ_TIMER:
 		null_cmd_end_timer(cmd);
@@ -1314,8 +1322,38 @@ static enum blk_eh_timer_return null_timeout_rq(struct request *rq, bool res)
 	return BLK_EH_DONE;
 }
 
-static blk_status_t null_queue_rq(struct blk_mq_hw_ctx *hctx,
-			 const struct blk_mq_queue_data *bd)
+#define NULL_COMP_BATCH		32
+
+/*
+ * Complete the commands null_handle_cmd() queued up for irqmode=0 since the
+ * last commit, so the tags of the whole dispatch batch are freed together.
+ */
+static void null_commit_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	struct nullb_queue *nq = hctx->driver_data;
+	struct request *rqs[NULL_COMP_BATCH];
+	struct nullb_cmd *cmd, *next;
+	struct llist_node *entry;
+	unsigned int nr = 0;
+
+	entry = llist_reverse_order(llist_del_all(&nq->comp_list));
+	llist_for_each_entry_safe(cmd, next, entry, ll_list) {
+		if (cmd->error) {
+			blk_mq_end_request(cmd->rq, cmd->error);
+			continue;
+		}
+		rqs[nr++] = cmd->rq;
+		if (nr == NULL_COMP_BATCH) {
+			blk_mq_end_request_batch(rqs, nr);
+			nr = 0;
+		}
+	}
+	if (nr)
+		blk_mq_end_request_batch(rqs, nr);
+}
+
+static blk_status_t __null_queue_rq(struct blk_mq_hw_ctx *hctx,
+				    const struct blk_mq_queue_data *bd)
 {
 	struct nullb_cmd *cmd = blk_mq_rq_to_pdu(bd->rq);
 	struct nullb_queue *nq = hctx->driver_data;
@@ -1350,8 +1388,19 @@ static blk_status_t null_queue_rq(struct blk_mq_hw_ctx *hctx,
 	return null_handle_cmd(cmd);
 }
 
+static blk_status_t null_queue_rq(struct blk_mq_hw_ctx *hctx,
+			 const struct blk_mq_queue_data *bd)
+{
+	blk_status_t sts = __null_queue_rq(hctx, bd);
+
+	if (bd->last)
+		null_commit_rqs(hctx);
+	return sts;
+}
+
 static const struct blk_mq_ops null_mq_ops = {
 	.queue_rq       = null_queue_rq,
+	.commit_rqs	= null_commit_rqs,
 	.complete	= null_complete_rq,
 	.timeout	= null_timeout_rq,
 };
@@ -1432,6 +1481,7 @@ static void null_init_queue(struct nullb *nullb, struct nullb_queue *nq)
 	BUG_ON(!nq);
 
 	init_waitqueue_head(&nq->wait);
+	init_llist_head(&nq->comp_list);
 	nq->queue_depth = nullb->queue_depth;
 	nq->dev = nullb->dev;
 }
@@ -1557,6 +1607,8 @@ static int null_init_tag_set(struct nullb *nullb, struct blk_mq_tag_set *set)
 
 	if ((nullb && nullb->dev->blocking) || g_blocking)
 		set->flags |= BLK_MQ_F_BLOCKING;
+	if (g_shared_tag_bitmap)
+		set->flags |= BLK_MQ_F_TAG_HCTX_SHARED;
 
 	return blk_mq_alloc_tag_set(set);
 }
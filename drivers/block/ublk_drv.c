@@ -0,0 +1,836 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Userspace block device - a blk-mq disk served by a userspace daemon.
+ *
+ * Every hardware queue has an area shared with the daemon holding a
+ * submission ring, a completion ring, a descriptor and a data buffer per
+ * tag, see include/uapi/linux/ublk_cmd.h.  Dispatching a request fills in
+ * its descriptor, copies write data into its buffer and queues its tag,
+ * one UBLK_IO_COMMIT_AND_FETCH from the queue's daemon thread then ends a
+ * whole batch of completions and waits for the next requests.  Nothing is
+ * framed or copied through a socket, unlike nbd.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/bitmap.h>
+#include <linux/cdev.h>
+#include <linux/device.h>
+#include <linux/fs.h>
+#include <linux/highmem.h>
+#include <linux/idr.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+#include <uapi/linux/ublk_cmd.h>
+
+#include <linux/uaccess.h>
+
+#define UBLK_PART_SHIFT		4
+#define UBLK_MAX_DEVS		1024
+/* data buffers pinned per queue */
+#define UBLK_MAX_QUEUE_BUF_BYTES (256U << 20)
+#define UBLK_COMP_BATCH		32
+
+struct ublk_device;
+
+struct ublk_queue {
+	struct ublk_device *ub;
+	unsigned int q_id;
+	u32 ring_mask;
+
+	void *map;
+	struct ublksrv_queue_ring *ring;
+	u32 *sqes;
+	struct ublksrv_io_cqe *cqes;
+	struct ublksrv_io_desc *descs;
+	void *bufs;
+
+	/* protects sq_tail, the daemon only ever sees ring->sq_tail */
+	spinlock_t lock;
+	u32 sq_tail;
+
+	/* serializes completions, cq_head is ours as well */
+	struct mutex cq_mutex;
+	u32 cq_head;
+
+	/* tags handed to the daemon and not completed yet */
+	unsigned long *inflight;
+	wait_queue_head_t wait;
+};
+
+struct ublk_device {
+	struct ublksrv_ctrl_dev_info dev_info;
+	/* the header every queue area starts with */
+	struct ublksrv_queue_ring ring_layout;
+	unsigned int buf_size;
+	unsigned int queue_map_size;
+
+	struct ublk_queue *queues;
+	struct blk_mq_tag_set tag_set;
+	struct cdev *cdev;
+
+	/* protects attached and disk */
+	struct mutex mutex;
+	bool attached;
+	struct gendisk *disk;
+
+	/* the daemon went away, fail everything */
+	bool aborted;
+	/* the disk is gone, let the daemon threads return */
+	bool shutdown;
+};
+
+static DEFINE_IDR(ublk_index_idr);
+/* serializes control commands and opens of /dev/ublkcN */
+static DEFINE_MUTEX(ublk_ctl_mutex);
+
+static int ublk_major;
+static dev_t ublk_chr_devt;
+static struct class *ublk_chr_class;
+
+static const struct block_device_operations ublk_fops = {
+	.owner =	THIS_MODULE,
+};
+
+static inline void *ublk_tag_buf(struct ublk_queue *q, unsigned int tag)
+{
+	return q->bufs + (size_t)tag * q->ub->buf_size;
+}
+
+static inline bool ublk_sq_pending(struct ublk_queue *q)
+{
+	return READ_ONCE(q->ring->sq_head) != READ_ONCE(q->sq_tail);
+}
+
+static void ublk_copy_rq(struct request *rq, void *buf, bool to_buf)
+{
+	struct req_iterator iter;
+	struct bio_vec bv;
+
+	rq_for_each_segment(bv, rq, iter) {
+		void *p = kmap_atomic(bv.bv_page);
+
+		if (to_buf) {
+			memcpy(buf, p + bv.bv_offset, bv.bv_len);
+		} else {
+			memcpy(p + bv.bv_offset, buf, bv.bv_len);
+			flush_dcache_page(bv.bv_page);
+		}
+		kunmap_atomic(p);
+		buf += bv.bv_len;
+	}
+}
+
+static blk_status_t ublk_queue_rq(struct blk_mq_hw_ctx *hctx,
+				  const struct blk_mq_queue_data *bd)
+{
+	struct ublk_queue *q = hctx->driver_data;
+	struct ublk_device *ub = q->ub;
+	struct request *rq = bd->rq;
+	struct ublksrv_io_desc *iod = &q->descs[rq->tag];
+	u32 op;
+
+	switch (req_op(rq)) {
+	case REQ_OP_READ:
+		op = UBLK_IO_OP_READ;
+		break;
+	case REQ_OP_WRITE:
+		op = UBLK_IO_OP_WRITE;
+		break;
+	case REQ_OP_FLUSH:
+		op = UBLK_IO_OP_FLUSH;
+		break;
+	case REQ_OP_DISCARD:
+		op = UBLK_IO_OP_DISCARD;
+		break;
+	case REQ_OP_WRITE_ZEROES:
+		op = UBLK_IO_OP_WRITE_ZEROES;
+		if (rq->cmd_flags & REQ_NOUNMAP)
+			op |= UBLK_IO_F_NOUNMAP;
+		break;
+	default:
+		return BLK_STS_NOTSUPP;
+	}
+
+	if (unlikely(READ_ONCE(ub->aborted)))
+		return BLK_STS_IOERR;
+	if (unlikely(op <= UBLK_IO_OP_WRITE &&
+		     blk_rq_bytes(rq) > ub->buf_size))
+		return BLK_STS_IOERR;
+
+	blk_mq_start_request(rq);
+
+	iod->op_flags = op;
+	iod->nr_sectors = blk_rq_sectors(rq);
+	iod->start_sector = blk_rq_pos(rq);
+	if (req_op(rq) == REQ_OP_WRITE)
+		ublk_copy_rq(rq, ublk_tag_buf(q, rq->tag), true);
+
+	spin_lock(&q->lock);
+	/* only a daemon completing tags it never fetched can get here */
+	if (unlikely(q->sq_tail - READ_ONCE(q->ring->sq_head) > q->ring_mask)) {
+		spin_unlock(&q->lock);
+		return BLK_STS_IOERR;
+	}
+	set_bit(rq->tag, q->inflight);
+	q->sqes[q->sq_tail & q->ring_mask] = rq->tag;
+	q->sq_tail++;
+	/* publish the descriptor, the data and the entry with the tail */
+	smp_store_release(&q->ring->sq_tail, q->sq_tail);
+	spin_unlock(&q->lock);
+
+	if (bd->last)
+		wake_up(&q->wait);
+	return BLK_STS_OK;
+}
+
+static void ublk_commit_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	struct ublk_queue *q = hctx->driver_data;
+
+	wake_up(&q->wait);
+}
+
+static int ublk_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
+			  unsigned int hctx_idx)
+{
+	struct ublk_device *ub = data;
+
+	hctx->driver_data = &ub->queues[hctx_idx];
+	return 0;
+}
+
+static const struct blk_mq_ops ublk_mq_ops = {
+	.queue_rq	= ublk_queue_rq,
+	.commit_rqs	= ublk_commit_rqs,
+	.init_hctx	= ublk_init_hctx,
+};
+
+/*
+ * End everything the daemon added to the completion ring, successful
+ * requests in batches.  Entries for tags that are not in flight are
+ * ignored, whatever the daemon writes there.
+ */
+static int ublk_commit_completions(struct ublk_queue *q)
+{
+	struct blk_mq_tags *tags = q->ub->tag_set.tags[q->q_id];
+	struct request *rqs[UBLK_COMP_BATCH];
+	unsigned int nr = 0;
+	u32 head, tail;
+
+	mutex_lock(&q->cq_mutex);
+	head = q->cq_head;
+	/* pairs with the daemon's release store of cq_tail */
+	tail = smp_load_acquire(&q->ring->cq_tail);
+	if (tail - head > q->ring_mask + 1) {
+		mutex_unlock(&q->cq_mutex);
+		return -EINVAL;
+	}
+
+	while (head != tail) {
+		struct ublksrv_io_cqe *cqe = &q->cqes[head++ & q->ring_mask];
+		u32 tag = READ_ONCE(cqe->tag);
+		s32 res = READ_ONCE(cqe->result);
+		struct request *rq;
+
+		if (tag >= q->ub->dev_info.queue_depth ||
+		    !test_and_clear_bit(tag, q->inflight))
+			continue;
+
+		rq = blk_mq_tag_to_rq(tags, tag);
+		if (res < 0) {
+			blk_mq_end_request(rq, errno_to_blk_status(res));
+			continue;
+		}
+		if (req_op(rq) == REQ_OP_READ)
+			ublk_copy_rq(rq, ublk_tag_buf(q, tag), false);
+
+		rqs[nr++] = rq;
+		if (nr == UBLK_COMP_BATCH) {
+			blk_mq_end_request_batch(rqs, nr);
+			nr = 0;
+		}
+	}
+	if (nr)
+		blk_mq_end_request_batch(rqs, nr);
+
+	q->cq_head = head;
+	WRITE_ONCE(q->ring->cq_head, head);
+	mutex_unlock(&q->cq_mutex);
+	return 0;
+}
+
+static long ublk_ch_ioctl(struct file *filp, unsigned int cmd,
+			  unsigned long arg)
+{
+	struct ublk_device *ub = filp->private_data;
+	struct ublk_queue *q;
+	int ret;
+
+	if (cmd != UBLK_IO_COMMIT_AND_FETCH)
+		return -ENOTTY;
+	if (arg >= ub->dev_info.nr_hw_queues)
+		return -EINVAL;
+	q = &ub->queues[arg];
+
+	ret = ublk_commit_completions(q);
+	if (ret)
+		return ret;
+
+	if (filp->f_flags & O_NONBLOCK)
+		return ublk_sq_pending(q) ? 0 : -EAGAIN;
+
+	ret = wait_event_interruptible(q->wait, ublk_sq_pending(q) ||
+				       READ_ONCE(ub->shutdown));
+	if (ret)
+		return ret;
+	return ublk_sq_pending(q) ? 0 : -ENODEV;
+}
+
+static int ublk_ch_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ublk_device *ub = filp->private_data;
+	unsigned long pages = ub->queue_map_size >> PAGE_SHIFT;
+	unsigned long q_id = vma->vm_pgoff / pages;
+
+	if (vma->vm_end - vma->vm_start != ub->queue_map_size ||
+	    vma->vm_pgoff % pages || q_id >= ub->dev_info.nr_hw_queues)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, ub->queues[q_id].map, 0);
+}
+
+static void ublk_queue_reset(struct ublk_queue *q)
+{
+	*q->ring = q->ub->ring_layout;
+	q->sq_tail = 0;
+	q->cq_head = 0;
+	bitmap_zero(q->inflight, q->ub->dev_info.queue_depth);
+}
+
+/*
+ * Only one daemon serves a device, and a new one can only attach while
+ * the disk is stopped: the requests a dead daemon held are failed, not
+ * handed over.
+ */
+static int ublk_ch_open(struct inode *inode, struct file *filp)
+{
+	struct ublk_device *ub;
+	int i, ret = -ENODEV;
+
+	mutex_lock(&ublk_ctl_mutex);
+	ub = idr_find(&ublk_index_idr, iminor(inode));
+	if (!ub)
+		goto out;
+
+	ret = -EBUSY;
+	mutex_lock(&ub->mutex);
+	if (!ub->attached && !ub->disk) {
+		for (i = 0; i < ub->dev_info.nr_hw_queues; i++)
+			ublk_queue_reset(&ub->queues[i]);
+		WRITE_ONCE(ub->shutdown, false);
+		ub->attached = true;
+		filp->private_data = ub;
+		ret = 0;
+	}
+	mutex_unlock(&ub->mutex);
+out:
+	mutex_unlock(&ublk_ctl_mutex);
+	return ret;
+}
+
+/* called with ub->mutex held, the daemon is gone */
+static void ublk_abort_dev(struct ublk_device *ub)
+{
+	struct request_queue *rq_q = ub->disk->queue;
+	unsigned int depth = ub->dev_info.queue_depth;
+	unsigned int tag;
+	int i;
+
+	WRITE_ONCE(ub->aborted, true);
+	blk_mq_quiesce_queue(rq_q);
+	for (i = 0; i < ub->dev_info.nr_hw_queues; i++) {
+		struct ublk_queue *q = &ub->queues[i];
+
+		for_each_set_bit(tag, q->inflight, depth) {
+			clear_bit(tag, q->inflight);
+			blk_mq_end_request(blk_mq_tag_to_rq(ub->tag_set.tags[i],
+							    tag),
+					   BLK_STS_IOERR);
+		}
+	}
+	blk_mq_unquiesce_queue(rq_q);
+}
+
+static int ublk_ch_release(struct inode *inode, struct file *filp)
+{
+	struct ublk_device *ub = filp->private_data;
+
+	mutex_lock(&ub->mutex);
+	if (ub->disk)
+		ublk_abort_dev(ub);
+	ub->attached = false;
+	mutex_unlock(&ub->mutex);
+	return 0;
+}
+
+static const struct file_operations ublk_ch_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ublk_ch_open,
+	.release	= ublk_ch_release,
+	.unlocked_ioctl	= ublk_ch_ioctl,
+	.compat_ioctl	= ublk_ch_ioctl,
+	.mmap		= ublk_ch_mmap,
+	.llseek		= noop_llseek,
+};
+
+static void ublk_config_queue(struct ublk_device *ub, struct request_queue *q)
+{
+	unsigned int bs = 1U << ub->dev_info.logical_bs_shift;
+
+	blk_queue_flag_set(QUEUE_FLAG_NONROT, q);
+	blk_queue_flag_clear(QUEUE_FLAG_ADD_RANDOM, q);
+	blk_queue_logical_block_size(q, bs);
+	blk_queue_physical_block_size(q, bs);
+	blk_queue_io_min(q, bs);
+	blk_queue_max_hw_sectors(q, ub->buf_size >> 9);
+	blk_queue_max_segment_size(q, UINT_MAX);
+	blk_queue_write_cache(q, true, false);
+
+	if (ub->dev_info.flags & UBLK_F_DISCARD) {
+		q->limits.discard_granularity = bs;
+		blk_queue_max_discard_sectors(q, UINT_MAX >> 9);
+		blk_queue_max_write_zeroes_sectors(q, UINT_MAX >> 9);
+		blk_queue_flag_set(QUEUE_FLAG_DISCARD, q);
+	}
+}
+
+static int ublk_ctrl_start_dev(struct ublk_device *ub)
+{
+	struct ublksrv_ctrl_dev_info *info = &ub->dev_info;
+	struct request_queue *q;
+	struct gendisk *disk;
+	int ret = -EBUSY;
+
+	mutex_lock(&ub->mutex);
+	if (!ub->attached || ub->disk)
+		goto out_unlock;
+
+	ret = -ENOMEM;
+	disk = alloc_disk(1 << UBLK_PART_SHIFT);
+	if (!disk)
+		goto out_unlock;
+
+	q = blk_mq_init_queue(&ub->tag_set);
+	if (IS_ERR(q)) {
+		ret = PTR_ERR(q);
+		put_disk(disk);
+		goto out_unlock;
+	}
+	q->queuedata = ub;
+	ublk_config_queue(ub, q);
+
+	disk->queue = q;
+	disk->major = ublk_major;
+	disk->first_minor = info->dev_id << UBLK_PART_SHIFT;
+	disk->fops = &ublk_fops;
+	disk->private_data = ub;
+	sprintf(disk->disk_name, "ublkb%d", info->dev_id);
+	set_capacity(disk, info->dev_sectors);
+	if (info->flags & UBLK_F_READ_ONLY)
+		set_disk_ro(disk, true);
+
+	WRITE_ONCE(ub->aborted, false);
+	WRITE_ONCE(ub->shutdown, false);
+	ub->disk = disk;
+	mutex_unlock(&ub->mutex);
+
+	/* the partition scan is served by the daemon threads already */
+	add_disk(disk);
+	return 0;
+
+out_unlock:
+	mutex_unlock(&ub->mutex);
+	return ret;
+}
+
+/*
+ * ub->disk stays set until the queue is cleaned up, so that a daemon
+ * dying meanwhile still fails what the teardown waits for.  The daemon
+ * threads are let go even if the disk was never started.
+ */
+static void ublk_stop_dev(struct ublk_device *ub)
+{
+	struct gendisk *disk;
+	int i;
+
+	mutex_lock(&ub->mutex);
+	disk = ub->disk;
+	mutex_unlock(&ub->mutex);
+	if (disk) {
+		del_gendisk(disk);
+		blk_cleanup_queue(disk->queue);
+	}
+
+	mutex_lock(&ub->mutex);
+	ub->disk = NULL;
+	WRITE_ONCE(ub->shutdown, true);
+	for (i = 0; i < ub->dev_info.nr_hw_queues; i++)
+		wake_up_all(&ub->queues[i].wait);
+	mutex_unlock(&ub->mutex);
+
+	if (disk)
+		put_disk(disk);
+}
+
+static void ublk_init_layout(struct ublk_device *ub)
+{
+	struct ublksrv_queue_ring *l = &ub->ring_layout;
+	unsigned int depth = ub->dev_info.queue_depth;
+	size_t off;
+
+	l->ring_entries = roundup_pow_of_two(depth);
+	off = ALIGN(sizeof(*l), SMP_CACHE_BYTES);
+	l->sq_off = off;
+	off = ALIGN(off + l->ring_entries * sizeof(u32), SMP_CACHE_BYTES);
+	l->cq_off = off;
+	off = ALIGN(off + l->ring_entries * sizeof(struct ublksrv_io_cqe),
+		    SMP_CACHE_BYTES);
+	l->desc_off = off;
+	off = PAGE_ALIGN(off + depth * sizeof(struct ublksrv_io_desc));
+	l->buf_off = off;
+	l->buf_size = ub->buf_size;
+
+	ub->queue_map_size = off + (size_t)depth * ub->buf_size;
+}
+
+static void ublk_free_queues(struct ublk_device *ub)
+{
+	int i;
+
+	for (i = 0; i < ub->dev_info.nr_hw_queues; i++) {
+		vfree(ub->queues[i].map);
+		bitmap_free(ub->queues[i].inflight);
+	}
+	kfree(ub->queues);
+}
+
+static int ublk_init_queues(struct ublk_device *ub)
+{
+	struct ublksrv_queue_ring *l = &ub->ring_layout;
+	int i;
+
+	ub->queues = kcalloc(ub->dev_info.nr_hw_queues, sizeof(*ub->queues),
+			     GFP_KERNEL);
+	if (!ub->queues)
+		return -ENOMEM;
+
+	for (i = 0; i < ub->dev_info.nr_hw_queues; i++) {
+		struct ublk_queue *q = &ub->queues[i];
+
+		q->ub = ub;
+		q->q_id = i;
+		q->ring_mask = l->ring_entries - 1;
+		spin_lock_init(&q->lock);
+		mutex_init(&q->cq_mutex);
+		init_waitqueue_head(&q->wait);
+
+		q->inflight = bitmap_zalloc(ub->dev_info.queue_depth,
+					    GFP_KERNEL);
+		q->map = vmalloc_user(ub->queue_map_size);
+		if (!q->inflight || !q->map) {
+			ublk_free_queues(ub);
+			return -ENOMEM;
+		}
+		q->ring = q->map;
+		q->sqes = q->map + l->sq_off;
+		q->cqes = q->map + l->cq_off;
+		q->descs = q->map + l->desc_off;
+		q->bufs = q->map + l->buf_off;
+	}
+	return 0;
+}
+
+static int ublk_check_dev_info(struct ublksrv_ctrl_dev_info *info)
+{
+	if (!info->logical_bs_shift)
+		info->logical_bs_shift = 9;
+
+	if (!info->nr_hw_queues || info->nr_hw_queues > UBLK_MAX_NR_QUEUES ||
+	    !info->queue_depth || info->queue_depth > UBLK_MAX_QUEUE_DEPTH ||
+	    info->max_io_buf_bytes > UBLK_MAX_IO_BUF_BYTES ||
+	    info->logical_bs_shift < 9 ||
+	    info->logical_bs_shift > PAGE_SHIFT ||
+	    info->flags & ~(UBLK_F_DISCARD | UBLK_F_READ_ONLY) ||
+	    info->dev_id < -1 || info->dev_id >= UBLK_MAX_DEVS)
+		return -EINVAL;
+
+	info->max_io_buf_bytes = round_up(max_t(u32, info->max_io_buf_bytes,
+						PAGE_SIZE), PAGE_SIZE);
+	if ((u64)info->queue_depth * info->max_io_buf_bytes >
+	    UBLK_MAX_QUEUE_BUF_BYTES)
+		return -EINVAL;
+	if (!info->dev_sectors ||
+	    info->dev_sectors & ((1U << (info->logical_bs_shift - 9)) - 1))
+		return -EINVAL;
+	return 0;
+}
+
+/* the device is stopped and no daemon is attached */
+static void ublk_remove(struct ublk_device *ub)
+{
+	int dev_id = ub->dev_info.dev_id;
+
+	idr_remove(&ublk_index_idr, dev_id);
+	device_destroy(ublk_chr_class, MKDEV(MAJOR(ublk_chr_devt), dev_id));
+	cdev_del(ub->cdev);
+	blk_mq_free_tag_set(&ub->tag_set);
+	ublk_free_queues(ub);
+	kfree(ub);
+}
+
+static int ublk_ctrl_add_dev(struct ublksrv_ctrl_dev_info __user *argp)
+{
+	struct ublksrv_ctrl_dev_info info;
+	struct ublk_device *ub;
+	dev_t devt;
+	int err;
+
+	if (copy_from_user(&info, argp, sizeof(info)))
+		return -EFAULT;
+	err = ublk_check_dev_info(&info);
+	if (err)
+		return err;
+
+	ub = kzalloc(sizeof(*ub), GFP_KERNEL);
+	if (!ub)
+		return -ENOMEM;
+	mutex_init(&ub->mutex);
+
+	if (info.dev_id >= 0) {
+		err = idr_alloc(&ublk_index_idr, ub, info.dev_id,
+				info.dev_id + 1, GFP_KERNEL);
+		if (err == -ENOSPC)
+			err = -EEXIST;
+	} else {
+		err = idr_alloc(&ublk_index_idr, ub, 0, UBLK_MAX_DEVS,
+				GFP_KERNEL);
+	}
+	if (err < 0)
+		goto out_free_ub;
+	info.dev_id = err;
+
+	ub->buf_size = info.max_io_buf_bytes;
+	ub->dev_info = info;
+	ublk_init_layout(ub);
+	ub->dev_info.queue_map_size = ub->queue_map_size;
+
+	err = ublk_init_queues(ub);
+	if (err)
+		goto out_free_idr;
+
+	ub->tag_set.ops = &ublk_mq_ops;
+	ub->tag_set.nr_hw_queues = info.nr_hw_queues;
+	ub->tag_set.queue_depth = info.queue_depth;
+	ub->tag_set.numa_node = NUMA_NO_NODE;
+	ub->tag_set.flags = BLK_MQ_F_SHOULD_MERGE;
+	ub->tag_set.driver_data = ub;
+	err = blk_mq_alloc_tag_set(&ub->tag_set);
+	if (err)
+		goto out_free_queues;
+
+	err = -ENOMEM;
+	ub->cdev = cdev_alloc();
+	if (!ub->cdev)
+		goto out_free_tags;
+	ub->cdev->owner = THIS_MODULE;
+	ub->cdev->ops = &ublk_ch_fops;
+	devt = MKDEV(MAJOR(ublk_chr_devt), info.dev_id);
+	err = cdev_add(ub->cdev, devt, 1);
+	if (err)
+		goto out_put_cdev;
+	device_create(ublk_chr_class, NULL, devt, NULL, "ublkc%d",
+		      info.dev_id);
+
+	if (copy_to_user(argp, &ub->dev_info, sizeof(ub->dev_info))) {
+		ublk_remove(ub);
+		return -EFAULT;
+	}
+	return 0;
+
+out_put_cdev:
+	kobject_put(&ub->cdev->kobj);
+out_free_tags:
+	blk_mq_free_tag_set(&ub->tag_set);
+out_free_queues:
+	ublk_free_queues(ub);
+out_free_idr:
+	idr_remove(&ublk_index_idr, info.dev_id);
+out_free_ub:
+	kfree(ub);
+	return err;
+}
+
+static int ublk_ctrl_del_dev(struct ublk_device *ub)
+{
+	bool busy;
+
+	mutex_lock(&ub->mutex);
+	busy = ub->attached;
+	mutex_unlock(&ub->mutex);
+	if (busy)
+		return -EBUSY;
+
+	ublk_stop_dev(ub);
+	ublk_remove(ub);
+	return 0;
+}
+
+static int ublk_ctrl_get_dev_info(struct ublksrv_ctrl_dev_info __user *argp)
+{
+	struct ublksrv_ctrl_dev_info info;
+	struct ublk_device *ub;
+	__s32 dev_id;
+
+	if (get_user(dev_id, &argp->dev_id))
+		return -EFAULT;
+	ub = dev_id >= 0 ? idr_find(&ublk_index_idr, dev_id) : NULL;
+	if (!ub)
+		return -ENODEV;
+
+	mutex_lock(&ub->mutex);
+	info = ub->dev_info;
+	info.state = ub->disk ? UBLK_S_DEV_LIVE : UBLK_S_DEV_DEAD;
+	mutex_unlock(&ub->mutex);
+
+	if (copy_to_user(argp, &info, sizeof(info)))
+		return -EFAULT;
+	return 0;
+}
+
+static long ublk_ctrl_ioctl(struct file *filp, unsigned int cmd,
+			    unsigned long arg)
+{
+	void __user *argp = (void __user *)arg;
+	struct ublk_device *ub;
+	int ret;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	mutex_lock(&ublk_ctl_mutex);
+	switch (cmd) {
+	case UBLK_CTRL_ADD_DEV:
+		ret = ublk_ctrl_add_dev(argp);
+		break;
+	case UBLK_CTRL_GET_DEV_INFO:
+		ret = ublk_ctrl_get_dev_info(argp);
+		break;
+	case UBLK_CTRL_DEL_DEV:
+	case UBLK_CTRL_START_DEV:
+	case UBLK_CTRL_STOP_DEV:
+		ub = NULL;
+		if (arg < UBLK_MAX_DEVS)
+			ub = idr_find(&ublk_index_idr, arg);
+		if (!ub) {
+			ret = -ENODEV;
+			break;
+		}
+		if (cmd == UBLK_CTRL_DEL_DEV) {
+			ret = ublk_ctrl_del_dev(ub);
+		} else if (cmd == UBLK_CTRL_START_DEV) {
+			ret = ublk_ctrl_start_dev(ub);
+		} else {
+			ublk_stop_dev(ub);
+			ret = 0;
+		}
+		break;
+	default:
+		ret = -ENOTTY;
+		break;
+	}
+	mutex_unlock(&ublk_ctl_mutex);
+	return ret;
+}
+
+static const struct file_operations ublk_ctl_fops = {
+	.owner		= THIS_MODULE,
+	.open		= nonseekable_open,
+	.unlocked_ioctl	= ublk_ctrl_ioctl,
+	.compat_ioctl	= ublk_ctrl_ioctl,
+	.llseek		= noop_llseek,
+};
+
+static struct miscdevice ublk_misc = {
+	.minor		= MISC_DYNAMIC_MINOR,
+	.name		= "ublk-control",
+	.fops		= &ublk_ctl_fops,
+};
+
+static int __init ublk_init(void)
+{
+	int ret;
+
+	BUILD_BUG_ON(sizeof(struct ublksrv_ctrl_dev_info) != 72);
+	BUILD_BUG_ON(sizeof(struct ublksrv_io_desc) != 16);
+	BUILD_BUG_ON(UBLK_MAX_QUEUE_DEPTH > (1U << 16));
+
+	ublk_major = register_blkdev(0, "ublkb");
+	if (ublk_major < 0)
+		return ublk_major;
+
+	ret = alloc_chrdev_region(&ublk_chr_devt, 0, UBLK_MAX_DEVS,
+				  "ublk-char");
+	if (ret)
+		goto out_unregister_blkdev;
+
+	ublk_chr_class = class_create(THIS_MODULE, "ublk-char");
+	if (IS_ERR(ublk_chr_class)) {
+		ret = PTR_ERR(ublk_chr_class);
+		goto out_unregister_chrdev;
+	}
+
+	ret = misc_register(&ublk_misc);
+	if (ret)
+		goto out_destroy_class;
+	return 0;
+
+out_destroy_class:
+	class_destroy(ublk_chr_class);
+out_unregister_chrdev:
+	unregister_chrdev_region(ublk_chr_devt, UBLK_MAX_DEVS);
+out_unregister_blkdev:
+	unregister_blkdev(ublk_major, "ublkb");
+	return ret;
+}
+
+static void __exit ublk_exit(void)
+{
+	struct ublk_device *ub;
+	int id;
+
+	misc_deregister(&ublk_misc);
+
+	/* an attached daemon holds a module reference */
+	idr_for_each_entry(&ublk_index_idr, ub, id) {
+		ublk_stop_dev(ub);
+		ublk_remove(ub);
+	}
+	idr_destroy(&ublk_index_idr);
+
+	class_destroy(ublk_chr_class);
+	unregister_chrdev_region(ublk_chr_devt, UBLK_MAX_DEVS);
+	unregister_blkdev(ublk_major, "ublkb");
+}
+
+module_init(ublk_init);
+module_exit(ublk_exit);
+
+MODULE_DESCRIPTION("Userspace block device");
+MODULE_LICENSE("GPL");
@@ -1464,6 +1464,9 @@ int i40e_setup_rx_descriptors(struct i40e_ring *rx_ring)
 				       rx_ring->queue_index);
 		if (err < 0)
 			goto err;
+		if (rx_ring->q_vector)
+			rx_ring->xdp_rxq.napi_id =
+				rx_ring->q_vector->napi.napi_id;
 	}
 
 	rx_ring->xdp_prog = rx_ring->vsi->xdp_prog;
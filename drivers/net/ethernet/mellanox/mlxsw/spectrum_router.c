@@ -4269,7 +4269,7 @@ mlxsw_sp_fib4_entry_type_set(struct mlxsw_sp *mlxsw_sp,
 {
 	union mlxsw_sp_l3addr dip = { .addr4 = htonl(fen_info->dst) };
 	u32 tb_id = mlxsw_sp_fix_tb_id(fen_info->tb_id);
-	struct net_device *dev = fen_info->fi->fib_dev;
+	struct net_device *dev = fib_info_nh(fen_info->fi, 0)->nh_dev;
 	struct mlxsw_sp_ipip_entry *ipip_entry;
 	struct fib_info *fi = fen_info->fi;
 
@@ -6060,6 +6060,26 @@ static int mlxsw_sp_router_fib_rule_event(unsigned long event,
 	return err;
 }
 
+/* Routes using nexthop objects are not offloaded */
+static bool mlxsw_sp_router_fib_uses_nh_obj(struct fib_notifier_info *info)
+{
+	struct fib6_entry_notifier_info *fen6_info;
+	struct fib_entry_notifier_info *fen_info;
+
+	switch (info->family) {
+	case AF_INET:
+		fen_info = container_of(info, struct fib_entry_notifier_info,
+					info);
+		return !!fen_info->fi->nh;
+	case AF_INET6:
+		fen6_info = container_of(info, struct fib6_entry_notifier_info,
+					 info);
+		return !!fen6_info->rt->nh;
+	}
+
+	return false;
+}
+
 /* Called with rcu_read_lock() */
 static int mlxsw_sp_router_fib_event(struct notifier_block *nb,
 				     unsigned long event, void *ptr)
@@ -6090,6 +6110,17 @@ static int mlxsw_sp_router_fib_event(struct notifier_block *nb,
 			NL_SET_ERR_MSG_MOD(info->extack, "FIB offload was aborted. Not configuring route");
 			return notifier_from_errno(-EINVAL);
 		}
+		/* fall through */
+	case FIB_EVENT_ENTRY_REPLACE: /* fall through */
+	case FIB_EVENT_ENTRY_APPEND:
+		if (mlxsw_sp_router_fib_uses_nh_obj(info)) {
+			NL_SET_ERR_MSG_MOD(info->extack, "Routes with nexthop objects are not supported");
+			return notifier_from_errno(-EINVAL);
+		}
+		break;
+	case FIB_EVENT_ENTRY_DEL:
+		if (mlxsw_sp_router_fib_uses_nh_obj(info))
+			return NOTIFY_DONE;
 		break;
 	}
 
@@ -2208,6 +2208,12 @@ static int rocker_router_fib_event(struct notifier_block *nb,
 	case FIB_EVENT_ENTRY_ADD: /* fall through */
 	case FIB_EVENT_ENTRY_DEL:
 		memcpy(&fib_work->fen_info, ptr, sizeof(fib_work->fen_info));
+		if (fib_work->fen_info.fi->nh) {
+			NL_SET_ERR_MSG_MOD(info->extack,
+					   "IPv4 route with nexthop objects is not supported");
+			kfree(fib_work);
+			return notifier_from_errno(-EINVAL);
+		}
 		/* Take referece on fib_info to prevent it from being
 		 * freed while work is queued. Release it afterwards.
 		 */
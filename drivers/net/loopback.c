@@ -195,6 +195,8 @@ static void loopback_setup(struct net_device *dev)
 	dev->netdev_ops		= &loopback_ops;
 	dev->needs_free_netdev	= true;
 	dev->priv_destructor	= loopback_dev_free;
+
+	netif_set_tso_max_size(dev, GSO_MAX_SIZE);
 }
 
 /* Setup and register the loopback device. */
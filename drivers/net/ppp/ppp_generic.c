@@ -1368,12 +1368,38 @@ static void ppp_dev_priv_destructor(struct net_device *dev)
 		ppp_destroy_interface(ppp);
 }
 
+static int ppp_fill_forward_path(struct net_device_path_ctx *ctx,
+				 struct net_device_path *path)
+{
+	struct ppp *ppp = netdev_priv(ctx->dev);
+	struct ppp_channel *chan;
+	struct channel *pch;
+	int err = -1;
+
+	if (ppp->flags & SC_MULTILINK)
+		return -1;
+
+	ppp_xmit_lock(ppp);
+	if (ppp->n_channels == 1) {
+		pch = list_first_entry(&ppp->channels, struct channel, clist);
+		spin_lock(&pch->downl);
+		chan = pch->chan;
+		if (chan && chan->ops->fill_forward_path)
+			err = chan->ops->fill_forward_path(ctx, path, chan);
+		spin_unlock(&pch->downl);
+	}
+	ppp_xmit_unlock(ppp);
+
+	return err;
+}
+
 static const struct net_device_ops ppp_netdev_ops = {
 	.ndo_init	 = ppp_dev_init,
 	.ndo_uninit      = ppp_dev_uninit,
 	.ndo_start_xmit  = ppp_start_xmit,
 	.ndo_do_ioctl    = ppp_net_ioctl,
 	.ndo_get_stats64 = ppp_get_stats64,
+	.ndo_fill_forward_path = ppp_fill_forward_path,
 };
 
 static struct device_type ppp_type = {
@@ -18,6 +18,7 @@
 #include <net/dst.h>
 #include <net/xfrm.h>
 #include <net/xdp.h>
+#include <net/page_pool.h>
 #include <linux/veth.h>
 #include <linux/module.h>
 #include <linux/bpf.h>
@@ -53,6 +54,14 @@ struct veth_rq {
 	bool			rx_notify_masked;
 	struct ptr_ring		xdp_ring;
 	struct xdp_rxq_info	xdp_rxq;
+	struct page_pool	*page_pool;
+};
+
+/* Pages of an skb given to XDP_TX or XDP_REDIRECT: the extra references
+ * taken by veth_xdp_get() made consume_skb() release them from the pool.
+ */
+static const struct xdp_mem_info veth_shared_mem = {
+	.type = MEM_TYPE_PAGE_SHARED,
 };
 
 struct veth_priv {
@@ -121,6 +130,7 @@ static void veth_get_strings(struct net_device *dev, u32 stringset, u8 *buf)
 				p += ETH_GSTRING_LEN;
 			}
 		}
+		page_pool_ethtool_stats_get_strings((u8 *)p);
 		break;
 	}
 }
@@ -130,12 +140,29 @@ static int veth_get_sset_count(struct net_device *dev, int sset)
 	switch (sset) {
 	case ETH_SS_STATS:
 		return ARRAY_SIZE(ethtool_stats_keys) +
-		       VETH_RQ_STATS_LEN * dev->real_num_rx_queues;
+		       VETH_RQ_STATS_LEN * dev->real_num_rx_queues +
+		       page_pool_ethtool_stats_get_count();
 	default:
 		return -EOPNOTSUPP;
 	}
 }
 
+static void veth_get_page_pool_stats(struct net_device *dev, u64 *data)
+{
+#ifdef CONFIG_PAGE_POOL_STATS
+	struct veth_priv *priv = netdev_priv(dev);
+	struct page_pool_stats pp_stats = {};
+	int i;
+
+	for (i = 0; i < dev->real_num_rx_queues; i++) {
+		if (!priv->rq[i].page_pool)
+			continue;
+		page_pool_get_stats(priv->rq[i].page_pool, &pp_stats);
+	}
+	page_pool_ethtool_stats_get(data, &pp_stats);
+#endif
+}
+
 static void veth_get_ethtool_stats(struct net_device *dev,
 		struct ethtool_stats *stats, u64 *data)
 {
@@ -160,6 +187,8 @@ static void veth_get_ethtool_stats(struct net_device *dev,
 		} while (u64_stats_fetch_retry_irq(&rq_stats->syncp, start));
 		idx += VETH_RQ_STATS_LEN;
 	}
+
+	veth_get_page_pool_stats(dev, &data[idx]);
 }
 
 static int veth_get_ts_info(struct net_device *dev,
@@ -432,7 +461,7 @@ static int veth_xdp_xmit(struct net_device *dev, int n,
 		struct xdp_frame *frame = frames[i];
 		void *ptr = veth_xdp_to_ptr(frame);
 
-		if (unlikely(frame->len > max_len ||
+		if (unlikely(xdp_get_frame_len(frame) > max_len ||
 			     __ptr_ring_produce(&rq->xdp_ring, ptr))) {
 			xdp_return_frame_rx_napi(frame);
 			drops++;
@@ -491,11 +520,15 @@ static struct sk_buff *veth_xdp_rcv_one(struct veth_rq *rq,
 {
 	void *hard_start = frame->data - frame->headroom;
 	void *head = hard_start - sizeof(struct xdp_frame);
+	bool has_frags = xdp_frame_has_frags(frame);
+	unsigned int frags_size = 0, frags_truesize = 0;
 	int len = frame->len, delta = 0;
+	struct skb_shared_info *sinfo;
 	struct xdp_frame orig_frame;
 	struct bpf_prog *xdp_prog;
 	unsigned int headroom;
 	struct sk_buff *skb;
+	u8 nr_frags = 0;
 
 	rcu_read_lock();
 	xdp_prog = rcu_dereference(rq->xdp_prog);
@@ -503,11 +536,21 @@ static struct sk_buff *veth_xdp_rcv_one(struct veth_rq *rq,
 		struct xdp_buff xdp;
 		u32 act;
 
+		if (unlikely(has_frags && !xdp_prog->aux->xdp_has_frags))
+			goto err_xdp;
+
+		xdp_init_buff(&xdp, 0, &rq->xdp_rxq);
+		if (unlikely(has_frags)) {
+			/* frame_sz is relative to the xdp_frame itself */
+			xdp.frame_sz = frame->frame_sz - sizeof(struct xdp_frame);
+			xdp.flags = frame->flags;
+		}
 		xdp.data_hard_start = hard_start;
 		xdp.data = frame->data;
 		xdp.data_end = frame->data + frame->len;
 		xdp.data_meta = frame->data - frame->metasize;
-		xdp.rxq = &rq->xdp_rxq;
+		/* trimmed fragments go back where the frame came from */
+		xdp.rxq->mem = frame->mem;
 
 		act = bpf_prog_run_xdp(xdp_prog, &xdp);
 
@@ -515,14 +558,19 @@ static struct sk_buff *veth_xdp_rcv_one(struct veth_rq *rq,
 		case XDP_PASS:
 			delta = frame->data - xdp.data;
 			len = xdp.data_end - xdp.data;
+			has_frags = xdp_buff_has_frags(&xdp);
 			break;
 		case XDP_TX:
 			orig_frame = *frame;
 			xdp.data_hard_start = head;
+			xdp.frame_sz = frame->frame_sz;
 			xdp.rxq->mem = frame->mem;
 			if (unlikely(veth_xdp_tx(rq->dev, &xdp) < 0)) {
 				trace_xdp_exception(rq->dev, xdp_prog, act);
-				frame = &orig_frame;
+				/* Restore in place, the frags info is found
+				 * relative to the frame address.
+				 */
+				*frame = orig_frame;
 				goto err_xdp;
 			}
 			*xdp_xmit |= VETH_XDP_TX;
@@ -531,9 +579,10 @@ static struct sk_buff *veth_xdp_rcv_one(struct veth_rq *rq,
 		case XDP_REDIRECT:
 			orig_frame = *frame;
 			xdp.data_hard_start = head;
+			xdp.frame_sz = frame->frame_sz;
 			xdp.rxq->mem = frame->mem;
 			if (xdp_do_redirect(rq->dev, &xdp, xdp_prog)) {
-				frame = &orig_frame;
+				*frame = orig_frame;
 				goto err_xdp;
 			}
 			*xdp_xmit |= VETH_XDP_REDIR;
@@ -551,13 +600,29 @@ static struct sk_buff *veth_xdp_rcv_one(struct veth_rq *rq,
 	}
 	rcu_read_unlock();
 
+	/* Fragments were possibly trimmed by the program, pick up their
+	 * final state before build_skb() clears the shared info.
+	 */
+	if (unlikely(has_frags)) {
+		sinfo = xdp_get_shared_info_from_frame(frame);
+		nr_frags = sinfo->nr_frags;
+		frags_size = sinfo->xdp_frags_size;
+		frags_truesize = sinfo->xdp_frags_truesize;
+	}
+
 	headroom = sizeof(struct xdp_frame) + frame->headroom - delta;
-	skb = veth_build_skb(head, headroom, len, 0);
+	skb = veth_build_skb(head, headroom, len,
+			     has_frags ? frame->frame_sz : 0);
 	if (!skb) {
 		xdp_return_frame(frame);
 		goto err;
 	}
 
+	if (unlikely(nr_frags))
+		xdp_update_skb_shared_info(skb, nr_frags, frags_size,
+					   frags_truesize,
+					   xdp_frame_is_frag_pfmemalloc(frame));
+
 	xdp_scrub_frame(frame);
 	skb->protocol = eth_type_trans(skb, rq->dev);
 err:
@@ -569,14 +634,94 @@ static struct sk_buff *veth_xdp_rcv_one(struct veth_rq *rq,
 	return NULL;
 }
 
+/* Copy @skb, whose mac header has been pushed, into a private page
+ * backed skb the XDP program is allowed to modify.  The linear part is
+ * limited to a single page; the rest of the packet goes to page sized
+ * fragments, which is only done if the program can handle multi-buffer
+ * frames (@frags).  Pages come from the rq page_pool and go back to it
+ * when the skb is freed.
+ */
+static struct sk_buff *veth_xdp_copy_skb(struct veth_rq *rq,
+					 struct sk_buff *skb, bool frags)
+{
+	u32 size, len, max_head_size, off;
+	struct sk_buff *nskb;
+	struct page *page;
+	int i, head_off;
+
+	max_head_size = SKB_WITH_OVERHEAD(PAGE_SIZE - VETH_XDP_HEADROOM);
+	if (skb->len > max_head_size &&
+	    (!frags || skb->len > PAGE_SIZE * MAX_SKB_FRAGS + max_head_size))
+		return NULL;
+
+	page = page_pool_dev_alloc_pages(rq->page_pool);
+	if (!page)
+		return NULL;
+
+	nskb = build_skb(page_address(page), PAGE_SIZE);
+	if (!nskb) {
+		page_pool_recycle_direct(rq->page_pool, page);
+		return NULL;
+	}
+	skb_mark_for_recycle(nskb);
+
+	skb_reserve(nskb, VETH_XDP_HEADROOM);
+	size = min_t(u32, skb->len, max_head_size);
+	if (skb_copy_bits(skb, 0, nskb->data, size))
+		goto err;
+	skb_put(nskb, size);
+
+	skb_copy_header(nskb, skb);
+	head_off = skb_headroom(nskb) - skb_headroom(skb);
+	skb_headers_offset_update(nskb, head_off);
+	/* skb_copy_header() also copied the recycle hint of @skb */
+	skb_mark_for_recycle(nskb);
+
+	off = size;
+	len = skb->len - off;
+
+	for (i = 0; i < MAX_SKB_FRAGS && off < skb->len; i++) {
+		page = page_pool_dev_alloc_pages(rq->page_pool);
+		if (!page)
+			goto err;
+
+		size = min_t(u32, len, PAGE_SIZE);
+		skb_add_rx_frag(nskb, i, page, 0, size, PAGE_SIZE);
+		if (skb_copy_bits(skb, off, page_address(page), size))
+			goto err;
+
+		len -= size;
+		off += size;
+	}
+
+	return nskb;
+err:
+	kfree_skb(nskb);
+	return NULL;
+}
+
+static void veth_xdp_get(struct xdp_buff *xdp)
+{
+	struct skb_shared_info *sinfo;
+	int i;
+
+	get_page(virt_to_page(xdp->data));
+	if (likely(!xdp_buff_has_frags(xdp)))
+		return;
+
+	sinfo = xdp_get_shared_info_from_buff(xdp);
+	for (i = 0; i < sinfo->nr_frags; i++)
+		__skb_frag_ref(&sinfo->frags[i]);
+}
+
 static struct sk_buff *veth_xdp_rcv_skb(struct veth_rq *rq, struct sk_buff *skb,
 					unsigned int *xdp_xmit)
 {
-	u32 pktlen, headroom, act, metalen;
 	void *orig_data, *orig_data_end;
+	u32 act, metalen, frame_sz;
 	struct bpf_prog *xdp_prog;
-	int mac_len, delta, off;
 	struct xdp_buff xdp;
+	int off;
 
 	skb_orphan(skb);
 
@@ -587,65 +732,53 @@ static struct sk_buff *veth_xdp_rcv_skb(struct veth_rq *rq, struct sk_buff *skb,
 		goto out;
 	}
 
-	mac_len = skb->data - skb_mac_header(skb);
-	pktlen = skb->len + mac_len;
-	headroom = skb_headroom(skb) - mac_len;
+	__skb_push(skb, skb->data - skb_mac_header(skb));
 
 	if (skb_shared(skb) || skb_head_is_locked(skb) ||
-	    skb_is_nonlinear(skb) || headroom < XDP_PACKET_HEADROOM) {
+	    skb_is_nonlinear(skb) || skb_headroom(skb) < XDP_PACKET_HEADROOM) {
 		struct sk_buff *nskb;
-		int size, head_off;
-		void *head, *start;
-		struct page *page;
-
-		size = SKB_DATA_ALIGN(VETH_XDP_HEADROOM + pktlen) +
-		       SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
-		if (size > PAGE_SIZE)
-			goto drop;
-
-		page = alloc_page(GFP_ATOMIC | __GFP_NOWARN);
-		if (!page)
-			goto drop;
 
-		head = page_address(page);
-		start = head + VETH_XDP_HEADROOM;
-		if (skb_copy_bits(skb, -mac_len, start, pktlen)) {
-			page_frag_free(head);
+		nskb = veth_xdp_copy_skb(rq, skb,
+					 xdp_prog->aux->xdp_has_frags);
+		if (!nskb)
 			goto drop;
-		}
 
-		nskb = veth_build_skb(head,
-				      VETH_XDP_HEADROOM + mac_len, skb->len,
-				      PAGE_SIZE);
-		if (!nskb) {
-			page_frag_free(head);
-			goto drop;
-		}
-
-		skb_copy_header(nskb, skb);
-		head_off = skb_headroom(nskb) - skb_headroom(skb);
-		skb_headers_offset_update(nskb, head_off);
 		consume_skb(skb);
 		skb = nskb;
 	}
 
+	/* The skb head always has tailroom for skb_shared_info, which
+	 * doubles as the xdp_buff fragment array.
+	 */
+	frame_sz = skb_end_pointer(skb) - skb->head;
+	frame_sz += SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+	xdp_init_buff(&xdp, frame_sz, &rq->xdp_rxq);
 	xdp.data_hard_start = skb->head;
-	xdp.data = skb_mac_header(skb);
-	xdp.data_end = xdp.data + pktlen;
+	xdp.data = skb->data;
+	xdp.data_end = xdp.data + skb_headlen(skb);
 	xdp.data_meta = xdp.data;
-	xdp.rxq = &rq->xdp_rxq;
+	if (skb_is_nonlinear(skb)) {
+		skb_shinfo(skb)->xdp_frags_size = skb->data_len;
+		skb_shinfo(skb)->xdp_frags_truesize =
+			skb_shinfo(skb)->nr_frags * PAGE_SIZE;
+		xdp_buff_set_frags_flag(&xdp);
+	}
 	orig_data = xdp.data;
 	orig_data_end = xdp.data_end;
 
+	/* Fragments only exist on page_pool copies, and are given back to
+	 * the pool if the program trims them.
+	 */
+	xdp.rxq->mem = rq->xdp_mem;
 	act = bpf_prog_run_xdp(xdp_prog, &xdp);
 
 	switch (act) {
 	case XDP_PASS:
 		break;
 	case XDP_TX:
-		get_page(virt_to_page(xdp.data));
+		veth_xdp_get(&xdp);
 		consume_skb(skb);
-		xdp.rxq->mem = rq->xdp_mem;
+		xdp.rxq->mem = veth_shared_mem;
 		if (unlikely(veth_xdp_tx(rq->dev, &xdp) < 0)) {
 			trace_xdp_exception(rq->dev, xdp_prog, act);
 			goto err_xdp;
@@ -654,9 +787,9 @@ static struct sk_buff *veth_xdp_rcv_skb(struct veth_rq *rq, struct sk_buff *skb,
 		rcu_read_unlock();
 		goto xdp_xmit;
 	case XDP_REDIRECT:
-		get_page(virt_to_page(xdp.data));
+		veth_xdp_get(&xdp);
 		consume_skb(skb);
-		xdp.rxq->mem = rq->xdp_mem;
+		xdp.rxq->mem = veth_shared_mem;
 		if (xdp_do_redirect(rq->dev, &xdp, xdp_prog))
 			goto err_xdp;
 		*xdp_xmit |= VETH_XDP_REDIR;
@@ -673,16 +806,22 @@ static struct sk_buff *veth_xdp_rcv_skb(struct veth_rq *rq, struct sk_buff *skb,
 	}
 	rcu_read_unlock();
 
-	delta = orig_data - xdp.data;
-	off = mac_len + delta;
+	/* check if bpf_xdp_adjust_head was used */
+	off = orig_data - xdp.data;
 	if (off > 0)
 		__skb_push(skb, off);
 	else if (off < 0)
 		__skb_pull(skb, -off);
-	skb->mac_header -= delta;
-	off = xdp.data_end - orig_data_end;
-	if (off != 0)
-		__skb_put(skb, off);
+
+	/* bpf_xdp_adjust_tail moves data_end and trims the fragments in
+	 * place, so only the lengths need to be refreshed here.
+	 */
+	if (xdp_buff_has_frags(&xdp))
+		skb->data_len = skb_shinfo(skb)->xdp_frags_size;
+	else
+		skb->data_len = 0;
+	skb_set_tail_pointer(skb, xdp.data_end - xdp.data);
+	skb->len = xdp.data_end - xdp.data + skb->data_len;
 	skb->protocol = eth_type_trans(skb, rq->dev);
 
 	metalen = xdp.data - xdp.data_meta;
@@ -696,7 +835,7 @@ static struct sk_buff *veth_xdp_rcv_skb(struct veth_rq *rq, struct sk_buff *skb,
 	return NULL;
 err_xdp:
 	rcu_read_unlock();
-	page_frag_free(xdp.data);
+	xdp_return_buff(&xdp);
 xdp_xmit:
 	return NULL;
 }
@@ -716,7 +855,7 @@ static int veth_xdp_rcv(struct veth_rq *rq, int budget, unsigned int *xdp_xmit)
 		if (veth_is_xdp_frame(ptr)) {
 			struct xdp_frame *frame = veth_ptr_to_xdp(ptr);
 
-			bytes += frame->len;
+			bytes += xdp_get_frame_len(frame);
 			skb = veth_xdp_rcv_one(rq, frame, &xdp_xmit_one);
 		} else {
 			skb = ptr;
@@ -770,6 +909,27 @@ static int veth_poll(struct napi_struct *napi, int budget)
 	return done;
 }
 
+static int veth_create_page_pool(struct veth_rq *rq)
+{
+	struct page_pool_params pp_params = {
+		.order = 0,
+		.pool_size = VETH_RING_SIZE,
+		.nid = NUMA_NO_NODE,
+		.dev = &rq->dev->dev,
+		.dma_dir = DMA_BIDIRECTIONAL,
+	};
+
+	rq->page_pool = page_pool_create(&pp_params);
+	if (IS_ERR(rq->page_pool)) {
+		int err = PTR_ERR(rq->page_pool);
+
+		rq->page_pool = NULL;
+		return err;
+	}
+
+	return 0;
+}
+
 static int veth_napi_add(struct net_device *dev)
 {
 	struct veth_priv *priv = netdev_priv(dev);
@@ -783,6 +943,12 @@ static int veth_napi_add(struct net_device *dev)
 			goto err_xdp_ring;
 	}
 
+	for (i = 0; i < dev->real_num_rx_queues; i++) {
+		err = veth_create_page_pool(&priv->rq[i]);
+		if (err)
+			goto err_page_pool;
+	}
+
 	for (i = 0; i < dev->real_num_rx_queues; i++) {
 		struct veth_rq *rq = &priv->rq[i];
 
@@ -791,6 +957,12 @@ static int veth_napi_add(struct net_device *dev)
 	}
 
 	return 0;
+err_page_pool:
+	for (i--; i >= 0; i--) {
+		page_pool_destroy(priv->rq[i].page_pool);
+		priv->rq[i].page_pool = NULL;
+	}
+	i = dev->real_num_rx_queues;
 err_xdp_ring:
 	for (i--; i >= 0; i--)
 		ptr_ring_cleanup(&priv->rq[i].xdp_ring, veth_ptr_free);
@@ -817,6 +989,8 @@ static void veth_napi_del(struct net_device *dev)
 		netif_napi_del(&rq->xdp_napi);
 		rq->rx_notify_masked = false;
 		ptr_ring_cleanup(&rq->xdp_ring, veth_ptr_free);
+		page_pool_destroy(rq->page_pool);
+		rq->page_pool = NULL;
 	}
 }
 
@@ -826,6 +1000,11 @@ static int veth_enable_xdp(struct net_device *dev)
 	int err, i;
 
 	if (!xdp_rxq_info_is_reg(&priv->rq[0].xdp_rxq)) {
+		/* the rxqs are registered on the page_pools */
+		err = veth_napi_add(dev);
+		if (err)
+			return err;
+
 		for (i = 0; i < dev->real_num_rx_queues; i++) {
 			struct veth_rq *rq = &priv->rq[i];
 
@@ -834,18 +1013,15 @@ static int veth_enable_xdp(struct net_device *dev)
 				goto err_rxq_reg;
 
 			err = xdp_rxq_info_reg_mem_model(&rq->xdp_rxq,
-							 MEM_TYPE_PAGE_SHARED,
-							 NULL);
+							 MEM_TYPE_PAGE_POOL,
+							 rq->page_pool);
 			if (err < 0)
 				goto err_reg_mem;
 
 			/* Save original mem info as it can be overwritten */
 			rq->xdp_mem = rq->xdp_rxq.mem;
+			rq->xdp_rxq.frag_size = PAGE_SIZE;
 		}
-
-		err = veth_napi_add(dev);
-		if (err)
-			goto err_rxq_reg;
 	}
 
 	for (i = 0; i < dev->real_num_rx_queues; i++)
@@ -857,6 +1033,7 @@ static int veth_enable_xdp(struct net_device *dev)
 err_rxq_reg:
 	for (i--; i >= 0; i--)
 		xdp_rxq_info_unreg(&priv->rq[i].xdp_rxq);
+	veth_napi_del(dev);
 
 	return err;
 }
@@ -868,13 +1045,20 @@ static void veth_disable_xdp(struct net_device *dev)
 
 	for (i = 0; i < dev->real_num_rx_queues; i++)
 		rcu_assign_pointer(priv->rq[i].xdp_prog, NULL);
-	veth_napi_del(dev);
+	/* Drop the mem models before veth_napi_del() destroys the pools,
+	 * pages still out find their pool through page->pp.
+	 */
 	for (i = 0; i < dev->real_num_rx_queues; i++) {
 		struct veth_rq *rq = &priv->rq[i];
 
 		rq->xdp_rxq.mem = rq->xdp_mem;
-		xdp_rxq_info_unreg(&rq->xdp_rxq);
+		xdp_rxq_info_unreg_mem_model(&rq->xdp_rxq);
+		/* the id may be reused, don't let unreg look it up again */
+		rq->xdp_rxq.mem = veth_shared_mem;
 	}
+	veth_napi_del(dev);
+	for (i = 0; i < dev->real_num_rx_queues; i++)
+		xdp_rxq_info_unreg(&priv->rq[i].xdp_rxq);
 }
 
 static int veth_open(struct net_device *dev)
@@ -1059,6 +1243,8 @@ static int veth_xdp_set(struct net_device *dev, struct bpf_prog *prog,
 		max_mtu = PAGE_SIZE - VETH_XDP_HEADROOM -
 			  peer->hard_header_len -
 			  SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+		if (prog->aux->xdp_has_frags)
+			max_mtu += PAGE_SIZE * MAX_SKB_FRAGS;
 		if (peer->mtu > max_mtu) {
 			NL_SET_ERR_MSG_MOD(extack, "Peer MTU is too large to set XDP");
 			err = -ERANGE;
@@ -1166,6 +1352,7 @@ static void veth_setup(struct net_device *dev)
 	dev->priv_flags |= IFF_LIVE_ADDR_CHANGE;
 	dev->priv_flags |= IFF_NO_QUEUE;
 	dev->priv_flags |= IFF_PHONY_HEADROOM;
+	dev->priv_flags |= IFF_XDP_XMIT_SG;
 
 	dev->netdev_ops = &veth_netdev_ops;
 	dev->ethtool_ops = &veth_ethtool_ops;
@@ -1183,6 +1370,7 @@ static void veth_setup(struct net_device *dev)
 	dev->hw_features = VETH_FEATURES;
 	dev->hw_enc_features = VETH_FEATURES;
 	dev->mpls_features = NETIF_F_HW_CSUM | NETIF_F_GSO_SOFTWARE;
+	netif_set_tso_max_size(dev, GSO_MAX_SIZE);
 }
 
 /*
@@ -34,6 +34,7 @@
 #include <linux/pci.h>
 #include <net/route.h>
 #include <net/xdp.h>
+#include <net/page_pool.h>
 #include <net/net_failover.h>
 
 static int napi_weight = NAPI_POLL_WEIGHT;
@@ -157,6 +158,11 @@ struct receive_queue {
 	/* Chain pages by the private ptr. */
 	struct page *pages;
 
+	/* Page pool backing big packet buffers, pages of received skbs
+	 * are recycled into it.
+	 */
+	struct page_pool *page_pool;
+
 	/* Average packet length for mergeable receive buffers. */
 	struct ewma_pkt_len mrg_avg_pkt_len;
 
@@ -319,11 +325,25 @@ static struct page *get_a_page(struct receive_queue *rq, gfp_t gfp_mask)
 		rq->pages = (struct page *)p->private;
 		/* clear private here, it is used to chain pages */
 		p->private = 0;
-	} else
+	} else if (rq->page_pool) {
+		p = page_pool_alloc_pages(rq->page_pool, gfp_mask);
+		/* recycled pages may still carry an old chain pointer */
+		if (p)
+			p->private = 0;
+	} else {
 		p = alloc_page(gfp_mask);
+	}
 	return p;
 }
 
+static void put_a_page(struct receive_queue *rq, struct page *page)
+{
+	if (rq->page_pool)
+		page_pool_put_page(rq->page_pool, page, false);
+	else
+		__free_pages(page, 0);
+}
+
 static void virtqueue_napi_schedule(struct napi_struct *napi,
 				    struct virtqueue *vq)
 {
@@ -441,6 +461,8 @@ static struct sk_buff *page_to_skb(struct virtnet_info *vi,
 		return NULL;
 	}
 	BUG_ON(offset >= PAGE_SIZE);
+	if (rq->page_pool)
+		skb_mark_for_recycle(skb);
 	while (len) {
 		unsigned int frag_size = min((unsigned)PAGE_SIZE - offset, len);
 		skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags, page, offset,
@@ -461,7 +483,9 @@ static int __virtnet_xdp_xmit_one(struct virtnet_info *vi,
 				   struct xdp_frame *xdpf)
 {
 	struct virtio_net_hdr_mrg_rxbuf *hdr;
-	int err;
+	struct skb_shared_info *shinfo;
+	u8 nr_frags = 0;
+	int err, i;
 
 	/* virtqueue want to use data area in-front of packet */
 	if (unlikely(xdpf->metasize > 0))
@@ -470,6 +494,11 @@ static int __virtnet_xdp_xmit_one(struct virtnet_info *vi,
 	if (unlikely(xdpf->headroom < vi->hdr_len))
 		return -EOVERFLOW;
 
+	if (unlikely(xdp_frame_has_frags(xdpf))) {
+		shinfo = xdp_get_shared_info_from_frame(xdpf);
+		nr_frags = shinfo->nr_frags;
+	}
+
 	/* Make room for virtqueue hdr (also change xdpf->headroom?) */
 	xdpf->data -= vi->hdr_len;
 	/* Zero header and leave csum up to XDP layers */
@@ -477,10 +506,17 @@ static int __virtnet_xdp_xmit_one(struct virtnet_info *vi,
 	memset(hdr, 0, vi->hdr_len);
 	xdpf->len   += vi->hdr_len;
 
-	sg_init_one(sq->sg, xdpf->data, xdpf->len);
+	sg_init_table(sq->sg, nr_frags + 1);
+	sg_set_buf(sq->sg, xdpf->data, xdpf->len);
+	for (i = 0; i < nr_frags; i++) {
+		skb_frag_t *frag = &shinfo->frags[i];
+
+		sg_set_page(&sq->sg[i + 1], skb_frag_page(frag),
+			    skb_frag_size(frag), frag->page_offset);
+	}
 
-	err = virtqueue_add_outbuf(sq->vq, sq->sg, 1, xdp_to_ptr(xdpf),
-				   GFP_ATOMIC);
+	err = virtqueue_add_outbuf(sq->vq, sq->sg, nr_frags + 1,
+				   xdp_to_ptr(xdpf), GFP_ATOMIC);
 	if (unlikely(err))
 		return -ENOSPC; /* Caller handle free/refcnt */
 
@@ -531,7 +567,7 @@ static int virtnet_xdp_xmit(struct net_device *dev,
 		if (likely(is_xdp_frame(ptr))) {
 			struct xdp_frame *frame = ptr_to_xdp(ptr);
 
-			bytes += frame->len;
+			bytes += xdp_get_frame_len(frame);
 			xdp_return_frame(frame);
 		} else {
 			struct sk_buff *skb = ptr;
@@ -694,11 +730,11 @@ static struct sk_buff *receive_small(struct net_device *dev,
 			page = xdp_page;
 		}
 
+		xdp_init_buff(&xdp, buflen, &rq->xdp_rxq);
 		xdp.data_hard_start = buf + VIRTNET_RX_PAD + vi->hdr_len;
 		xdp.data = xdp.data_hard_start + xdp_headroom;
 		xdp_set_data_meta_invalid(&xdp);
 		xdp.data_end = xdp.data + len;
-		xdp.rxq = &rq->xdp_rxq;
 		orig_data = xdp.data;
 		act = bpf_prog_run_xdp(xdp_prog, &xdp);
 		stats->xdp_packets++;
@@ -788,6 +824,119 @@ static struct sk_buff *receive_big(struct net_device *dev,
 	return NULL;
 }
 
+static void put_xdp_frags(struct xdp_buff *xdp)
+{
+	struct skb_shared_info *shinfo;
+	int i;
+
+	if (likely(!xdp_buff_has_frags(xdp)))
+		return;
+
+	shinfo = xdp_get_shared_info_from_buff(xdp);
+	for (i = 0; i < shinfo->nr_frags; i++)
+		put_page(skb_frag_page(&shinfo->frags[i]));
+}
+
+/* Collect the remaining @num_buf - 1 buffers of a mergeable packet as
+ * fragments of a multi-buffer xdp_buff.  On error the fragments
+ * gathered so far are released and @num_buf is left such that the
+ * caller can drop the buffers still pending in the virtqueue.
+ */
+static int virtnet_build_xdp_frags(struct net_device *dev,
+				   struct virtnet_info *vi,
+				   struct receive_queue *rq,
+				   struct xdp_buff *xdp,
+				   u16 *num_buf,
+				   struct virtnet_rq_stats *stats)
+{
+	struct skb_shared_info *shinfo = xdp_get_shared_info_from_buff(xdp);
+	unsigned int len, truesize, frags_truesize = 0;
+	struct page *page;
+	skb_frag_t *frag;
+	void *buf, *ctx;
+
+	if (unlikely(*num_buf - 1 > MAX_SKB_FRAGS)) {
+		pr_debug("%s: rx error: too many buffers (%d) for XDP\n",
+			 dev->name, *num_buf);
+		dev->stats.rx_length_errors++;
+		return -EINVAL;
+	}
+
+	shinfo->nr_frags = 0;
+	shinfo->xdp_frags_size = 0;
+	xdp_buff_set_frags_flag(xdp);
+
+	while (--*num_buf) {
+		buf = virtqueue_get_buf_ctx(rq->vq, &len, &ctx);
+		if (unlikely(!buf)) {
+			pr_debug("%s: rx error: %d buffers missing\n",
+				 dev->name, *num_buf);
+			dev->stats.rx_length_errors++;
+			*num_buf = 1;
+			goto err;
+		}
+
+		stats->bytes += len;
+		page = virt_to_head_page(buf);
+
+		truesize = mergeable_ctx_to_truesize(ctx);
+		if (unlikely(len > truesize)) {
+			pr_debug("%s: rx error: len %u exceeds truesize %lu\n",
+				 dev->name, len, (unsigned long)ctx);
+			dev->stats.rx_length_errors++;
+			put_page(page);
+			goto err;
+		}
+
+		frag = &shinfo->frags[shinfo->nr_frags++];
+		__skb_frag_set_page(frag, page);
+		frag->page_offset = buf - page_address(page);
+		skb_frag_size_set(frag, len);
+		if (page_is_pfmemalloc(page))
+			xdp_buff_set_frag_pfmemalloc(xdp);
+
+		shinfo->xdp_frags_size += len;
+		frags_truesize += truesize;
+	}
+
+	shinfo->xdp_frags_truesize = frags_truesize;
+	return 0;
+err:
+	put_xdp_frags(xdp);
+	return -EINVAL;
+}
+
+static struct sk_buff *build_skb_from_xdp_buff(struct xdp_buff *xdp)
+{
+	struct skb_shared_info *sinfo = xdp_get_shared_info_from_buff(xdp);
+	unsigned int frags_size = 0, frags_truesize = 0;
+	struct sk_buff *skb;
+	u8 nr_frags = 0;
+
+	if (unlikely(xdp->data_end > xdp_data_hard_end(xdp)))
+		return NULL;
+
+	if (unlikely(xdp_buff_has_frags(xdp))) {
+		nr_frags = sinfo->nr_frags;
+		frags_size = sinfo->xdp_frags_size;
+		frags_truesize = sinfo->xdp_frags_truesize;
+	}
+
+	skb = build_skb(xdp->data_hard_start, xdp->frame_sz);
+	if (unlikely(!skb))
+		return NULL;
+
+	skb_reserve(skb, xdp->data - xdp->data_hard_start);
+	__skb_put(skb, xdp->data_end - xdp->data);
+
+	if (unlikely(nr_frags))
+		xdp_update_skb_shared_info(skb, nr_frags, frags_size,
+					   frags_truesize,
+					   xdp_buff_is_frag_pfmemalloc(xdp));
+
+	return skb;
+}
+
 static struct sk_buff *receive_mergeable(struct net_device *dev,
 					 struct virtnet_info *vi,
 					 struct receive_queue *rq,
@@ -815,6 +964,8 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 	if (xdp_prog) {
 		struct xdp_frame *xdpf;
 		struct page *xdp_page;
+		bool xdp_frags = false;
+		unsigned int frame_sz;
 		struct xdp_buff xdp;
 		void *data;
 		u32 act;
@@ -830,9 +981,11 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 		 * or headroom is not enough because of the buffer
 		 * was refilled before XDP is set. This should only
 		 * happen for the first several packets, so we don't
-		 * care much about its performance.
+		 * care much about its performance.  Programs that can
+		 * handle multi-buffer frames get the buffers as fragments
+		 * instead.
 		 */
-		if (unlikely(num_buf > 1 ||
+		if (unlikely((num_buf > 1 && !xdp_prog->aux->xdp_has_frags) ||
 			     headroom < virtnet_get_headroom(vi))) {
 			/* linearize data for XDP */
 			xdp_page = xdp_linearize_page(rq, &num_buf,
@@ -850,17 +1003,44 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 		 * the descriptor on if we get an XDP_TX return code.
 		 */
 		data = page_address(xdp_page) + offset;
+		/* Buffers posted while XDP is enabled reserve headroom and
+		 * skb_shared_info sized tailroom around their truesize.
+		 */
+		frame_sz = mergeable_ctx_to_truesize(ctx) - vi->hdr_len +
+			   SKB_DATA_ALIGN(VIRTIO_XDP_HEADROOM +
+					  sizeof(struct skb_shared_info));
+		xdp_init_buff(&xdp, frame_sz, &rq->xdp_rxq);
 		xdp.data_hard_start = data - VIRTIO_XDP_HEADROOM + vi->hdr_len;
 		xdp.data = data + vi->hdr_len;
 		xdp_set_data_meta_invalid(&xdp);
 		xdp.data_end = xdp.data + (len - vi->hdr_len);
-		xdp.rxq = &rq->xdp_rxq;
+
+		if (unlikely(num_buf > 1)) {
+			if (virtnet_build_xdp_frags(dev, vi, rq, &xdp,
+						    &num_buf, stats))
+				goto err_xdp;
+			xdp_frags = true;
+		}
 
 		act = bpf_prog_run_xdp(xdp_prog, &xdp);
 		stats->xdp_packets++;
 
 		switch (act) {
 		case XDP_PASS:
+			/* All buffers of the packet are attached to the
+			 * xdp_buff, build the skb straight from it.
+			 */
+			if (unlikely(xdp_frags)) {
+				rcu_read_unlock();
+				head_skb = build_skb_from_xdp_buff(&xdp);
+				if (unlikely(!head_skb)) {
+					put_xdp_frags(&xdp);
+					put_page(page);
+					stats->drops++;
+				}
+				return head_skb;
+			}
+
 			/* recalculate offset to account for any header
 			 * adjustments. Note other cases do not build an
 			 * skb and avoid using offset
@@ -885,13 +1065,16 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 		case XDP_TX:
 			stats->xdp_tx++;
 			xdpf = convert_to_xdp_frame(&xdp);
-			if (unlikely(!xdpf))
+			if (unlikely(!xdpf)) {
+				put_xdp_frags(&xdp);
 				goto err_xdp;
+			}
 			err = virtnet_xdp_xmit(dev, 1, &xdpf, 0);
 			if (unlikely(err < 0)) {
 				trace_xdp_exception(vi->dev, xdp_prog, act);
 				if (unlikely(xdp_page != page))
 					put_page(xdp_page);
+				put_xdp_frags(&xdp);
 				goto err_xdp;
 			}
 			*xdp_xmit |= VIRTIO_XDP_TX;
@@ -905,6 +1088,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 			if (err) {
 				if (unlikely(xdp_page != page))
 					put_page(xdp_page);
+				put_xdp_frags(&xdp);
 				goto err_xdp;
 			}
 			*xdp_xmit |= VIRTIO_XDP_REDIR;
@@ -921,6 +1105,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 		case XDP_DROP:
 			if (unlikely(xdp_page != page))
 				__free_pages(xdp_page, 0);
+			put_xdp_frags(&xdp);
 			goto err_xdp;
 		}
 	}
@@ -1380,7 +1565,7 @@ static void free_old_xmit_skbs(struct send_queue *sq, bool in_napi)
 		} else {
 			struct xdp_frame *frame = ptr_to_xdp(ptr);
 
-			bytes += frame->len;
+			bytes += xdp_get_frame_len(frame);
 			xdp_return_frame(frame);
 		}
 		packets++;
@@ -1481,6 +1666,10 @@ static int virtnet_open(struct net_device *dev)
 			return err;
 		}
 
+		/* Mergeable buffers can be handed to XDP as fragments */
+		if (vi->mergeable_rx_bufs)
+			vi->rq[i].xdp_rxq.frag_size = PAGE_SIZE;
+
 		virtnet_napi_enable(vi->rq[i].vq, &vi->rq[i].napi);
 		virtnet_napi_tx_enable(vi, vi->sq[i].vq, &vi->sq[i].napi);
 	}
@@ -2111,6 +2300,8 @@ static void virtnet_get_strings(struct net_device *dev, u32 stringset, u8 *data)
 				p += ETH_GSTRING_LEN;
 			}
 		}
+
+		page_pool_ethtool_stats_get_strings((u8 *)p);
 		break;
 	}
 }
@@ -2122,12 +2313,27 @@ static int virtnet_get_sset_count(struct net_device *dev, int sset)
 	switch (sset) {
 	case ETH_SS_STATS:
 		return vi->curr_queue_pairs * (VIRTNET_RQ_STATS_LEN +
-					       VIRTNET_SQ_STATS_LEN);
+					       VIRTNET_SQ_STATS_LEN) +
+		       page_pool_ethtool_stats_get_count();
 	default:
 		return -EOPNOTSUPP;
 	}
 }
 
+static void virtnet_get_page_pool_stats(struct virtnet_info *vi, u64 *data)
+{
+#ifdef CONFIG_PAGE_POOL_STATS
+	struct page_pool_stats pp_stats = {};
+	unsigned int i;
+
+	for (i = 0; i < vi->curr_queue_pairs; i++)
+		if (vi->rq[i].page_pool)
+			page_pool_get_stats(vi->rq[i].page_pool, &pp_stats);
+
+	page_pool_ethtool_stats_get(data, &pp_stats);
+#endif
+}
+
 static void virtnet_get_ethtool_stats(struct net_device *dev,
 				      struct ethtool_stats *stats, u64 *data)
 {
@@ -2163,6 +2369,8 @@ static void virtnet_get_ethtool_stats(struct net_device *dev,
 		} while (u64_stats_fetch_retry_irq(&sq->stats.syncp, start));
 		idx += VIRTNET_SQ_STATS_LEN;
 	}
+
+	virtnet_get_page_pool_stats(vi, &data[idx]);
 }
 
 static void virtnet_get_channels(struct net_device *dev,
@@ -2435,6 +2643,9 @@ static int virtnet_xdp_set(struct net_device *dev, struct bpf_prog *prog,
 		return -EINVAL;
 	}
 
+	if (prog && prog->aux->xdp_has_frags && vi->mergeable_rx_bufs)
+		max_sz = dev->max_mtu;
+
 	if (dev->mtu > max_sz) {
 		NL_SET_ERR_MSG_MOD(extack, "MTU too large to enable XDP");
 		netdev_warn(dev, "XDP requires MTU less than %lu\n", max_sz);
@@ -2658,6 +2869,8 @@ static void virtnet_free_queues(struct virtnet_info *vi)
 		napi_hash_del(&vi->rq[i].napi);
 		netif_napi_del(&vi->rq[i].napi);
 		netif_napi_del(&vi->sq[i].napi);
+		if (vi->rq[i].page_pool)
+			page_pool_destroy(vi->rq[i].page_pool);
 	}
 
 	/* We called napi_hash_del() before netif_napi_del(),
@@ -2677,7 +2890,8 @@ static void _free_receive_bufs(struct virtnet_info *vi)
 
 	for (i = 0; i < vi->max_queue_pairs; i++) {
 		while (vi->rq[i].pages)
-			__free_pages(get_a_page(&vi->rq[i], GFP_KERNEL), 0);
+			put_a_page(&vi->rq[i],
+				   get_a_page(&vi->rq[i], GFP_KERNEL));
 
 		old_prog = rtnl_dereference(vi->rq[i].xdp_prog);
 		RCU_INIT_POINTER(vi->rq[i].xdp_prog, NULL);
@@ -2882,6 +3096,40 @@ static int virtnet_alloc_queues(struct virtnet_info *vi)
 	return -ENOMEM;
 }
 
+/* Big packet buffers are built from whole pages, one per skb frag, so
+ * they can be recycled through a page_pool.  Mergeable buffers are
+ * carved from page frags, which page_pool does not handle.
+ */
+static int virtnet_create_page_pools(struct virtnet_info *vi)
+{
+	struct page_pool_params pp_params = {
+		.order = 0,
+		.nid = NUMA_NO_NODE,
+		.dev = &vi->vdev->dev,
+		.dma_dir = DMA_FROM_DEVICE,
+	};
+	struct page_pool *pool;
+	int i;
+
+	if (!vi->big_packets || vi->mergeable_rx_bufs)
+		return 0;
+
+	for (i = 0; i < vi->max_queue_pairs; i++) {
+		struct receive_queue *rq = &vi->rq[i];
+
+		pp_params.pool_size =
+			min_t(unsigned int, 32768,
+			      virtqueue_get_vring_size(rq->vq) *
+			      (MAX_SKB_FRAGS + 2));
+		pool = page_pool_create(&pp_params);
+		if (IS_ERR(pool))
+			return PTR_ERR(pool);
+		rq->page_pool = pool;
+	}
+
+	return 0;
+}
+
 static int init_vqs(struct virtnet_info *vi)
 {
 	int ret;
@@ -2895,6 +3143,12 @@ static int init_vqs(struct virtnet_info *vi)
 	if (ret)
 		goto err_free;
 
+	ret = virtnet_create_page_pools(vi);
+	if (ret) {
+		virtnet_del_vqs(vi);
+		goto err;
+	}
+
 	get_online_cpus();
 	virtnet_set_affinity(vi);
 	put_online_cpus();
@@ -3022,7 +3276,8 @@ static int virtnet_probe(struct virtio_device *vdev)
 		return -ENOMEM;
 
 	/* Set up network device as normal. */
-	dev->priv_flags |= IFF_UNICAST_FLT | IFF_LIVE_ADDR_CHANGE;
+	dev->priv_flags |= IFF_UNICAST_FLT | IFF_LIVE_ADDR_CHANGE |
+			   IFF_XDP_XMIT_SG;
 	dev->netdev_ops = &virtnet_netdev;
 	dev->features = NETIF_F_HIGHDMA;
 
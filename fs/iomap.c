@@ -1666,7 +1666,7 @@ iomap_dio_bio_actor(struct inode *inode, loff_t pos, loff_t length,
 			return 0;
 		}
 
-		bio = bio_alloc(GFP_KERNEL, nr_pages);
+		bio = bio_alloc_cached(GFP_KERNEL, nr_pages, &fs_bio_set);
 		bio_set_dev(bio, iomap->bdev);
 		bio->bi_iter.bi_sector = iomap_sector(iomap, pos);
 		bio->bi_write_hint = dio->iocb->ki_hint;
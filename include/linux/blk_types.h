@@ -215,6 +215,8 @@ struct bio {
 /*
  * bio flags
  */
+#define BIO_PERCPU_CACHE 0	/* freed to its bio_set's per-cpu cache,
+				 * kept by bio_reset() */
 #define BIO_SEG_VALID	1	/* bi_phys_segments valid */
 #define BIO_CLONED	2	/* doesn't own data */
 #define BIO_BOUNCED	3	/* bio is a bounce bio */
@@ -253,7 +255,8 @@ struct bio {
 
 /*
  * Flags starting here get preserved by bio_reset() - this includes
- * only BVEC_POOL_IDX()
+ * only BVEC_POOL_IDX().  There is no bit left above them, so
+ * bio_reset() keeps BIO_PERCPU_CACHE explicitly.
  */
 #define BIO_RESET_BITS	BVEC_POOL_OFFSET
 
@@ -17,6 +17,7 @@
 #include <linux/numa.h>
 #include <linux/wait.h>
 #include <linux/u64_stats_sync.h>
+#include <linux/module.h>
 
 struct bpf_verifier_env;
 struct perf_event;
@@ -306,6 +307,24 @@ struct bpf_verifier_ops {
 				  struct bpf_prog *prog, u32 *target_size);
 };
 
+/* Kernel operation table implemented by a BPF_MAP_TYPE_STRUCT_OPS map */
+struct bpf_struct_ops {
+	const char *name;
+	/* verifier_ops of the BPF_PROG_TYPE_STRUCT_OPS programs */
+	const struct bpf_verifier_ops *verifier_ops;
+	u32 value_size;		/* size of the uapi map value */
+	u32 kdata_size;		/* size of the kernel table */
+	/* offsets of the program fds in the map value, in operation order */
+	const u32 *prog_offs;
+	u32 nr_progs;
+	/* fill in the kernel table from the map value, progs[i] is NULL
+	 * for operations left unset
+	 */
+	int (*init)(void *kdata, const void *udata, struct bpf_prog **progs);
+	int (*reg)(void *kdata);
+	void (*unreg)(void *kdata);
+};
+
 struct bpf_prog_offload_ops {
 	/* verifier basic callbacks */
 	int (*insn_hook)(struct bpf_verifier_env *env,
@@ -357,6 +376,7 @@ struct bpf_prog_aux {
 	u32 func_cnt; /* used by non-func prog as the number of func progs */
 	u32 func_idx; /* 0 for non-func prog, the index in func array for func prog */
 	bool offload_requested;
+	bool xdp_has_frags; /* loaded with BPF_F_XDP_HAS_FRAGS */
 	struct bpf_prog **func;
 	void *jit_data; /* JIT specific data. arch dependent */
 	struct latch_tree_node ksym_tnode;
@@ -644,6 +664,31 @@ static inline int bpf_map_attr_numa_node(const union bpf_attr *attr)
 struct bpf_prog *bpf_prog_get_type_path(const char *name, enum bpf_prog_type type);
 int array_map_alloc_check(union bpf_attr *attr);
 
+const struct bpf_struct_ops *bpf_struct_ops_find(u32 type);
+bool bpf_struct_ops_get(const void *kdata);
+void bpf_struct_ops_put(const void *kdata);
+struct bpf_prog *bpf_struct_ops_prog(const void *kdata, u32 idx);
+
+/* Owner of the operation tables of BPF_MAP_TYPE_STRUCT_OPS maps, their
+ * users hold a reference on the map rather than on a module.
+ */
+#define BPF_MODULE_OWNER ((void *)((0xeB9FUL << 2) + POISON_POINTER_DELTA))
+
+static inline bool bpf_try_module_get(const void *data, struct module *owner)
+{
+	if (owner == BPF_MODULE_OWNER)
+		return bpf_struct_ops_get(data);
+	return try_module_get(owner);
+}
+
+static inline void bpf_module_put(const void *data, struct module *owner)
+{
+	if (owner == BPF_MODULE_OWNER)
+		bpf_struct_ops_put(data);
+	else
+		module_put(owner);
+}
+
 #else /* !CONFIG_BPF_SYSCALL */
 static inline struct bpf_prog *bpf_prog_get(u32 ufd)
 {
@@ -755,6 +800,16 @@ static inline struct bpf_prog *bpf_prog_get_type_path(const char *name,
 {
 	return ERR_PTR(-EOPNOTSUPP);
 }
+
+static inline bool bpf_try_module_get(const void *data, struct module *owner)
+{
+	return try_module_get(owner);
+}
+
+static inline void bpf_module_put(const void *data, struct module *owner)
+{
+	module_put(owner);
+}
 #endif /* CONFIG_BPF_SYSCALL */
 
 static inline struct bpf_prog *bpf_prog_get_type(u32 ufd,
@@ -931,6 +986,8 @@ extern const struct bpf_func_proto bpf_spin_lock_proto;
 extern const struct bpf_func_proto bpf_spin_unlock_proto;
 extern const struct bpf_func_proto bpf_get_local_storage_proto;
 
+const struct bpf_func_proto *bpf_base_func_proto(enum bpf_func_id func_id);
+
 /* Shared helpers among cBPF and eBPF. */
 void bpf_user_rnd_init_once(void);
 u64 bpf_user_rnd_u32(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5);
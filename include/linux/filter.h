@@ -900,6 +900,32 @@ bpf_run_sk_reuseport(struct sock_reuseport *reuse, struct sock *sk,
 }
 #endif
 
+#ifdef CONFIG_INET
+DECLARE_STATIC_KEY_FALSE(bpf_sk_lookup_enabled);
+
+struct sock *bpf_sk_lookup_run_v4(struct net *net, int protocol,
+				  __be32 saddr, __be16 sport,
+				  __be32 daddr, u16 dport);
+#if IS_ENABLED(CONFIG_IPV6)
+struct sock *bpf_sk_lookup_run_v6(struct net *net, int protocol,
+				  const struct in6_addr *saddr, __be16 sport,
+				  const struct in6_addr *daddr, u16 dport);
+#endif
+int sk_lookup_prog_attach(const union bpf_attr *attr, struct bpf_prog *prog);
+int sk_lookup_prog_detach(const union bpf_attr *attr);
+#else
+static inline int sk_lookup_prog_attach(const union bpf_attr *attr,
+					struct bpf_prog *prog)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int sk_lookup_prog_detach(const union bpf_attr *attr)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
 #ifdef CONFIG_BPF_JIT
 extern int bpf_jit_enable;
 extern int bpf_jit_harden;
@@ -418,6 +418,24 @@ void sbitmap_queue_resize(struct sbitmap_queue *sbq, unsigned int depth);
  */
 int __sbitmap_queue_get(struct sbitmap_queue *sbq);
 
+/**
+ * __sbitmap_queue_get_batch() - Try to allocate a batch of free bits from a
+ * &struct sbitmap_queue with preemption already disabled.
+ * @sbq: Bitmap queue to allocate from.
+ * @nr_tags: Number of bits wanted.
+ * @offset: Output parameter; bit number that bit 0 of the returned mask
+ *          stands for.
+ *
+ * The bits all come from a single word of the map and are claimed with one
+ * atomic operation, so fewer than @nr_tags may be returned. Not supported on
+ * round robin bitmaps.
+ *
+ * Return: Mask of the allocated bits relative to @offset, 0 if none could be
+ * allocated.
+ */
+unsigned long __sbitmap_queue_get_batch(struct sbitmap_queue *sbq, int nr_tags,
+					unsigned int *offset);
+
 /**
  * __sbitmap_queue_get_shallow() - Try to allocate a free bit from a &struct
  * sbitmap_queue, limiting the depth used from each word, with preemption
@@ -507,6 +525,19 @@ void sbitmap_queue_min_shallow_depth(struct sbitmap_queue *sbq,
 void sbitmap_queue_clear(struct sbitmap_queue *sbq, unsigned int nr,
 			 unsigned int cpu);
 
+/**
+ * sbitmap_queue_clear_batch() - Free a batch of allocated bits and wake up
+ * waiters on a &struct sbitmap_queue.
+ * @sbq: Bitmap to free from.
+ * @offset: Value to subtract from each entry of @tags to get its bit number.
+ * @tags: Bits to free, ideally grouped by word.
+ * @nr_tags: Number of entries in @tags.
+ *
+ * Bits sharing a word of the map are cleared with a single atomic operation.
+ */
+void sbitmap_queue_clear_batch(struct sbitmap_queue *sbq, int offset,
+			       int *tags, int nr_tags);
+
 static inline int sbq_index_inc(int index)
 {
 	return (index + 1) & (SBQ_WAIT_QUEUES - 1);
@@ -303,6 +303,7 @@ void sk_psock_stop_strp(struct sock *sk, struct sk_psock *psock);
 
 int sk_psock_msg_verdict(struct sock *sk, struct sk_psock *psock,
 			 struct sk_msg *msg);
+int sk_psock_tls_strp_read(struct sk_psock *psock, struct sk_buff *skb);
 
 static inline struct sk_psock_link *sk_psock_init_link(void)
 {
@@ -417,6 +418,11 @@ static inline void sk_psock_put(struct sock *sk, struct sk_psock *psock)
 		sk_psock_drop(sk, psock);
 }
 
+static inline bool sk_psock_strp_enabled(struct sk_psock *psock)
+{
+	return psock && psock->parser.enabled;
+}
+
 static inline void sk_psock_data_ready(struct sock *sk, struct sk_psock *psock)
 {
 	if (psock->parser.enabled)
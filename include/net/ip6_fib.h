@@ -39,10 +39,12 @@
 
 struct rt6_info;
 struct fib6_info;
+struct nexthop;
 
 struct fib6_config {
 	u32		fc_table;
 	u32		fc_metric;
+	u32		fc_nh_id;
 	int		fc_dst_len;
 	int		fc_src_len;
 	int		fc_ifindex;
@@ -146,6 +148,9 @@ struct fib6_info {
 	struct list_head		fib6_siblings;
 	unsigned int			fib6_nsiblings;
 
+	/* routes using the same nexthop object, see nexthop->f6i_list */
+	struct list_head		nh_list;
+
 	atomic_t			fib6_ref;
 	unsigned long			expires;
 	struct dst_metrics		*fib6_metrics;
@@ -174,6 +179,7 @@ struct fib6_info {
 					unused:3;
 
 	struct fib6_nh			fib6_nh;
+	struct nexthop			*nh;
 	struct rcu_head			rcu;
 };
 
@@ -438,15 +444,26 @@ void rt6_get_prefsrc(const struct rt6_info *rt, struct in6_addr *addr)
 	rcu_read_unlock();
 }
 
+/* Routes using a nexthop object leave their own fib6_nh unused */
+struct fib6_nh *nexthop_fib6_nh(struct nexthop *nh);
+
+static inline struct fib6_nh *fib6_info_nh(const struct fib6_info *f6i)
+{
+	if (unlikely(f6i->nh))
+		return nexthop_fib6_nh(f6i->nh);
+
+	return (struct fib6_nh *)&f6i->fib6_nh;
+}
+
 static inline struct net_device *fib6_info_nh_dev(const struct fib6_info *f6i)
 {
-	return f6i->fib6_nh.nh_dev;
+	return fib6_info_nh(f6i)->nh_dev;
 }
 
 static inline
 struct lwtunnel_state *fib6_info_nh_lwt(const struct fib6_info *f6i)
 {
-	return f6i->fib6_nh.nh_lwtstate;
+	return fib6_info_nh(f6i)->nh_lwtstate;
 }
 
 void inet6_rt_notify(int event, struct fib6_info *rt, struct nl_info *info,
@@ -483,6 +500,11 @@ int fib6_tables_dump(struct net *net, struct notifier_block *nb);
 void fib6_update_sernum(struct net *net, struct fib6_info *rt);
 void fib6_update_sernum_upto_root(struct net *net, struct fib6_info *rt);
 
+int fib6_nh_init(struct net *net, struct fib6_nh *fib6_nh,
+		 struct fib6_config *cfg, gfp_t gfp_flags,
+		 struct netlink_ext_ack *extack);
+void fib6_nh_release(struct fib6_nh *fib6_nh);
+
 void fib6_metric_set(struct fib6_info *f6i, int metric, u32 val);
 static inline bool fib6_metric_locked(struct fib6_info *f6i, int metric)
 {
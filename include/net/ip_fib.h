@@ -34,6 +34,7 @@ struct fib_config {
 	u8			fc_type;
 	/* 3 bytes unused */
 	u32			fc_table;
+	u32			fc_nh_id;
 	__be32			fc_dst;
 	__be32			fc_gw;
 	int			fc_oif;
@@ -52,6 +53,7 @@ struct fib_config {
 };
 
 struct fib_info;
+struct nexthop;
 struct rtable;
 
 struct fib_nh_exception {
@@ -123,11 +125,32 @@ struct fib_info {
 #define fib_rtt fib_metrics->metrics[RTAX_RTT-1]
 #define fib_advmss fib_metrics->metrics[RTAX_ADVMSS-1]
 	int			fib_nhs;
+	struct list_head	nh_list;
+	struct nexthop		*nh;
 	struct rcu_head		rcu;
 	struct fib_nh		fib_nh[0];
-#define fib_dev		fib_nh[0].nh_dev
 };
 
+/* Routes using a nexthop object have no fib_nh array of their own */
+struct fib_nh *nexthop_fib_nh(struct nexthop *nh, int nhsel);
+int nexthop_num_path(const struct nexthop *nh);
+
+static inline int fib_info_num_path(const struct fib_info *fi)
+{
+	if (unlikely(fi->nh))
+		return nexthop_num_path(fi->nh);
+
+	return fi->fib_nhs;
+}
+
+static inline struct fib_nh *fib_info_nh(struct fib_info *fi, int nhsel)
+{
+	if (unlikely(fi->nh))
+		return nexthop_fib_nh(fi->nh, nhsel);
+
+	return &fi->fib_nh[nhsel];
+}
+
 
 #ifdef CONFIG_IP_MULTIPLE_TABLES
 struct fib_rule;
@@ -162,9 +185,9 @@ struct fib_result_nl {
 };
 
 #ifdef CONFIG_IP_ROUTE_MULTIPATH
-#define FIB_RES_NH(res)		((res).fi->fib_nh[(res).nh_sel])
+#define FIB_RES_NH(res)		(*fib_info_nh((res).fi, (res).nh_sel))
 #else /* CONFIG_IP_ROUTE_MULTIPATH */
-#define FIB_RES_NH(res)		((res).fi->fib_nh[0])
+#define FIB_RES_NH(res)		(*fib_info_nh((res).fi, 0))
 #endif /* CONFIG_IP_ROUTE_MULTIPATH */
 
 #ifdef CONFIG_IP_MULTIPLE_TABLES
@@ -173,13 +196,15 @@ struct fib_result_nl {
 #define FIB_TABLE_HASHSZ 2
 #endif
 
-__be32 fib_info_update_nh_saddr(struct net *net, struct fib_nh *nh);
+__be32 fib_info_update_nh_saddr(struct net *net, struct fib_nh *nh,
+				unsigned char scope);
 
 #define FIB_RES_SADDR(net, res)				\
 	((FIB_RES_NH(res).nh_saddr_genid ==		\
 	  atomic_read(&(net)->ipv4.dev_addr_genid)) ?	\
 	 FIB_RES_NH(res).nh_saddr :			\
-	 fib_info_update_nh_saddr((net), &FIB_RES_NH(res)))
+	 fib_info_update_nh_saddr((net), &FIB_RES_NH(res),	\
+				  (res).fi->fib_scope))
 #define FIB_RES_GW(res)			(FIB_RES_NH(res).nh_gw)
 #define FIB_RES_DEV(res)		(FIB_RES_NH(res).nh_dev)
 #define FIB_RES_OIF(res)		(FIB_RES_NH(res).nh_oif)
@@ -400,6 +425,7 @@ static inline int fib_num_tclassid_users(struct net *net)
 }
 #endif
 int fib_unmerge(struct net *net);
+void fib_flush(struct net *net);
 
 /* Exported by fib_semantics.c */
 int ip_fib_check_default(__be32 gw, struct net_device *dev);
@@ -407,10 +433,18 @@ int fib_sync_down_dev(struct net_device *dev, unsigned long event, bool force);
 int fib_sync_down_addr(struct net_device *dev, __be32 local);
 int fib_sync_up(struct net_device *dev, unsigned int nh_flags);
 void fib_sync_mtu(struct net_device *dev, u32 orig_mtu);
+void fib_nh_update_mtu(struct fib_nh *nh, u32 new, u32 orig);
+
+int fib_nh_init(struct net *net, struct fib_nh *nh, struct fib_config *cfg,
+		int nh_weight, struct netlink_ext_ack *extack);
+int fib_check_nh(struct fib_config *cfg, struct fib_nh *nh,
+		 struct netlink_ext_ack *extack);
+void fib_nh_release(struct fib_nh *fib_nh);
 
 #ifdef CONFIG_IP_ROUTE_MULTIPATH
 int fib_multipath_hash(const struct net *net, const struct flowi4 *fl4,
 		       const struct sk_buff *skb, struct flow_keys *flkeys);
+bool fib_good_nh(const struct fib_nh *nh);
 #endif
 void fib_select_multipath(struct fib_result *res, int hash);
 void fib_select_path(struct net *net, struct fib_result *res,
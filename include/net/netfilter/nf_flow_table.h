@@ -6,6 +6,10 @@
 #include <linux/netdevice.h>
 #include <linux/rhashtable-types.h>
 #include <linux/rcupdate.h>
+#include <linux/if_ether.h>
+#include <linux/if_vlan.h>
+#include <linux/if_pppox.h>
+#include <linux/ppp_defs.h>
 #include <linux/netfilter/nf_conntrack_tuple_common.h>
 #include <net/dst.h>
 
@@ -33,6 +37,13 @@ enum flow_offload_tuple_dir {
 	FLOW_OFFLOAD_DIR_MAX = IP_CT_DIR_MAX
 };
 
+enum flow_offload_xmit_type {
+	FLOW_OFFLOAD_XMIT_NEIGH		= 0,
+	FLOW_OFFLOAD_XMIT_DIRECT,
+};
+
+#define NF_FLOW_TABLE_ENCAP_MAX		2
+
 struct flow_offload_tuple {
 	union {
 		struct in_addr		src_v4;
@@ -51,13 +62,30 @@ struct flow_offload_tuple {
 
 	u8				l3proto;
 	u8				l4proto;
+
+	/* vlan and pppoe headers seen on input, outermost first */
+	struct {
+		u16			id;
+		__be16			proto;
+	} encap[NF_FLOW_TABLE_ENCAP_MAX];
+
+	/* All members above are keys for lookups, see flow_offload_hash(). */
 	u8				dir;
+	u8				encap_num;
+	u8				xmit_type;
 
 	int				oifidx;
 
 	u16				mtu;
 
 	struct dst_entry		*dst_cache;
+
+	/* Used by FLOW_OFFLOAD_XMIT_DIRECT. */
+	struct {
+		int			ifidx;
+		u8			h_source[ETH_ALEN];
+		u8			h_dest[ETH_ALEN];
+	} out;
 };
 
 struct flow_offload_tuple_rhash {
@@ -69,6 +97,15 @@ struct flow_offload_tuple_rhash {
 #define FLOW_OFFLOAD_DNAT	0x2
 #define FLOW_OFFLOAD_DYING	0x4
 #define FLOW_OFFLOAD_TEARDOWN	0x8
+#define FLOW_OFFLOAD_ACCT	0x10
+
+/* Packets seen by the fast path, folded into the conntrack accounting
+ * extension from the garbage collector instead of on every packet.
+ */
+struct flow_offload_counter {
+	atomic64_t	packets;
+	atomic64_t	bytes;
+};
 
 struct flow_offload {
 	struct flow_offload_tuple_rhash		tuplehash[FLOW_OFFLOAD_DIR_MAX];
@@ -77,13 +114,28 @@ struct flow_offload {
 		/* Your private driver data here. */
 		u32		timeout;
 	};
+	struct flow_offload_counter		counter[FLOW_OFFLOAD_DIR_MAX];
 };
 
 #define NF_FLOW_TIMEOUT (30 * HZ)
 
 struct nf_flow_route {
 	struct {
-		struct dst_entry	*dst;
+		struct dst_entry		*dst;
+		struct {
+			int			ifindex;
+			struct {
+				u16		id;
+				__be16		proto;
+			} encap[NF_FLOW_TABLE_ENCAP_MAX];
+			u8			num_encaps;
+		} in;
+		struct {
+			int			ifindex;
+			u8			h_source[ETH_ALEN];
+			u8			h_dest[ETH_ALEN];
+		} out;
+		enum flow_offload_xmit_type	xmit_type;
 	} tuple[FLOW_OFFLOAD_DIR_MAX];
 };
 
@@ -105,6 +157,17 @@ static inline void flow_offload_dead(struct flow_offload *flow)
 	flow->flags |= FLOW_OFFLOAD_DYING;
 }
 
+static inline void flow_offload_count(struct flow_offload *flow,
+				      enum flow_offload_tuple_dir dir,
+				      unsigned int len)
+{
+	if (!(flow->flags & FLOW_OFFLOAD_ACCT))
+		return;
+
+	atomic64_inc(&flow->counter[dir].packets);
+	atomic64_add(len, &flow->counter[dir].bytes);
+}
+
 int nf_flow_snat_port(const struct flow_offload *flow,
 		      struct sk_buff *skb, unsigned int thoff,
 		      u8 protocol, enum flow_offload_tuple_dir dir);
@@ -116,6 +179,44 @@ struct flow_ports {
 	__be16 source, dest;
 };
 
+static inline __be16 nf_flow_pppoe_proto(struct sk_buff *skb)
+{
+	__be16 proto;
+
+	if (!pskb_may_pull(skb, PPPOE_SES_HLEN))
+		return 0;
+
+	proto = *((__be16 *)(skb->data + sizeof(struct pppoe_hdr)));
+	switch (proto) {
+	case htons(PPP_IP):
+		return htons(ETH_P_IP);
+	case htons(PPP_IPV6):
+		return htons(ETH_P_IPV6);
+	}
+
+	return 0;
+}
+
+/* Network protocol of skb, looking through one in-band vlan or pppoe
+ * session header.
+ */
+static inline __be16 nf_flow_skb_proto(struct sk_buff *skb)
+{
+	struct vlan_hdr *vhdr;
+
+	switch (skb->protocol) {
+	case htons(ETH_P_8021Q):
+		if (!pskb_may_pull(skb, VLAN_HLEN))
+			return 0;
+		vhdr = (struct vlan_hdr *)skb->data;
+		return vhdr->h_vlan_encapsulated_proto;
+	case htons(ETH_P_PPP_SES):
+		return nf_flow_pppoe_proto(skb);
+	}
+
+	return skb->protocol;
+}
+
 unsigned int nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 				     const struct nf_hook_state *state);
 unsigned int nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
@@ -24,6 +24,14 @@
  * If no DMA mapping is done, then it can act as shim-layer that
  * fall-through to alloc_page.  As no state is kept on the page, the
  * regular put_page() call is sufficient.
+ *
+ * Pages handed to the network stack inside an skb can be returned to
+ * their pool when the skb is freed.  The driver marks such an skb with
+ * skb_mark_for_recycle(); skb_release_data() then hands each page to
+ * page_pool_return_skb_page(), which recognises pool pages by
+ * page->pp_magic.  Because pages can outlive the driver this way, the
+ * pool tracks its in-flight pages and page_pool_destroy() defers the
+ * final free until all of them have come back.
  */
 #ifndef _NET_PAGE_POOL_H
 #define _NET_PAGE_POOL_H
@@ -31,6 +39,7 @@
 #include <linux/mm.h> /* Needed by ptr_ring */
 #include <linux/ptr_ring.h>
 #include <linux/dma-direction.h>
+#include <linux/workqueue.h>
 
 #define PP_FLAG_DMA_MAP 1 /* Should page_pool do the DMA map/unmap */
 #define PP_FLAG_ALL	PP_FLAG_DMA_MAP
@@ -65,10 +74,78 @@ struct page_pool_params {
 	enum dma_data_direction dma_dir; /* DMA mapping direction */
 };
 
+#ifdef CONFIG_PAGE_POOL_STATS
+struct page_pool_alloc_stats {
+	u64 fast; /* fast path allocations */
+	u64 slow; /* slow-path order 0 allocations */
+	u64 slow_high_order; /* slow-path high order allocations */
+	u64 empty; /* failed refills due to empty ptr ring, forcing
+		    * slow path allocation
+		    */
+	u64 refill; /* allocations via successful refill */
+};
+
+struct page_pool_recycle_stats {
+	u64 cached;	/* recycling placed page in the cache. */
+	u64 cache_full; /* cache was full */
+	u64 ring;	/* recycling placed page back into ptr ring */
+	u64 ring_full;	/* page was released from page-pool because
+			 * PTR ring was full.
+			 */
+	u64 released_refcnt; /* page released because of elevated
+			      * refcnt
+			      */
+};
+
+/* This struct wraps the above stats structs so users of the
+ * page_pool_get_stats API can pass a single argument when requesting the
+ * stats for the page pool.
+ */
+struct page_pool_stats {
+	struct page_pool_alloc_stats alloc_stats;
+	struct page_pool_recycle_stats recycle_stats;
+};
+
+int page_pool_ethtool_stats_get_count(void);
+u8 *page_pool_ethtool_stats_get_strings(u8 *data);
+u64 *page_pool_ethtool_stats_get(u64 *data, void *stats);
+
+/*
+ * Drivers that wish to harvest page pool stats and report them to users
+ * (perhaps via ethtool, debugfs, or another mechanism) can allocate a
+ * struct page_pool_stats and call page_pool_get_stats to get the stats
+ * for the specified pool.  Stats are accumulated, so one struct can be
+ * passed for several pools.
+ */
+bool page_pool_get_stats(struct page_pool *pool,
+			 struct page_pool_stats *stats);
+#else
+static inline int page_pool_ethtool_stats_get_count(void)
+{
+	return 0;
+}
+
+static inline u8 *page_pool_ethtool_stats_get_strings(u8 *data)
+{
+	return data;
+}
+
+static inline u64 *page_pool_ethtool_stats_get(u64 *data, void *stats)
+{
+	return data;
+}
+#endif
+
 struct page_pool {
 	struct rcu_head rcu;
 	struct page_pool_params p;
 
+	struct delayed_work release_dw;
+	unsigned long defer_start;
+	unsigned long defer_warn;
+
+	u32 pages_state_hold_cnt;
+
 	/*
 	 * Data structure for allocation side
 	 *
@@ -84,6 +161,11 @@ struct page_pool {
 	 */
 	struct pp_alloc_cache alloc ____cacheline_aligned_in_smp;
 
+#ifdef CONFIG_PAGE_POOL_STATS
+	/* these stats are incremented while in softirq context */
+	struct page_pool_alloc_stats alloc_stats;
+#endif
+
 	/* Data structure for storing recycled pages.
 	 *
 	 * Returning/freeing pages is more complicated synchronization
@@ -96,6 +178,12 @@ struct page_pool {
 	 * TODO: Implement bulk return pages into this structure.
 	 */
 	struct ptr_ring ring;
+
+#ifdef CONFIG_PAGE_POOL_STATS
+	/* recycle stats are per-cpu to avoid locking */
+	struct page_pool_recycle_stats __percpu *recycle_stats;
+#endif
+	atomic_t pages_state_release_cnt;
 };
 
 struct page *page_pool_alloc_pages(struct page_pool *pool, gfp_t gfp);
@@ -125,6 +213,32 @@ static inline void page_pool_put_page(struct page_pool *pool,
 	__page_pool_put_page(pool, page, allow_direct);
 #endif
 }
+/* Never call this directly, use page_pool_release_page() */
+void __page_pool_release_page(struct page_pool *pool, struct page *page);
+
+/* API user that takes a page out of the pool without handing it back
+ * via page_pool_put_page() (e.g. keeping it in a private cache, or
+ * freeing it with put_page()) must disconnect it first, otherwise the
+ * pool keeps counting it as in-flight and page_pool_destroy() never
+ * completes.
+ */
+static inline void page_pool_release_page(struct page_pool *pool,
+					  struct page *page)
+{
+#ifdef CONFIG_PAGE_POOL
+	__page_pool_release_page(pool, page);
+#endif
+}
+
+#ifdef CONFIG_PAGE_POOL
+bool page_pool_return_skb_page(struct page *page);
+#else
+static inline bool page_pool_return_skb_page(struct page *page)
+{
+	return false;
+}
+#endif
+
 /* Very limited use-cases allow recycle direct */
 static inline void page_pool_recycle_direct(struct page_pool *pool,
 					    struct page *page)
@@ -6,6 +6,8 @@
 #ifndef __LINUX_NET_XDP_H__
 #define __LINUX_NET_XDP_H__
 
+#include <linux/skbuff.h> /* skb_shared_info */
+
 /**
  * DOC: XDP RX-queue information
  *
@@ -33,6 +35,25 @@
  * also mandatory during RX-ring setup.
  */
 
+/**
+ * DOC: XDP multi-buffer frames
+ *
+ * A multi-buffer xdp_buff consists of a linear part, described by
+ * data/data_end as for a single buffer frame, plus an array of
+ * page fragments stored in a struct skb_shared_info placed at the
+ * end of the first buffer (see xdp_get_shared_info_from_buff()), the
+ * same place build_skb() expects it.  This keeps the conversion to an
+ * SKB free of copies.
+ *
+ * Only RX-queues with a non-zero frag_size in their xdp_rxq_info can
+ * deliver multi-buffer frames, and the frame_sz and flags members of
+ * an xdp_buff are only meaningful for such queues; drivers set them
+ * up with xdp_init_buff().  Programs have to be loaded with
+ * BPF_F_XDP_HAS_FRAGS to be attached where multi-buffer frames can
+ * be seen, and devices must advertise IFF_XDP_XMIT_SG to be used as
+ * XDP_REDIRECT targets for them.
+ */
+
 enum xdp_mem_type {
 	MEM_TYPE_PAGE_SHARED = 0, /* Split-page refcnt based model */
 	MEM_TYPE_PAGE_ORDER0,     /* Orig XDP full page model */
@@ -61,8 +82,17 @@ struct xdp_rxq_info {
 	u32 queue_index;
 	u32 reg_state;
 	struct xdp_mem_info mem;
+	u32 frag_size; /* size of frag buffers, 0 if no multi-buffer support */
+	unsigned int napi_id; /* NAPI instance serving the queue, for busy-poll */
 } ____cacheline_aligned; /* perf critical, avoid false-sharing */
 
+enum xdp_buff_flags {
+	XDP_FLAGS_HAS_FRAGS		= BIT(0), /* non-linear xdp buff */
+	XDP_FLAGS_FRAGS_PF_MEMALLOC	= BIT(1), /* xdp paged memory is under
+						   * pressure
+						   */
+};
+
 struct xdp_buff {
 	void *data;
 	void *data_end;
@@ -70,8 +100,73 @@ struct xdp_buff {
 	void *data_hard_start;
 	unsigned long handle;
 	struct xdp_rxq_info *rxq;
+	u32 frame_sz; /* frame size to deduce data_hard_end/reserved tailroom */
+	u32 flags; /* supported values defined in xdp_buff_flags */
 };
 
+static __always_inline void
+xdp_init_buff(struct xdp_buff *xdp, u32 frame_sz, struct xdp_rxq_info *rxq)
+{
+	xdp->frame_sz = frame_sz;
+	xdp->rxq = rxq;
+	xdp->flags = 0;
+}
+
+static __always_inline bool xdp_buff_has_frags(const struct xdp_buff *xdp)
+{
+	return xdp->rxq->frag_size && (xdp->flags & XDP_FLAGS_HAS_FRAGS);
+}
+
+static __always_inline void xdp_buff_set_frags_flag(struct xdp_buff *xdp)
+{
+	xdp->flags |= XDP_FLAGS_HAS_FRAGS;
+}
+
+static __always_inline void xdp_buff_clear_frags_flag(struct xdp_buff *xdp)
+{
+	xdp->flags &= ~XDP_FLAGS_HAS_FRAGS;
+}
+
+static __always_inline bool
+xdp_buff_is_frag_pfmemalloc(const struct xdp_buff *xdp)
+{
+	return !!(xdp->flags & XDP_FLAGS_FRAGS_PF_MEMALLOC);
+}
+
+static __always_inline void xdp_buff_set_frag_pfmemalloc(struct xdp_buff *xdp)
+{
+	xdp->flags |= XDP_FLAGS_FRAGS_PF_MEMALLOC;
+}
+
+/* Reserve memory area at end-of data area.
+ *
+ * This macro reserves tailroom in the XDP buffer by limiting the
+ * XDP/BPF data access to data_hard_end.  Notice same area (and size)
+ * is used for XDP_PASS, when constructing the SKB via build_skb().
+ */
+#define xdp_data_hard_end(xdp)				\
+	((xdp)->data_hard_start + (xdp)->frame_sz -	\
+	 SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+
+static inline struct skb_shared_info *
+xdp_get_shared_info_from_buff(const struct xdp_buff *xdp)
+{
+	return (struct skb_shared_info *)xdp_data_hard_end(xdp);
+}
+
+static __always_inline unsigned int
+xdp_get_buff_len(const struct xdp_buff *xdp)
+{
+	unsigned int len = xdp->data_end - xdp->data;
+	const struct skb_shared_info *sinfo;
+
+	if (likely(!xdp_buff_has_frags(xdp)))
+		return len;
+
+	sinfo = xdp_get_shared_info_from_buff(xdp);
+	return len + sinfo->xdp_frags_size;
+}
+
 struct xdp_frame {
 	void *data;
 	u16 len;
@@ -82,8 +177,60 @@ struct xdp_frame {
 	 */
 	struct xdp_mem_info mem;
 	struct net_device *dev_rx; /* used by cpumap */
+	u32 frame_sz;
+	u32 flags; /* supported values defined in xdp_buff_flags */
 };
 
+static __always_inline bool xdp_frame_has_frags(const struct xdp_frame *frame)
+{
+	return !!(frame->flags & XDP_FLAGS_HAS_FRAGS);
+}
+
+static __always_inline bool
+xdp_frame_is_frag_pfmemalloc(const struct xdp_frame *frame)
+{
+	return !!(frame->flags & XDP_FLAGS_FRAGS_PF_MEMALLOC);
+}
+
+/* The xdp_frame is stored at data_hard_start, so the shared info of a
+ * multi-buffer frame is found at the same offset as in the xdp_buff
+ * it was converted from.
+ */
+static inline struct skb_shared_info *
+xdp_get_shared_info_from_frame(const struct xdp_frame *frame)
+{
+	void *data_hard_start = (void *)frame;
+
+	return (struct skb_shared_info *)(data_hard_start + frame->frame_sz -
+				SKB_DATA_ALIGN(sizeof(struct skb_shared_info)));
+}
+
+static __always_inline unsigned int
+xdp_get_frame_len(const struct xdp_frame *frame)
+{
+	const struct skb_shared_info *sinfo;
+	unsigned int len = frame->len;
+
+	if (likely(!xdp_frame_has_frags(frame)))
+		return len;
+
+	sinfo = xdp_get_shared_info_from_frame(frame);
+	return len + sinfo->xdp_frags_size;
+}
+
+static inline void
+xdp_update_skb_shared_info(struct sk_buff *skb, u8 nr_frags,
+			   unsigned int size, unsigned int truesize,
+			   bool pfmemalloc)
+{
+	skb_shinfo(skb)->nr_frags = nr_frags;
+
+	skb->len += size;
+	skb->data_len += size;
+	skb->truesize += truesize;
+	skb->pfmemalloc |= pfmemalloc;
+}
+
 /* Clear kernel pointers in xdp_frame */
 static inline void xdp_scrub_frame(struct xdp_frame *frame)
 {
@@ -122,12 +269,21 @@ struct xdp_frame *convert_to_xdp_frame(struct xdp_buff *xdp)
 	/* rxq only valid until napi_schedule ends, convert to xdp_mem_info */
 	xdp_frame->mem = xdp->rxq->mem;
 
+	if (unlikely(xdp_buff_has_frags(xdp))) {
+		xdp_frame->frame_sz = xdp->frame_sz;
+		xdp_frame->flags = xdp->flags;
+	} else {
+		xdp_frame->frame_sz = 0;
+		xdp_frame->flags = 0;
+	}
+
 	return xdp_frame;
 }
 
 void xdp_return_frame(struct xdp_frame *xdpf);
 void xdp_return_frame_rx_napi(struct xdp_frame *xdpf);
 void xdp_return_buff(struct xdp_buff *xdp);
+void xdp_return_frag(struct page *page, const struct xdp_buff *xdp);
 
 int xdp_rxq_info_reg(struct xdp_rxq_info *xdp_rxq,
 		     struct net_device *dev, u32 queue_index);
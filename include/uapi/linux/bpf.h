@@ -132,6 +132,7 @@ enum bpf_map_type {
 	BPF_MAP_TYPE_PERCPU_CGROUP_STORAGE,
 	BPF_MAP_TYPE_QUEUE,
 	BPF_MAP_TYPE_STACK,
+	BPF_MAP_TYPE_STRUCT_OPS,
 };
 
 /* Note that tracing related programs such as
@@ -166,6 +167,9 @@ enum bpf_prog_type {
 	BPF_PROG_TYPE_LIRC_MODE2,
 	BPF_PROG_TYPE_SK_REUSEPORT,
 	BPF_PROG_TYPE_FLOW_DISSECTOR,
+	BPF_PROG_TYPE_STRUCT_OPS,
+	BPF_PROG_TYPE_RPS,
+	BPF_PROG_TYPE_SK_LOOKUP,
 };
 
 enum bpf_attach_type {
@@ -187,11 +191,22 @@ enum bpf_attach_type {
 	BPF_CGROUP_UDP6_SENDMSG,
 	BPF_LIRC_MODE2,
 	BPF_FLOW_DISSECTOR,
+	BPF_RPS,
+	BPF_SK_LOOKUP,
 	__MAX_BPF_ATTACH_TYPE
 };
 
 #define MAX_BPF_ATTACH_TYPE __MAX_BPF_ATTACH_TYPE
 
+/* Kernel operation tables that BPF_MAP_TYPE_STRUCT_OPS maps implement,
+ * given as struct_ops_type on map creation and as expected_attach_type
+ * when loading the BPF_PROG_TYPE_STRUCT_OPS programs of the table.
+ */
+enum bpf_struct_ops_type {
+	BPF_STRUCT_OPS_TCP_CONGESTION,	/* struct bpf_tcp_congestion_ops */
+	__MAX_BPF_STRUCT_OPS_TYPE
+};
+
 /* cgroup-bpf attach flags used in BPF_PROG_ATTACH command
  *
  * NONE(default): No further bpf programs allowed in the subtree.
@@ -255,6 +270,14 @@ enum bpf_attach_type {
  */
 #define BPF_F_ANY_ALIGNMENT	(1U << 1)
 
+/* If BPF_F_XDP_HAS_FRAGS is used in BPF_PROG_LOAD command, the loaded
+ * XDP program is able to handle multi-buffer frames, i.e. it does not
+ * assume that data_end marks the end of the packet and uses the
+ * bpf_xdp_get_buff_len(), bpf_xdp_load_bytes() and bpf_xdp_store_bytes()
+ * helpers to reach the fragments.
+ */
+#define BPF_F_XDP_HAS_FRAGS	(1U << 2)
+
 /* when bpf_ldimm64->src_reg == BPF_PSEUDO_MAP_FD, bpf_ldimm64->imm == fd */
 #define BPF_PSEUDO_MAP_FD	1
 
@@ -333,6 +356,9 @@ union bpf_attr {
 		__u32	btf_fd;		/* fd pointing to a BTF type data */
 		__u32	btf_key_type_id;	/* BTF type_id of the key */
 		__u32	btf_value_type_id;	/* BTF type_id of the value */
+		__u32	struct_ops_type;	/* enum bpf_struct_ops_type of
+						 * BPF_MAP_TYPE_STRUCT_OPS
+						 */
 	};
 
 	struct { /* anonymous struct used by BPF_MAP_*_ELEM commands */
@@ -2366,6 +2392,72 @@ union bpf_attr {
  *             current value is ect (ECN capable). Works with IPv6 and IPv4.
  *     Return
  *             1 if set, 0 if not set.
+ *
+ * u64 bpf_xdp_get_buff_len(struct xdp_buff *xdp_md)
+ *	Description
+ *		Get the total size of a given xdp buff (linear and paged area)
+ *	Return
+ *		The total size of a given xdp buffer.
+ *
+ * int bpf_xdp_load_bytes(struct xdp_buff *xdp_md, u32 offset, void *buf, u32 len)
+ *	Description
+ *		This helper is provided as an easy way to load data from a
+ *		xdp buffer. It can be used to load *len* bytes from *offset* from
+ *		the frame associated to *xdp_md*, into the buffer pointed by
+ *		*buf*. The data may span the linear area and the fragments of
+ *		a multi-buffer frame.
+ *	Return
+ *		0 on success, or a negative error in case of failure.
+ *
+ * int bpf_xdp_store_bytes(struct xdp_buff *xdp_md, u32 offset, void *buf, u32 len)
+ *	Description
+ *		Store *len* bytes from buffer *buf* into the frame
+ *		associated to *xdp_md*, at *offset*. The data may span the
+ *		linear area and the fragments of a multi-buffer frame.
+ *	Return
+ *		0 on success, or a negative error in case of failure.
+ *
+ * int bpf_tcp_send_ack(struct bpf_tcp_ca *ctx, u32 rcv_nxt)
+ *	Description
+ *		Send an ACK acknowledging *rcv_nxt* right away, on the socket
+ *		whose congestion control operation *ctx* belongs to. The
+ *		**ecn_flags** of *ctx* are applied to the socket first, so
+ *		that the ACK carries the ECE state set up by the program.
+ *
+ *		Only usable by the **cwnd_event** operation of a
+ *		**BPF_STRUCT_OPS_TCP_CONGESTION** table, for the
+ *		**CA_EVENT_ECN_NO_CE** and **CA_EVENT_ECN_IS_CE** events.
+ *	Return
+ *		0 on success, or a negative error in case of failure.
+ *
+ * int bpf_sk_assign(struct bpf_sk_lookup *ctx, struct bpf_map *map, void *key, u64 flags)
+ *	Description
+ *		Select the socket at index *key* of *map* (of type
+ *		**BPF_MAP_TYPE_REUSEPORT_SOCKARRAY**) as the result of the
+ *		socket lookup *ctx* describes. It takes effect if the
+ *		program returns **SK_PASS**; a later call replaces the
+ *		selection.
+ *
+ *		The socket must be of the protocol of the lookup and
+ *		listening, for TCP. An **AF_INET6** socket that is not
+ *		restricted to IPv6 can be selected for IPv4 lookups. If it
+ *		belongs to a reuseport group, the group picks the final
+ *		socket as usual.
+ *
+ *		*flags* must be zero.
+ *	Return
+ *		0 on success, or a negative error in case of failure:
+ *
+ *		**-ENOENT** if there is no socket at *key*.
+ *
+ *		**-EPROTOTYPE** if the socket has the wrong protocol or,
+ *		for TCP, is not listening.
+ *
+ *		**-EAFNOSUPPORT** if the socket can not take packets of
+ *		the lookup's address family.
+ *
+ *		**-EINVAL** if *flags* are set or the socket belongs to
+ *		another network namespace.
  */
 #define __BPF_FUNC_MAPPER(FN)		\
 	FN(unspec),			\
@@ -2465,7 +2557,12 @@ union bpf_attr {
 	FN(spin_unlock),		\
 	FN(sk_fullsock),		\
 	FN(tcp_sock),			\
-	FN(skb_ecn_set_ce),
+	FN(skb_ecn_set_ce),		\
+	FN(xdp_get_buff_len),		\
+	FN(xdp_load_bytes),		\
+	FN(xdp_store_bytes),		\
+	FN(tcp_send_ack),		\
+	FN(sk_assign),
 
 /* integer value in 'imm' field of BPF_CALL instruction selects which helper
  * function eBPF program intends to call
@@ -2786,6 +2883,23 @@ struct sk_reuseport_md {
 	__u32 hash;		/* A hash of the packet 4 tuples */
 };
 
+/* User accessible data for BPF_PROG_TYPE_SK_LOOKUP programs. They run on
+ * lookups of listening TCP and unconnected UDP sockets for received
+ * packets, and return SK_PASS to go on with the socket selected by
+ * bpf_sk_assign(), if any, or with the regular lookup; SK_DROP fails the
+ * lookup.
+ */
+struct bpf_sk_lookup {
+	__u32 family;		/* AF_INET, AF_INET6 */
+	__u32 protocol;		/* IPPROTO_TCP, IPPROTO_UDP */
+	__u32 remote_ip4;	/* Network byte order */
+	__u32 remote_ip6[4];	/* Network byte order */
+	__u32 remote_port;	/* Network byte order */
+	__u32 local_ip4;	/* Network byte order */
+	__u32 local_ip6[4];	/* Network byte order */
+	__u32 local_port;	/* Host byte order */
+};
+
 #define BPF_TAG_SIZE	8
 
 struct bpf_prog_info {
@@ -3031,6 +3145,88 @@ struct bpf_cgroup_dev_ctx {
 	__u32 minor;
 };
 
+/* BPF_MAP_TYPE_STRUCT_OPS value of BPF_STRUCT_OPS_TCP_CONGESTION, a
+ * congestion control algorithm selectable through TCP_CONGESTION once the
+ * element is updated. The operations are BPF_PROG_TYPE_STRUCT_OPS program
+ * fds on update and program ids on lookup, 0 leaves an operation unset.
+ * ssthresh, cong_avoid and undo_cwnd are required.
+ */
+struct bpf_tcp_congestion_ops {
+	char	name[16];	/* TCP_CA_NAME_MAX */
+	__u32	flags;		/* BPF_TCP_CA_* flags */
+	__u32	init;
+	__u32	release;
+	__u32	ssthresh;
+	__u32	cong_avoid;
+	__u32	set_state;
+	__u32	cwnd_event;
+	__u32	in_ack_event;
+	__u32	undo_cwnd;
+	__u32	pkts_acked;
+};
+
+/* bpf_tcp_congestion_ops flags */
+#define BPF_TCP_CA_NEEDS_ECN		(1U << 0)
+
+/* The operation a program runs for, in bpf_tcp_ca->op */
+enum {
+	BPF_TCP_CA_OP_INIT,
+	BPF_TCP_CA_OP_RELEASE,
+	BPF_TCP_CA_OP_SSTHRESH,
+	BPF_TCP_CA_OP_CONG_AVOID,
+	BPF_TCP_CA_OP_SET_STATE,
+	BPF_TCP_CA_OP_CWND_EVENT,
+	BPF_TCP_CA_OP_IN_ACK_EVENT,
+	BPF_TCP_CA_OP_UNDO_CWND,
+	BPF_TCP_CA_OP_PKTS_ACKED,
+	__BPF_TCP_CA_OP_MAX,
+};
+
+/* bpf_tcp_ca->actions, carried out once the program returns */
+#define BPF_TCP_CA_ACT_ACK_NOW		(1U << 0) /* ACK without delay */
+#define BPF_TCP_CA_ACT_FALLBACK_RENO	(1U << 1) /* init only: use reno */
+
+/* User accessible context of the programs of a bpf_tcp_congestion_ops.
+ * The socket state is a snapshot taken before the program runs, the
+ * read-write fields and priv are written back to the socket after it
+ * returns. ssthresh and undo_cwnd programs return the new value.
+ */
+struct bpf_tcp_ca {
+	__u32 op;		/* BPF_TCP_CA_OP_* */
+	/* Arguments of the operation */
+	__u32 ack;		/* cong_avoid */
+	__u32 acked;		/* cong_avoid, pkts_acked */
+	__s32 rtt_us;		/* pkts_acked */
+	__u32 in_flight;	/* pkts_acked */
+	__u32 new_state;	/* set_state, TCP_CA_* state */
+	__u32 event;		/* cwnd_event, CA_EVENT_* */
+	__u32 ack_flags;	/* in_ack_event, CA_ACK_* flags */
+	/* Read-only socket state */
+	__u32 state;		/* TCP_* state */
+	__u32 ca_state;
+	__u32 snd_una;
+	__u32 snd_nxt;
+	__u32 rcv_nxt;
+	__u32 mss_cache;
+	__u32 rcv_mss;
+	__u32 srtt_us;		/* smoothed RTT << 3 */
+	__u32 packets_out;
+	__u32 snd_cwnd_clamp;
+	__u32 prior_cwnd;
+	__u32 is_cwnd_limited;
+	__u32 ack_pending;	/* ICSK_ACK_* flags */
+	__u32 delivered;
+	__u32 delivered_ce;
+	/* Read-write socket state */
+	__u32 snd_cwnd;
+	__u32 snd_ssthresh;
+	__u32 snd_cwnd_cnt;
+	__u32 ecn_flags;	/* only CWR state is written back */
+	__u32 actions;		/* BPF_TCP_CA_ACT_* */
+	/* Private state of the algorithm, zeroed before init */
+	__u64 priv[13];
+};
+
 struct bpf_raw_tracepoint_args {
 	__u64 args[0];
 };
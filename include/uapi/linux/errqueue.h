@@ -31,6 +31,31 @@ struct sock_extended_err {
 #define SO_EE_CODE_TXTIME_INVALID_PARAM	1
 #define SO_EE_CODE_TXTIME_MISSED	2
 
+/* Zerocopy completions returned on sendmsg
+ *
+ *	Instead of reading MSG_ZEROCOPY completions with
+ *	recvmsg(MSG_ERRQUEUE), a sender may pass a SOL_SOCKET
+ *	SCM_ZC_NOTIFICATION cmsg carrying the __u64 address of this struct.
+ *	@size is the number of entries in @arr (at most SOCK_ZC_INFO_MAX).
+ *	The kernel moves up to that many pending completion ranges from
+ *	the error queue into @arr and sets @count to the number of entries
+ *	filled. @count is left untouched if the cmsg was not processed.
+ */
+struct zc_info_elem {
+	__u32	lo;
+	__u32	hi;
+	__u8	zerocopy;
+	__u8	reserved[3];
+};
+
+struct zc_info {
+	__u32	size;
+	__u32	count;
+	struct zc_info_elem arr[];
+};
+
+#define SOCK_ZC_INFO_MAX	128
+
 /**
  *	struct scm_timestamping - timestamps exposed through cmsg
  *
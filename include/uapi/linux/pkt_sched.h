@@ -1161,4 +1161,23 @@ enum {
 
 #define TCA_TAPRIO_ATTR_MAX (__TCA_TAPRIO_ATTR_MAX - 1)
 
+/* MQTB section */
+
+enum {
+	TCA_MQTB_UNSPEC,
+	TCA_MQTB_RATE64,	/* u64, bytes per second, 0 means unlimited */
+	TCA_MQTB_BURST,		/* u32, bucket depth in bytes */
+	TCA_MQTB_BATCH,		/* u32, bytes borrowed per CPU at a time */
+	TCA_MQTB_LIMIT,		/* u32, per queue backlog in packets */
+	TCA_MQTB_PAD,
+	__TCA_MQTB_MAX,
+};
+
+#define TCA_MQTB_MAX (__TCA_MQTB_MAX - 1)
+
+struct tc_mqtb_xstats {
+	__u64	borrows;	/* refills of a per-CPU cache from the budget */
+	__u64	throttled;	/* dequeues deferred for lack of tokens */
+};
+
 #endif
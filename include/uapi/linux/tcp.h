@@ -295,9 +295,20 @@ struct tcp_diag_md5sig {
 
 /* setsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, ...) */
 
+/* The caller already unmapped the target range, skip the zap */
+#define TCP_RECEIVE_ZEROCOPY_FLAG_TLB_CLEAN_HINT 0x1
 struct tcp_zerocopy_receive {
 	__u64 address;		/* in: address of mapping */
 	__u32 length;		/* in/out: number of bytes to map/mapped */
 	__u32 recv_skip_hint;	/* out: amount of bytes to skip */
+	__u32 inq;		/* out: amount of bytes in read queue */
+	__s32 err;		/* out: socket error */
+	__u64 copybuf_address;	/* in: copybuf address (small reads) */
+	__s32 copybuf_len;	/* in/out: copybuf bytes avail/used or error */
+	__u32 flags;		/* in: flags */
+	__u64 msg_control;	/* ancillary data */
+	__u64 msg_controllen;
+	__u32 msg_flags;
+	__u32 reserved;		/* set to 0 for now */
 };
 #endif /* _UAPI_LINUX_TCP_H */
@@ -0,0 +1,103 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_UBLK_CMD_H
+#define _UAPI_LINUX_UBLK_CMD_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * Userspace block device.
+ *
+ * /dev/ublk-control creates /dev/ublkcN and, once the daemon serving it
+ * is attached, the disk /dev/ublkbN.  Every hardware queue of the disk
+ * has its own area, mapped from /dev/ublkcN at offset
+ * q_id * queue_map_size, which holds:
+ *
+ * - struct ublksrv_queue_ring, with the indices of both rings and the
+ *   offsets of everything below;
+ * - the submission ring, the tags of new requests (kernel -> daemon);
+ * - the completion ring, struct ublksrv_io_cqe (daemon -> kernel);
+ * - one struct ublksrv_io_desc per tag, describing the request;
+ * - one buf_size bytes data buffer per tag, filled by the kernel before
+ *   a write is submitted and by the daemon before a read is completed.
+ *
+ * Each ring index is written by one side only and is free running, the
+ * slot is index & (ring_entries - 1).  Producers publish entries with a
+ * release store of the tail, consumers read it with an acquire load.
+ *
+ * A daemon thread per queue loops on UBLK_IO_COMMIT_AND_FETCH, which
+ * completes what the daemon added to the completion ring and then sleeps
+ * until the submission ring has new entries.
+ */
+
+#define UBLK_MAX_NR_QUEUES	128
+#define UBLK_MAX_QUEUE_DEPTH	1024
+#define UBLK_MAX_IO_BUF_BYTES	(1U << 20)
+
+/* discard and write zeroes requests are sent to the daemon */
+#define UBLK_F_DISCARD		(1ULL << 0)
+#define UBLK_F_READ_ONLY	(1ULL << 1)
+
+/* ublksrv_ctrl_dev_info.state */
+#define UBLK_S_DEV_DEAD		0
+#define UBLK_S_DEV_LIVE		1
+
+struct ublksrv_ctrl_dev_info {
+	__s32	dev_id;			/* -1 picks a free one */
+	__u16	nr_hw_queues;
+	__u16	queue_depth;
+	__u64	dev_sectors;		/* capacity, in 512 byte sectors */
+	__u32	max_io_buf_bytes;	/* rounded up to a page by the kernel */
+	__u8	logical_bs_shift;	/* 0 means 9 */
+	__u8	pad[3];
+	__u64	flags;			/* UBLK_F_* */
+	__u32	queue_map_size;		/* out: bytes to map per queue */
+	__u32	state;			/* out: UBLK_S_DEV_* */
+	__u64	reserved[4];
+};
+
+/* on /dev/ublk-control, the argument of DEL, START and STOP is dev_id */
+#define UBLK_CTRL_ADD_DEV	_IOWR('u', 0x00, struct ublksrv_ctrl_dev_info)
+#define UBLK_CTRL_DEL_DEV	_IO('u', 0x01)
+#define UBLK_CTRL_START_DEV	_IO('u', 0x02)
+#define UBLK_CTRL_STOP_DEV	_IO('u', 0x03)
+#define UBLK_CTRL_GET_DEV_INFO	_IOWR('u', 0x04, struct ublksrv_ctrl_dev_info)
+
+/* on /dev/ublkcN, the argument is the queue id */
+#define UBLK_IO_COMMIT_AND_FETCH _IO('u', 0x20)
+
+struct ublksrv_queue_ring {
+	__u32	sq_head;		/* written by the daemon */
+	__u32	sq_tail;		/* written by the kernel */
+	__u32	cq_head;		/* written by the kernel */
+	__u32	cq_tail;		/* written by the daemon */
+	__u32	ring_entries;
+	__u32	sq_off;			/* __u32 tags */
+	__u32	cq_off;			/* struct ublksrv_io_cqe */
+	__u32	desc_off;		/* struct ublksrv_io_desc, by tag */
+	__u32	buf_off;		/* data buffers, by tag */
+	__u32	buf_size;
+};
+
+#define UBLK_IO_OP_READ		0
+#define UBLK_IO_OP_WRITE	1
+#define UBLK_IO_OP_FLUSH	2
+#define UBLK_IO_OP_DISCARD	3
+#define UBLK_IO_OP_WRITE_ZEROES	4
+
+#define UBLK_IO_OP_MASK		0xff
+/* write zeroes must not deallocate the range */
+#define UBLK_IO_F_NOUNMAP	(1U << 8)
+
+struct ublksrv_io_desc {
+	__u32	op_flags;		/* UBLK_IO_OP_* | UBLK_IO_F_* */
+	__u32	nr_sectors;
+	__u64	start_sector;
+};
+
+struct ublksrv_io_cqe {
+	__u32	tag;
+	__s32	result;			/* 0 or -errno */
+};
+
+#endif /* _UAPI_LINUX_UBLK_CMD_H */
@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * BPF implementations of kernel operation tables
+ *
+ * A BPF_MAP_TYPE_STRUCT_OPS map has a single element, the uapi version of
+ * a kernel table of function pointers such as struct tcp_congestion_ops.
+ * Updating it with the fds of BPF_PROG_TYPE_STRUCT_OPS programs fills in
+ * the kernel table and registers it with its subsystem, deleting it
+ * unregisters the table again. The registration and every user of the
+ * table hold a reference on the map, see bpf_try_module_get().
+ */
+#include <linux/bpf.h>
+#include <linux/err.h>
+#include <linux/filter.h>
+#include <linux/mutex.h>
+#include <linux/nospec.h>
+#include <linux/slab.h>
+
+extern const struct bpf_struct_ops bpf_tcp_ca_struct_ops;
+
+static const struct bpf_struct_ops * const bpf_struct_ops[] = {
+#ifdef CONFIG_INET
+	[BPF_STRUCT_OPS_TCP_CONGESTION] = &bpf_tcp_ca_struct_ops,
+#endif
+};
+
+enum bpf_struct_ops_state {
+	BPF_STRUCT_OPS_STATE_INIT,
+	BPF_STRUCT_OPS_STATE_INUSE,
+	BPF_STRUCT_OPS_STATE_UNREG,
+};
+
+struct bpf_struct_ops_map {
+	struct bpf_map map;
+	const struct bpf_struct_ops *st_ops;
+	/* serializes update and delete */
+	struct mutex lock;
+	enum bpf_struct_ops_state state;
+	struct bpf_prog **progs;
+	/* map value, with program ids in place of the fds */
+	void *uvalue;
+	/* the kernel table, must stay last */
+	char kdata[0] __aligned(8);
+};
+
+static struct bpf_struct_ops_map *bpf_struct_ops_map(const void *kdata)
+{
+	return container_of((void *)kdata, struct bpf_struct_ops_map, kdata);
+}
+
+const struct bpf_struct_ops *bpf_struct_ops_find(u32 type)
+{
+	if (type >= ARRAY_SIZE(bpf_struct_ops))
+		return NULL;
+
+	return bpf_struct_ops[array_index_nospec(type,
+						 ARRAY_SIZE(bpf_struct_ops))];
+}
+
+/* Pin the map behind a table, as try_module_get() pins a module */
+bool bpf_struct_ops_get(const void *kdata)
+{
+	struct bpf_struct_ops_map *st_map = bpf_struct_ops_map(kdata);
+
+	return !IS_ERR(bpf_map_inc(&st_map->map, false));
+}
+
+void bpf_struct_ops_put(const void *kdata)
+{
+	bpf_map_put(&bpf_struct_ops_map(kdata)->map);
+}
+
+/* Program of operation @idx, the caller must hold a reference */
+struct bpf_prog *bpf_struct_ops_prog(const void *kdata, u32 idx)
+{
+	return bpf_struct_ops_map(kdata)->progs[idx];
+}
+
+static const struct bpf_struct_ops *bpf_struct_ops_of(const struct bpf_prog *prog)
+{
+	return bpf_struct_ops[prog->expected_attach_type];
+}
+
+static const struct bpf_func_proto *
+bpf_struct_ops_get_func_proto(enum bpf_func_id func_id,
+			      const struct bpf_prog *prog)
+{
+	return bpf_struct_ops_of(prog)->verifier_ops->get_func_proto(func_id,
+								      prog);
+}
+
+static bool bpf_struct_ops_is_valid_access(int off, int size,
+					   enum bpf_access_type type,
+					   const struct bpf_prog *prog,
+					   struct bpf_insn_access_aux *info)
+{
+	return bpf_struct_ops_of(prog)->verifier_ops->is_valid_access(off, size,
+								       type,
+								       prog,
+								       info);
+}
+
+/* Programs are loaded with their bpf_struct_ops_type in
+ * expected_attach_type, bpf_prog_load_check_attach_type() makes sure it
+ * is a valid index.
+ */
+const struct bpf_verifier_ops bpf_struct_ops_verifier_ops = {
+	.get_func_proto		= bpf_struct_ops_get_func_proto,
+	.is_valid_access	= bpf_struct_ops_is_valid_access,
+};
+
+const struct bpf_prog_ops bpf_struct_ops_prog_ops = {
+};
+
+static int bpf_struct_ops_map_alloc_check(union bpf_attr *attr)
+{
+	const struct bpf_struct_ops *st_ops;
+
+	st_ops = bpf_struct_ops_find(attr->struct_ops_type);
+	if (!st_ops)
+		return -EINVAL;
+
+	if (attr->key_size != sizeof(u32) || attr->max_entries != 1 ||
+	    attr->value_size != st_ops->value_size || attr->map_flags)
+		return -EINVAL;
+
+	return 0;
+}
+
+static struct bpf_map *bpf_struct_ops_map_alloc(union bpf_attr *attr)
+{
+	const struct bpf_struct_ops *st_ops;
+	struct bpf_struct_ops_map *st_map;
+	u64 cost;
+	int err;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return ERR_PTR(-EPERM);
+
+	st_ops = bpf_struct_ops_find(attr->struct_ops_type);
+
+	st_map = kzalloc(sizeof(*st_map) + st_ops->kdata_size, GFP_USER);
+	if (!st_map)
+		return ERR_PTR(-ENOMEM);
+
+	bpf_map_init_from_attr(&st_map->map, attr);
+	st_map->st_ops = st_ops;
+	mutex_init(&st_map->lock);
+
+	cost = sizeof(*st_map) + st_ops->kdata_size + st_ops->value_size +
+	       st_ops->nr_progs * sizeof(struct bpf_prog *);
+	st_map->map.pages = round_up(cost, PAGE_SIZE) >> PAGE_SHIFT;
+	err = bpf_map_precharge_memlock(st_map->map.pages);
+	if (err)
+		goto free_st_map;
+
+	err = -ENOMEM;
+	st_map->uvalue = kzalloc(st_ops->value_size, GFP_USER);
+	if (!st_map->uvalue)
+		goto free_st_map;
+
+	st_map->progs = kcalloc(st_ops->nr_progs, sizeof(*st_map->progs),
+				GFP_USER);
+	if (!st_map->progs)
+		goto free_uvalue;
+
+	return &st_map->map;
+
+free_uvalue:
+	kfree(st_map->uvalue);
+free_st_map:
+	kfree(st_map);
+	return ERR_PTR(err);
+}
+
+static void bpf_struct_ops_map_put_progs(struct bpf_struct_ops_map *st_map)
+{
+	u32 i;
+
+	for (i = 0; i < st_map->st_ops->nr_progs; i++) {
+		if (st_map->progs[i]) {
+			bpf_prog_put(st_map->progs[i]);
+			st_map->progs[i] = NULL;
+		}
+	}
+}
+
+/* Called once the registration and all users dropped their references */
+static void bpf_struct_ops_map_free(struct bpf_map *map)
+{
+	struct bpf_struct_ops_map *st_map = (struct bpf_struct_ops_map *)map;
+
+	bpf_struct_ops_map_put_progs(st_map);
+	kfree(st_map->progs);
+	kfree(st_map->uvalue);
+	kfree(st_map);
+}
+
+static int bpf_struct_ops_map_get_next_key(struct bpf_map *map, void *key,
+					   void *next_key)
+{
+	if (key && *(u32 *)key == 0)
+		return -ENOENT;
+
+	*(u32 *)next_key = 0;
+	return 0;
+}
+
+static void *bpf_struct_ops_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_struct_ops_map *st_map = (struct bpf_struct_ops_map *)map;
+
+	if (*(u32 *)key != 0)
+		return NULL;
+
+	return st_map->uvalue;
+}
+
+static int bpf_struct_ops_map_update_elem(struct bpf_map *map, void *key,
+					  void *value, u64 flags)
+{
+	struct bpf_struct_ops_map *st_map = (struct bpf_struct_ops_map *)map;
+	const struct bpf_struct_ops *st_ops = st_map->st_ops;
+	struct bpf_prog *prog;
+	u32 i, *slot;
+	int err;
+
+	if (flags > BPF_NOEXIST)
+		return -EINVAL;
+	if (*(u32 *)key != 0)
+		return -E2BIG;
+
+	mutex_lock(&st_map->lock);
+
+	if (st_map->state != BPF_STRUCT_OPS_STATE_INIT) {
+		err = -EBUSY;
+		goto unlock;
+	}
+
+	memcpy(st_map->uvalue, value, map->value_size);
+
+	for (i = 0; i < st_ops->nr_progs; i++) {
+		slot = st_map->uvalue + st_ops->prog_offs[i];
+		if (!*slot)
+			continue;
+
+		prog = bpf_prog_get_type(*slot, BPF_PROG_TYPE_STRUCT_OPS);
+		if (IS_ERR(prog)) {
+			err = PTR_ERR(prog);
+			goto reset;
+		}
+		st_map->progs[i] = prog;
+
+		if (bpf_struct_ops_of(prog) != st_ops) {
+			err = -EINVAL;
+			goto reset;
+		}
+		*slot = prog->aux->id;
+	}
+
+	err = st_ops->init(st_map->kdata, value, st_map->progs);
+	if (err)
+		goto reset;
+
+	/* the registration holds the map until the element is deleted */
+	if (IS_ERR(bpf_map_inc(map, false))) {
+		err = -EBUSY;
+		goto reset;
+	}
+
+	err = st_ops->reg(st_map->kdata);
+	if (err) {
+		bpf_map_put(map);
+		goto reset;
+	}
+
+	st_map->state = BPF_STRUCT_OPS_STATE_INUSE;
+	goto unlock;
+
+reset:
+	bpf_struct_ops_map_put_progs(st_map);
+	memset(st_map->uvalue, 0, map->value_size);
+	memset(st_map->kdata, 0, st_ops->kdata_size);
+unlock:
+	mutex_unlock(&st_map->lock);
+	return err;
+}
+
+/* Unregister the table. Sockets still using it keep the map and the
+ * programs alive until they switch away or are closed; the table can
+ * not be registered again, a new map has to be created for that.
+ */
+static int bpf_struct_ops_map_delete_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_struct_ops_map *st_map = (struct bpf_struct_ops_map *)map;
+	int err = 0;
+
+	if (*(u32 *)key != 0)
+		return -E2BIG;
+
+	mutex_lock(&st_map->lock);
+	if (st_map->state == BPF_STRUCT_OPS_STATE_INUSE) {
+		st_map->st_ops->unreg(st_map->kdata);
+		st_map->state = BPF_STRUCT_OPS_STATE_UNREG;
+	} else {
+		err = -ENOENT;
+	}
+	mutex_unlock(&st_map->lock);
+
+	if (!err)
+		bpf_map_put(map);
+	return err;
+}
+
+const struct bpf_map_ops bpf_struct_ops_map_ops = {
+	.map_alloc_check = bpf_struct_ops_map_alloc_check,
+	.map_alloc = bpf_struct_ops_map_alloc,
+	.map_free = bpf_struct_ops_map_free,
+	.map_get_next_key = bpf_struct_ops_map_get_next_key,
+	.map_lookup_elem = bpf_struct_ops_map_lookup_elem,
+	.map_update_elem = bpf_struct_ops_map_update_elem,
+	.map_delete_elem = bpf_struct_ops_map_delete_elem,
+	.map_check_btf = map_check_no_btf,
+};
@@ -344,7 +344,11 @@ int dev_map_enqueue(struct bpf_dtab_netdev *dst, struct xdp_buff *xdp,
 	if (!dev->netdev_ops->ndo_xdp_xmit)
 		return -EOPNOTSUPP;
 
-	err = xdp_ok_fwd_dev(dev, xdp->data_end - xdp->data);
+	if (unlikely(xdp_buff_has_frags(xdp) &&
+		     !(dev->priv_flags & IFF_XDP_XMIT_SG)))
+		return -EOPNOTSUPP;
+
+	err = xdp_ok_fwd_dev(dev, xdp_get_buff_len(xdp));
 	if (unlikely(err))
 		return err;
 
@@ -507,6 +507,67 @@ int __sbitmap_queue_get_shallow(struct sbitmap_queue *sbq,
 }
 EXPORT_SYMBOL_GPL(__sbitmap_queue_get_shallow);
 
+unsigned long __sbitmap_queue_get_batch(struct sbitmap_queue *sbq, int nr_tags,
+					unsigned int *offset)
+{
+	struct sbitmap *sb = &sbq->sb;
+	unsigned int hint, depth, i, index;
+
+	if (unlikely(sbq->round_robin))
+		return 0;
+
+	hint = this_cpu_read(*sbq->alloc_hint);
+	depth = READ_ONCE(sb->depth);
+	if (unlikely(hint >= depth))
+		hint = depth ? prandom_u32() % depth : 0;
+
+	index = SB_NR_TO_INDEX(sb, hint);
+
+	for (i = 0; i < sb->map_nr; i++) {
+		struct sbitmap_word *map = &sb->map[index];
+		unsigned long get_mask, val, old;
+		unsigned int nr, want;
+
+		do {
+			nr = find_first_zero_bit(&map->word, map->depth);
+			if (nr < map->depth)
+				break;
+		} while (sbitmap_deferred_clear(sb, index));
+
+		if (nr >= map->depth)
+			goto next;
+
+		/*
+		 * Grab the free run starting at the first zero bit with a
+		 * single cmpxchg, whatever of it another CPU claimed first
+		 * is masked out below.
+		 */
+		want = min_t(unsigned int, nr_tags, map->depth - nr);
+		get_mask = (~0UL >> (BITS_PER_LONG - want)) << nr;
+		val = READ_ONCE(map->word);
+		while ((old = cmpxchg(&map->word, val, val | get_mask)) != val)
+			val = old;
+
+		get_mask = (get_mask & ~val) >> nr;
+		if (get_mask) {
+			*offset = nr + (index << sb->shift);
+			hint = *offset + want;
+			if (hint >= depth - 1)
+				hint = 0;
+			this_cpu_write(*sbq->alloc_hint, hint);
+			return get_mask;
+		}
+next:
+		if (++index >= sb->map_nr)
+			index = 0;
+	}
+
+	/* If the map is full, a hint won't do us much good. */
+	this_cpu_write(*sbq->alloc_hint, 0);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(__sbitmap_queue_get_batch);
+
 void sbitmap_queue_min_shallow_depth(struct sbitmap_queue *sbq,
 				     unsigned int min_shallow_depth)
 {
@@ -607,6 +668,42 @@ void sbitmap_queue_clear(struct sbitmap_queue *sbq, unsigned int nr,
 }
 EXPORT_SYMBOL_GPL(sbitmap_queue_clear);
 
+void sbitmap_queue_clear_batch(struct sbitmap_queue *sbq, int offset,
+			       int *tags, int nr_tags)
+{
+	struct sbitmap *sb = &sbq->sb;
+	unsigned long *addr = NULL;
+	unsigned long mask = 0;
+	int i;
+
+	smp_mb__before_atomic();
+	for (i = 0; i < nr_tags; i++) {
+		const int tag = tags[i] - offset;
+		unsigned long *this_addr;
+
+		/* a whole batch is freed at once, skip the deferred mask */
+		this_addr = &sb->map[SB_NR_TO_INDEX(sb, tag)].word;
+		if (addr && addr != this_addr) {
+			atomic_long_andnot(mask, (atomic_long_t *)addr);
+			mask = 0;
+		}
+		addr = this_addr;
+		mask |= 1UL << SB_NR_TO_BIT(sb, tag);
+	}
+
+	if (mask)
+		atomic_long_andnot(mask, (atomic_long_t *)addr);
+
+	/* Pairs with set_current_state() in the waiter, see above. */
+	smp_mb__after_atomic();
+	for (i = 0; i < nr_tags; i++)
+		sbitmap_queue_wake_up(sbq);
+
+	if (likely(!sbq->round_robin && nr_tags))
+		this_cpu_write(*sbq->alloc_hint, tags[0] - offset);
+}
+EXPORT_SYMBOL_GPL(sbitmap_queue_clear_batch);
+
 void sbitmap_queue_wake_all(struct sbitmap_queue *sbq)
 {
 	int i, wake_index;
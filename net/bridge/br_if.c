@@ -520,7 +520,7 @@ void br_mtu_auto_adjust(struct net_bridge *br)
 
 static void br_set_gso_limits(struct net_bridge *br)
 {
-	unsigned int gso_max_size = GSO_MAX_SIZE;
+	unsigned int gso_max_size = GSO_LEGACY_MAX_SIZE;
 	u16 gso_max_segs = GSO_MAX_SEGS;
 	const struct net_bridge_port *p;
 
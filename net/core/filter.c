@@ -3285,6 +3285,142 @@ static const struct bpf_func_proto bpf_xdp_adjust_head_proto = {
 	.arg2_type	= ARG_ANYTHING,
 };
 
+BPF_CALL_1(bpf_xdp_get_buff_len, struct xdp_buff *, xdp)
+{
+	return xdp_get_buff_len(xdp);
+}
+
+static const struct bpf_func_proto bpf_xdp_get_buff_len_proto = {
+	.func		= bpf_xdp_get_buff_len,
+	.gpl_only	= false,
+	.ret_type	= RET_INTEGER,
+	.arg1_type	= ARG_PTR_TO_CTX,
+};
+
+/* Copy @len bytes between @buf and the (possibly multi-buffer) frame
+ * starting at @off.  Bounds have already been checked by the caller.
+ */
+static void bpf_xdp_copy_buf(struct xdp_buff *xdp, unsigned long off,
+			     void *buf, unsigned long len, bool flush)
+{
+	unsigned long ptr_len, ptr_off = 0;
+	skb_frag_t *next_frag, *end_frag;
+	struct skb_shared_info *sinfo;
+	void *src, *dst;
+	u8 *ptr_buf;
+
+	if (likely(xdp->data_end - xdp->data >= off + len)) {
+		src = flush ? buf : xdp->data + off;
+		dst = flush ? xdp->data + off : buf;
+		memcpy(dst, src, len);
+		return;
+	}
+
+	sinfo = xdp_get_shared_info_from_buff(xdp);
+	end_frag = &sinfo->frags[sinfo->nr_frags];
+	next_frag = &sinfo->frags[0];
+
+	ptr_len = xdp->data_end - xdp->data;
+	ptr_buf = xdp->data;
+
+	while (true) {
+		if (off < ptr_off + ptr_len) {
+			unsigned long copy_off = off - ptr_off;
+			unsigned long copy_len = min(len, ptr_len - copy_off);
+
+			src = flush ? buf : ptr_buf + copy_off;
+			dst = flush ? ptr_buf + copy_off : buf;
+			memcpy(dst, src, copy_len);
+
+			off += copy_len;
+			len -= copy_len;
+			buf += copy_len;
+		}
+
+		if (!len || next_frag == end_frag)
+			break;
+
+		ptr_off += ptr_len;
+		ptr_buf = skb_frag_address(next_frag);
+		ptr_len = skb_frag_size(next_frag);
+		next_frag++;
+	}
+}
+
+BPF_CALL_4(bpf_xdp_load_bytes, struct xdp_buff *, xdp, u32, offset,
+	   void *, buf, u32, len)
+{
+	if (unlikely((u64)offset + len > xdp_get_buff_len(xdp)))
+		return -EINVAL;
+
+	bpf_xdp_copy_buf(xdp, offset, buf, len, false);
+	return 0;
+}
+
+static const struct bpf_func_proto bpf_xdp_load_bytes_proto = {
+	.func		= bpf_xdp_load_bytes,
+	.gpl_only	= false,
+	.ret_type	= RET_INTEGER,
+	.arg1_type	= ARG_PTR_TO_CTX,
+	.arg2_type	= ARG_ANYTHING,
+	.arg3_type	= ARG_PTR_TO_UNINIT_MEM,
+	.arg4_type	= ARG_CONST_SIZE,
+};
+
+BPF_CALL_4(bpf_xdp_store_bytes, struct xdp_buff *, xdp, u32, offset,
+	   void *, buf, u32, len)
+{
+	if (unlikely((u64)offset + len > xdp_get_buff_len(xdp)))
+		return -EINVAL;
+
+	bpf_xdp_copy_buf(xdp, offset, buf, len, true);
+	return 0;
+}
+
+static const struct bpf_func_proto bpf_xdp_store_bytes_proto = {
+	.func		= bpf_xdp_store_bytes,
+	.gpl_only	= false,
+	.ret_type	= RET_INTEGER,
+	.arg1_type	= ARG_PTR_TO_CTX,
+	.arg2_type	= ARG_ANYTHING,
+	.arg3_type	= ARG_PTR_TO_MEM,
+	.arg4_type	= ARG_CONST_SIZE,
+};
+
+static int bpf_xdp_frags_shrink_tail(struct xdp_buff *xdp, int offset)
+{
+	struct skb_shared_info *sinfo = xdp_get_shared_info_from_buff(xdp);
+	int i, n_frags_free = 0, len_free = 0;
+
+	if (unlikely(offset > (int)xdp_get_buff_len(xdp) - ETH_HLEN))
+		return -EINVAL;
+
+	for (i = sinfo->nr_frags - 1; i >= 0 && offset > 0; i--) {
+		skb_frag_t *frag = &sinfo->frags[i];
+		int shrink = min_t(int, offset, skb_frag_size(frag));
+
+		len_free += shrink;
+		offset -= shrink;
+
+		if (skb_frag_size(frag) == shrink) {
+			xdp_return_frag(skb_frag_page(frag), xdp);
+			n_frags_free++;
+		} else {
+			skb_frag_size_sub(frag, shrink);
+			break;
+		}
+	}
+	sinfo->nr_frags -= n_frags_free;
+	sinfo->xdp_frags_size -= len_free;
+
+	if (unlikely(!sinfo->nr_frags)) {
+		xdp_buff_clear_frags_flag(xdp);
+		xdp->data_end -= offset;
+	}
+
+	return 0;
+}
+
 BPF_CALL_2(bpf_xdp_adjust_tail, struct xdp_buff *, xdp, int, offset)
 {
 	void *data_end = xdp->data_end + offset;
@@ -3293,6 +3429,9 @@ BPF_CALL_2(bpf_xdp_adjust_tail, struct xdp_buff *, xdp, int, offset)
 	if (unlikely(offset >= 0))
 		return -EINVAL;
 
+	if (unlikely(xdp_buff_has_frags(xdp)))
+		return bpf_xdp_frags_shrink_tail(xdp, -offset);
+
 	if (unlikely(data_end < xdp->data + ETH_HLEN))
 		return -EINVAL;
 
@@ -3349,7 +3488,11 @@ static int __bpf_tx_xdp(struct net_device *dev,
 		return -EOPNOTSUPP;
 	}
 
-	err = xdp_ok_fwd_dev(dev, xdp->data_end - xdp->data);
+	if (unlikely(xdp_buff_has_frags(xdp) &&
+		     !(dev->priv_flags & IFF_XDP_XMIT_SG)))
+		return -EOPNOTSUPP;
+
+	err = xdp_ok_fwd_dev(dev, xdp_get_buff_len(xdp));
 	if (unlikely(err))
 		return err;
 
@@ -4550,7 +4693,7 @@ static int bpf_ipv4_fib_lookup(struct net *net, struct bpf_fib_lookup *params,
 	if (res.type != RTN_UNICAST)
 		return BPF_FIB_LKUP_RET_NOT_FWDED;
 
-	if (res.fi->fib_nhs > 1)
+	if (fib_info_num_path(res.fi) > 1)
 		fib_select_path(net, &res, &fl4, NULL);
 
 	if (check_mtu) {
@@ -4559,7 +4702,7 @@ static int bpf_ipv4_fib_lookup(struct net *net, struct bpf_fib_lookup *params,
 			return BPF_FIB_LKUP_RET_FRAG_NEEDED;
 	}
 
-	nh = &res.fi->fib_nh[res.nh_sel];
+	nh = fib_info_nh(res.fi, res.nh_sel);
 
 	/* do not handle lwt encaps right now */
 	if (nh->nh_lwtstate)
@@ -4592,6 +4735,7 @@ static int bpf_ipv6_fib_lookup(struct net *net, struct bpf_fib_lookup *params,
 	struct net_device *dev;
 	struct inet6_dev *idev;
 	struct fib6_info *f6i;
+	struct fib6_nh *nh;
 	struct flowi6 fl6;
 	int strict = 0;
 	int oif;
@@ -4676,13 +4820,14 @@ static int bpf_ipv6_fib_lookup(struct net *net, struct bpf_fib_lookup *params,
 			return BPF_FIB_LKUP_RET_FRAG_NEEDED;
 	}
 
-	if (f6i->fib6_nh.nh_lwtstate)
+	nh = fib6_info_nh(f6i);
+	if (nh->nh_lwtstate)
 		return BPF_FIB_LKUP_RET_UNSUPP_LWT;
 
 	if (f6i->fib6_flags & RTF_GATEWAY)
-		*dst = f6i->fib6_nh.nh_gw;
+		*dst = nh->nh_gw;
 
-	dev = f6i->fib6_nh.nh_dev;
+	dev = nh->nh_dev;
 	params->rt_metric = f6i->fib6_metric;
 
 	/* xdp and cls_bpf programs are run in RCU-bh so rcu_read_lock_bh is
@@ -5484,7 +5629,7 @@ bool bpf_helper_changes_pkt_data(void *func)
 	return false;
 }
 
-static const struct bpf_func_proto *
+const struct bpf_func_proto *
 bpf_base_func_proto(enum bpf_func_id func_id)
 {
 	switch (func_id) {
@@ -5728,6 +5873,12 @@ xdp_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
 		return &bpf_xdp_redirect_map_proto;
 	case BPF_FUNC_xdp_adjust_tail:
 		return &bpf_xdp_adjust_tail_proto;
+	case BPF_FUNC_xdp_get_buff_len:
+		return &bpf_xdp_get_buff_len_proto;
+	case BPF_FUNC_xdp_load_bytes:
+		return &bpf_xdp_load_bytes_proto;
+	case BPF_FUNC_xdp_store_bytes:
+		return &bpf_xdp_store_bytes_proto;
 	case BPF_FUNC_fib_lookup:
 		return &bpf_xdp_fib_lookup_proto;
 #ifdef CONFIG_INET
@@ -5846,6 +5997,19 @@ flow_dissector_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
 	}
 }
 
+static const struct bpf_func_proto *
+rps_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
+{
+	switch (func_id) {
+	case BPF_FUNC_skb_load_bytes:
+		return &bpf_skb_load_bytes_proto;
+	case BPF_FUNC_get_hash_recalc:
+		return &bpf_get_hash_recalc_proto;
+	default:
+		return bpf_base_func_proto(func_id);
+	}
+}
+
 static const struct bpf_func_proto *
 lwt_out_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
 {
@@ -7052,21 +7216,21 @@ u32 bpf_sock_convert_ctx_access(enum bpf_access_type type,
 		break;
 
 	case offsetof(struct bpf_sock, type):
-		BUILD_BUG_ON(HWEIGHT32(SK_FL_TYPE_MASK) != BITS_PER_BYTE * 2);
-		*insn++ = BPF_LDX_MEM(BPF_W, si->dst_reg, si->src_reg,
-				      offsetof(struct sock, __sk_flags_offset));
-		*insn++ = BPF_ALU32_IMM(BPF_AND, si->dst_reg, SK_FL_TYPE_MASK);
-		*insn++ = BPF_ALU32_IMM(BPF_RSH, si->dst_reg, SK_FL_TYPE_SHIFT);
-		*target_size = 2;
+		*insn++ = BPF_LDX_MEM(
+			BPF_FIELD_SIZEOF(struct sock, sk_type),
+			si->dst_reg, si->src_reg,
+			bpf_target_off(struct sock, sk_type,
+				       FIELD_SIZEOF(struct sock, sk_type),
+				       target_size));
 		break;
 
 	case offsetof(struct bpf_sock, protocol):
-		BUILD_BUG_ON(HWEIGHT32(SK_FL_PROTO_MASK) != BITS_PER_BYTE);
-		*insn++ = BPF_LDX_MEM(BPF_W, si->dst_reg, si->src_reg,
-				      offsetof(struct sock, __sk_flags_offset));
-		*insn++ = BPF_ALU32_IMM(BPF_AND, si->dst_reg, SK_FL_PROTO_MASK);
-		*insn++ = BPF_ALU32_IMM(BPF_RSH, si->dst_reg, SK_FL_PROTO_SHIFT);
-		*target_size = 1;
+		*insn++ = BPF_LDX_MEM(
+			BPF_FIELD_SIZEOF(struct sock, sk_protocol),
+			si->dst_reg, si->src_reg,
+			bpf_target_off(struct sock, sk_protocol,
+				       FIELD_SIZEOF(struct sock, sk_protocol),
+				       target_size));
 		break;
 
 	case offsetof(struct bpf_sock, src_ip4):
@@ -7352,20 +7516,13 @@ static u32 sock_addr_convert_ctx_access(enum bpf_access_type type,
 		break;
 
 	case offsetof(struct bpf_sock_addr, type):
-		SOCK_ADDR_LOAD_NESTED_FIELD_SIZE_OFF(
-			struct bpf_sock_addr_kern, struct sock, sk,
-			__sk_flags_offset, BPF_W, 0);
-		*insn++ = BPF_ALU32_IMM(BPF_AND, si->dst_reg, SK_FL_TYPE_MASK);
-		*insn++ = BPF_ALU32_IMM(BPF_RSH, si->dst_reg, SK_FL_TYPE_SHIFT);
+		SOCK_ADDR_LOAD_NESTED_FIELD(struct bpf_sock_addr_kern,
+					    struct sock, sk, sk_type);
 		break;
 
 	case offsetof(struct bpf_sock_addr, protocol):
-		SOCK_ADDR_LOAD_NESTED_FIELD_SIZE_OFF(
-			struct bpf_sock_addr_kern, struct sock, sk,
-			__sk_flags_offset, BPF_W, 0);
-		*insn++ = BPF_ALU32_IMM(BPF_AND, si->dst_reg, SK_FL_PROTO_MASK);
-		*insn++ = BPF_ALU32_IMM(BPF_RSH, si->dst_reg,
-					SK_FL_PROTO_SHIFT);
+		SOCK_ADDR_LOAD_NESTED_FIELD(struct bpf_sock_addr_kern,
+					    struct sock, sk, sk_protocol);
 		break;
 
 	case offsetof(struct bpf_sock_addr, msg_src_ip4):
@@ -7950,6 +8107,18 @@ const struct bpf_prog_ops flow_dissector_prog_ops = {
 	.test_run		= bpf_prog_test_run_flow_dissector,
 };
 
+/* RPS programs see the packet as the flow dissector does, with the flow
+ * already dissected into skb->flow_keys.
+ */
+const struct bpf_verifier_ops rps_verifier_ops = {
+	.get_func_proto		= rps_func_proto,
+	.is_valid_access	= flow_dissector_is_valid_access,
+	.convert_ctx_access	= bpf_convert_ctx_access,
+};
+
+const struct bpf_prog_ops rps_prog_ops = {
+};
+
 int sk_detach_filter(struct sock *sk)
 {
 	int ret = -ENOENT;
@@ -8216,11 +8385,11 @@ sk_reuseport_is_valid_access(int off, int size,
 				    skb,				\
 				    SKB_FIELD)
 
-#define SK_REUSEPORT_LOAD_SK_FIELD_SIZE_OFF(SK_FIELD, BPF_SIZE, EXTRA_OFF) \
-	SOCK_ADDR_LOAD_NESTED_FIELD_SIZE_OFF(struct sk_reuseport_kern,	\
-					     struct sock,		\
-					     sk,			\
-					     SK_FIELD, BPF_SIZE, EXTRA_OFF)
+#define SK_REUSEPORT_LOAD_SK_FIELD(SK_FIELD)				\
+	SOCK_ADDR_LOAD_NESTED_FIELD(struct sk_reuseport_kern,		\
+				    struct sock,			\
+				    sk,					\
+				    SK_FIELD)
 
 static u32 sk_reuseport_convert_ctx_access(enum bpf_access_type type,
 					   const struct bpf_insn *si,
@@ -8244,16 +8413,7 @@ static u32 sk_reuseport_convert_ctx_access(enum bpf_access_type type,
 		break;
 
 	case offsetof(struct sk_reuseport_md, ip_protocol):
-		BUILD_BUG_ON(HWEIGHT32(SK_FL_PROTO_MASK) != BITS_PER_BYTE);
-		SK_REUSEPORT_LOAD_SK_FIELD_SIZE_OFF(__sk_flags_offset,
-						    BPF_W, 0);
-		*insn++ = BPF_ALU32_IMM(BPF_AND, si->dst_reg, SK_FL_PROTO_MASK);
-		*insn++ = BPF_ALU32_IMM(BPF_RSH, si->dst_reg,
-					SK_FL_PROTO_SHIFT);
-		/* SK_FL_PROTO_MASK and SK_FL_PROTO_SHIFT are endian
-		 * aware.  No further narrowing or masking is needed.
-		 */
-		*target_size = 1;
+		SK_REUSEPORT_LOAD_SK_FIELD(sk_protocol);
 		break;
 
 	case offsetof(struct sk_reuseport_md, data_end):
@@ -8280,4 +8440,278 @@ const struct bpf_verifier_ops sk_reuseport_verifier_ops = {
 
 const struct bpf_prog_ops sk_reuseport_prog_ops = {
 };
+
+DEFINE_STATIC_KEY_FALSE(bpf_sk_lookup_enabled);
+EXPORT_SYMBOL(bpf_sk_lookup_enabled);
+
+static DEFINE_MUTEX(sk_lookup_prog_mutex);
+
+struct bpf_sk_lookup_kern {
+	struct net	*net;
+	u16		family;
+	u16		protocol;
+	__be16		sport;
+	u16		dport;
+	struct {
+		__be32 saddr;
+		__be32 daddr;
+	} v4;
+	struct {
+		const struct in6_addr *saddr;
+		const struct in6_addr *daddr;
+	} v6;
+	struct sock	*selected_sk;
+};
+
+static struct sock *bpf_sk_lookup_run(struct bpf_prog *prog,
+				      struct bpf_sk_lookup_kern *ctx)
+{
+	u32 act = BPF_PROG_RUN(prog, ctx);
+
+	if (act != SK_PASS)
+		return ERR_PTR(-ECONNREFUSED);
+	return ctx->selected_sk;
+}
+
+/* Run the socket lookup program of @net, if any, for a received packet.
+ * Returns the socket it selected, NULL to go on with the regular lookup,
+ * or ERR_PTR(-ECONNREFUSED) when the lookup has to fail. Called under
+ * rcu_read_lock(), no reference is taken on the socket.
+ */
+struct sock *bpf_sk_lookup_run_v4(struct net *net, int protocol,
+				  __be32 saddr, __be16 sport,
+				  __be32 daddr, u16 dport)
+{
+	struct bpf_sk_lookup_kern ctx = {
+		.net		= net,
+		.family		= AF_INET,
+		.protocol	= protocol,
+		.v4.saddr	= saddr,
+		.v4.daddr	= daddr,
+		.sport		= sport,
+		.dport		= dport,
+	};
+	struct bpf_prog *prog;
+
+	prog = rcu_dereference(net->sk_lookup_prog);
+	if (!prog)
+		return NULL;
+	return bpf_sk_lookup_run(prog, &ctx);
+}
+EXPORT_SYMBOL_GPL(bpf_sk_lookup_run_v4);
+
+#if IS_ENABLED(CONFIG_IPV6)
+struct sock *bpf_sk_lookup_run_v6(struct net *net, int protocol,
+				  const struct in6_addr *saddr, __be16 sport,
+				  const struct in6_addr *daddr, u16 dport)
+{
+	struct bpf_sk_lookup_kern ctx = {
+		.net		= net,
+		.family		= AF_INET6,
+		.protocol	= protocol,
+		.v6.saddr	= saddr,
+		.v6.daddr	= daddr,
+		.sport		= sport,
+		.dport		= dport,
+	};
+	struct bpf_prog *prog;
+
+	prog = rcu_dereference(net->sk_lookup_prog);
+	if (!prog)
+		return NULL;
+	return bpf_sk_lookup_run(prog, &ctx);
+}
+EXPORT_SYMBOL_GPL(bpf_sk_lookup_run_v6);
+#endif
+
+int sk_lookup_prog_attach(const union bpf_attr *attr, struct bpf_prog *prog)
+{
+	struct net *net = current->nsproxy->net_ns;
+	struct bpf_prog *attached;
+
+	mutex_lock(&sk_lookup_prog_mutex);
+	attached = rcu_dereference_protected(net->sk_lookup_prog,
+					     lockdep_is_held(&sk_lookup_prog_mutex));
+	if (attached) {
+		/* Only one BPF program can be attached at a time */
+		mutex_unlock(&sk_lookup_prog_mutex);
+		return -EEXIST;
+	}
+	rcu_assign_pointer(net->sk_lookup_prog, prog);
+	static_branch_inc(&bpf_sk_lookup_enabled);
+	mutex_unlock(&sk_lookup_prog_mutex);
+	return 0;
+}
+
+static int __sk_lookup_prog_detach(struct net *net)
+{
+	struct bpf_prog *attached;
+
+	mutex_lock(&sk_lookup_prog_mutex);
+	attached = rcu_dereference_protected(net->sk_lookup_prog,
+					     lockdep_is_held(&sk_lookup_prog_mutex));
+	if (!attached) {
+		mutex_unlock(&sk_lookup_prog_mutex);
+		return -ENOENT;
+	}
+	RCU_INIT_POINTER(net->sk_lookup_prog, NULL);
+	static_branch_dec(&bpf_sk_lookup_enabled);
+	bpf_prog_put(attached);
+	mutex_unlock(&sk_lookup_prog_mutex);
+	return 0;
+}
+
+int sk_lookup_prog_detach(const union bpf_attr *attr)
+{
+	return __sk_lookup_prog_detach(current->nsproxy->net_ns);
+}
+
+static void __net_exit sk_lookup_net_exit(struct net *net)
+{
+	__sk_lookup_prog_detach(net);
+}
+
+static struct pernet_operations sk_lookup_net_ops = {
+	.exit = sk_lookup_net_exit,
+};
+
+static int __init sk_lookup_init(void)
+{
+	return register_pernet_subsys(&sk_lookup_net_ops);
+}
+subsys_initcall(sk_lookup_init);
+
+BPF_CALL_4(bpf_sk_assign, struct bpf_sk_lookup_kern *, ctx,
+	   struct bpf_map *, map, void *, key, u64, flags)
+{
+	struct sock *sk;
+
+	if (unlikely(flags))
+		return -EINVAL;
+
+	sk = map->ops->map_lookup_elem(map, key);
+	/* Unhashed by close() after the map lookup, as if already gone */
+	if (!sk || !rcu_access_pointer(sk->sk_reuseport_cb))
+		return -ENOENT;
+
+	if (!net_eq(sock_net(sk), ctx->net))
+		return -EINVAL;
+	if (sk->sk_protocol != ctx->protocol ||
+	    (sk->sk_protocol == IPPROTO_TCP && sk->sk_state != TCP_LISTEN))
+		return -EPROTOTYPE;
+	if (sk->sk_family != ctx->family &&
+	    (sk->sk_family == AF_INET || ipv6_only_sock(sk)))
+		return -EAFNOSUPPORT;
+
+	ctx->selected_sk = sk;
+	return 0;
+}
+
+static const struct bpf_func_proto bpf_sk_assign_proto = {
+	.func		= bpf_sk_assign,
+	.gpl_only	= false,
+	.ret_type	= RET_INTEGER,
+	.arg1_type	= ARG_PTR_TO_CTX,
+	.arg2_type	= ARG_CONST_MAP_PTR,
+	.arg3_type	= ARG_PTR_TO_MAP_KEY,
+	.arg4_type	= ARG_ANYTHING,
+};
+
+static const struct bpf_func_proto *
+sk_lookup_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
+{
+	switch (func_id) {
+	case BPF_FUNC_sk_assign:
+		return &bpf_sk_assign_proto;
+	default:
+		return bpf_base_func_proto(func_id);
+	}
+}
+
+static bool sk_lookup_is_valid_access(int off, int size,
+				      enum bpf_access_type type,
+				      const struct bpf_prog *prog,
+				      struct bpf_insn_access_aux *info)
+{
+	if (off < 0 || off >= sizeof(struct bpf_sk_lookup) ||
+	    off % size || type != BPF_READ)
+		return false;
+
+	return size == sizeof(__u32);
+}
+
+#define SK_LOOKUP_LOAD_FIELD(F) ({					\
+	*insn++ = BPF_LDX_MEM(BPF_FIELD_SIZEOF(struct bpf_sk_lookup_kern, F), \
+			      si->dst_reg, si->src_reg,			\
+			      bpf_target_off(struct bpf_sk_lookup_kern, F, \
+					     FIELD_SIZEOF(struct bpf_sk_lookup_kern, F), \
+					     target_size));		\
+	})
+
+/* Loads word @off of the IPv6 address F points to, 0 for IPv4 lookups */
+#define SK_LOOKUP_LOAD_IP6_WORD(F, off) ({				\
+	*insn++ = BPF_LDX_MEM(BPF_SIZEOF(void *), si->dst_reg, si->src_reg, \
+			      offsetof(struct bpf_sk_lookup_kern, F));	\
+	*insn++ = BPF_JMP_IMM(BPF_JEQ, si->dst_reg, 0, 1);		\
+	*insn++ = BPF_LDX_MEM(BPF_W, si->dst_reg, si->dst_reg, (off));	\
+	})
+
+static u32 sk_lookup_convert_ctx_access(enum bpf_access_type type,
+					const struct bpf_insn *si,
+					struct bpf_insn *insn_buf,
+					struct bpf_prog *prog,
+					u32 *target_size)
+{
+	struct bpf_insn *insn = insn_buf;
+	int off;
+
+	switch (si->off) {
+	case offsetof(struct bpf_sk_lookup, family):
+		SK_LOOKUP_LOAD_FIELD(family);
+		break;
+
+	case offsetof(struct bpf_sk_lookup, protocol):
+		SK_LOOKUP_LOAD_FIELD(protocol);
+		break;
+
+	case offsetof(struct bpf_sk_lookup, remote_ip4):
+		SK_LOOKUP_LOAD_FIELD(v4.saddr);
+		break;
+
+	case offsetof(struct bpf_sk_lookup, local_ip4):
+		SK_LOOKUP_LOAD_FIELD(v4.daddr);
+		break;
+
+	case bpf_ctx_range_till(struct bpf_sk_lookup,
+				remote_ip6[0], remote_ip6[3]):
+		off = si->off - offsetof(struct bpf_sk_lookup, remote_ip6[0]);
+		SK_LOOKUP_LOAD_IP6_WORD(v6.saddr, off);
+		break;
+
+	case bpf_ctx_range_till(struct bpf_sk_lookup,
+				local_ip6[0], local_ip6[3]):
+		off = si->off - offsetof(struct bpf_sk_lookup, local_ip6[0]);
+		SK_LOOKUP_LOAD_IP6_WORD(v6.daddr, off);
+		break;
+
+	case offsetof(struct bpf_sk_lookup, remote_port):
+		SK_LOOKUP_LOAD_FIELD(sport);
+		break;
+
+	case offsetof(struct bpf_sk_lookup, local_port):
+		SK_LOOKUP_LOAD_FIELD(dport);
+		break;
+	}
+
+	return insn - insn_buf;
+}
+
+const struct bpf_verifier_ops sk_lookup_verifier_ops = {
+	.get_func_proto		= sk_lookup_func_proto,
+	.is_valid_access	= sk_lookup_is_valid_access,
+	.convert_ctx_access	= sk_lookup_convert_ctx_access,
+};
+
+const struct bpf_prog_ops sk_lookup_prog_ops = {
+};
 #endif /* CONFIG_INET */
@@ -723,6 +723,50 @@ bool __skb_flow_bpf_dissect(struct bpf_prog *prog,
 	return result == BPF_OK;
 }
 
+/**
+ * skb_flow_dissect_bpf_keys - dissect the flow of an skb for BPF
+ * @skb: sk_buff to extract the flow from, the network header must be set
+ * @flow_keys: filled in the way a BPF flow dissector would
+ *
+ * For BPF programs that look at the flow of a packet through
+ * skb->flow_keys but do not dissect it themselves. Uses the BPF flow
+ * dissector of the namespace, if attached.
+ */
+bool skb_flow_dissect_bpf_keys(const struct sk_buff *skb,
+			       struct bpf_flow_keys *flow_keys)
+{
+	struct flow_keys keys;
+	bool ret;
+
+	ret = skb_flow_dissect_flow_keys(skb, &keys, 0);
+
+	memset(flow_keys, 0, sizeof(*flow_keys));
+	flow_keys->nhoff = skb_network_offset(skb);
+	flow_keys->thoff = keys.control.thoff;
+	flow_keys->is_frag = !!(keys.control.flags & FLOW_DIS_IS_FRAGMENT);
+	flow_keys->is_first_frag = !!(keys.control.flags & FLOW_DIS_FIRST_FRAG);
+	flow_keys->is_encap = !!(keys.control.flags & FLOW_DIS_ENCAPSULATION);
+	flow_keys->n_proto = keys.basic.n_proto;
+	flow_keys->ip_proto = keys.basic.ip_proto;
+	flow_keys->sport = keys.ports.src;
+	flow_keys->dport = keys.ports.dst;
+
+	switch (keys.control.addr_type) {
+	case FLOW_DISSECTOR_KEY_IPV4_ADDRS:
+		flow_keys->addr_proto = ETH_P_IP;
+		flow_keys->ipv4_src = keys.addrs.v4addrs.src;
+		flow_keys->ipv4_dst = keys.addrs.v4addrs.dst;
+		break;
+	case FLOW_DISSECTOR_KEY_IPV6_ADDRS:
+		flow_keys->addr_proto = ETH_P_IPV6;
+		memcpy(&flow_keys->ipv6_src, &keys.addrs.v6addrs,
+		       sizeof(keys.addrs.v6addrs));
+		break;
+	}
+
+	return ret;
+}
+
 /**
  * __skb_flow_dissect - extract the flow_keys struct and return it
  * @skb: sk_buff to extract the flow from, can be NULL if the rest are specified
@@ -196,6 +196,11 @@ int __scm_send(struct socket *sock, struct msghdr *msg, struct scm_cookie *p)
 			p->creds.gid = gid;
 			break;
 		}
+		case SCM_ZC_NOTIFICATION:
+			err = sock_zerocopy_report(sock->sk, cmsg);
+			if (err)
+				goto error;
+			break;
 		default:
 			goto error;
 		}
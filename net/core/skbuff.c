@@ -69,6 +69,7 @@
 #include <net/sock.h>
 #include <net/checksum.h>
 #include <net/ip6_checksum.h>
+#include <net/ipv6.h>
 #include <net/xfrm.h>
 
 #include <linux/uaccess.h>
@@ -547,14 +548,24 @@ static void skb_clone_fraglist(struct sk_buff *skb)
 		skb_get(list);
 }
 
+static bool skb_pp_recycle(struct sk_buff *skb, void *data)
+{
+	if (!IS_ENABLED(CONFIG_PAGE_POOL) || !skb->pp_recycle)
+		return false;
+	return page_pool_return_skb_page(virt_to_page(data));
+}
+
 static void skb_free_head(struct sk_buff *skb)
 {
 	unsigned char *head = skb->head;
 
-	if (skb->head_frag)
+	if (skb->head_frag) {
+		if (skb_pp_recycle(skb, head))
+			return;
 		skb_free_frag(head);
-	else
+	} else {
 		kfree(head);
+	}
 }
 
 static void skb_release_data(struct sk_buff *skb)
@@ -568,7 +579,7 @@ static void skb_release_data(struct sk_buff *skb)
 		return;
 
 	for (i = 0; i < shinfo->nr_frags; i++)
-		__skb_frag_unref(&shinfo->frags[i]);
+		__skb_frag_unref(&shinfo->frags[i], skb->pp_recycle);
 
 	if (shinfo->frag_list)
 		kfree_skb_list(shinfo->frag_list);
@@ -1080,6 +1091,77 @@ void sock_zerocopy_callback(struct ubuf_info *uarg, bool success)
 }
 EXPORT_SYMBOL_GPL(sock_zerocopy_callback);
 
+/* SCM_ZC_NOTIFICATION: move pending completion ranges from the error
+ * queue into the struct zc_info passed on sendmsg, saving the separate
+ * recvmsg(MSG_ERRQUEUE) call per notification.  Other error queue
+ * entries, such as timestamps, are left in place.
+ */
+int sock_zerocopy_report(struct sock *sk, struct cmsghdr *cmsg)
+{
+	struct sk_buff_head *q = &sk->sk_error_queue;
+	struct zc_info __user *uinfo;
+	struct sk_buff *skb, *tmp;
+	struct sk_buff_head list;
+	unsigned long flags;
+	u32 size, n = 0;
+	u64 uaddr;
+
+	if (!sock_flag(sk, SOCK_ZEROCOPY))
+		return -EINVAL;
+	if (cmsg->cmsg_len != CMSG_LEN(sizeof(u64)))
+		return -EINVAL;
+
+	memcpy(&uaddr, CMSG_DATA(cmsg), sizeof(uaddr));
+	uinfo = u64_to_user_ptr(uaddr);
+	if (get_user(size, &uinfo->size))
+		return -EFAULT;
+	if (size > SOCK_ZC_INFO_MAX)
+		return -EINVAL;
+
+	__skb_queue_head_init(&list);
+
+	spin_lock_irqsave(&q->lock, flags);
+	skb_queue_walk_safe(q, skb, tmp) {
+		if (n == size)
+			break;
+		if (SKB_EXT_ERR(skb)->ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+			continue;
+		__skb_unlink(skb, q);
+		__skb_queue_tail(&list, skb);
+		n++;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	n = 0;
+	skb_queue_walk(&list, skb) {
+		struct sock_exterr_skb *serr = SKB_EXT_ERR(skb);
+		struct zc_info_elem elem = {
+			.lo = serr->ee.ee_info,
+			.hi = serr->ee.ee_data,
+			.zerocopy = !(serr->ee.ee_code &
+				      SO_EE_CODE_ZEROCOPY_COPIED),
+		};
+
+		if (copy_to_user(&uinfo->arr[n], &elem, sizeof(elem)))
+			goto efault;
+		n++;
+	}
+
+	if (put_user(n, &uinfo->count))
+		goto efault;
+
+	__skb_queue_purge(&list);
+	return 0;
+
+efault:
+	/* Nothing was reported, put the completions back in order */
+	spin_lock_irqsave(&q->lock, flags);
+	skb_queue_splice(&list, q);
+	spin_unlock_irqrestore(&q->lock, flags);
+	return -EFAULT;
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_report);
+
 void sock_zerocopy_put(struct ubuf_info *uarg)
 {
 	if (uarg && refcount_dec_and_test(&uarg->refcnt)) {
@@ -1108,9 +1190,12 @@ EXPORT_SYMBOL_GPL(sock_zerocopy_put_abort);
 extern int __zerocopy_sg_from_iter(struct sock *sk, struct sk_buff *skb,
 				   struct iov_iter *from, size_t length);
 
+/* Pinned pages are charged to skb->sk->sk_wmem_alloc, which is also
+ * what AF_UNIX stream sockets need.
+ */
 int skb_zerocopy_iter_dgram(struct sk_buff *skb, struct msghdr *msg, int len)
 {
-	return __zerocopy_sg_from_iter(skb->sk, skb, &msg->msg_iter, len);
+	return __zerocopy_sg_from_iter(NULL, skb, &msg->msg_iter, len);
 }
 EXPORT_SYMBOL_GPL(skb_zerocopy_iter_dgram);
 
@@ -3215,7 +3300,7 @@ int skb_shift(struct sk_buff *tgt, struct sk_buff *skb, int shiftlen)
 		fragto = &skb_shinfo(tgt)->frags[merge];
 
 		skb_frag_size_add(fragto, skb_frag_size(fragfrom));
-		__skb_frag_unref(fragfrom);
+		__skb_frag_unref(fragfrom, skb->pp_recycle);
 	}
 
 	/* Reposition in the original skb */
@@ -3799,11 +3884,32 @@ int skb_gro_receive(struct sk_buff *p, struct sk_buff *skb)
 	unsigned int headlen = skb_headlen(skb);
 	unsigned int len = skb_gro_len(skb);
 	unsigned int delta_truesize;
+	unsigned int gro_max_size;
 	struct sk_buff *lp;
 
-	if (unlikely(p->len + len >= 65536))
+	/* pairs with WRITE_ONCE() in netif_set_gro_max_size() */
+	gro_max_size = READ_ONCE(p->dev->gro_max_size);
+
+	if (unlikely(p->len + len >= gro_max_size))
 		return -E2BIG;
 
+	/* Beyond 64KB only plain TCP over IPv6 can be aggregated, and
+	 * ipv6_gro_complete() needs headroom for a jumbo payload option.
+	 */
+	if (unlikely(p->len + len >= GRO_LEGACY_MAX_SIZE)) {
+		if (p->protocol != htons(ETH_P_IPV6) ||
+		    skb_headroom(p) < sizeof(struct hop_jumbo_hdr) ||
+		    ipv6_hdr(p)->nexthdr != IPPROTO_TCP ||
+		    p->encapsulation)
+			return -E2BIG;
+	}
+
+	/* Pages from a page_pool and regular pages are released
+	 * differently, do not mix them in one skb.
+	 */
+	if (unlikely(p->pp_recycle != skb->pp_recycle))
+		return -ETOOMANYREFS;
+
 	lp = NAPI_GRO_CB(p)->last;
 	pinfo = skb_shinfo(lp);
 
@@ -4851,6 +4957,12 @@ bool skb_try_coalesce(struct sk_buff *to, struct sk_buff *from,
 	if (skb_zcopy(to) || skb_zcopy(from))
 		return false;
 
+	/* Do not mix page_pool backed and regular page frags, they are
+	 * released differently.
+	 */
+	if (to->pp_recycle != from->pp_recycle)
+		return false;
+
 	if (skb_headlen(from) != 0) {
 		struct page *page;
 		unsigned int offset;
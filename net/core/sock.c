@@ -141,6 +141,7 @@
 #include <trace/events/sock.h>
 
 #include <net/tcp.h>
+#include <net/ipv6.h>
 #include <net/busy_poll.h>
 
 static DEFINE_MUTEX(proto_list_mutex);
@@ -1141,6 +1142,9 @@ int sock_setsockopt(struct socket *sock, int level, int optname,
 			      (sk->sk_type == SOCK_DGRAM &&
 			       sk->sk_protocol == IPPROTO_UDP)))
 				ret = -ENOTSUPP;
+		} else if (sk->sk_family == PF_UNIX) {
+			if (sk->sk_type != SOCK_STREAM)
+				ret = -ENOTSUPP;
 		} else if (sk->sk_family != PF_RDS) {
 			ret = -ENOTSUPP;
 		}
@@ -1903,6 +1907,26 @@ void sk_free_unlock_clone(struct sock *sk)
 }
 EXPORT_SYMBOL_GPL(sk_free_unlock_clone);
 
+/* Only IPv6 can build packets beyond 64KB, using a jumbo payload
+ * option; IPv4 and v4-mapped sockets stay within the legacy limit.
+ */
+static u32 sk_dst_gso_max_size(struct sock *sk, struct dst_entry *dst)
+{
+	u32 max_size = READ_ONCE(dst->dev->gso_max_size);
+
+	if (max_size <= GSO_LEGACY_MAX_SIZE)
+		return max_size;
+
+#if IS_ENABLED(CONFIG_IPV6)
+	if (sk->sk_family == AF_INET6 &&
+	    sk->sk_protocol == IPPROTO_TCP &&
+	    !ipv6_addr_v4mapped(&sk->sk_v6_rcv_saddr))
+		return max_size;
+#endif
+
+	return GSO_LEGACY_MAX_SIZE;
+}
+
 void sk_setup_caps(struct sock *sk, struct dst_entry *dst)
 {
 	u32 max_segs = 1;
@@ -1917,7 +1941,7 @@ void sk_setup_caps(struct sock *sk, struct dst_entry *dst)
 			sk->sk_route_caps &= ~NETIF_F_GSO_MASK;
 		} else {
 			sk->sk_route_caps |= NETIF_F_SG | NETIF_F_HW_CSUM;
-			sk->sk_gso_max_size = dst->dev->gso_max_size;
+			sk->sk_gso_max_size = sk_dst_gso_max_size(sk, dst);
 			max_segs = max_t(u32, dst->dev->gso_max_segs, 1);
 		}
 	}
@@ -2269,6 +2293,8 @@ int __sock_cmsg_send(struct sock *sk, struct msghdr *msg, struct cmsghdr *cmsg,
 			return -EINVAL;
 		sockc->transmit_time = get_unaligned((u64 *)CMSG_DATA(cmsg));
 		break;
+	case SCM_ZC_NOTIFICATION:
+		return sock_zerocopy_report(sk, cmsg);
 	/* SCM_RIGHTS and SCM_CREDENTIALS are semantically in SOL_UNIX. */
 	case SCM_RIGHTS:
 	case SCM_CREDENTIALS:
@@ -138,6 +138,7 @@ void xdp_rxq_info_unreg(struct xdp_rxq_info *xdp_rxq)
 	/* Reset mem info to defaults */
 	xdp_rxq->mem.id = 0;
 	xdp_rxq->mem.type = 0;
+	xdp_rxq->frag_size = 0;
 }
 EXPORT_SYMBOL_GPL(xdp_rxq_info_unreg);
 
@@ -336,7 +337,11 @@ static void __xdp_return(void *data, struct xdp_mem_info *mem, bool napi_direct,
 		if (xa) {
 			napi_direct &= !xdp_return_frame_no_direct();
 			page_pool_put_page(xa->page_pool, page, napi_direct);
-		} else {
+		} else if (!page_pool_return_skb_page(page)) {
+			/* Allocator already unregistered; the page still
+			 * knows its pool, which stays alive until all
+			 * in-flight pages are back.
+			 */
 			put_page(page);
 		}
 		rcu_read_unlock();
@@ -361,20 +366,53 @@ static void __xdp_return(void *data, struct xdp_mem_info *mem, bool napi_direct,
 	}
 }
 
+static void xdp_return_frags(struct skb_shared_info *sinfo,
+			     struct xdp_mem_info *mem, bool napi_direct)
+{
+	int i;
+
+	for (i = 0; i < sinfo->nr_frags; i++) {
+		struct page *page = skb_frag_page(&sinfo->frags[i]);
+
+		__xdp_return(page_address(page), mem, napi_direct, 0);
+	}
+}
+
 void xdp_return_frame(struct xdp_frame *xdpf)
 {
+	if (unlikely(xdp_frame_has_frags(xdpf)))
+		xdp_return_frags(xdp_get_shared_info_from_frame(xdpf),
+				 &xdpf->mem, false);
+
 	__xdp_return(xdpf->data, &xdpf->mem, false, 0);
 }
 EXPORT_SYMBOL_GPL(xdp_return_frame);
 
 void xdp_return_frame_rx_napi(struct xdp_frame *xdpf)
 {
+	if (unlikely(xdp_frame_has_frags(xdpf)))
+		xdp_return_frags(xdp_get_shared_info_from_frame(xdpf),
+				 &xdpf->mem, true);
+
 	__xdp_return(xdpf->data, &xdpf->mem, true, 0);
 }
 EXPORT_SYMBOL_GPL(xdp_return_frame_rx_napi);
 
+/* Release a single fragment of a multi-buffer xdp_buff, e.g. when it is
+ * dropped by bpf_xdp_adjust_tail().
+ */
+void xdp_return_frag(struct page *page, const struct xdp_buff *xdp)
+{
+	__xdp_return(page_address(page), &xdp->rxq->mem, false, 0);
+}
+EXPORT_SYMBOL_GPL(xdp_return_frag);
+
 void xdp_return_buff(struct xdp_buff *xdp)
 {
+	if (unlikely(xdp_buff_has_frags(xdp)))
+		xdp_return_frags(xdp_get_shared_info_from_buff(xdp),
+				 &xdp->rxq->mem, true);
+
 	__xdp_return(xdp->data, &xdp->rxq->mem, true, xdp->handle);
 }
 EXPORT_SYMBOL_GPL(xdp_return_buff);
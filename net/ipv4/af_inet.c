@@ -1976,6 +1976,9 @@ static int __init inet_init(void)
 	/* Setup TCP slab cache for open requests. */
 	tcp_init();
 
+	/* Add MPTCP on top of TCP */
+	mptcp_init();
+
 	/* Setup UDP memory threshold */
 	udp_init();
 
@@ -0,0 +1,352 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * TCP congestion control implemented by BPF programs
+ *
+ * Updating a BPF_MAP_TYPE_STRUCT_OPS map of BPF_STRUCT_OPS_TCP_CONGESTION
+ * registers a tcp_congestion_ops whose operations run the programs of the
+ * map. Each program sees a struct bpf_tcp_ca snapshot of the socket, the
+ * fields it may write and the private state of the algorithm are copied
+ * back once it returns.
+ *
+ * cong_control, get_info, sndbuf_expand and min_tso_segs are not
+ * available to BPF.
+ */
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <net/tcp.h>
+
+struct bpf_tcp_ca_kern {
+	struct bpf_tcp_ca ctx;
+	struct sock *sk;
+};
+
+/* ecn_flags the programs may change, the ECE state of the ACKs */
+#define BPF_TCP_CA_ECN_FLAGS	(TCP_ECN_QUEUE_CWR | TCP_ECN_DEMAND_CWR)
+
+static void bpf_tcp_ca_load(const struct sock *sk, struct bpf_tcp_ca *ctx)
+{
+	const struct inet_connection_sock *icsk = inet_csk(sk);
+	const struct tcp_sock *tp = tcp_sk(sk);
+
+	ctx->state = sk->sk_state;
+	ctx->ca_state = icsk->icsk_ca_state;
+	ctx->snd_una = tp->snd_una;
+	ctx->snd_nxt = tp->snd_nxt;
+	ctx->rcv_nxt = tp->rcv_nxt;
+	ctx->mss_cache = tp->mss_cache;
+	ctx->rcv_mss = icsk->icsk_ack.rcv_mss;
+	ctx->srtt_us = tp->srtt_us;
+	ctx->packets_out = tp->packets_out;
+	ctx->snd_cwnd_clamp = tp->snd_cwnd_clamp;
+	ctx->prior_cwnd = tp->prior_cwnd;
+	ctx->is_cwnd_limited = tcp_is_cwnd_limited(sk);
+	ctx->ack_pending = icsk->icsk_ack.pending;
+	ctx->delivered = tp->delivered;
+	ctx->delivered_ce = tp->delivered_ce;
+
+	ctx->snd_cwnd = tp->snd_cwnd;
+	ctx->snd_ssthresh = tp->snd_ssthresh;
+	ctx->snd_cwnd_cnt = tp->snd_cwnd_cnt;
+	ctx->ecn_flags = tp->ecn_flags;
+	memcpy(ctx->priv, icsk->icsk_ca_priv, sizeof(ctx->priv));
+}
+
+static void bpf_tcp_ca_sync_ecn(struct sock *sk, const struct bpf_tcp_ca *ctx)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	tp->ecn_flags = (tp->ecn_flags & ~BPF_TCP_CA_ECN_FLAGS) |
+			(ctx->ecn_flags & BPF_TCP_CA_ECN_FLAGS);
+}
+
+static void bpf_tcp_ca_store(struct sock *sk, const struct bpf_tcp_ca *ctx)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	tp->snd_cwnd = clamp(ctx->snd_cwnd, 1U, tp->snd_cwnd_clamp);
+	tp->snd_ssthresh = ctx->snd_ssthresh;
+	tp->snd_cwnd_cnt = ctx->snd_cwnd_cnt;
+	bpf_tcp_ca_sync_ecn(sk, ctx);
+	memcpy(icsk->icsk_ca_priv, ctx->priv, sizeof(ctx->priv));
+
+	if (ctx->actions & BPF_TCP_CA_ACT_ACK_NOW)
+		icsk->icsk_ack.pending |= ICSK_ACK_NOW;
+}
+
+/* Run the program of operation kctx->ctx.op, the arguments of which the
+ * caller filled in. Returns the return value of the program.
+ */
+static u32 bpf_tcp_ca_run(struct sock *sk, struct bpf_tcp_ca_kern *kctx)
+{
+	struct bpf_prog *prog;
+	u32 ret;
+
+	prog = bpf_struct_ops_prog(inet_csk(sk)->icsk_ca_ops, kctx->ctx.op);
+	kctx->sk = sk;
+	bpf_tcp_ca_load(sk, &kctx->ctx);
+
+	preempt_disable();
+	rcu_read_lock();
+	ret = BPF_PROG_RUN(prog, &kctx->ctx);
+	rcu_read_unlock();
+	preempt_enable();
+
+	bpf_tcp_ca_store(sk, &kctx->ctx);
+	return ret;
+}
+
+static void bpf_tcp_ca_init(struct sock *sk)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	const struct tcp_congestion_ops *ca = icsk->icsk_ca_ops;
+	struct bpf_tcp_ca_kern kctx = {
+		.ctx.op		= BPF_TCP_CA_OP_INIT,
+	};
+
+	bpf_tcp_ca_run(sk, &kctx);
+
+	/* The algorithm can not run on this connection, e.g. DCTCP without
+	 * ECN. Like dctcp_init(), switch to reno before the caller decides
+	 * on ECT for the socket.
+	 */
+	if (kctx.ctx.actions & BPF_TCP_CA_ACT_FALLBACK_RENO) {
+		icsk->icsk_ca_ops = &tcp_reno;
+		memset(icsk->icsk_ca_priv, 0, sizeof(icsk->icsk_ca_priv));
+		bpf_module_put(ca, ca->owner);
+	}
+}
+
+static void bpf_tcp_ca_release(struct sock *sk)
+{
+	struct bpf_tcp_ca_kern kctx = {
+		.ctx.op		= BPF_TCP_CA_OP_RELEASE,
+	};
+
+	bpf_tcp_ca_run(sk, &kctx);
+}
+
+static u32 bpf_tcp_ca_ssthresh(struct sock *sk)
+{
+	struct bpf_tcp_ca_kern kctx = {
+		.ctx.op		= BPF_TCP_CA_OP_SSTHRESH,
+	};
+
+	return bpf_tcp_ca_run(sk, &kctx);
+}
+
+static void bpf_tcp_ca_cong_avoid(struct sock *sk, u32 ack, u32 acked)
+{
+	struct bpf_tcp_ca_kern kctx = {
+		.ctx.op		= BPF_TCP_CA_OP_CONG_AVOID,
+		.ctx.ack	= ack,
+		.ctx.acked	= acked,
+	};
+
+	bpf_tcp_ca_run(sk, &kctx);
+}
+
+static void bpf_tcp_ca_set_state(struct sock *sk, u8 new_state)
+{
+	struct bpf_tcp_ca_kern kctx = {
+		.ctx.op		= BPF_TCP_CA_OP_SET_STATE,
+		.ctx.new_state	= new_state,
+	};
+
+	bpf_tcp_ca_run(sk, &kctx);
+}
+
+static void bpf_tcp_ca_cwnd_event(struct sock *sk, enum tcp_ca_event ev)
+{
+	struct bpf_tcp_ca_kern kctx = {
+		.ctx.op		= BPF_TCP_CA_OP_CWND_EVENT,
+		.ctx.event	= ev,
+	};
+
+	bpf_tcp_ca_run(sk, &kctx);
+}
+
+static void bpf_tcp_ca_in_ack_event(struct sock *sk, u32 flags)
+{
+	struct bpf_tcp_ca_kern kctx = {
+		.ctx.op		= BPF_TCP_CA_OP_IN_ACK_EVENT,
+		.ctx.ack_flags	= flags,
+	};
+
+	bpf_tcp_ca_run(sk, &kctx);
+}
+
+static u32 bpf_tcp_ca_undo_cwnd(struct sock *sk)
+{
+	struct bpf_tcp_ca_kern kctx = {
+		.ctx.op		= BPF_TCP_CA_OP_UNDO_CWND,
+	};
+
+	return bpf_tcp_ca_run(sk, &kctx);
+}
+
+static void bpf_tcp_ca_pkts_acked(struct sock *sk,
+				  const struct ack_sample *sample)
+{
+	struct bpf_tcp_ca_kern kctx = {
+		.ctx.op		= BPF_TCP_CA_OP_PKTS_ACKED,
+		.ctx.acked	= sample->pkts_acked,
+		.ctx.rtt_us	= sample->rtt_us,
+		.ctx.in_flight	= sample->in_flight,
+	};
+
+	bpf_tcp_ca_run(sk, &kctx);
+}
+
+BPF_CALL_2(bpf_tcp_send_ack, struct bpf_tcp_ca *, ctx, u32, rcv_nxt)
+{
+	struct bpf_tcp_ca_kern *kctx;
+
+	/* only from the receive path, where the ACK reflects the CE state */
+	if (ctx->op != BPF_TCP_CA_OP_CWND_EVENT ||
+	    (ctx->event != CA_EVENT_ECN_NO_CE &&
+	     ctx->event != CA_EVENT_ECN_IS_CE))
+		return -EOPNOTSUPP;
+
+	kctx = container_of(ctx, struct bpf_tcp_ca_kern, ctx);
+	bpf_tcp_ca_sync_ecn(kctx->sk, ctx);
+	__tcp_send_ack(kctx->sk, rcv_nxt);
+	return 0;
+}
+
+static const struct bpf_func_proto bpf_tcp_send_ack_proto = {
+	.func		= bpf_tcp_send_ack,
+	.gpl_only	= false,
+	.ret_type	= RET_INTEGER,
+	.arg1_type	= ARG_PTR_TO_CTX,
+	.arg2_type	= ARG_ANYTHING,
+};
+
+static const struct bpf_func_proto *
+bpf_tcp_ca_get_func_proto(enum bpf_func_id func_id,
+			  const struct bpf_prog *prog)
+{
+	switch (func_id) {
+	case BPF_FUNC_tcp_send_ack:
+		return &bpf_tcp_send_ack_proto;
+	default:
+		return bpf_base_func_proto(func_id);
+	}
+}
+
+static bool bpf_tcp_ca_is_valid_access(int off, int size,
+				       enum bpf_access_type type,
+				       const struct bpf_prog *prog,
+				       struct bpf_insn_access_aux *info)
+{
+	if (off < 0 || off + size > sizeof(struct bpf_tcp_ca))
+		return false;
+	if (off % size != 0)
+		return false;
+
+	if (off >= offsetof(struct bpf_tcp_ca, priv))
+		return true;
+
+	if (size != sizeof(__u32))
+		return false;
+
+	if (type == BPF_WRITE) {
+		switch (off) {
+		case offsetof(struct bpf_tcp_ca, snd_cwnd):
+		case offsetof(struct bpf_tcp_ca, snd_ssthresh):
+		case offsetof(struct bpf_tcp_ca, snd_cwnd_cnt):
+		case offsetof(struct bpf_tcp_ca, ecn_flags):
+		case offsetof(struct bpf_tcp_ca, actions):
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static const struct bpf_verifier_ops bpf_tcp_ca_verifier_ops = {
+	.get_func_proto		= bpf_tcp_ca_get_func_proto,
+	.is_valid_access	= bpf_tcp_ca_is_valid_access,
+};
+
+static const u32 bpf_tcp_ca_prog_offs[] = {
+	[BPF_TCP_CA_OP_INIT] = offsetof(struct bpf_tcp_congestion_ops, init),
+	[BPF_TCP_CA_OP_RELEASE] = offsetof(struct bpf_tcp_congestion_ops, release),
+	[BPF_TCP_CA_OP_SSTHRESH] = offsetof(struct bpf_tcp_congestion_ops, ssthresh),
+	[BPF_TCP_CA_OP_CONG_AVOID] = offsetof(struct bpf_tcp_congestion_ops, cong_avoid),
+	[BPF_TCP_CA_OP_SET_STATE] = offsetof(struct bpf_tcp_congestion_ops, set_state),
+	[BPF_TCP_CA_OP_CWND_EVENT] = offsetof(struct bpf_tcp_congestion_ops, cwnd_event),
+	[BPF_TCP_CA_OP_IN_ACK_EVENT] = offsetof(struct bpf_tcp_congestion_ops, in_ack_event),
+	[BPF_TCP_CA_OP_UNDO_CWND] = offsetof(struct bpf_tcp_congestion_ops, undo_cwnd),
+	[BPF_TCP_CA_OP_PKTS_ACKED] = offsetof(struct bpf_tcp_congestion_ops, pkts_acked),
+};
+
+static int bpf_tcp_ca_init_kdata(void *kdata, const void *udata,
+				 struct bpf_prog **progs)
+{
+	const struct bpf_tcp_congestion_ops *uops = udata;
+	struct tcp_congestion_ops *ca = kdata;
+	size_t len;
+
+	BUILD_BUG_ON(sizeof(uops->name) != TCP_CA_NAME_MAX);
+	BUILD_BUG_ON(FIELD_SIZEOF(struct bpf_tcp_ca, priv) != ICSK_CA_PRIV_SIZE);
+	BUILD_BUG_ON(ARRAY_SIZE(bpf_tcp_ca_prog_offs) != __BPF_TCP_CA_OP_MAX);
+
+	if (uops->flags & ~BPF_TCP_CA_NEEDS_ECN)
+		return -EINVAL;
+
+	len = strnlen(uops->name, sizeof(uops->name));
+	if (!len || len == sizeof(uops->name))
+		return -EINVAL;
+	memcpy(ca->name, uops->name, len);
+
+	if (uops->flags & BPF_TCP_CA_NEEDS_ECN)
+		ca->flags |= TCP_CONG_NEEDS_ECN;
+	ca->owner = BPF_MODULE_OWNER;
+
+	/* tcp_register_congestion_control() checks for the required ones */
+	if (progs[BPF_TCP_CA_OP_INIT])
+		ca->init = bpf_tcp_ca_init;
+	if (progs[BPF_TCP_CA_OP_RELEASE])
+		ca->release = bpf_tcp_ca_release;
+	if (progs[BPF_TCP_CA_OP_SSTHRESH])
+		ca->ssthresh = bpf_tcp_ca_ssthresh;
+	if (progs[BPF_TCP_CA_OP_CONG_AVOID])
+		ca->cong_avoid = bpf_tcp_ca_cong_avoid;
+	if (progs[BPF_TCP_CA_OP_SET_STATE])
+		ca->set_state = bpf_tcp_ca_set_state;
+	if (progs[BPF_TCP_CA_OP_CWND_EVENT])
+		ca->cwnd_event = bpf_tcp_ca_cwnd_event;
+	if (progs[BPF_TCP_CA_OP_IN_ACK_EVENT])
+		ca->in_ack_event = bpf_tcp_ca_in_ack_event;
+	if (progs[BPF_TCP_CA_OP_UNDO_CWND])
+		ca->undo_cwnd = bpf_tcp_ca_undo_cwnd;
+	if (progs[BPF_TCP_CA_OP_PKTS_ACKED])
+		ca->pkts_acked = bpf_tcp_ca_pkts_acked;
+
+	return 0;
+}
+
+static int bpf_tcp_ca_reg(void *kdata)
+{
+	return tcp_register_congestion_control(kdata);
+}
+
+static void bpf_tcp_ca_unreg(void *kdata)
+{
+	tcp_unregister_congestion_control(kdata);
+}
+
+const struct bpf_struct_ops bpf_tcp_ca_struct_ops = {
+	.name		= "tcp_congestion_ops",
+	.verifier_ops	= &bpf_tcp_ca_verifier_ops,
+	.value_size	= sizeof(struct bpf_tcp_congestion_ops),
+	.kdata_size	= sizeof(struct tcp_congestion_ops),
+	.prog_offs	= bpf_tcp_ca_prog_offs,
+	.nr_progs	= ARRAY_SIZE(bpf_tcp_ca_prog_offs),
+	.init		= bpf_tcp_ca_init_kdata,
+	.reg		= bpf_tcp_ca_reg,
+	.unreg		= bpf_tcp_ca_unreg,
+};
@@ -146,7 +146,7 @@ static bool fib4_rule_suppress(struct fib_rule *rule, struct fib_lookup_arg *arg
 	struct net_device *dev = NULL;
 
 	if (result->fi)
-		dev = result->fi->fib_dev;
+		dev = fib_info_nh(result->fi, 0)->nh_dev;
 
 	/* do not accept result if the route does
 	 * not meet the required prefix length
@@ -787,6 +787,18 @@ EXPORT_SYMBOL_GPL(inet_csk_reqsk_queue_hash_add);
  *
  *	Caller must unlock socket even in error path (bh_unlock_sock(newsk))
  */
+static void inet_clone_ulp(const struct request_sock *req, struct sock *newsk,
+			   const gfp_t priority)
+{
+	struct inet_connection_sock *icsk = inet_csk(newsk);
+
+	if (!icsk->icsk_ulp_ops || !icsk->icsk_ulp_ops->clone)
+		return;
+
+	__module_get(icsk->icsk_ulp_ops->owner);
+	icsk->icsk_ulp_ops->clone(req, newsk, priority);
+}
+
 struct sock *inet_csk_clone_lock(const struct sock *sk,
 				 const struct request_sock *req,
 				 const gfp_t priority)
@@ -820,6 +832,8 @@ struct sock *inet_csk_clone_lock(const struct sock *sk,
 		memset(&newicsk->icsk_accept_queue, 0, sizeof(newicsk->icsk_accept_queue));
 
 		security_inet_csk_clone(newsk, req);
+
+		inet_clone_ulp(req, newsk, priority);
 	}
 	return newsk;
 }
@@ -292,6 +292,27 @@ static struct sock *inet_lhash2_lookup(struct net *net,
 	return result;
 }
 
+static struct sock *inet_lookup_run_bpf(struct net *net,
+					struct inet_hashinfo *hashinfo,
+					struct sk_buff *skb, int doff,
+					__be32 saddr, __be16 sport,
+					__be32 daddr, u16 hnum)
+{
+	struct sock *sk, *reuse_sk;
+	u32 phash;
+
+	if (hashinfo != &tcp_hashinfo)
+		return NULL; /* only TCP is supported */
+
+	sk = bpf_sk_lookup_run_v4(net, IPPROTO_TCP, saddr, sport, daddr, hnum);
+	if (IS_ERR_OR_NULL(sk) || !sk->sk_reuseport)
+		return sk;
+
+	phash = inet_ehashfn(net, daddr, hnum, saddr, sport);
+	reuse_sk = reuseport_select_sock(sk, phash, skb, doff);
+	return reuse_sk ? reuse_sk : sk;
+}
+
 struct sock *__inet_lookup_listener(struct net *net,
 				    struct inet_hashinfo *hashinfo,
 				    struct sk_buff *skb, int doff,
@@ -303,6 +324,14 @@ struct sock *__inet_lookup_listener(struct net *net,
 	struct sock *result = NULL;
 	unsigned int hash2;
 
+	/* Lookup redirect from BPF, for received packets only */
+	if (static_branch_unlikely(&bpf_sk_lookup_enabled) && skb) {
+		result = inet_lookup_run_bpf(net, hashinfo, skb, doff,
+					     saddr, sport, daddr, hnum);
+		if (result)
+			goto done;
+	}
+
 	hash2 = ipv4_portaddr_hash(net, daddr, hnum);
 	ilb2 = inet_lhash2_bucket(hashinfo, hash2);
 
@@ -349,6 +349,7 @@ struct sock *cookie_v4_check(struct sock *sk, struct sk_buff *skb)
 	req->ts_recent		= tcp_opt.saw_tstamp ? tcp_opt.rcv_tsval : 0;
 	treq->snt_synack	= 0;
 	treq->tfo_listener	= false;
+	treq->is_mptcp		= 0;
 	if (IS_ENABLED(CONFIG_SMC))
 		ireq->smc_ok = 0;
 
@@ -5622,6 +5622,9 @@ void tcp_rcv_established(struct sock *sk, struct sk_buff *skb)
 	if (!tcp_validate_incoming(sk, skb, th, 1))
 		return;
 
+	if (sk_is_mptcp(sk))
+		mptcp_incoming_options(sk, skb);
+
 step5:
 	if (tcp_ack(sk, skb, FLAG_SLOWPATH | FLAG_UPDATE_TS_RECENT) < 0)
 		goto discard;
@@ -5853,6 +5856,9 @@ static int tcp_rcv_synsent_state_process(struct sock *sk, struct sk_buff *skb,
 
 		smc_check_reset_syn(tp);
 
+		if (sk_is_mptcp(sk))
+			mptcp_rcv_synsent(sk, skb);
+
 		smp_mb();
 
 		tcp_finish_connect(sk, skb);
@@ -6052,6 +6058,9 @@ int tcp_rcv_state_process(struct sock *sk, struct sk_buff *skb)
 	if (!tcp_validate_incoming(sk, skb, th, 0))
 		return 0;
 
+	if (sk_is_mptcp(sk))
+		mptcp_incoming_options(sk, skb);
+
 	/* step 5: check the ACK field */
 	acceptable = tcp_ack(sk, skb, FLAG_SLOWPATH |
 				      FLAG_UPDATE_TS_RECENT |
@@ -6424,6 +6433,7 @@ int tcp_conn_request(struct request_sock_ops *rsk_ops,
 
 	tcp_rsk(req)->af_specific = af_ops;
 	tcp_rsk(req)->ts_off = 0;
+	tcp_rsk(req)->is_mptcp = 0;
 
 	tcp_clear_options(&tmp_opt);
 	tmp_opt.mss_clamp = af_ops->mss_clamp;
@@ -6482,6 +6492,8 @@ int tcp_conn_request(struct request_sock_ops *rsk_ops,
 	if (want_cookie) {
 		isn = cookie_init_sequence(af_ops, sk, skb, &req->mss);
 		req->cookie_ts = tmp_opt.tstamp_ok;
+		/* MPTCP state can't be encoded in the cookie */
+		tcp_rsk(req)->is_mptcp = 0;
 		if (!tmp_opt.tstamp_ok)
 			inet_rsk(req)->ecn_ok = 0;
 	}
@@ -24,6 +24,7 @@
 #include <net/secure_seq.h>
 #include <net/ip.h>
 #include <net/sock_reuseport.h>
+#include <net/tcp.h>
 
 u32 inet6_ehashfn(const struct net *net,
 		  const struct in6_addr *laddr, const u16 lport,
@@ -150,6 +151,29 @@ static struct sock *inet6_lhash2_lookup(struct net *net,
 	return result;
 }
 
+static struct sock *inet6_lookup_run_bpf(struct net *net,
+					 struct inet_hashinfo *hashinfo,
+					 struct sk_buff *skb, int doff,
+					 const struct in6_addr *saddr,
+					 const __be16 sport,
+					 const struct in6_addr *daddr,
+					 const u16 hnum)
+{
+	struct sock *sk, *reuse_sk;
+	u32 phash;
+
+	if (hashinfo != &tcp_hashinfo)
+		return NULL; /* only TCP is supported */
+
+	sk = bpf_sk_lookup_run_v6(net, IPPROTO_TCP, saddr, sport, daddr, hnum);
+	if (IS_ERR_OR_NULL(sk) || !sk->sk_reuseport)
+		return sk;
+
+	phash = inet6_ehashfn(net, daddr, hnum, saddr, sport);
+	reuse_sk = reuseport_select_sock(sk, phash, skb, doff);
+	return reuse_sk ? reuse_sk : sk;
+}
+
 struct sock *inet6_lookup_listener(struct net *net,
 		struct inet_hashinfo *hashinfo,
 		struct sk_buff *skb, int doff,
@@ -161,6 +185,14 @@ struct sock *inet6_lookup_listener(struct net *net,
 	struct sock *result = NULL;
 	unsigned int hash2;
 
+	/* Lookup redirect from BPF, for received packets only */
+	if (static_branch_unlikely(&bpf_sk_lookup_enabled) && skb) {
+		result = inet6_lookup_run_bpf(net, hashinfo, skb, doff,
+					      saddr, sport, daddr, hnum);
+		if (result)
+			goto done;
+	}
+
 	hash2 = ipv6_portaddr_hash(net, daddr, hnum);
 	ilb2 = inet_lhash2_bucket(hashinfo, hash2);
 
@@ -195,17 +195,24 @@ int ip6_xmit(const struct sock *sk, struct sk_buff *skb, struct flowi6 *fl6,
 	const struct ipv6_pinfo *np = inet6_sk(sk);
 	struct in6_addr *first_hop = &fl6->daddr;
 	struct dst_entry *dst = skb_dst(skb);
+	struct hop_jumbo_hdr *hop_jumbo;
 	unsigned int head_room;
 	struct ipv6hdr *hdr;
 	u8  proto = fl6->flowi6_proto;
 	int seg_len = skb->len;
 	int hlimit = -1;
+	int hoplen = 0;
 	u32 mtu;
 
 	head_room = sizeof(struct ipv6hdr) + LL_RESERVED_SPACE(dst->dev);
 	if (opt)
 		head_room += opt->opt_nflen + opt->opt_flen;
 
+	if (unlikely(seg_len > IPV6_MAXPLEN)) {
+		hoplen = sizeof(*hop_jumbo);
+		head_room += hoplen;
+	}
+
 	if (unlikely(skb_headroom(skb) < head_room)) {
 		struct sk_buff *skb2 = skb_realloc_headroom(skb, head_room);
 		if (!skb2) {
@@ -231,6 +238,24 @@ int ip6_xmit(const struct sock *sk, struct sk_buff *skb, struct flowi6 *fl6,
 					     &fl6->saddr);
 	}
 
+	/* BIG TCP: a GSO packet beyond 64KB carries its length in a
+	 * jumbo payload option.  It can not be merged with a hop-by-hop
+	 * header of the socket, such packets take the error path below.
+	 */
+	if (unlikely(seg_len > IPV6_MAXPLEN) && hoplen && skb_is_gso(skb) &&
+	    proto != NEXTHDR_HOP) {
+		hop_jumbo = skb_push(skb, hoplen);
+
+		hop_jumbo->nexthdr = proto;
+		hop_jumbo->hdrlen = 0;
+		hop_jumbo->tlv_type = IPV6_TLV_JUMBO;
+		hop_jumbo->tlv_len = 4;
+		hop_jumbo->jumbo_payload_len = htonl(seg_len + hoplen);
+
+		proto = IPPROTO_HOPOPTS;
+		seg_len = 0;
+	}
+
 	skb_push(skb, sizeof(struct ipv6hdr));
 	skb_reset_network_header(skb);
 	hdr = ipv6_hdr(skb);
@@ -258,6 +283,9 @@ int ip6_xmit(const struct sock *sk, struct sk_buff *skb, struct flowi6 *fl6,
 	skb->mark = mark;
 
 	mtu = dst_mtu(dst);
+	if (unlikely(seg_len > IPV6_MAXPLEN))
+		goto too_big;
+
 	if ((skb->len <= mtu) || skb->ignore_df || skb_is_gso(skb)) {
 		IP6_UPD_PO_STATS(net, ip6_dst_idev(skb_dst(skb)),
 			      IPSTATS_MIB_OUT, skb->len);
@@ -277,6 +305,7 @@ int ip6_xmit(const struct sock *sk, struct sk_buff *skb, struct flowi6 *fl6,
 			       dst_output);
 	}
 
+too_big:
 	skb->dev = dst->dev;
 	/* ipv6_local_error() does not require socket lock,
 	 * we promote our socket to non const
@@ -1274,6 +1303,7 @@ static int __ip6_append_data(struct sock *sk,
 	unsigned int maxnonfragsize, headersize;
 	unsigned int wmem_alloc_delta = 0;
 	bool paged, extra_uref;
+	bool zc = false;
 
 	skb = skb_peek_tail(queue);
 	if (!skb) {
@@ -1346,6 +1376,7 @@ static int __ip6_append_data(struct sock *sk,
 		if (rt->dst.dev->features & NETIF_F_SG &&
 		    csummode == CHECKSUM_PARTIAL) {
 			paged = true;
+			zc = true;
 		} else {
 			uarg->zerocopy = 0;
 			skb_zcopy_set(skb, uarg, &extra_uref);
@@ -1415,9 +1446,15 @@ static int __ip6_append_data(struct sock *sk,
 				alloclen = mtu;
 			else if (!paged)
 				alloclen = fraglen;
-			else {
+			else if (!zc) {
 				alloclen = min_t(int, fraglen, MAX_HEADER);
 				pagedlen = fraglen - alloclen;
+			} else {
+				/* only headers go in the linear area, all
+				 * payload is taken from the user pages
+				 */
+				alloclen = fragheaderlen + transhdrlen;
+				pagedlen = datalen - transhdrlen;
 			}
 
 			alloclen += dst_exthdrlen;
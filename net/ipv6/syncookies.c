@@ -182,6 +182,7 @@ struct sock *cookie_v6_check(struct sock *sk, struct sk_buff *skb)
 	ireq = inet_rsk(req);
 	treq = tcp_rsk(req);
 	treq->tfo_listener = false;
+	treq->is_mptcp = 0;
 
 	if (security_inet_conn_request(sk, skb, req))
 		goto out_free;
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Multipath TCP cryptographic functions
+ *
+ * Keys, tokens and initial data sequence numbers are derived with
+ * SHA-256 as described in RFC 8684:
+ *
+ * The token is the most significant 32 bits of SHA-256(key), the
+ * initial data sequence number (IDSN) is the least significant 64 bits.
+ * Both are computed from the key in network byte order.
+ *
+ * MP_JOIN authentication uses HMAC-SHA256 keyed with the concatenation
+ * of the two connection keys over the concatenation of the two nonces.
+ */
+
+#include <linux/kernel.h>
+#include <linux/mutex.h>
+#include <crypto/hash.h>
+#include <crypto/sha.h>
+#include <asm/unaligned.h>
+
+#include "protocol.h"
+
+static DEFINE_MUTEX(mptcp_crypto_mutex);
+static struct crypto_shash *mptcp_sha256 __read_mostly;
+
+/* The transform is allocated the first time an MPTCP socket is created:
+ * at inet_init() time the sha256 implementation may not be registered
+ * yet. Process context is required, all later users may run in BH.
+ */
+int mptcp_crypto_init(void)
+{
+	struct crypto_shash *tfm;
+	int err = 0;
+
+	if (likely(READ_ONCE(mptcp_sha256)))
+		return 0;
+
+	mutex_lock(&mptcp_crypto_mutex);
+	if (!mptcp_sha256) {
+		tfm = crypto_alloc_shash("sha256", 0, 0);
+		if (IS_ERR(tfm)) {
+			err = PTR_ERR(tfm);
+		} else {
+			/* pairs with READ_ONCE() in mptcp_crypto_tfm() */
+			smp_wmb();
+			WRITE_ONCE(mptcp_sha256, tfm);
+		}
+	}
+	mutex_unlock(&mptcp_crypto_mutex);
+
+	return err;
+}
+
+static struct crypto_shash *mptcp_crypto_tfm(void)
+{
+	return READ_ONCE(mptcp_sha256);
+}
+
+void mptcp_crypto_key_sha(u64 key, u32 *token, u64 *idsn)
+{
+	struct crypto_shash *tfm = mptcp_crypto_tfm();
+	u8 digest[SHA256_DIGEST_SIZE];
+	__be64 input = cpu_to_be64(key);
+	SHASH_DESC_ON_STACK(desc, tfm);
+
+	desc->tfm = tfm;
+	desc->flags = 0;
+	crypto_shash_digest(desc, (u8 *)&input, sizeof(input), digest);
+	shash_desc_zero(desc);
+
+	if (token)
+		*token = get_unaligned_be32(digest);
+	if (idsn)
+		*idsn = get_unaligned_be64(digest + SHA256_DIGEST_SIZE - 8);
+}
+
+/* HMAC-SHA256(key1 || key2, nonce1 || nonce2), the full digest is
+ * stored in @hmac, which must hold SHA256_DIGEST_SIZE bytes. The key is
+ * shorter than the block size and is used zero padded.
+ */
+int mptcp_crypto_hmac_sha(u64 key1, u64 key2, u32 nonce1, u32 nonce2,
+			  u8 *hmac)
+{
+	struct crypto_shash *tfm = mptcp_crypto_tfm();
+	u8 input[SHA256_BLOCK_SIZE + SHA256_DIGEST_SIZE];
+	u8 key_input[2 * sizeof(u64)];
+	u8 msg[2 * sizeof(u32)];
+	SHASH_DESC_ON_STACK(desc, tfm);
+	int err;
+	int i;
+
+	if (!tfm)
+		return -ENOENT;
+
+	put_unaligned_be64(key1, key_input);
+	put_unaligned_be64(key2, key_input + 8);
+	put_unaligned_be32(nonce1, msg);
+	put_unaligned_be32(nonce2, msg + 4);
+
+	desc->tfm = tfm;
+	desc->flags = 0;
+
+	/* inner hash: (key ^ ipad) || msg */
+	memset(input, 0x36, SHA256_BLOCK_SIZE);
+	for (i = 0; i < sizeof(key_input); i++)
+		input[i] ^= key_input[i];
+
+	err = crypto_shash_init(desc);
+	if (!err)
+		err = crypto_shash_update(desc, input, SHA256_BLOCK_SIZE);
+	if (!err)
+		err = crypto_shash_finup(desc, msg, sizeof(msg),
+					 &input[SHA256_BLOCK_SIZE]);
+	if (err)
+		goto out;
+
+	/* outer hash: (key ^ opad) || inner hash */
+	memset(input, 0x5C, SHA256_BLOCK_SIZE);
+	for (i = 0; i < sizeof(key_input); i++)
+		input[i] ^= key_input[i];
+
+	err = crypto_shash_digest(desc, input, sizeof(input), hmac);
+out:
+	shash_desc_zero(desc);
+	memzero_explicit(input, sizeof(input));
+	return err;
+}
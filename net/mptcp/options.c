@@ -0,0 +1,474 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Multipath TCP
+ *
+ * Building and parsing of the MPTCP TCP option (RFC 8684).
+ */
+
+#include <linux/kernel.h>
+#include <asm/unaligned.h>
+#include <net/tcp.h>
+#include <net/mptcp.h>
+#include "protocol.h"
+
+static void mptcp_parse_option(const unsigned char *ptr, int opsize,
+			       struct mptcp_options_received *mp_opt)
+{
+	u8 subtype = *ptr >> 4;
+	int expected_opsize;
+	u8 version;
+	u8 flags;
+
+	switch (subtype) {
+	case MPTCPOPT_MP_CAPABLE:
+		if (opsize != TCPOLEN_MPTCP_MPC_SYN &&
+		    opsize != TCPOLEN_MPTCP_MPC_SYNACK &&
+		    opsize != TCPOLEN_MPTCP_MPC_ACK &&
+		    opsize != TCPOLEN_MPTCP_MPC_ACK_DATA &&
+		    opsize != TCPOLEN_MPTCP_MPC_ACK_DATA +
+			      TCPOLEN_MPTCP_DSS_CHECKSUM)
+			break;
+
+		version = *ptr++ & MPTCP_VERSION_MASK;
+		if (version != MPTCP_SUPPORTED_VERSION)
+			break;
+
+		/* DSS checksums are not supported: ignoring the option makes
+		 * the connection fall back to plain TCP.
+		 */
+		flags = *ptr++;
+		if (!(flags & MPTCP_CAP_HMAC_SHA256) ||
+		    (flags & MPTCP_CAP_CHECKSUM_REQD))
+			break;
+
+		if (opsize == TCPOLEN_MPTCP_MPC_SYN) {
+			mp_opt->suboptions |= OPTION_MPTCP_MPC_SYN;
+		} else if (opsize == TCPOLEN_MPTCP_MPC_SYNACK) {
+			mp_opt->sndr_key = get_unaligned_be64(ptr);
+			mp_opt->suboptions |= OPTION_MPTCP_MPC_SYNACK;
+		} else {
+			mp_opt->sndr_key = get_unaligned_be64(ptr);
+			mp_opt->rcvr_key = get_unaligned_be64(ptr + 8);
+			mp_opt->suboptions |= OPTION_MPTCP_MPC_ACK;
+		}
+		break;
+
+	case MPTCPOPT_MP_JOIN:
+		if (opsize == TCPOLEN_MPTCP_MPJ_SYN) {
+			mp_opt->backup = *ptr++ & MPTCPOPT_BACKUP;
+			mp_opt->join_id = *ptr++;
+			mp_opt->token = get_unaligned_be32(ptr);
+			mp_opt->nonce = get_unaligned_be32(ptr + 4);
+			mp_opt->suboptions |= OPTION_MPTCP_MPJ_SYN;
+		} else if (opsize == TCPOLEN_MPTCP_MPJ_SYNACK) {
+			mp_opt->backup = *ptr++ & MPTCPOPT_BACKUP;
+			mp_opt->join_id = *ptr++;
+			mp_opt->thmac = get_unaligned_be64(ptr);
+			mp_opt->nonce = get_unaligned_be32(ptr + 8);
+			mp_opt->suboptions |= OPTION_MPTCP_MPJ_SYNACK;
+		} else if (opsize == TCPOLEN_MPTCP_MPJ_ACK) {
+			ptr += 2;
+			memcpy(mp_opt->hmac, ptr, MPTCPOPT_HMAC_LEN);
+			mp_opt->suboptions |= OPTION_MPTCP_MPJ_ACK;
+		}
+		break;
+
+	case MPTCPOPT_DSS:
+		ptr++;
+		flags = (*ptr++) & MPTCP_DSS_FLAG_MASK;
+		mp_opt->data_fin = (flags & MPTCP_DSS_DATA_FIN) != 0;
+		mp_opt->dsn64 = (flags & MPTCP_DSS_DSN64) != 0;
+		mp_opt->use_map = (flags & MPTCP_DSS_HAS_MAP) != 0;
+		mp_opt->ack64 = (flags & MPTCP_DSS_ACK64) != 0;
+		mp_opt->use_ack = (flags & MPTCP_DSS_HAS_ACK) != 0;
+
+		expected_opsize = TCPOLEN_MPTCP_DSS_BASE;
+		if (mp_opt->use_ack)
+			expected_opsize += mp_opt->ack64 ?
+					   TCPOLEN_MPTCP_DSS_ACK64 :
+					   TCPOLEN_MPTCP_DSS_ACK32;
+		if (mp_opt->use_map)
+			expected_opsize += mp_opt->dsn64 ?
+					   TCPOLEN_MPTCP_DSS_MAP64 :
+					   TCPOLEN_MPTCP_DSS_MAP32;
+
+		/* a trailing checksum is tolerated and ignored */
+		if (opsize != expected_opsize &&
+		    opsize != expected_opsize + TCPOLEN_MPTCP_DSS_CHECKSUM)
+			break;
+
+		if (mp_opt->use_ack) {
+			if (mp_opt->ack64) {
+				mp_opt->data_ack = get_unaligned_be64(ptr);
+				ptr += 8;
+			} else {
+				mp_opt->data_ack = get_unaligned_be32(ptr);
+				ptr += 4;
+			}
+		}
+
+		if (mp_opt->use_map) {
+			if (mp_opt->dsn64) {
+				mp_opt->data_seq = get_unaligned_be64(ptr);
+				ptr += 8;
+			} else {
+				mp_opt->data_seq = get_unaligned_be32(ptr);
+				ptr += 4;
+			}
+			mp_opt->subflow_seq = get_unaligned_be32(ptr);
+			mp_opt->data_len = get_unaligned_be16(ptr + 4);
+		}
+
+		mp_opt->suboptions |= OPTION_MPTCP_DSS;
+		break;
+
+	default:
+		break;
+	}
+}
+
+void mptcp_get_options(const struct sk_buff *skb,
+		       struct mptcp_options_received *mp_opt)
+{
+	const struct tcphdr *th = tcp_hdr(skb);
+	const unsigned char *ptr;
+	int length;
+
+	memset(mp_opt, 0, sizeof(*mp_opt));
+
+	length = (th->doff * 4) - sizeof(struct tcphdr);
+	ptr = (const unsigned char *)(th + 1);
+
+	while (length > 0) {
+		int opcode = *ptr++;
+		int opsize;
+
+		switch (opcode) {
+		case TCPOPT_EOL:
+			return;
+		case TCPOPT_NOP:	/* Ref: RFC 793 section 3.1 */
+			length--;
+			continue;
+		default:
+			if (length < 2)
+				return;
+			opsize = *ptr++;
+			if (opsize < 2) /* "silly options" */
+				return;
+			if (opsize > length)
+				return;	/* don't parse partial options */
+			if (opcode == TCPOPT_MPTCP && opsize > 2)
+				mptcp_parse_option(ptr, opsize, mp_opt);
+			ptr += opsize - 2;
+			length -= opsize;
+		}
+	}
+}
+
+bool mptcp_syn_options(struct sock *sk, const struct sk_buff *skb,
+		       unsigned int *size, struct mptcp_out_options *opts)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(sk);
+
+	/* subflow sequence numbers in DSS options are relative to the ISN */
+	subflow->snd_isn = TCP_SKB_CB(skb)->seq;
+
+	if (subflow->request_mptcp) {
+		opts->suboptions = OPTION_MPTCP_MPC_SYN;
+		*size = TCPOLEN_MPTCP_MPC_SYN;
+		return true;
+	} else if (subflow->request_join) {
+		opts->suboptions = OPTION_MPTCP_MPJ_SYN;
+		opts->join_id = subflow->local_id;
+		opts->token = subflow->remote_token;
+		opts->nonce = subflow->local_nonce;
+		opts->backup = subflow->request_bkup;
+		*size = TCPOLEN_MPTCP_MPJ_SYN;
+		return true;
+	}
+	return false;
+}
+
+bool mptcp_synack_options(const struct request_sock *req, unsigned int *size,
+			  struct mptcp_out_options *opts)
+{
+	struct mptcp_subflow_request_sock *subflow_req = mptcp_subflow_rsk(req);
+
+	if (subflow_req->mp_capable) {
+		opts->suboptions = OPTION_MPTCP_MPC_SYNACK;
+		opts->sndr_key = subflow_req->local_key;
+		*size = TCPOLEN_MPTCP_MPC_SYNACK;
+		return true;
+	} else if (subflow_req->mp_join) {
+		opts->suboptions = OPTION_MPTCP_MPJ_SYNACK;
+		opts->backup = subflow_req->backup;
+		opts->join_id = subflow_req->local_id;
+		opts->thmac = subflow_req->thmac;
+		opts->nonce = subflow_req->local_nonce;
+		*size = TCPOLEN_MPTCP_MPJ_SYNACK;
+		return true;
+	}
+	return false;
+}
+
+/* The active side repeats the MP_CAPABLE or MP_JOIN third ACK on every
+ * pure ACK until the peer shows, with a DSS option, that it got it.
+ * Data is not sent before that, so a lost third ACK is recovered.
+ */
+static bool mptcp_established_options_mp(struct sock *sk, struct sk_buff *skb,
+					 unsigned int *size,
+					 unsigned int remaining,
+					 struct mptcp_out_options *opts)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(sk);
+
+	if (subflow->fully_established || !skb || skb->len)
+		return false;
+
+	if (subflow->mp_capable) {
+		if (remaining < TCPOLEN_MPTCP_MPC_ACK)
+			return false;
+		opts->suboptions = OPTION_MPTCP_MPC_ACK;
+		opts->sndr_key = subflow->local_key;
+		opts->rcvr_key = subflow->remote_key;
+		*size = TCPOLEN_MPTCP_MPC_ACK;
+		return true;
+	} else if (subflow->mp_join) {
+		if (remaining < TCPOLEN_MPTCP_MPJ_ACK)
+			return false;
+		opts->suboptions = OPTION_MPTCP_MPJ_ACK;
+		memcpy(opts->hmac, subflow->hmac, MPTCPOPT_HMAC_LEN);
+		*size = TCPOLEN_MPTCP_MPJ_ACK;
+		return true;
+	}
+	return false;
+}
+
+static bool mptcp_established_options_dss(struct sock *sk, struct sk_buff *skb,
+					  unsigned int *size,
+					  unsigned int remaining,
+					  struct mptcp_out_options *opts)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(sk);
+	struct mptcp_sock *msk = mptcp_sk(subflow->conn);
+	unsigned int dss_size;
+
+	/* Called by tcp_current_mss(): reserve room for a full mapping */
+	if (!skb) {
+		if (remaining < TCPOLEN_MPTCP_DSS_MAX)
+			return false;
+		opts->suboptions = OPTION_MPTCP_DSS;
+		*size = TCPOLEN_MPTCP_DSS_MAX;
+		return true;
+	}
+
+	dss_size = TCPOLEN_MPTCP_DSS_BASE + TCPOLEN_MPTCP_DSS_ACK64;
+	if (remaining < dss_size)
+		return false;
+
+	opts->suboptions = OPTION_MPTCP_DSS;
+	opts->use_ack = 1;
+	opts->data_ack = atomic64_read(&msk->ack_seq);
+	opts->use_map = 0;
+	opts->data_fin = 0;
+
+	if (remaining < ALIGN(dss_size + TCPOLEN_MPTCP_DSS_MAP64, 4))
+		goto out;
+
+	if (skb->len) {
+		u32 seq = TCP_SKB_CB(skb)->seq;
+
+		if (mptcp_subflow_map_tx(sk, seq, skb->len, &opts->data_seq,
+					 &opts->data_len)) {
+			opts->subflow_seq = seq - subflow->snd_isn;
+			opts->use_map = 1;
+		}
+	} else if (test_bit(MPTCP_SEND_DATA_FIN, &msk->flags)) {
+		/* A DATA_FIN without data carries a zero subflow sequence
+		 * and a data-level length of one.
+		 */
+		opts->data_seq = READ_ONCE(msk->data_fin_seq);
+		opts->subflow_seq = 0;
+		opts->data_len = 1;
+		opts->data_fin = 1;
+		opts->use_map = 1;
+	}
+
+	if (opts->use_map)
+		dss_size += TCPOLEN_MPTCP_DSS_MAP64;
+out:
+	*size = ALIGN(dss_size, 4);
+	return true;
+}
+
+bool mptcp_established_options(struct sock *sk, struct sk_buff *skb,
+			       unsigned int *size, unsigned int remaining,
+			       struct mptcp_out_options *opts)
+{
+	if (!mptcp_subflow_ctx(sk)->conn)
+		return false;
+
+	opts->suboptions = 0;
+
+	if (mptcp_established_options_mp(sk, skb, size, remaining, opts))
+		return true;
+
+	return mptcp_established_options_dss(sk, skb, size, remaining, opts);
+}
+
+void mptcp_incoming_options(struct sock *sk, struct sk_buff *skb)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(sk);
+	struct mptcp_options_received mp_opt;
+	struct mptcp_sock *msk;
+	u64 data_seq;
+	u32 len;
+
+	if (!subflow->conn)
+		return;
+
+	msk = mptcp_sk(subflow->conn);
+	mptcp_get_options(skb, &mp_opt);
+
+	if (!subflow->fully_established) {
+		if (mp_opt.suboptions & OPTION_MPTCP_DSS) {
+			mptcp_subflow_fully_established(sk);
+		} else if (!mp_opt.suboptions && subflow->mp_capable) {
+			/* The peer, or a middlebox, dropped the MPTCP option
+			 * after the handshake: continue as plain TCP.
+			 */
+			tcp_sk(sk)->is_mptcp = 0;
+			set_bit(MPTCP_FALLBACK, &msk->flags);
+			mptcp_subflow_write_space(sk);
+			return;
+		}
+	}
+
+	if (!(mp_opt.suboptions & OPTION_MPTCP_DSS))
+		return;
+
+	if (mp_opt.use_ack) {
+		u64 old = atomic64_read(&msk->snd_una);
+		u64 ack = mp_opt.data_ack;
+
+		if (!mp_opt.ack64)
+			ack = mptcp_expand_seq(old, ack);
+
+		while (after64(ack, old)) {
+			u64 cur = atomic64_cmpxchg(&msk->snd_una, old, ack);
+
+			if (cur == old)
+				break;
+			old = cur;
+		}
+	}
+
+	/* a zero data-level length is the infinite mapping, unsupported */
+	if (!mp_opt.use_map || !mp_opt.data_len)
+		return;
+
+	data_seq = mp_opt.data_seq;
+	if (!mp_opt.dsn64)
+		data_seq = mptcp_expand_seq(atomic64_read(&msk->ack_seq),
+					    data_seq);
+
+	if (mp_opt.data_fin)
+		mptcp_data_fin(subflow->conn, data_seq + mp_opt.data_len - 1);
+
+	len = mp_opt.data_len - mp_opt.data_fin;
+	if (mp_opt.subflow_seq && len)
+		mptcp_subflow_map_rx(sk, data_seq,
+				     subflow->rcv_isn + mp_opt.subflow_seq, len);
+}
+
+static __be32 mptcp_option(u8 subopt, u8 len, u8 nib, u8 field)
+{
+	return htonl((TCPOPT_MPTCP << 24) | (len << 16) | (subopt << 12) |
+		     ((nib & 0xF) << 8) | field);
+}
+
+void mptcp_write_options(__be32 *ptr, struct mptcp_out_options *opts)
+{
+	if ((OPTION_MPTCP_MPC_SYN | OPTION_MPTCP_MPC_SYNACK |
+	     OPTION_MPTCP_MPC_ACK) & opts->suboptions) {
+		u8 len;
+
+		if (OPTION_MPTCP_MPC_SYN & opts->suboptions)
+			len = TCPOLEN_MPTCP_MPC_SYN;
+		else if (OPTION_MPTCP_MPC_SYNACK & opts->suboptions)
+			len = TCPOLEN_MPTCP_MPC_SYNACK;
+		else
+			len = TCPOLEN_MPTCP_MPC_ACK;
+
+		*ptr++ = mptcp_option(MPTCPOPT_MP_CAPABLE, len,
+				      MPTCP_SUPPORTED_VERSION,
+				      MPTCP_CAP_HMAC_SHA256);
+
+		if ((OPTION_MPTCP_MPC_SYNACK | OPTION_MPTCP_MPC_ACK) &
+		    opts->suboptions) {
+			put_unaligned_be64(opts->sndr_key, ptr);
+			ptr += 2;
+		}
+		if (OPTION_MPTCP_MPC_ACK & opts->suboptions) {
+			put_unaligned_be64(opts->rcvr_key, ptr);
+			ptr += 2;
+		}
+	}
+
+	if (OPTION_MPTCP_MPJ_SYN & opts->suboptions) {
+		*ptr++ = mptcp_option(MPTCPOPT_MP_JOIN, TCPOLEN_MPTCP_MPJ_SYN,
+				      opts->backup, opts->join_id);
+		put_unaligned_be32(opts->token, ptr);
+		ptr += 1;
+		put_unaligned_be32(opts->nonce, ptr);
+		ptr += 1;
+	}
+
+	if (OPTION_MPTCP_MPJ_SYNACK & opts->suboptions) {
+		*ptr++ = mptcp_option(MPTCPOPT_MP_JOIN,
+				      TCPOLEN_MPTCP_MPJ_SYNACK,
+				      opts->backup, opts->join_id);
+		put_unaligned_be64(opts->thmac, ptr);
+		ptr += 2;
+		put_unaligned_be32(opts->nonce, ptr);
+		ptr += 1;
+	}
+
+	if (OPTION_MPTCP_MPJ_ACK & opts->suboptions) {
+		*ptr++ = mptcp_option(MPTCPOPT_MP_JOIN, TCPOLEN_MPTCP_MPJ_ACK,
+				      0, 0);
+		memcpy(ptr, opts->hmac, MPTCPOPT_HMAC_LEN);
+		ptr += 5;
+	}
+
+	if (OPTION_MPTCP_DSS & opts->suboptions) {
+		unsigned int len = TCPOLEN_MPTCP_DSS_BASE;
+		u8 flags = 0;
+
+		if (opts->use_ack) {
+			flags |= MPTCP_DSS_HAS_ACK | MPTCP_DSS_ACK64;
+			len += TCPOLEN_MPTCP_DSS_ACK64;
+		}
+		if (opts->use_map) {
+			flags |= MPTCP_DSS_HAS_MAP | MPTCP_DSS_DSN64;
+			len += TCPOLEN_MPTCP_DSS_MAP64;
+			if (opts->data_fin)
+				flags |= MPTCP_DSS_DATA_FIN;
+		}
+
+		*ptr++ = mptcp_option(MPTCPOPT_DSS, len, 0, flags);
+
+		if (opts->use_ack) {
+			put_unaligned_be64(opts->data_ack, ptr);
+			ptr += 2;
+		}
+		if (opts->use_map) {
+			put_unaligned_be64(opts->data_seq, ptr);
+			ptr += 2;
+			put_unaligned_be32(opts->subflow_seq, ptr);
+			ptr += 1;
+			/* no checksum, pad the option to a 32-bit boundary */
+			*ptr++ = htonl(opts->data_len << 16 |
+				       TCPOPT_NOP << 8 | TCPOPT_NOP);
+		}
+	}
+}
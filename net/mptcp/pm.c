@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Multipath TCP path manager
+ *
+ * A minimal in-kernel full mesh path manager: once the initial subflow of
+ * an active connection is fully established, an additional subflow is
+ * opened from every other usable local address of the same family to
+ * the address of the peer, up to net.mptcp.max_subflows. Addresses of
+ * the peer are not announced nor learned, and the passive side never
+ * opens subflows on its own.
+ */
+
+#include <linux/kernel.h>
+#include <linux/inetdevice.h>
+#include <linux/netdevice.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <net/addrconf.h>
+#include <net/sock.h>
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+#include <net/ipv6.h>
+#endif
+
+#include "protocol.h"
+
+struct mptcp_pm_addr {
+	struct sockaddr_storage addr;
+	int ifindex;
+};
+
+void mptcp_pm_fully_established(struct mptcp_sock *msk)
+{
+	mptcp_schedule_work((struct sock *)msk, MPTCP_WORK_PM);
+}
+
+bool mptcp_pm_allow_new_subflow(struct mptcp_sock *msk)
+{
+	struct sock *sk = (struct sock *)msk;
+
+	return inet_sk_state_load(sk) == TCP_ESTABLISHED && sk->sk_socket &&
+	       !test_bit(MPTCP_FALLBACK, &msk->flags) &&
+	       READ_ONCE(msk->subflows) < mptcp_max_subflows(sock_net(sk));
+}
+
+static int pm_fill_addrs_v4(struct mptcp_sock *msk, struct mptcp_pm_addr *addrs,
+			    int max, bool mapped)
+{
+	struct sock *sk = (struct sock *)msk;
+	__be32 saddr = inet_sk(sk)->inet_saddr;
+	struct net_device *dev;
+	int n = 0;
+
+	rcu_read_lock();
+	for_each_netdev_rcu(sock_net(sk), dev) {
+		struct in_device *in_dev;
+
+		if (!(dev->flags & IFF_UP) || (dev->flags & IFF_LOOPBACK))
+			continue;
+
+		in_dev = __in_dev_get_rcu(dev);
+		if (!in_dev)
+			continue;
+
+		for_ifa(in_dev) {
+			if (n == max)
+				goto out;
+			if (ifa->ifa_local == saddr)
+				continue;
+
+			memset(&addrs[n], 0, sizeof(addrs[n]));
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+			if (mapped) {
+				struct sockaddr_in6 *sin6;
+
+				sin6 = (struct sockaddr_in6 *)&addrs[n].addr;
+				sin6->sin6_family = AF_INET6;
+				ipv6_addr_set_v4mapped(ifa->ifa_local,
+						       &sin6->sin6_addr);
+			} else
+#endif
+			{
+				struct sockaddr_in *sin;
+
+				sin = (struct sockaddr_in *)&addrs[n].addr;
+				sin->sin_family = AF_INET;
+				sin->sin_addr.s_addr = ifa->ifa_local;
+			}
+			addrs[n++].ifindex = dev->ifindex;
+		} endfor_ifa(in_dev);
+	}
+out:
+	rcu_read_unlock();
+	return n;
+}
+
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+static int pm_fill_addrs_v6(struct mptcp_sock *msk, struct mptcp_pm_addr *addrs,
+			    int max)
+{
+	struct sock *sk = (struct sock *)msk;
+	struct net_device *dev;
+	int n = 0;
+
+	rcu_read_lock();
+	for_each_netdev_rcu(sock_net(sk), dev) {
+		struct inet6_ifaddr *ifp;
+		struct inet6_dev *idev;
+
+		if (!(dev->flags & IFF_UP) || (dev->flags & IFF_LOOPBACK))
+			continue;
+
+		idev = __in6_dev_get(dev);
+		if (!idev)
+			continue;
+
+		read_lock_bh(&idev->lock);
+		list_for_each_entry(ifp, &idev->addr_list, if_list) {
+			struct sockaddr_in6 *sin6;
+
+			if (n == max)
+				break;
+			if (ifp->flags & (IFA_F_TENTATIVE | IFA_F_DADFAILED))
+				continue;
+			if (ipv6_addr_type(&ifp->addr) & IPV6_ADDR_LINKLOCAL)
+				continue;
+			if (ipv6_addr_equal(&ifp->addr, &inet6_sk(sk)->saddr))
+				continue;
+
+			memset(&addrs[n], 0, sizeof(addrs[n]));
+			sin6 = (struct sockaddr_in6 *)&addrs[n].addr;
+			sin6->sin6_family = AF_INET6;
+			sin6->sin6_addr = ifp->addr;
+			addrs[n++].ifindex = dev->ifindex;
+		}
+		read_unlock_bh(&idev->lock);
+
+		if (n == max)
+			break;
+	}
+	rcu_read_unlock();
+	return n;
+}
+#endif
+
+/* Called by the MPTCP worker with the msk socket lock held. */
+void mptcp_pm_create_subflows(struct mptcp_sock *msk)
+{
+	struct sock *sk = (struct sock *)msk;
+	struct mptcp_pm_addr *addrs;
+	int max, n, i;
+
+	max = mptcp_max_subflows(sock_net(sk)) - READ_ONCE(msk->subflows);
+	if (max <= 0 || !mptcp_pm_allow_new_subflow(msk))
+		return;
+
+	addrs = kmalloc_array(max, sizeof(*addrs), GFP_KERNEL);
+	if (!addrs)
+		return;
+
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+	if (sk->sk_family == AF_INET6) {
+		if (ipv6_addr_v4mapped(&sk->sk_v6_daddr))
+			n = pm_fill_addrs_v4(msk, addrs, max, true);
+		else
+			n = pm_fill_addrs_v6(msk, addrs, max);
+	} else
+#endif
+		n = pm_fill_addrs_v4(msk, addrs, max, false);
+
+	for (i = 0; i < n && mptcp_pm_allow_new_subflow(msk); i++)
+		mptcp_subflow_connect(sk, (struct sockaddr *)&addrs[i].addr,
+				      addrs[i].ifindex, ++msk->local_id);
+
+	kfree(addrs);
+}
@@ -0,0 +1,1446 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Multipath TCP
+ *
+ * The MPTCP socket: a stream socket spreading its data over one or more
+ * TCP subflows. Data is scheduled on the established subflow with the
+ * lowest RTT that has room in its send buffer, and put back in order on
+ * reception using the data sequence numbers carried by the DSS option.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/netdevice.h>
+#include <linux/sched/signal.h>
+#include <linux/sizes.h>
+#include <linux/atomic.h>
+#include <net/sock.h>
+#include <net/inet_common.h>
+#include <net/inet_hashtables.h>
+#include <net/protocol.h>
+#include <net/tcp.h>
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+#include <net/ipv6.h>
+#include <net/transp_v6.h>
+#endif
+#include <net/mptcp.h>
+#include "protocol.h"
+
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+struct mptcp6_sock {
+	struct mptcp_sock msk;
+	struct ipv6_pinfo np;
+};
+#endif
+
+struct mptcp_read_arg {
+	struct mptcp_sock *msk;
+	struct sock *ssk;
+};
+
+static struct proto_ops mptcp_stream_ops __ro_after_init;
+
+void mptcp_schedule_work(struct sock *sk, int bit)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+
+	set_bit(bit, &msk->flags);
+	if (schedule_work(&msk->work))
+		sock_hold(sk);
+}
+
+void mptcp_copy_inaddrs(struct sock *msk, const struct sock *ssk)
+{
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+	const struct ipv6_pinfo *ssk6 = inet6_sk(ssk);
+	struct ipv6_pinfo *msk6 = inet6_sk(msk);
+
+	msk->sk_v6_daddr = ssk->sk_v6_daddr;
+	msk->sk_v6_rcv_saddr = ssk->sk_v6_rcv_saddr;
+
+	if (msk6 && ssk6) {
+		msk6->saddr = ssk6->saddr;
+		msk6->flow_label = ssk6->flow_label;
+	}
+#endif
+
+	inet_sk(msk)->inet_dport = inet_sk(ssk)->inet_dport;
+	inet_sk(msk)->inet_sport = inet_sk(ssk)->inet_sport;
+	inet_sk(msk)->inet_daddr = inet_sk(ssk)->inet_daddr;
+	inet_sk(msk)->inet_saddr = inet_sk(ssk)->inet_saddr;
+	inet_sk(msk)->inet_rcv_saddr = inet_sk(ssk)->inet_rcv_saddr;
+}
+
+/* Subflows created by the peer are not visible to user space, but TCP
+ * expects a socket for its wakeups and flags: use the MPTCP one.
+ */
+static void mptcp_sock_graft(struct sock *sk, struct socket *parent)
+{
+	write_lock_bh(&sk->sk_callback_lock);
+	rcu_assign_pointer(sk->sk_wq, parent->wq);
+	sk_set_socket(sk, parent);
+	sk->sk_uid = SOCK_INODE(parent)->i_uid;
+	write_unlock_bh(&sk->sk_callback_lock);
+}
+
+static void mptcp_flush_join_list(struct mptcp_sock *msk)
+{
+	if (likely(list_empty(&msk->join_list)))
+		return;
+
+	spin_lock_bh(&msk->join_list_lock);
+	list_splice_tail_init(&msk->join_list, &msk->conn_list);
+	spin_unlock_bh(&msk->join_list_lock);
+}
+
+/* Create the subflow used for bind(), connect() and listen(). Options
+ * set on the MPTCP socket so far are inherited by the subflow.
+ */
+static struct socket *__mptcp_socket_create(struct mptcp_sock *msk)
+{
+	struct mptcp_subflow_context *subflow;
+	struct sock *sk = (struct sock *)msk;
+	struct socket *ssock;
+	int err;
+
+	if (msk->subflow)
+		return msk->subflow;
+
+	if (sk->sk_state != TCP_CLOSE)
+		return ERR_PTR(-EINVAL);
+
+	err = mptcp_subflow_create_socket(sk, &ssock);
+	if (err)
+		return ERR_PTR(err);
+
+	ssock->sk->sk_reuse = sk->sk_reuse;
+	ssock->sk->sk_reuseport = sk->sk_reuseport;
+	ssock->sk->sk_bound_dev_if = sk->sk_bound_dev_if;
+	ssock->sk->sk_mark = sk->sk_mark;
+	ssock->sk->sk_priority = sk->sk_priority;
+
+	subflow = mptcp_subflow_ctx(ssock->sk);
+	subflow->request_mptcp = 1;
+	msk->subflow = ssock;
+
+	return ssock;
+}
+
+static struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
+{
+	struct mptcp_subflow_context *subflow;
+	struct sock *ssk = NULL;
+	u32 best_rtt = U32_MAX;
+
+	mptcp_for_each_subflow(msk, subflow) {
+		struct sock *tmp = mptcp_subflow_tcp_sock(subflow);
+
+		if (!mptcp_subflow_usable(subflow))
+			continue;
+		if (!((1 << tmp->sk_state) & (TCPF_ESTABLISHED | TCPF_CLOSE_WAIT)))
+			continue;
+		if (!sk_stream_memory_free(tmp))
+			continue;
+
+		if (tcp_sk(tmp)->srtt_us < best_rtt) {
+			best_rtt = tcp_sk(tmp)->srtt_us;
+			ssk = tmp;
+		}
+	}
+	return ssk;
+}
+
+static void mptcp_set_nospace(struct mptcp_sock *msk)
+{
+	struct mptcp_subflow_context *subflow;
+
+	clear_bit(MPTCP_SEND_SPACE, &msk->flags);
+
+	/* makes TCP call our write_space callback when memory is freed */
+	mptcp_for_each_subflow(msk, subflow) {
+		struct socket *sock;
+
+		sock = READ_ONCE(mptcp_subflow_tcp_sock(subflow)->sk_socket);
+		if (sock)
+			set_bit(SOCK_NOSPACE, &sock->flags);
+	}
+}
+
+static int mptcp_wait_send_space(struct sock *sk, long *timeo)
+{
+	DEFINE_WAIT_FUNC(wait, woken_wake_function);
+	struct mptcp_sock *msk = mptcp_sk(sk);
+
+	if (!*timeo)
+		return -EAGAIN;
+	if (signal_pending(current))
+		return sock_intr_errno(*timeo);
+
+	add_wait_queue(sk_sleep(sk), &wait);
+	set_bit(SOCK_NOSPACE, &sk->sk_socket->flags);
+	sk_wait_event(sk, timeo,
+		      test_bit(MPTCP_SEND_SPACE, &msk->flags) || sk->sk_err ||
+		      (sk->sk_shutdown & SEND_SHUTDOWN), &wait);
+	remove_wait_queue(sk_sleep(sk), &wait);
+
+	return 0;
+}
+
+/* Queue up to 64KB of the user data on @ssk and record the mapping. The
+ * subflow never blocks: when it is out of memory -EAGAIN is returned
+ * and the caller waits for any subflow to have room.
+ */
+static int mptcp_sendmsg_frag(struct sock *sk, struct sock *ssk,
+			      struct msghdr *msg)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(ssk);
+	size_t len = min_t(size_t, msg_data_left(msg), SZ_64K);
+	size_t left = msg_data_left(msg);
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	struct tcp_sock *tp = tcp_sk(ssk);
+	unsigned int msg_flags = msg->msg_flags;
+	struct mptcp_map *map = NULL;
+	bool fallback;
+	int ret;
+
+	lock_sock(ssk);
+
+	fallback = !sk_is_mptcp(ssk);
+	if (!fallback) {
+		mptcp_subflow_prune_maps(&subflow->tx_maps, tp->snd_una);
+
+		/* extend the last mapping if this chunk follows it */
+		if (!list_empty(&subflow->tx_maps)) {
+			map = list_last_entry(&subflow->tx_maps,
+					      struct mptcp_map, list);
+			if (map->ssn + map->len != tp->write_seq ||
+			    map->dsn + map->len != msk->write_seq)
+				map = NULL;
+		}
+
+		if (!map) {
+			struct sk_buff *tail = tcp_write_queue_tail(ssk);
+
+			/* an skb must not carry data of two mappings */
+			if (tail)
+				TCP_SKB_CB(tail)->eor = 1;
+
+			map = kmalloc(sizeof(*map), ssk->sk_allocation);
+			if (!map) {
+				ret = -ENOMEM;
+				goto out;
+			}
+			map->dsn = msk->write_seq;
+			map->ssn = tp->write_seq;
+			map->len = 0;
+			list_add_tail(&map->list, &subflow->tx_maps);
+		}
+
+		/* provisional, the options of the segments built below
+		 * must already cover the new data
+		 */
+		map->len += len;
+	}
+
+	msg->msg_flags |= MSG_DONTWAIT | MSG_NOSIGNAL;
+	iov_iter_truncate(&msg->msg_iter, len);
+	ret = tcp_sendmsg_locked(ssk, msg, len);
+	iov_iter_reexpand(&msg->msg_iter, left - max(ret, 0));
+	msg->msg_flags = msg_flags;
+
+	if (!fallback) {
+		map->len -= len - max(ret, 0);
+		if (!map->len) {
+			list_del(&map->list);
+			kfree(map);
+		}
+	}
+
+	if (ret > 0)
+		msk->write_seq += ret;
+
+out:
+	release_sock(ssk);
+	return ret;
+}
+
+static int mptcp_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	size_t copied = 0;
+	int ret = 0;
+	long timeo;
+
+	if (msg->msg_flags & ~(MSG_MORE | MSG_DONTWAIT | MSG_NOSIGNAL))
+		return -EOPNOTSUPP;
+
+	lock_sock(sk);
+
+	timeo = sock_sndtimeo(sk, msg->msg_flags & MSG_DONTWAIT);
+
+	if ((1 << sk->sk_state) & ~(TCPF_ESTABLISHED | TCPF_CLOSE_WAIT)) {
+		ret = sk_stream_wait_connect(sk, &timeo);
+		if (ret)
+			goto out;
+	}
+
+	while (msg_data_left(msg)) {
+		struct sock *ssk;
+
+		if (sk->sk_err || (sk->sk_shutdown & SEND_SHUTDOWN)) {
+			ret = -EPIPE;
+			break;
+		}
+
+		mptcp_flush_join_list(msk);
+		ssk = mptcp_subflow_get_send(msk);
+		if (ssk)
+			ret = mptcp_sendmsg_frag(sk, ssk, msg);
+
+		if (!ssk || ret == -EAGAIN) {
+			mptcp_set_nospace(msk);
+
+			/* a subflow may have got room in the meantime */
+			if (ssk || !mptcp_subflow_get_send(msk)) {
+				ret = mptcp_wait_send_space(sk, &timeo);
+				if (ret)
+					break;
+			}
+			continue;
+		}
+
+		if (ret < 0)
+			break;
+
+		copied += ret;
+	}
+
+out:
+	if (copied)
+		ret = copied;
+	else if (ret < 0)
+		ret = sk_stream_error(sk, msg->msg_flags, ret);
+
+	release_sock(sk);
+	return ret;
+}
+
+static void mptcp_rfree(struct sk_buff *skb)
+{
+	atomic_sub(skb->truesize, &skb->sk->sk_rmem_alloc);
+}
+
+static void mptcp_ofo_queue(struct mptcp_sock *msk, struct sk_buff *skb)
+{
+	struct rb_node **p = &msk->out_of_order_queue.rb_node;
+	u64 seq = MPTCP_SKB_CB(skb)->map_seq;
+	struct rb_node *parent = NULL;
+
+	while (*p) {
+		struct sk_buff *skb1;
+
+		parent = *p;
+		skb1 = rb_to_skb(parent);
+		if (before64(seq, MPTCP_SKB_CB(skb1)->map_seq)) {
+			p = &parent->rb_left;
+		} else if (seq == MPTCP_SKB_CB(skb1)->map_seq &&
+			   MPTCP_SKB_CB(skb)->end_offset -
+			   MPTCP_SKB_CB(skb)->offset <=
+			   MPTCP_SKB_CB(skb1)->end_offset -
+			   MPTCP_SKB_CB(skb1)->offset) {
+			/* duplicate, e.g. received on two subflows */
+			kfree_skb(skb);
+			return;
+		} else {
+			p = &parent->rb_right;
+		}
+	}
+
+	rb_link_node(&skb->rbnode, parent, p);
+	rb_insert_color(&skb->rbnode, &msk->out_of_order_queue);
+}
+
+/* move the out of order data that became in sequence to the receive
+ * queue, returns the new ack_seq
+ */
+static u64 mptcp_ofo_drain(struct mptcp_sock *msk, u64 ack_seq)
+{
+	struct sock *sk = (struct sock *)msk;
+	struct rb_node *p;
+
+	while ((p = rb_first(&msk->out_of_order_queue)) != NULL) {
+		struct sk_buff *skb = rb_to_skb(p);
+		u64 seq = MPTCP_SKB_CB(skb)->map_seq;
+		u32 len = MPTCP_SKB_CB(skb)->end_offset -
+			  MPTCP_SKB_CB(skb)->offset;
+
+		if (after64(seq, ack_seq))
+			break;
+
+		rb_erase(p, &msk->out_of_order_queue);
+		if (!after64(seq + len, ack_seq)) {
+			kfree_skb(skb);
+			continue;
+		}
+
+		MPTCP_SKB_CB(skb)->offset += ack_seq - seq;
+		MPTCP_SKB_CB(skb)->map_seq = ack_seq;
+		ack_seq = seq + len;
+		__skb_queue_tail(&sk->sk_receive_queue, skb);
+	}
+	return ack_seq;
+}
+
+/* called with rx_lock held */
+static void __mptcp_check_data_fin(struct mptcp_sock *msk)
+{
+	struct sock *sk = (struct sock *)msk;
+	u64 ack_seq = atomic64_read(&msk->ack_seq);
+
+	if (test_bit(MPTCP_RCV_DATA_FIN, &msk->flags) &&
+	    msk->rcv_data_fin_seq == ack_seq) {
+		/* the DATA_FIN takes one byte of the sequence space */
+		atomic64_set(&msk->ack_seq, ack_seq + 1);
+		set_bit(MPTCP_RCV_EOF, &msk->flags);
+		sk->sk_shutdown |= RCV_SHUTDOWN;
+	}
+}
+
+void mptcp_data_fin(struct sock *sk, u64 data_fin_seq)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+
+	spin_lock_bh(&msk->rx_lock);
+	if (!test_bit(MPTCP_RCV_EOF, &msk->flags)) {
+		msk->rcv_data_fin_seq = data_fin_seq;
+		set_bit(MPTCP_RCV_DATA_FIN, &msk->flags);
+		__mptcp_check_data_fin(msk);
+	}
+	spin_unlock_bh(&msk->rx_lock);
+
+	if (test_bit(MPTCP_RCV_EOF, &msk->flags))
+		sk->sk_data_ready(sk);
+}
+
+/* Queue @len bytes of @skb at @offset, mapped at @dsn, on the MPTCP
+ * socket. Returns false if the data must be left on the subflow, e.g.
+ * because the receive buffer is full.
+ */
+static bool mptcp_queue_data(struct mptcp_sock *msk, struct sk_buff *skb,
+			     u32 offset, u32 len, u64 dsn)
+{
+	struct sock *sk = (struct sock *)msk;
+	struct sk_buff *clone;
+	bool ret = true;
+	u64 ack_seq;
+	int limit;
+
+	spin_lock_bh(&msk->rx_lock);
+	ack_seq = atomic64_read(&msk->ack_seq);
+
+	/* already received on another subflow */
+	if (!after64(dsn + len, ack_seq))
+		goto out;
+
+	if (before64(dsn, ack_seq)) {
+		u32 delta = ack_seq - dsn;
+
+		offset += delta;
+		len -= delta;
+		dsn = ack_seq;
+	}
+
+	/* out of order data must not prevent in sequence data, possibly
+	 * on another subflow, from being queued
+	 */
+	limit = dsn == ack_seq ? 2 * sk->sk_rcvbuf : sk->sk_rcvbuf;
+	if (atomic_read(&sk->sk_rmem_alloc) > limit) {
+		ret = false;
+		goto out;
+	}
+
+	clone = skb_clone(skb, GFP_ATOMIC);
+	if (!clone) {
+		ret = false;
+		goto out;
+	}
+
+	MPTCP_SKB_CB(clone)->map_seq = dsn;
+	MPTCP_SKB_CB(clone)->offset = offset;
+	MPTCP_SKB_CB(clone)->end_offset = offset + len;
+	clone->sk = sk;
+	clone->destructor = mptcp_rfree;
+	atomic_add(clone->truesize, &sk->sk_rmem_alloc);
+
+	if (dsn == ack_seq) {
+		__skb_queue_tail(&sk->sk_receive_queue, clone);
+		ack_seq = mptcp_ofo_drain(msk, dsn + len);
+		atomic64_set(&msk->ack_seq, ack_seq);
+		__mptcp_check_data_fin(msk);
+	} else {
+		mptcp_ofo_queue(msk, clone);
+	}
+
+out:
+	spin_unlock_bh(&msk->rx_lock);
+	return ret;
+}
+
+static int mptcp_recv_actor(read_descriptor_t *desc, struct sk_buff *skb,
+			    unsigned int offset, size_t len)
+{
+	struct mptcp_read_arg *arg = desc->arg.data;
+	struct mptcp_subflow_context *subflow;
+	struct mptcp_sock *msk = arg->msk;
+	struct sock *ssk = arg->ssk;
+	u32 seq, map_len;
+	u64 dsn;
+
+	subflow = mptcp_subflow_ctx(ssk);
+	if (subflow->reset)
+		goto stop;
+
+	seq = TCP_SKB_CB(skb)->seq + offset;
+	if (!sk_is_mptcp(ssk)) {
+		/* plain TCP: a single subflow carries the whole stream */
+		dsn = atomic64_read(&msk->ack_seq);
+		map_len = len;
+	} else if (!mptcp_subflow_map_rx_lookup(ssk, seq, &dsn, &map_len)) {
+		/* data without a mapping: the subflow is unusable */
+		subflow->reset = 1;
+		mptcp_schedule_work((struct sock *)msk, MPTCP_WORK_SUBFLOWS);
+		goto stop;
+	}
+
+	len = min_t(size_t, len, map_len);
+	if (!mptcp_queue_data(msk, skb, offset, len, dsn))
+		goto stop;
+
+	return len;
+
+stop:
+	desc->count = 0;
+	return 0;
+}
+
+/* move the data received on @ssk to the MPTCP socket, the subflow must
+ * be locked
+ */
+static bool __mptcp_move_skbs(struct mptcp_sock *msk, struct sock *ssk)
+{
+	struct mptcp_read_arg arg = {
+		.msk = msk,
+		.ssk = ssk,
+	};
+	read_descriptor_t desc = {
+		.arg.data = &arg,
+		.count = 1,
+	};
+	int moved;
+
+	moved = tcp_read_sock(ssk, &desc, mptcp_recv_actor);
+	mptcp_subflow_prune_maps(&mptcp_subflow_ctx(ssk)->rx_maps,
+				 tcp_sk(ssk)->copied_seq);
+
+	return moved > 0;
+}
+
+void mptcp_data_ready(struct sock *sk, struct sock *ssk)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+
+	if (inet_sk_state_load(sk) == TCP_CLOSE)
+		return;
+
+	if (__mptcp_move_skbs(msk, ssk) ||
+	    test_bit(MPTCP_RCV_EOF, &msk->flags))
+		sk->sk_data_ready(sk);
+}
+
+/* pull the data left on the subflows when the receive buffer was full */
+static bool mptcp_move_skbs(struct mptcp_sock *msk)
+{
+	struct mptcp_subflow_context *subflow;
+	bool moved = false;
+
+	mptcp_flush_join_list(msk);
+	mptcp_for_each_subflow(msk, subflow) {
+		struct sock *ssk = mptcp_subflow_tcp_sock(subflow);
+
+		lock_sock(ssk);
+		moved |= __mptcp_move_skbs(msk, ssk);
+		release_sock(ssk);
+	}
+	return moved;
+}
+
+/* every subflow got a FIN: no more data can be received */
+static bool mptcp_subflows_eof(struct mptcp_sock *msk)
+{
+	struct mptcp_subflow_context *subflow;
+
+	if (list_empty(&msk->conn_list))
+		return false;
+
+	mptcp_for_each_subflow(msk, subflow) {
+		struct sock *ssk = mptcp_subflow_tcp_sock(subflow);
+
+		if (!(ssk->sk_shutdown & RCV_SHUTDOWN) ||
+		    !skb_queue_empty(&ssk->sk_receive_queue))
+			return false;
+	}
+	return true;
+}
+
+static int __mptcp_recv_copy(struct sock *sk, struct msghdr *msg, size_t len)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	struct sk_buff *skb;
+	size_t copied = 0;
+
+	while (copied < len) {
+		u32 offset, count;
+
+		/* only the tail of the queue is touched by the subflows */
+		spin_lock_bh(&msk->rx_lock);
+		skb = skb_peek(&sk->sk_receive_queue);
+		spin_unlock_bh(&msk->rx_lock);
+		if (!skb)
+			break;
+
+		offset = MPTCP_SKB_CB(skb)->offset;
+		count = min_t(size_t, MPTCP_SKB_CB(skb)->end_offset - offset,
+			      len - copied);
+		if (skb_copy_datagram_msg(skb, offset, msg, count)) {
+			if (!copied)
+				return -EFAULT;
+			break;
+		}
+
+		copied += count;
+		MPTCP_SKB_CB(skb)->offset += count;
+		MPTCP_SKB_CB(skb)->map_seq += count;
+		if (MPTCP_SKB_CB(skb)->offset < MPTCP_SKB_CB(skb)->end_offset)
+			break;
+
+		spin_lock_bh(&msk->rx_lock);
+		__skb_unlink(skb, &sk->sk_receive_queue);
+		spin_unlock_bh(&msk->rx_lock);
+		consume_skb(skb);
+	}
+	return copied;
+}
+
+static void mptcp_wait_data(struct sock *sk, long *timeo)
+{
+	DEFINE_WAIT_FUNC(wait, woken_wake_function);
+
+	add_wait_queue(sk_sleep(sk), &wait);
+	sk_set_bit(SOCKWQ_ASYNC_WAITDATA, sk);
+	sk_wait_event(sk, timeo,
+		      !skb_queue_empty(&sk->sk_receive_queue) || sk->sk_err ||
+		      (sk->sk_shutdown & RCV_SHUTDOWN), &wait);
+	sk_clear_bit(SOCKWQ_ASYNC_WAITDATA, sk);
+	remove_wait_queue(sk_sleep(sk), &wait);
+}
+
+static int mptcp_recvmsg(struct sock *sk, struct msghdr *msg, size_t len,
+			 int nonblock, int flags, int *addr_len)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	int copied = 0;
+	int target;
+	long timeo;
+
+	if (flags & (MSG_PEEK | MSG_OOB | MSG_ERRQUEUE | MSG_TRUNC))
+		return -EOPNOTSUPP;
+
+	lock_sock(sk);
+	if (sk->sk_state == TCP_LISTEN) {
+		copied = -ENOTCONN;
+		goto out;
+	}
+
+	timeo = sock_rcvtimeo(sk, nonblock);
+	target = sock_rcvlowat(sk, flags & MSG_WAITALL, len);
+
+	while (copied < len) {
+		int ret;
+
+		ret = __mptcp_recv_copy(sk, msg, len - copied);
+		if (ret < 0) {
+			if (!copied)
+				copied = ret;
+			break;
+		}
+		copied += ret;
+
+		if (copied >= target && skb_queue_empty(&sk->sk_receive_queue))
+			break;
+		if (ret)
+			continue;
+
+		if (mptcp_move_skbs(msk))
+			continue;
+
+		if (copied) {
+			if (sk->sk_err || sk->sk_state == TCP_CLOSE ||
+			    (sk->sk_shutdown & RCV_SHUTDOWN) ||
+			    !timeo || signal_pending(current))
+				break;
+		} else {
+			if (sk->sk_err) {
+				copied = sock_error(sk);
+				break;
+			}
+
+			if ((sk->sk_shutdown & RCV_SHUTDOWN) ||
+			    mptcp_subflows_eof(msk))
+				break;
+
+			if (sk->sk_state == TCP_CLOSE) {
+				copied = -ENOTCONN;
+				break;
+			}
+
+			if (!timeo) {
+				copied = -EAGAIN;
+				break;
+			}
+
+			if (signal_pending(current)) {
+				copied = sock_intr_errno(timeo);
+				break;
+			}
+		}
+
+		mptcp_wait_data(sk, &timeo);
+	}
+
+out:
+	release_sock(sk);
+	return copied;
+}
+
+void mptcp_subflow_write_space(struct sock *ssk)
+{
+	struct sock *sk = mptcp_subflow_ctx(ssk)->conn;
+	struct socket *sock = READ_ONCE(ssk->sk_socket);
+
+	if (sock && sock != sk->sk_socket)
+		clear_bit(SOCK_NOSPACE, &sock->flags);
+
+	set_bit(MPTCP_SEND_SPACE, &mptcp_sk(sk)->flags);
+	sk_stream_write_space(sk);
+}
+
+void mptcp_subflow_state_change(struct sock *sk, struct sock *ssk)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	int state = inet_sk_state_load(sk);
+	bool fallback;
+
+	if (state == TCP_CLOSE || state == TCP_LISTEN)
+		return;
+
+	fallback = test_bit(MPTCP_FALLBACK, &msk->flags);
+
+	if (ssk == msk->first) {
+		if (state == TCP_SYN_SENT) {
+			if (ssk->sk_state == TCP_ESTABLISHED) {
+				mptcp_copy_inaddrs(sk, ssk);
+				inet_sk_state_store(sk, TCP_ESTABLISHED);
+			} else if (ssk->sk_state == TCP_CLOSE) {
+				inet_sk_state_store(sk, TCP_CLOSE);
+			}
+		}
+
+		/* errors are reported when the first subflow is all we have */
+		if (ssk->sk_err && (state == TCP_SYN_SENT || fallback)) {
+			sk->sk_err = ssk->sk_err;
+			sk->sk_error_report(sk);
+		}
+		sk->sk_state_change(sk);
+	}
+
+	if (ssk->sk_shutdown & RCV_SHUTDOWN) {
+		if (fallback)
+			sk->sk_shutdown |= RCV_SHUTDOWN;
+		sk->sk_data_ready(sk);
+	}
+
+	if (ssk->sk_state == TCP_CLOSE && state != TCP_SYN_SENT) {
+		mptcp_schedule_work(sk, MPTCP_WORK_SUBFLOWS);
+
+		/* let blocked senders pick another subflow */
+		set_bit(MPTCP_SEND_SPACE, &msk->flags);
+		sk_stream_write_space(sk);
+	}
+}
+
+void mptcp_finish_connect(struct sock *ssk)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(ssk);
+	struct mptcp_sock *msk = mptcp_sk(subflow->conn);
+	u64 ack_seq;
+
+	mptcp_crypto_key_sha(subflow->remote_key, &subflow->remote_token,
+			     &ack_seq);
+
+	msk->remote_key = subflow->remote_key;
+	msk->remote_token = subflow->remote_token;
+	atomic64_set(&msk->ack_seq, ack_seq + 1);
+}
+
+bool mptcp_finish_join(struct sock *sk, struct sock *ssk)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(ssk);
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	bool ret = false;
+
+	spin_lock_bh(&msk->join_list_lock);
+	if (inet_sk_state_load(sk) == TCP_ESTABLISHED &&
+	    msk->subflows < mptcp_max_subflows(sock_net(sk))) {
+		list_add_tail(&subflow->node, &msk->join_list);
+		msk->subflows++;
+		ret = true;
+	}
+	spin_unlock_bh(&msk->join_list_lock);
+
+	if (ret && sk->sk_socket)
+		mptcp_sock_graft(ssk, sk->sk_socket);
+
+	return ret;
+}
+
+/* Close the subflows that were reset or closed by the peer. Without
+ * reinjection, data in flight on those subflows is lost: the peer
+ * notices the missing range and resets the connection.
+ */
+static void __mptcp_prune_subflows(struct mptcp_sock *msk)
+{
+	struct mptcp_subflow_context *subflow, *tmp;
+	struct sock *sk = (struct sock *)msk;
+
+	list_for_each_entry_safe(subflow, tmp, &msk->conn_list, node) {
+		struct sock *ssk = mptcp_subflow_tcp_sock(subflow);
+		struct socket *ssock = subflow->ssock;
+
+		if (!subflow->reset && ssk->sk_state != TCP_CLOSE)
+			continue;
+
+		spin_lock_bh(&msk->join_list_lock);
+		list_del_init(&subflow->node);
+		msk->subflows--;
+		spin_unlock_bh(&msk->join_list_lock);
+
+		if (msk->first == ssk)
+			msk->first = NULL;
+		if (msk->subflow == ssock)
+			msk->subflow = NULL;
+
+		lock_sock(ssk);
+		if (ssk->sk_state != TCP_CLOSE)
+			tcp_disconnect(ssk, 0);
+		release_sock(ssk);
+
+		if (ssock)
+			sock_release(ssock);
+		else
+			tcp_close(ssk, 0);
+	}
+
+	if (list_empty(&msk->conn_list) && !(sk->sk_shutdown & RCV_SHUTDOWN)) {
+		sk->sk_err = ECONNRESET;
+		sk->sk_error_report(sk);
+	}
+}
+
+static void mptcp_close(struct sock *sk, long timeout);
+
+static void mptcp_worker(struct work_struct *work)
+{
+	struct mptcp_sock *msk = container_of(work, struct mptcp_sock, work);
+	struct sock *sk = &msk->sk.icsk_inet.sk;
+
+	lock_sock(sk);
+
+	if (test_and_clear_bit(MPTCP_WORK_CLOSE, &msk->flags) &&
+	    !sk->sk_socket && !sock_flag(sk, SOCK_DEAD)) {
+		release_sock(sk);
+		mptcp_close(sk, 0);
+		goto out;
+	}
+
+	if (sk->sk_state == TCP_CLOSE)
+		goto unlock;
+
+	mptcp_flush_join_list(msk);
+
+	if (test_and_clear_bit(MPTCP_WORK_SUBFLOWS, &msk->flags))
+		__mptcp_prune_subflows(msk);
+
+	if (test_and_clear_bit(MPTCP_WORK_PM, &msk->flags))
+		mptcp_pm_create_subflows(msk);
+
+unlock:
+	release_sock(sk);
+out:
+	sock_put(sk);
+}
+
+static void __mptcp_init_sock(struct sock *sk)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+
+	INIT_LIST_HEAD(&msk->conn_list);
+	INIT_LIST_HEAD(&msk->join_list);
+	spin_lock_init(&msk->join_list_lock);
+	spin_lock_init(&msk->rx_lock);
+	INIT_WORK(&msk->work, mptcp_worker);
+	INIT_HLIST_NODE(&msk->token_node);
+	msk->out_of_order_queue = RB_ROOT;
+	msk->flags = 0;
+	set_bit(MPTCP_SEND_SPACE, &msk->flags);
+	msk->subflows = 0;
+	msk->local_id = 0;
+	msk->first = NULL;
+	msk->subflow = NULL;
+}
+
+static int mptcp_init_sock(struct sock *sk)
+{
+	struct net *net = sock_net(sk);
+	int ret;
+
+	if (!mptcp_is_enabled(net))
+		return -ENOPROTOOPT;
+
+	ret = mptcp_crypto_init();
+	if (ret)
+		return ret;
+
+	__mptcp_init_sock(sk);
+
+	sk->sk_rcvbuf = net->ipv4.sysctl_tcp_rmem[1];
+	sk->sk_sndbuf = net->ipv4.sysctl_tcp_wmem[1];
+
+	return 0;
+}
+
+static void mptcp_close(struct sock *sk, long timeout)
+{
+	struct mptcp_subflow_context *subflow, *tmp;
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	LIST_HEAD(conn_list);
+
+	lock_sock(sk);
+
+	mptcp_token_destroy(msk);
+
+	/* no more joins after this point */
+	spin_lock_bh(&msk->join_list_lock);
+	inet_sk_state_store(sk, TCP_CLOSE);
+	list_splice_tail_init(&msk->join_list, &msk->conn_list);
+	list_splice_init(&msk->conn_list, &conn_list);
+	msk->subflows = 0;
+	spin_unlock_bh(&msk->join_list_lock);
+
+	/* the FIN of each subflow carries the DATA_FIN */
+	WRITE_ONCE(msk->data_fin_seq, msk->write_seq);
+	set_bit(MPTCP_SEND_DATA_FIN, &msk->flags);
+
+	list_for_each_entry_safe(subflow, tmp, &conn_list, node) {
+		struct sock *ssk = mptcp_subflow_tcp_sock(subflow);
+
+		list_del_init(&subflow->node);
+		if (subflow->ssock) {
+			if (msk->subflow == subflow->ssock)
+				msk->subflow = NULL;
+			sock_release(subflow->ssock);
+		} else {
+			tcp_close(ssk, timeout);
+		}
+	}
+
+	/* listener, or subflow never connected */
+	if (msk->subflow) {
+		sock_release(msk->subflow);
+		msk->subflow = NULL;
+	}
+	msk->first = NULL;
+
+	spin_lock_bh(&msk->rx_lock);
+	__skb_queue_purge(&sk->sk_receive_queue);
+	skb_rbtree_purge(&msk->out_of_order_queue);
+	spin_unlock_bh(&msk->rx_lock);
+
+	release_sock(sk);
+
+	if (sk->sk_prot->destroy)
+		sk->sk_prot->destroy(sk);
+
+	sock_orphan(sk);
+	sock_put(sk);
+}
+
+/* The clone of a listening MPTCP socket for a new passive connection. Two
+ * references are held: one for the socket the connection is accepted on,
+ * one for the first subflow.
+ */
+struct sock *mptcp_sk_clone(const struct sock *sk, struct request_sock *req,
+			    u64 remote_key)
+{
+	struct mptcp_subflow_request_sock *subflow_req = mptcp_subflow_rsk(req);
+	struct sock *nsk = sk_clone_lock(sk, GFP_ATOMIC);
+	struct mptcp_sock *msk;
+	u64 ack_seq;
+
+	if (!nsk)
+		return NULL;
+
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+	if (nsk->sk_family == AF_INET6) {
+		struct ipv6_pinfo *newnp = &((struct mptcp6_sock *)nsk)->np;
+
+		inet_sk(nsk)->pinet6 = newnp;
+		newnp->ipv6_mc_list = NULL;
+		newnp->ipv6_ac_list = NULL;
+		newnp->ipv6_fl_list = NULL;
+		newnp->pktoptions = NULL;
+		newnp->rxpmtu = NULL;
+		RCU_INIT_POINTER(newnp->opt, NULL);
+	}
+#endif
+
+	__mptcp_init_sock(nsk);
+
+	msk = mptcp_sk(nsk);
+	msk->local_key = subflow_req->local_key;
+	msk->token = subflow_req->token;
+	msk->write_seq = subflow_req->idsn + 1;
+	atomic64_set(&msk->snd_una, msk->write_seq);
+
+	msk->remote_key = remote_key;
+	mptcp_crypto_key_sha(remote_key, &msk->remote_token, &ack_seq);
+	atomic64_set(&msk->ack_seq, ack_seq + 1);
+
+	inet_sk_state_store(nsk, TCP_ESTABLISHED);
+	bh_unlock_sock(nsk);
+
+	return nsk;
+}
+
+void mptcp_sk_dispose(struct sock *sk)
+{
+	inet_sk_state_store(sk, TCP_CLOSE);
+	sock_orphan(sk);
+
+	/* both the owner and the first subflow references */
+	__sock_put(sk);
+	sock_put(sk);
+}
+
+static struct sock *mptcp_accept(struct sock *sk, int flags, int *err,
+				 bool kern)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	struct socket *listener;
+	struct sock *newsk;
+
+	listener = msk->subflow;
+	if (!listener) {
+		*err = -EINVAL;
+		return NULL;
+	}
+
+	newsk = inet_csk_accept(listener->sk, flags, err, kern);
+	if (!newsk)
+		return NULL;
+
+	/* The MPTCP socket replaces its first subflow, which stays owned
+	 * by it. A connection that fell back is a plain TCP socket.
+	 */
+	if (sk_is_mptcp(newsk))
+		return mptcp_subflow_ctx(newsk)->conn;
+
+	return newsk;
+}
+
+static void mptcp_unhash(struct sock *sk)
+{
+	/* called from sk_common_release() */
+}
+
+static int mptcp_setsockopt(struct sock *sk, int level, int optname,
+			    char __user *optval, unsigned int optlen)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	struct sock *ssk = NULL;
+	struct socket *ssock;
+	int ret;
+
+	/* Options apply to the initial subflow, additional subflows use
+	 * the defaults.
+	 */
+	lock_sock(sk);
+	ssock = __mptcp_socket_create(msk);
+	if (!IS_ERR(ssock))
+		ssk = ssock->sk;
+	else if (msk->first)
+		ssk = msk->first;
+
+	if (ssk)
+		ret = ssk->sk_prot->setsockopt(ssk, level, optname, optval,
+					       optlen);
+	else
+		ret = -EOPNOTSUPP;
+	release_sock(sk);
+
+	return ret;
+}
+
+static int mptcp_getsockopt(struct sock *sk, int level, int optname,
+			    char __user *optval, int __user *option)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	struct sock *ssk = NULL;
+	int ret;
+
+	lock_sock(sk);
+	if (msk->subflow)
+		ssk = msk->subflow->sk;
+	else if (msk->first)
+		ssk = msk->first;
+
+	if (ssk)
+		ret = ssk->sk_prot->getsockopt(ssk, level, optname, optval,
+					       option);
+	else
+		ret = -EOPNOTSUPP;
+	release_sock(sk);
+
+	return ret;
+}
+
+struct proto mptcp_prot = {
+	.name		= "MPTCP",
+	.owner		= THIS_MODULE,
+	.init		= mptcp_init_sock,
+	.close		= mptcp_close,
+	.accept		= mptcp_accept,
+	.setsockopt	= mptcp_setsockopt,
+	.getsockopt	= mptcp_getsockopt,
+	.sendmsg	= mptcp_sendmsg,
+	.recvmsg	= mptcp_recvmsg,
+	.unhash		= mptcp_unhash,
+	.no_autobind	= true,
+	.obj_size	= sizeof(struct mptcp_sock),
+};
+
+static int mptcp_bind(struct socket *sock, struct sockaddr *uaddr, int addr_len)
+{
+	struct mptcp_sock *msk = mptcp_sk(sock->sk);
+	struct socket *ssock;
+	int err;
+
+	lock_sock(sock->sk);
+	ssock = __mptcp_socket_create(msk);
+	if (IS_ERR(ssock)) {
+		err = PTR_ERR(ssock);
+		goto unlock;
+	}
+
+	err = ssock->ops->bind(ssock, uaddr, addr_len);
+	if (!err)
+		mptcp_copy_inaddrs(sock->sk, ssock->sk);
+
+unlock:
+	release_sock(sock->sk);
+	return err;
+}
+
+static int mptcp_stream_connect(struct socket *sock, struct sockaddr *uaddr,
+				int addr_len, int flags)
+{
+	struct mptcp_sock *msk = mptcp_sk(sock->sk);
+	struct mptcp_subflow_context *subflow;
+	struct sock *sk = sock->sk;
+	struct socket *ssock;
+	int err;
+
+	lock_sock(sk);
+
+	/* connect() again on a connecting or connected socket */
+	if (sk->sk_state != TCP_CLOSE) {
+		if (!msk->first || !msk->subflow) {
+			err = sk->sk_state == TCP_LISTEN ? -EINVAL : -EISCONN;
+			goto unlock;
+		}
+		ssock = msk->subflow;
+		goto do_connect;
+	}
+
+	ssock = __mptcp_socket_create(msk);
+	if (IS_ERR(ssock)) {
+		err = PTR_ERR(ssock);
+		goto unlock;
+	}
+
+	subflow = mptcp_subflow_ctx(ssock->sk);
+	mptcp_token_destroy(msk);
+	err = mptcp_token_new_connect(ssock->sk);
+	if (err)
+		goto unlock;
+
+	if (list_empty(&subflow->node)) {
+		list_add(&subflow->node, &msk->conn_list);
+		msk->subflows = 1;
+	}
+	msk->first = ssock->sk;
+	inet_sk_state_store(sk, TCP_SYN_SENT);
+
+do_connect:
+	err = ssock->ops->connect(ssock, uaddr, addr_len, flags);
+	inet_sk_state_store(sk, inet_sk_state_load(ssock->sk));
+	sock->state = ssock->state;
+	mptcp_copy_inaddrs(sk, ssock->sk);
+
+unlock:
+	release_sock(sk);
+	return err;
+}
+
+static int mptcp_listen(struct socket *sock, int backlog)
+{
+	struct mptcp_sock *msk = mptcp_sk(sock->sk);
+	struct socket *ssock;
+	int err;
+
+	lock_sock(sock->sk);
+	ssock = __mptcp_socket_create(msk);
+	if (IS_ERR(ssock)) {
+		err = PTR_ERR(ssock);
+		goto unlock;
+	}
+
+	err = ssock->ops->listen(ssock, backlog);
+	inet_sk_state_store(sock->sk, inet_sk_state_load(ssock->sk));
+	if (!err)
+		mptcp_copy_inaddrs(sock->sk, ssock->sk);
+
+unlock:
+	release_sock(sock->sk);
+	return err;
+}
+
+static int mptcp_stream_accept(struct socket *sock, struct socket *newsock,
+			       int flags, bool kern)
+{
+	struct mptcp_subflow_context *subflow;
+	struct mptcp_sock *msk;
+	struct sock *newsk;
+	int err;
+
+	if (sock->sk->sk_state != TCP_LISTEN)
+		return -EINVAL;
+
+	err = inet_accept(sock, newsock, flags, kern);
+	if (err)
+		return err;
+
+	newsk = newsock->sk;
+	if (newsk->sk_protocol == IPPROTO_TCP) {
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+		if (newsk->sk_family == AF_INET6)
+			newsock->ops = &inet6_stream_ops;
+		else
+#endif
+			newsock->ops = &inet_stream_ops;
+		return 0;
+	}
+
+	msk = mptcp_sk(newsk);
+	lock_sock(newsk);
+	mptcp_flush_join_list(msk);
+	mptcp_for_each_subflow(msk, subflow)
+		mptcp_sock_graft(mptcp_subflow_tcp_sock(subflow), newsock);
+	release_sock(newsk);
+
+	return 0;
+}
+
+static __poll_t mptcp_poll(struct file *file, struct socket *sock,
+			   struct poll_table_struct *wait)
+{
+	struct sock *sk = sock->sk;
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	struct socket *ssock;
+	__poll_t mask = 0;
+	int state;
+
+	/* accept() waits on the listening subflow */
+	lock_sock(sk);
+	ssock = msk->subflow;
+	if (sk->sk_state == TCP_LISTEN && ssock) {
+		mask = ssock->ops->poll(file, ssock, wait);
+		release_sock(sk);
+		return mask;
+	}
+	release_sock(sk);
+
+	sock_poll_wait(file, sock, wait);
+
+	state = inet_sk_state_load(sk);
+	if (sk->sk_err)
+		mask |= EPOLLERR;
+	if (sk->sk_shutdown == SHUTDOWN_MASK || state == TCP_CLOSE)
+		mask |= EPOLLHUP;
+	if (sk->sk_shutdown & RCV_SHUTDOWN)
+		mask |= EPOLLIN | EPOLLRDNORM | EPOLLRDHUP;
+
+	if ((1 << state) & (TCPF_ESTABLISHED | TCPF_CLOSE_WAIT)) {
+		if (!skb_queue_empty(&sk->sk_receive_queue))
+			mask |= EPOLLIN | EPOLLRDNORM;
+
+		if (!(sk->sk_shutdown & SEND_SHUTDOWN)) {
+			if (test_bit(MPTCP_SEND_SPACE, &msk->flags))
+				mask |= EPOLLOUT | EPOLLWRNORM;
+			else
+				set_bit(SOCK_NOSPACE, &sock->flags);
+		}
+	}
+
+	return mask;
+}
+
+static int mptcp_shutdown(struct socket *sock, int how)
+{
+	struct mptcp_subflow_context *subflow;
+	struct sock *sk = sock->sk;
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	int ret = 0;
+
+	/* maps 0->1 as well as 1->2 and 2->3 */
+	how++;
+	if ((how & ~SHUTDOWN_MASK) || !how)
+		return -EINVAL;
+
+	lock_sock(sk);
+
+	if ((1 << sk->sk_state) & (TCPF_CLOSE | TCPF_LISTEN | TCPF_SYN_SENT)) {
+		ret = -ENOTCONN;
+		goto out_unlock;
+	}
+
+	sk->sk_shutdown |= how;
+	if (how & SEND_SHUTDOWN) {
+		WRITE_ONCE(msk->data_fin_seq, msk->write_seq);
+		set_bit(MPTCP_SEND_DATA_FIN, &msk->flags);
+	}
+
+	mptcp_flush_join_list(msk);
+	mptcp_for_each_subflow(msk, subflow) {
+		struct sock *ssk = mptcp_subflow_tcp_sock(subflow);
+
+		lock_sock(ssk);
+		tcp_shutdown(ssk, how);
+		release_sock(ssk);
+	}
+
+	/* Wake up anyone sleeping in poll. */
+	sk->sk_state_change(sk);
+
+out_unlock:
+	release_sock(sk);
+	return ret;
+}
+
+static struct inet_protosw mptcp_protosw = {
+	.type		= SOCK_STREAM,
+	.protocol	= IPPROTO_MPTCP,
+	.prot		= &mptcp_prot,
+	.ops		= &mptcp_stream_ops,
+	.flags		= INET_PROTOSW_ICSK,
+};
+
+void __init mptcp_init(void)
+{
+	mptcp_stream_ops = inet_stream_ops;
+	mptcp_stream_ops.bind = mptcp_bind;
+	mptcp_stream_ops.connect = mptcp_stream_connect;
+	mptcp_stream_ops.poll = mptcp_poll;
+	mptcp_stream_ops.accept = mptcp_stream_accept;
+	mptcp_stream_ops.listen = mptcp_listen;
+	mptcp_stream_ops.shutdown = mptcp_shutdown;
+	mptcp_stream_ops.mmap = sock_no_mmap;
+	mptcp_stream_ops.sendpage = sock_no_sendpage;
+	mptcp_stream_ops.splice_read = NULL;
+	mptcp_stream_ops.read_sock = NULL;
+	mptcp_stream_ops.peek_len = NULL;
+	mptcp_stream_ops.sendmsg_locked = NULL;
+	mptcp_stream_ops.sendpage_locked = NULL;
+	mptcp_stream_ops.set_rcvlowat = NULL;
+
+	mptcp_subflow_init();
+	mptcp_ctrl_init();
+
+	if (proto_register(&mptcp_prot, 1) != 0)
+		panic("Failed to register MPTCP proto.\n");
+
+	inet_register_protosw(&mptcp_protosw);
+}
+
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+static struct proto_ops mptcp_v6_stream_ops __ro_after_init;
+static struct proto mptcp_v6_prot;
+
+static void mptcp_v6_destroy(struct sock *sk)
+{
+	inet6_destroy_sock(sk);
+}
+
+static struct inet_protosw mptcp_v6_protosw = {
+	.type		= SOCK_STREAM,
+	.protocol	= IPPROTO_MPTCP,
+	.prot		= &mptcp_v6_prot,
+	.ops		= &mptcp_v6_stream_ops,
+	.flags		= INET_PROTOSW_ICSK,
+};
+
+int __init mptcpv6_init(void)
+{
+	int err;
+
+	mptcp_v6_prot = mptcp_prot;
+	strcpy(mptcp_v6_prot.name, "MPTCPv6");
+	mptcp_v6_prot.slab = NULL;
+	mptcp_v6_prot.destroy = mptcp_v6_destroy;
+	mptcp_v6_prot.obj_size = sizeof(struct mptcp6_sock);
+
+	err = proto_register(&mptcp_v6_prot, 1);
+	if (err)
+		return err;
+
+	mptcp_v6_stream_ops = inet6_stream_ops;
+	mptcp_v6_stream_ops.bind = mptcp_bind;
+	mptcp_v6_stream_ops.connect = mptcp_stream_connect;
+	mptcp_v6_stream_ops.poll = mptcp_poll;
+	mptcp_v6_stream_ops.accept = mptcp_stream_accept;
+	mptcp_v6_stream_ops.listen = mptcp_listen;
+	mptcp_v6_stream_ops.shutdown = mptcp_shutdown;
+	mptcp_v6_stream_ops.mmap = sock_no_mmap;
+	mptcp_v6_stream_ops.sendpage = sock_no_sendpage;
+	mptcp_v6_stream_ops.splice_read = NULL;
+	mptcp_v6_stream_ops.read_sock = NULL;
+	mptcp_v6_stream_ops.peek_len = NULL;
+	mptcp_v6_stream_ops.sendmsg_locked = NULL;
+	mptcp_v6_stream_ops.sendpage_locked = NULL;
+	mptcp_v6_stream_ops.set_rcvlowat = NULL;
+
+	err = inet6_register_protosw(&mptcp_v6_protosw);
+	if (err)
+		proto_unregister(&mptcp_v6_prot);
+
+	return err;
+}
+#endif
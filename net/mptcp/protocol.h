@@ -0,0 +1,319 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Multipath TCP
+ *
+ * Internal interfaces shared by the MPTCP socket, the subflow ULP and
+ * the option handling code.
+ */
+
+#ifndef __MPTCP_PROTOCOL_H
+#define __MPTCP_PROTOCOL_H
+
+#include <linux/list.h>
+#include <linux/rbtree.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <net/inet_connection_sock.h>
+#include <net/request_sock.h>
+#include <net/tcp.h>
+
+#define MPTCP_SUPPORTED_VERSION	1
+
+/* MPTCP option subtypes */
+#define MPTCPOPT_MP_CAPABLE	0
+#define MPTCPOPT_MP_JOIN	1
+#define MPTCPOPT_DSS		2
+
+/* MPTCP suboption bits */
+#define OPTION_MPTCP_MPC_SYN	BIT(0)
+#define OPTION_MPTCP_MPC_SYNACK	BIT(1)
+#define OPTION_MPTCP_MPC_ACK	BIT(2)
+#define OPTION_MPTCP_MPJ_SYN	BIT(3)
+#define OPTION_MPTCP_MPJ_SYNACK	BIT(4)
+#define OPTION_MPTCP_MPJ_ACK	BIT(5)
+#define OPTION_MPTCP_DSS	BIT(6)
+
+/* MPTCP option lengths */
+#define TCPOLEN_MPTCP_MPC_SYN		4
+#define TCPOLEN_MPTCP_MPC_SYNACK	12
+#define TCPOLEN_MPTCP_MPC_ACK		20
+#define TCPOLEN_MPTCP_MPC_ACK_DATA	22
+#define TCPOLEN_MPTCP_MPJ_SYN		12
+#define TCPOLEN_MPTCP_MPJ_SYNACK	16
+#define TCPOLEN_MPTCP_MPJ_ACK		24
+#define TCPOLEN_MPTCP_DSS_BASE		4
+#define TCPOLEN_MPTCP_DSS_ACK32		4
+#define TCPOLEN_MPTCP_DSS_ACK64		8
+#define TCPOLEN_MPTCP_DSS_MAP32		10
+#define TCPOLEN_MPTCP_DSS_MAP64		14
+#define TCPOLEN_MPTCP_DSS_CHECKSUM	2
+
+/* Largest option we may add to a segment carrying data: a DSS with
+ * 64-bit data ack and 64-bit mapping, without checksum.
+ */
+#define TCPOLEN_MPTCP_DSS_MAX	ALIGN(TCPOLEN_MPTCP_DSS_BASE + \
+				      TCPOLEN_MPTCP_DSS_ACK64 + \
+				      TCPOLEN_MPTCP_DSS_MAP64, 4)
+
+/* MPTCP MP_CAPABLE flags */
+#define MPTCP_VERSION_MASK	(0x0F)
+#define MPTCP_CAP_CHECKSUM_REQD	BIT(7)
+#define MPTCP_CAP_EXTENSIBILITY	BIT(6)
+#define MPTCP_CAP_HMAC_SHA256	BIT(0)
+
+/* MPTCP MP_JOIN flags */
+#define MPTCPOPT_BACKUP		BIT(0)
+#define MPTCPOPT_THMAC_LEN	8
+
+/* MPTCP DSS flags */
+#define MPTCP_DSS_DATA_FIN	BIT(4)
+#define MPTCP_DSS_DSN64		BIT(3)
+#define MPTCP_DSS_HAS_MAP	BIT(2)
+#define MPTCP_DSS_ACK64		BIT(1)
+#define MPTCP_DSS_HAS_ACK	BIT(0)
+#define MPTCP_DSS_FLAG_MASK	(0x1F)
+
+/* MPTCP socket flags */
+#define MPTCP_SEND_SPACE	0	/* a subflow may accept more data */
+#define MPTCP_SEND_DATA_FIN	1	/* DATA_FIN must be sent */
+#define MPTCP_RCV_DATA_FIN	2	/* DATA_FIN received, not in sequence */
+#define MPTCP_RCV_EOF		3	/* DATA_FIN received and in sequence */
+#define MPTCP_FALLBACK		4	/* peer is not MPTCP capable */
+#define MPTCP_WORK_PM		5	/* worker: create additional subflows */
+#define MPTCP_WORK_SUBFLOWS	6	/* worker: reset or prune subflows */
+#define MPTCP_WORK_CLOSE	7	/* worker: close a never accepted msk */
+
+struct mptcp_options_received {
+	u64	sndr_key;
+	u64	rcvr_key;
+	u64	data_ack;
+	u64	data_seq;
+	u32	subflow_seq;
+	u16	data_len;
+	u16	suboptions;
+	u32	token;
+	u32	nonce;
+	u64	thmac;
+	u8	hmac[MPTCPOPT_HMAC_LEN];
+	u8	join_id;
+	u8	backup:1,
+		use_ack:1,
+		ack64:1,
+		use_map:1,
+		dsn64:1,
+		data_fin:1;
+};
+
+/* MPTCP connection sock */
+struct mptcp_sock {
+	/* inet_connection_sock must be the first member */
+	struct inet_connection_sock sk;
+	u64		local_key;
+	u64		remote_key;
+	u64		write_seq;	/* next DSN to be sent */
+	u64		data_fin_seq;	/* DSN of our DATA_FIN */
+	atomic64_t	ack_seq;	/* next DSN expected from the peer */
+	atomic64_t	snd_una;	/* highest DATA_ACK from the peer */
+	u64		rcv_data_fin_seq;
+	u32		token;
+	u32		remote_token;
+	unsigned long	flags;
+	u8		local_id;	/* last address id handed out */
+	struct hlist_node token_node;	/* entry on the token hash */
+	struct work_struct work;
+	spinlock_t	rx_lock;	/* protects ack_seq updates and ofo */
+	struct rb_root	out_of_order_queue;
+	struct list_head conn_list;	/* subflows, protected by the msk lock */
+	struct list_head join_list;	/* passive joins not yet in conn_list */
+	spinlock_t	join_list_lock;
+	int		subflows;	/* entries on conn_list and join_list */
+	struct sock	*first;		/* initial subflow */
+	struct socket	*subflow;	/* listener or not yet connected subflow */
+};
+
+#define mptcp_for_each_subflow(__msk, __subflow)			\
+	list_for_each_entry(__subflow, &((__msk)->conn_list), node)
+
+static inline struct mptcp_sock *mptcp_sk(const struct sock *sk)
+{
+	return (struct mptcp_sock *)sk;
+}
+
+/* Per skb state of data queued on the msk: the skb is a clone of the
+ * subflow skb and only the bytes in [offset, end_offset) belong to the
+ * MPTCP stream, starting at data sequence map_seq.
+ */
+struct mptcp_skb_cb {
+	u64	map_seq;
+	u32	offset;
+	u32	end_offset;
+};
+
+#define MPTCP_SKB_CB(__skb)	((struct mptcp_skb_cb *)&((__skb)->cb[0]))
+
+/* A contiguous range of subflow sequence space mapped to the data
+ * sequence space. Senders keep one list per subflow to build the DSS
+ * option of (re)transmitted segments, receivers one list to place the
+ * received bytes in the MPTCP stream.
+ */
+struct mptcp_map {
+	struct list_head list;
+	u64		dsn;
+	u32		ssn;		/* absolute subflow sequence */
+	u32		len;
+};
+
+struct mptcp_subflow_request_sock {
+	struct	tcp_request_sock sk;
+	u8	mp_capable : 1,
+		mp_join : 1,
+		backup : 1;
+	u8	local_id;
+	u8	remote_id;
+	u64	local_key;
+	u64	idsn;
+	u32	token;
+	u32	local_nonce;
+	u32	remote_nonce;
+	u64	thmac;
+	struct mptcp_sock *msk;		/* join target, holds a reference */
+};
+
+static inline struct mptcp_subflow_request_sock *
+mptcp_subflow_rsk(const struct request_sock *rsk)
+{
+	return (struct mptcp_subflow_request_sock *)rsk;
+}
+
+/* MPTCP subflow context, attached to the TCP socket as ULP data */
+struct mptcp_subflow_context {
+	struct	list_head node;		/* conn_list or join_list of subflows */
+	u64	local_key;
+	u64	remote_key;
+	u64	idsn;
+	u32	token;
+	u32	snd_isn;
+	u32	rcv_isn;
+	u32	local_nonce;
+	u32	remote_token;
+	u32	remote_nonce;
+	u64	thmac;
+	u8	hmac[MPTCPOPT_HMAC_LEN];
+	u8	local_id;
+	u8	remote_id;
+	u32	request_mptcp : 1,	/* send MP_CAPABLE */
+		request_join : 1,	/* send MP_JOIN */
+		request_bkup : 1,
+		mp_capable : 1,		/* remote is MPTCP capable */
+		mp_join : 1,		/* remote accepted MP_JOIN */
+		fully_established : 1,	/* peer has seen our MPTCP option */
+		backup : 1,
+		reset : 1;		/* must be reset by the worker */
+	struct	list_head tx_maps;
+	struct	list_head rx_maps;
+	struct	socket *ssock;		/* active subflows only */
+	struct	sock *tcp_sock;		/* tcp sk backpointer */
+	struct	sock *conn;		/* parent mptcp_sock */
+	const	struct inet_connection_sock_af_ops *icsk_af_ops;
+	void	(*tcp_data_ready)(struct sock *sk);
+	void	(*tcp_state_change)(struct sock *sk);
+	void	(*tcp_write_space)(struct sock *sk);
+};
+
+static inline struct mptcp_subflow_context *
+mptcp_subflow_ctx(const struct sock *sk)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+
+	return (struct mptcp_subflow_context *)icsk->icsk_ulp_data;
+}
+
+static inline struct sock *
+mptcp_subflow_tcp_sock(const struct mptcp_subflow_context *subflow)
+{
+	return subflow->tcp_sock;
+}
+
+static inline bool mptcp_subflow_usable(const struct mptcp_subflow_context *subflow)
+{
+	return !subflow->reset &&
+	       (subflow->fully_established ||
+		!tcp_sk(mptcp_subflow_tcp_sock(subflow))->is_mptcp);
+}
+
+/* subflow.c */
+void mptcp_subflow_init(void);
+int mptcp_subflow_create_socket(struct sock *sk, struct socket **new_sock);
+int mptcp_subflow_connect(struct sock *sk, const struct sockaddr *local,
+			  int ifindex, u8 local_id);
+void mptcp_subflow_fully_established(struct sock *ssk);
+void mptcp_subflow_map_rx(struct sock *ssk, u64 dsn, u32 ssn, u32 len);
+bool mptcp_subflow_map_rx_lookup(struct sock *ssk, u32 seq, u64 *dsn, u32 *len);
+bool mptcp_subflow_map_tx(struct sock *ssk, u32 seq, u32 len,
+			  u64 *dsn, u16 *data_len);
+void mptcp_subflow_prune_maps(struct list_head *maps, u32 seq);
+void mptcp_subflow_free_maps(struct list_head *maps);
+
+/* protocol.c */
+extern struct proto mptcp_prot;
+
+void mptcp_data_ready(struct sock *sk, struct sock *ssk);
+void mptcp_data_fin(struct sock *sk, u64 data_fin_seq);
+void mptcp_subflow_state_change(struct sock *sk, struct sock *ssk);
+void mptcp_subflow_write_space(struct sock *sk);
+struct sock *mptcp_sk_clone(const struct sock *sk, struct request_sock *req,
+			    u64 remote_key);
+void mptcp_sk_dispose(struct sock *sk);
+bool mptcp_finish_join(struct sock *sk, struct sock *ssk);
+void mptcp_finish_connect(struct sock *ssk);
+void mptcp_schedule_work(struct sock *sk, int bit);
+void mptcp_copy_inaddrs(struct sock *msk, const struct sock *ssk);
+
+/* options.c */
+void mptcp_get_options(const struct sk_buff *skb,
+		       struct mptcp_options_received *mp_opt);
+
+/* token.c */
+int mptcp_token_new_request(struct request_sock *req);
+int mptcp_token_new_connect(struct sock *sk);
+void mptcp_token_new_accept(u32 token, struct sock *conn);
+struct mptcp_sock *mptcp_token_get_sock(u32 token);
+void mptcp_token_destroy(struct mptcp_sock *msk);
+
+/* crypto.c */
+int mptcp_crypto_init(void);
+void mptcp_crypto_key_sha(u64 key, u32 *token, u64 *idsn);
+int mptcp_crypto_hmac_sha(u64 key1, u64 key2, u32 nonce1, u32 nonce2,
+			  u8 *hmac);
+
+/* ctrl.c */
+int mptcp_is_enabled(struct net *net);
+int mptcp_max_subflows(struct net *net);
+void mptcp_ctrl_init(void);
+
+/* pm.c */
+void mptcp_pm_fully_established(struct mptcp_sock *msk);
+void mptcp_pm_create_subflows(struct mptcp_sock *msk);
+bool mptcp_pm_allow_new_subflow(struct mptcp_sock *msk);
+
+static inline bool before64(__u64 seq1, __u64 seq2)
+{
+	return (__s64)(seq1 - seq2) < 0;
+}
+
+#define after64(seq2, seq1)	before64(seq1, seq2)
+
+/* Rebuild a 64 bit sequence number from the low 32 bits carried on the
+ * wire, picking the value closest to the given reference.
+ */
+static inline u64 mptcp_expand_seq(u64 ref, u32 seq)
+{
+	u64 cand = (ref & GENMASK_ULL(63, 32)) | seq;
+
+	if ((s32)(seq - (u32)ref) < 0 && cand > ref)
+		cand -= 1ULL << 32;
+	else if ((s32)(seq - (u32)ref) >= 0 && cand < ref)
+		cand += 1ULL << 32;
+	return cand;
+}
+
+#endif /* __MPTCP_PROTOCOL_H */
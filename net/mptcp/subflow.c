@@ -0,0 +1,866 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Multipath TCP
+ *
+ * Subflows are regular, in-kernel TCP sockets carrying the "mptcp" ULP.
+ * The ULP context links the subflow to its MPTCP socket, hooks the
+ * socket callbacks and tracks the data sequence mappings. Listening
+ * subflows use request socks and af_ops of their own, to run the
+ * MP_CAPABLE and MP_JOIN handshakes.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/netdevice.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <crypto/algapi.h>
+#include <crypto/sha.h>
+#include <asm/unaligned.h>
+#include <net/sock.h>
+#include <net/inet_common.h>
+#include <net/inet_hashtables.h>
+#include <net/protocol.h>
+#include <net/tcp.h>
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+#include <net/ip6_route.h>
+#include <net/transp_v6.h>
+#endif
+#include <net/mptcp.h>
+#include "protocol.h"
+
+static struct request_sock_ops subflow_request_sock_ops __ro_after_init;
+static struct tcp_request_sock_ops subflow_request_sock_ipv4_ops __ro_after_init;
+static struct inet_connection_sock_af_ops subflow_specific __ro_after_init;
+
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+static struct request_sock_ops subflow6_request_sock_ops __ro_after_init;
+static struct tcp_request_sock_ops subflow_request_sock_ipv6_ops __ro_after_init;
+static struct inet_connection_sock_af_ops subflow_v6_specific __ro_after_init;
+#endif
+
+static void subflow_req_destructor(struct request_sock *req)
+{
+	struct mptcp_subflow_request_sock *subflow_req = mptcp_subflow_rsk(req);
+
+	if (subflow_req->msk)
+		sock_put((struct sock *)subflow_req->msk);
+
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+	if (req->rsk_ops->family == AF_INET6) {
+		tcp6_request_sock_ops.destructor(req);
+		return;
+	}
+#endif
+	tcp_request_sock_ops.destructor(req);
+}
+
+/* The connection to join must be fully set up and owned by user space:
+ * see mptcp_pm_allow_new_subflow().
+ */
+static struct mptcp_sock *subflow_token_join_request(const struct sock *sk_listener,
+						     u32 token)
+{
+	struct mptcp_sock *msk;
+
+	msk = mptcp_token_get_sock(token);
+	if (!msk)
+		return NULL;
+
+	if (!net_eq(sock_net((struct sock *)msk), sock_net(sk_listener)) ||
+	    !mptcp_pm_allow_new_subflow(msk)) {
+		sock_put((struct sock *)msk);
+		return NULL;
+	}
+	return msk;
+}
+
+static void subflow_init_req(struct request_sock *req,
+			     const struct sock *sk_listener,
+			     struct sk_buff *skb)
+{
+	struct mptcp_subflow_context *listener = mptcp_subflow_ctx(sk_listener);
+	struct mptcp_subflow_request_sock *subflow_req = mptcp_subflow_rsk(req);
+	struct mptcp_options_received mp_opt;
+	u8 hmac[SHA256_DIGEST_SIZE];
+	struct mptcp_sock *msk;
+
+	subflow_req->mp_capable = 0;
+	subflow_req->mp_join = 0;
+	subflow_req->backup = 0;
+	subflow_req->msk = NULL;
+
+	if (!listener->conn || !mptcp_is_enabled(sock_net(sk_listener)))
+		return;
+
+	mptcp_get_options(skb, &mp_opt);
+
+	if (mp_opt.suboptions & OPTION_MPTCP_MPC_SYN) {
+		if (mptcp_token_new_request(req))
+			return;
+		subflow_req->mp_capable = 1;
+	} else if (mp_opt.suboptions & OPTION_MPTCP_MPJ_SYN) {
+		msk = subflow_token_join_request(sk_listener, mp_opt.token);
+		if (!msk)
+			return;
+
+		subflow_req->msk = msk;
+		subflow_req->remote_id = mp_opt.join_id;
+		subflow_req->remote_nonce = mp_opt.nonce;
+		subflow_req->backup = mp_opt.backup;
+		subflow_req->local_id = 0;
+		subflow_req->local_nonce = get_random_u32();
+
+		if (mptcp_crypto_hmac_sha(msk->local_key, msk->remote_key,
+					  subflow_req->local_nonce,
+					  subflow_req->remote_nonce, hmac))
+			return;
+
+		subflow_req->thmac = get_unaligned_be64(hmac);
+		subflow_req->mp_join = 1;
+	}
+}
+
+static void subflow_v4_init_req(struct request_sock *req,
+				const struct sock *sk_listener,
+				struct sk_buff *skb)
+{
+	tcp_rsk(req)->is_mptcp = 1;
+
+	tcp_request_sock_ipv4_ops.init_req(req, sk_listener, skb);
+
+	subflow_init_req(req, sk_listener, skb);
+}
+
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+static void subflow_v6_init_req(struct request_sock *req,
+				const struct sock *sk_listener,
+				struct sk_buff *skb)
+{
+	tcp_rsk(req)->is_mptcp = 1;
+
+	tcp_request_sock_ipv6_ops.init_req(req, sk_listener, skb);
+
+	subflow_init_req(req, sk_listener, skb);
+}
+#endif
+
+/* validate the HMAC-A carried by the third ACK of a MP_JOIN handshake */
+static bool subflow_hmac_valid(const struct request_sock *req,
+			       const struct mptcp_options_received *mp_opt)
+{
+	const struct mptcp_subflow_request_sock *subflow_req;
+	u8 hmac[SHA256_DIGEST_SIZE];
+	struct mptcp_sock *msk;
+
+	subflow_req = mptcp_subflow_rsk(req);
+	msk = subflow_req->msk;
+	if (!msk)
+		return false;
+
+	if (mptcp_crypto_hmac_sha(msk->remote_key, msk->local_key,
+				  subflow_req->remote_nonce,
+				  subflow_req->local_nonce, hmac))
+		return false;
+
+	return !crypto_memneq(hmac, mp_opt->hmac, MPTCPOPT_HMAC_LEN);
+}
+
+/* validate the truncated HMAC-B carried by a MP_JOIN SYN/ACK */
+static bool subflow_thmac_valid(struct mptcp_subflow_context *subflow)
+{
+	u8 hmac[SHA256_DIGEST_SIZE];
+
+	if (mptcp_crypto_hmac_sha(subflow->remote_key, subflow->local_key,
+				  subflow->remote_nonce, subflow->local_nonce,
+				  hmac))
+		return false;
+
+	return get_unaligned_be64(hmac) == subflow->thmac;
+}
+
+void mptcp_rcv_synsent(struct sock *sk, struct sk_buff *skb)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(sk);
+	struct mptcp_options_received mp_opt;
+	u8 hmac[SHA256_DIGEST_SIZE];
+	struct sock *parent;
+
+	parent = subflow->conn;
+	if (!parent) {
+		tcp_sk(sk)->is_mptcp = 0;
+		return;
+	}
+
+	subflow->rcv_isn = TCP_SKB_CB(skb)->seq;
+	mptcp_get_options(skb, &mp_opt);
+
+	if (subflow->request_mptcp) {
+		if (!(mp_opt.suboptions & OPTION_MPTCP_MPC_SYNACK)) {
+			tcp_sk(sk)->is_mptcp = 0;
+			set_bit(MPTCP_FALLBACK, &mptcp_sk(parent)->flags);
+			return;
+		}
+
+		subflow->mp_capable = 1;
+		subflow->remote_key = mp_opt.sndr_key;
+		mptcp_finish_connect(sk);
+	} else if (subflow->request_join) {
+		if (!(mp_opt.suboptions & OPTION_MPTCP_MPJ_SYNACK))
+			goto do_reset;
+
+		subflow->remote_id = mp_opt.join_id;
+		subflow->remote_nonce = mp_opt.nonce;
+		subflow->thmac = mp_opt.thmac;
+		if (!subflow_thmac_valid(subflow))
+			goto do_reset;
+
+		if (mptcp_crypto_hmac_sha(subflow->local_key,
+					  subflow->remote_key,
+					  subflow->local_nonce,
+					  subflow->remote_nonce, hmac))
+			goto do_reset;
+
+		memcpy(subflow->hmac, hmac, MPTCPOPT_HMAC_LEN);
+		subflow->mp_join = 1;
+	}
+	return;
+
+do_reset:
+	/* A subflow can't fall back to plain TCP: leave it to the worker,
+	 * the socket lock is held here.
+	 */
+	tcp_sk(sk)->is_mptcp = 0;
+	subflow->reset = 1;
+	mptcp_schedule_work(parent, MPTCP_WORK_SUBFLOWS);
+}
+
+static int subflow_v4_conn_request(struct sock *sk, struct sk_buff *skb)
+{
+	/* Never answer to SYNs sent to broadcast or multicast */
+	if (skb_rtable(skb)->rt_flags & (RTCF_BROADCAST | RTCF_MULTICAST))
+		goto drop;
+
+	return tcp_conn_request(&subflow_request_sock_ops,
+				&subflow_request_sock_ipv4_ops,
+				sk, skb);
+drop:
+	tcp_listendrop(sk);
+	return 0;
+}
+
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+static int subflow_v6_conn_request(struct sock *sk, struct sk_buff *skb)
+{
+	if (skb->protocol == htons(ETH_P_IP))
+		return subflow_v4_conn_request(sk, skb);
+
+	if (!ipv6_unicast_destination(skb))
+		goto drop;
+
+	return tcp_conn_request(&subflow6_request_sock_ops,
+				&subflow_request_sock_ipv6_ops, sk, skb);
+
+drop:
+	tcp_listendrop(sk);
+	return 0; /* don't send reset */
+}
+#endif
+
+static struct sock *subflow_syn_recv_sock(const struct sock *sk,
+					  struct sk_buff *skb,
+					  struct request_sock *req,
+					  struct dst_entry *dst,
+					  struct request_sock *req_unhash,
+					  bool *own_req)
+{
+	struct mptcp_subflow_context *listener = mptcp_subflow_ctx(sk);
+	struct mptcp_subflow_request_sock *subflow_req = NULL;
+	struct mptcp_options_received mp_opt;
+	struct mptcp_subflow_context *ctx;
+	struct sock *new_msk = NULL;
+	bool fallback_is_fatal = false;
+	struct sock *child;
+
+	/* requests built from a syncookie are plain tcp request socks */
+	if (tcp_rsk(req)->is_mptcp) {
+		subflow_req = mptcp_subflow_rsk(req);
+		mptcp_get_options(skb, &mp_opt);
+
+		if (subflow_req->mp_capable) {
+			/* the peer must echo our key, or fall back to TCP */
+			if (!(mp_opt.suboptions & OPTION_MPTCP_MPC_ACK) ||
+			    mp_opt.rcvr_key != subflow_req->local_key)
+				subflow_req->mp_capable = 0;
+			else
+				new_msk = mptcp_sk_clone(listener->conn, req,
+							 mp_opt.sndr_key);
+			if (!new_msk)
+				subflow_req->mp_capable = 0;
+		} else if (subflow_req->mp_join) {
+			fallback_is_fatal = true;
+			if (!(mp_opt.suboptions & OPTION_MPTCP_MPJ_ACK) ||
+			    !subflow_hmac_valid(req, &mp_opt))
+				subflow_req->mp_join = 0;
+		}
+	}
+
+	child = listener->icsk_af_ops->syn_recv_sock(sk, skb, req, dst,
+						     req_unhash, own_req);
+
+	if (child && *own_req) {
+		ctx = mptcp_subflow_ctx(child);
+
+		if (fallback_is_fatal && (!ctx || !subflow_req->mp_join))
+			goto dispose_child;
+
+		if (new_msk && ctx) {
+			struct mptcp_sock *msk = mptcp_sk(new_msk);
+
+			ctx->conn = new_msk;
+			ctx->remote_key = msk->remote_key;
+			mptcp_token_new_accept(subflow_req->token, new_msk);
+			mptcp_copy_inaddrs(new_msk, child);
+
+			msk->first = child;
+			list_add(&ctx->node, &msk->conn_list);
+			msk->subflows = 1;
+			new_msk = NULL;
+		} else if (ctx && subflow_req && subflow_req->mp_join) {
+			/* the reference to the msk moves to the subflow */
+			ctx->conn = (struct sock *)subflow_req->msk;
+			subflow_req->msk = NULL;
+
+			if (!mptcp_finish_join(ctx->conn, child))
+				goto dispose_child;
+
+			/* joined subflows are not queued for accept() */
+			tcp_rsk(req)->drop_req = true;
+		}
+	}
+
+	/* the clone failed, or another CPU won the race for the request */
+	if (new_msk)
+		mptcp_sk_dispose(new_msk);
+
+	return child;
+
+dispose_child:
+	if (new_msk)
+		mptcp_sk_dispose(new_msk);
+
+	tcp_rsk(req)->drop_req = true;
+	sock_set_flag(child, SOCK_DEAD);
+	percpu_counter_inc(sk->sk_prot->orphan_count);
+	tcp_done(child);
+	req->rsk_ops->send_reset(sk, skb);
+
+	/* The last child reference will be released by the caller */
+	return child;
+}
+
+static void subflow_data_ready(struct sock *sk)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(sk);
+	struct sock *parent = subflow->conn;
+
+	if (sk->sk_state == TCP_LISTEN || !parent) {
+		subflow->tcp_data_ready(sk);
+		return;
+	}
+
+	mptcp_data_ready(parent, sk);
+}
+
+static void subflow_write_space(struct sock *sk)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(sk);
+
+	if (!subflow->conn) {
+		subflow->tcp_write_space(sk);
+		return;
+	}
+
+	mptcp_subflow_write_space(sk);
+}
+
+static void subflow_state_change(struct sock *sk)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(sk);
+	struct sock *parent = subflow->conn;
+
+	subflow->tcp_state_change(sk);
+
+	/* The passive side must answer the third ACK right away: the DSS
+	 * option tells the peer the handshake completed, and it will not
+	 * send data before.
+	 */
+	if (!subflow->ssock && sk->sk_state == TCP_ESTABLISHED &&
+	    sk_is_mptcp(sk))
+		inet_csk(sk)->icsk_ack.pending |= ICSK_ACK_SCHED | ICSK_ACK_NOW;
+
+	if (parent)
+		mptcp_subflow_state_change(parent, sk);
+}
+
+void mptcp_subflow_fully_established(struct sock *ssk)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(ssk);
+	struct mptcp_sock *msk = mptcp_sk(subflow->conn);
+
+	subflow->fully_established = 1;
+
+	/* additional subflows are created once the first one is usable */
+	if (subflow->mp_capable && subflow->ssock &&
+	    !test_bit(MPTCP_FALLBACK, &msk->flags))
+		mptcp_pm_fully_established(msk);
+
+	mptcp_subflow_write_space(ssk);
+}
+
+int mptcp_subflow_create_socket(struct sock *sk, struct socket **new_sock)
+{
+	struct mptcp_subflow_context *subflow;
+	struct net *net = sock_net(sk);
+	struct socket *sf;
+	int err;
+
+	err = sock_create_kern(net, sk->sk_family, SOCK_STREAM, IPPROTO_TCP,
+			       &sf);
+	if (err)
+		return err;
+
+	lock_sock(sf->sk);
+
+	/* kernel sockets do not acquire a netns reference by default, but
+	 * the subflow may outlive the MPTCP socket, e.g. in TIME_WAIT.
+	 */
+	sf->sk->sk_net_refcnt = 1;
+	get_net(net);
+#ifdef CONFIG_PROC_FS
+	this_cpu_add(*net->core.sock_inuse, 1);
+#endif
+	err = tcp_set_ulp(sf->sk, "mptcp");
+	release_sock(sf->sk);
+
+	if (err) {
+		sock_release(sf);
+		return err;
+	}
+
+	subflow = mptcp_subflow_ctx(sf->sk);
+	sock_hold(sk);
+	subflow->conn = sk;
+	subflow->ssock = sf;
+	*new_sock = sf;
+
+	return 0;
+}
+
+static int subflow_peer_addr(const struct sock *sk,
+			     struct sockaddr_storage *addr)
+{
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+	if (sk->sk_family == AF_INET6) {
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)addr;
+
+		memset(sin6, 0, sizeof(*sin6));
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_port = inet_sk(sk)->inet_dport;
+		sin6->sin6_addr = sk->sk_v6_daddr;
+		return sizeof(*sin6);
+	}
+#endif
+	{
+		struct sockaddr_in *sin = (struct sockaddr_in *)addr;
+
+		memset(sin, 0, sizeof(*sin));
+		sin->sin_family = AF_INET;
+		sin->sin_port = inet_sk(sk)->inet_dport;
+		sin->sin_addr.s_addr = inet_sk(sk)->inet_daddr;
+		return sizeof(*sin);
+	}
+}
+
+/**
+ * mptcp_subflow_connect - open an additional subflow with MP_JOIN
+ * @sk: the MPTCP socket, owned by the caller
+ * @local: local address to bind the subflow to, in the family of @sk
+ * @ifindex: device to bind the subflow to, or 0
+ * @local_id: address id announced in the MP_JOIN SYN
+ *
+ * The connection is started without waiting for completion; failed
+ * subflows are reaped by the MPTCP worker.
+ */
+int mptcp_subflow_connect(struct sock *sk, const struct sockaddr *local,
+			  int ifindex, u8 local_id)
+{
+	struct mptcp_sock *msk = mptcp_sk(sk);
+	struct mptcp_subflow_context *subflow;
+	struct sockaddr_storage addr;
+	struct socket *sf;
+	int addrlen;
+	int err;
+
+	if (sk->sk_state != TCP_ESTABLISHED)
+		return -ENOTCONN;
+
+	err = mptcp_subflow_create_socket(sk, &sf);
+	if (err)
+		return err;
+
+	subflow = mptcp_subflow_ctx(sf->sk);
+	subflow->local_key = msk->local_key;
+	subflow->token = msk->token;
+	subflow->remote_key = msk->remote_key;
+	subflow->remote_token = msk->remote_token;
+	subflow->local_id = local_id;
+	subflow->local_nonce = get_random_u32();
+	subflow->request_join = 1;
+
+	sf->sk->sk_bound_dev_if = ifindex;
+	addrlen = local->sa_family == AF_INET6 ? sizeof(struct sockaddr_in6) :
+						 sizeof(struct sockaddr_in);
+	err = kernel_bind(sf, (struct sockaddr *)local, addrlen);
+	if (err)
+		goto failed;
+
+	spin_lock_bh(&msk->join_list_lock);
+	list_add_tail(&subflow->node, &msk->conn_list);
+	msk->subflows++;
+	spin_unlock_bh(&msk->join_list_lock);
+
+	addrlen = subflow_peer_addr(sk, &addr);
+	err = kernel_connect(sf, (struct sockaddr *)&addr, addrlen, O_NONBLOCK);
+	if (err && err != -EINPROGRESS) {
+		spin_lock_bh(&msk->join_list_lock);
+		list_del_init(&subflow->node);
+		msk->subflows--;
+		spin_unlock_bh(&msk->join_list_lock);
+		goto failed;
+	}
+
+	return 0;
+
+failed:
+	sock_release(sf);
+	return err;
+}
+
+/* Data sequence mappings.
+ *
+ * The sender records, for each chunk of the MPTCP stream it queues on a
+ * subflow, where in the subflow sequence space it landed. The DSS option
+ * of every (re)transmitted segment is built from these records, so an
+ * skb always maps the data from its own sequence number onwards.
+ *
+ * The receiver records the mappings announced by the peer, ordered by
+ * subflow sequence number, and looks up the data sequence number of the
+ * bytes it reads from the subflow. Both lists are pruned as data is
+ * acknowledged or consumed.
+ */
+void mptcp_subflow_map_rx(struct sock *ssk, u64 dsn, u32 ssn, u32 len)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(ssk);
+	struct mptcp_map *map, *prev = NULL;
+
+	/* nothing to do for data that was already consumed */
+	if (!after(ssn + len, tcp_sk(ssk)->copied_seq))
+		return;
+
+	list_for_each_entry_reverse(map, &subflow->rx_maps, list) {
+		if (!after(map->ssn, ssn)) {
+			prev = map;
+			break;
+		}
+	}
+
+	/* most segments repeat or extend the latest mapping */
+	if (prev && !after(ssn, prev->ssn + prev->len) &&
+	    prev->dsn + (ssn - prev->ssn) == dsn) {
+		if (after(ssn + len, prev->ssn + prev->len))
+			prev->len = ssn + len - prev->ssn;
+		return;
+	}
+
+	map = kmalloc(sizeof(*map), GFP_ATOMIC);
+	if (!map)
+		return;
+
+	map->dsn = dsn;
+	map->ssn = ssn;
+	map->len = len;
+	list_add(&map->list, prev ? &prev->list : &subflow->rx_maps);
+}
+
+bool mptcp_subflow_map_rx_lookup(struct sock *ssk, u32 seq, u64 *dsn,
+				 u32 *len)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(ssk);
+	struct mptcp_map *map;
+
+	list_for_each_entry_reverse(map, &subflow->rx_maps, list) {
+		if (after(map->ssn, seq))
+			continue;
+		if (!before(seq, map->ssn + map->len))
+			return false;
+
+		*dsn = map->dsn + (seq - map->ssn);
+		*len = map->ssn + map->len - seq;
+		return true;
+	}
+	return false;
+}
+
+bool mptcp_subflow_map_tx(struct sock *ssk, u32 seq, u32 len,
+			  u64 *dsn, u16 *data_len)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(ssk);
+	struct mptcp_map *map;
+
+	list_for_each_entry_reverse(map, &subflow->tx_maps, list) {
+		if (after(map->ssn, seq))
+			continue;
+		if (!before(seq, map->ssn + map->len))
+			return false;
+
+		*dsn = map->dsn + (seq - map->ssn);
+		*data_len = min_t(u32, map->ssn + map->len - seq, U16_MAX);
+		return true;
+	}
+	return false;
+}
+
+/* release the mappings covering only data before @seq */
+void mptcp_subflow_prune_maps(struct list_head *maps, u32 seq)
+{
+	struct mptcp_map *map, *tmp;
+
+	list_for_each_entry_safe(map, tmp, maps, list) {
+		if (after(map->ssn + map->len, seq))
+			break;
+		list_del(&map->list);
+		kfree(map);
+	}
+}
+
+void mptcp_subflow_free_maps(struct list_head *maps)
+{
+	struct mptcp_map *map, *tmp;
+
+	list_for_each_entry_safe(map, tmp, maps, list) {
+		list_del(&map->list);
+		kfree(map);
+	}
+}
+
+static struct mptcp_subflow_context *subflow_create_ctx(struct sock *sk,
+							const gfp_t priority)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	struct mptcp_subflow_context *ctx;
+
+	ctx = kzalloc(sizeof(*ctx), priority);
+	if (!ctx)
+		return NULL;
+
+	icsk->icsk_ulp_data = ctx;
+	INIT_LIST_HEAD(&ctx->node);
+	INIT_LIST_HEAD(&ctx->tx_maps);
+	INIT_LIST_HEAD(&ctx->rx_maps);
+	ctx->tcp_sock = sk;
+
+	return ctx;
+}
+
+static int subflow_ulp_init(struct sock *sk)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	struct mptcp_subflow_context *ctx;
+
+	/* disallow attaching ULP to a socket unless it has been
+	 * created with sock_create_kern()
+	 */
+	if (!sk->sk_kern_sock)
+		return -EOPNOTSUPP;
+
+	ctx = subflow_create_ctx(sk, GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	tcp_sk(sk)->is_mptcp = 1;
+
+	ctx->icsk_af_ops = icsk->icsk_af_ops;
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+	if (sk->sk_family == AF_INET6)
+		icsk->icsk_af_ops = &subflow_v6_specific;
+	else
+#endif
+		icsk->icsk_af_ops = &subflow_specific;
+
+	ctx->tcp_data_ready = sk->sk_data_ready;
+	ctx->tcp_state_change = sk->sk_state_change;
+	ctx->tcp_write_space = sk->sk_write_space;
+	sk->sk_data_ready = subflow_data_ready;
+	sk->sk_write_space = subflow_write_space;
+	sk->sk_state_change = subflow_state_change;
+
+	return 0;
+}
+
+static void subflow_ulp_release(struct sock *sk)
+{
+	struct mptcp_subflow_context *ctx = mptcp_subflow_ctx(sk);
+	struct sock *parent;
+
+	if (!ctx)
+		return;
+
+	parent = ctx->conn;
+	if (parent) {
+		struct mptcp_sock *msk = mptcp_sk(parent);
+
+		spin_lock_bh(&msk->join_list_lock);
+		if (!list_empty(&ctx->node)) {
+			list_del_init(&ctx->node);
+			msk->subflows--;
+		}
+		if (msk->first == sk)
+			msk->first = NULL;
+		spin_unlock_bh(&msk->join_list_lock);
+
+		/* A passive connection whose first subflow goes away before
+		 * accept(), e.g. because the listener is closed, has no other
+		 * owner: let the worker close it.
+		 */
+		if (!sock_flag(parent, SOCK_DEAD) && !parent->sk_socket &&
+		    parent->sk_state != TCP_CLOSE)
+			mptcp_schedule_work(parent, MPTCP_WORK_CLOSE);
+
+		sock_put(parent);
+	}
+
+	mptcp_subflow_free_maps(&ctx->tx_maps);
+	mptcp_subflow_free_maps(&ctx->rx_maps);
+	kfree(ctx);
+	inet_csk(sk)->icsk_ulp_data = NULL;
+}
+
+/* turn a clone of the listener back into a plain TCP socket */
+static void subflow_ulp_fallback(struct sock *sk,
+				 struct mptcp_subflow_context *old_ctx)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+
+	sk->sk_data_ready = old_ctx->tcp_data_ready;
+	sk->sk_state_change = old_ctx->tcp_state_change;
+	sk->sk_write_space = old_ctx->tcp_write_space;
+	icsk->icsk_af_ops = old_ctx->icsk_af_ops;
+
+	module_put(icsk->icsk_ulp_ops->owner);
+	icsk->icsk_ulp_ops = NULL;
+	icsk->icsk_ulp_data = NULL;
+	tcp_sk(sk)->is_mptcp = 0;
+}
+
+static void subflow_ulp_clone(const struct request_sock *req,
+			      struct sock *newsk,
+			      const gfp_t priority)
+{
+	struct mptcp_subflow_request_sock *subflow_req = mptcp_subflow_rsk(req);
+	struct mptcp_subflow_context *old_ctx = mptcp_subflow_ctx(newsk);
+	struct mptcp_subflow_context *new_ctx;
+
+	if (!tcp_rsk(req)->is_mptcp ||
+	    (!subflow_req->mp_capable && !subflow_req->mp_join)) {
+		subflow_ulp_fallback(newsk, old_ctx);
+		return;
+	}
+
+	new_ctx = subflow_create_ctx(newsk, priority);
+	if (!new_ctx) {
+		subflow_ulp_fallback(newsk, old_ctx);
+		return;
+	}
+
+	/* the af_ops override is only needed by listeners */
+	inet_csk(newsk)->icsk_af_ops = old_ctx->icsk_af_ops;
+	new_ctx->icsk_af_ops = old_ctx->icsk_af_ops;
+	new_ctx->tcp_data_ready = old_ctx->tcp_data_ready;
+	new_ctx->tcp_state_change = old_ctx->tcp_state_change;
+	new_ctx->tcp_write_space = old_ctx->tcp_write_space;
+
+	new_ctx->snd_isn = tcp_rsk(req)->snt_isn;
+	new_ctx->rcv_isn = tcp_rsk(req)->rcv_isn;
+	new_ctx->fully_established = 1;
+
+	if (subflow_req->mp_capable) {
+		new_ctx->mp_capable = 1;
+		new_ctx->local_key = subflow_req->local_key;
+		new_ctx->token = subflow_req->token;
+		new_ctx->idsn = subflow_req->idsn;
+	} else {
+		new_ctx->mp_join = 1;
+		new_ctx->backup = subflow_req->backup;
+		new_ctx->local_id = subflow_req->local_id;
+		new_ctx->remote_id = subflow_req->remote_id;
+		new_ctx->local_nonce = subflow_req->local_nonce;
+		new_ctx->remote_nonce = subflow_req->remote_nonce;
+	}
+}
+
+static struct tcp_ulp_ops subflow_ulp_ops __read_mostly = {
+	.name		= "mptcp",
+	.owner		= THIS_MODULE,
+	.init		= subflow_ulp_init,
+	.release	= subflow_ulp_release,
+	.clone		= subflow_ulp_clone,
+};
+
+static int subflow_ops_init(struct request_sock_ops *subflow_ops)
+{
+	subflow_ops->obj_size = sizeof(struct mptcp_subflow_request_sock);
+
+	subflow_ops->slab = kmem_cache_create(subflow_ops->slab_name,
+					      subflow_ops->obj_size, 0,
+					      SLAB_ACCOUNT |
+					      SLAB_TYPESAFE_BY_RCU,
+					      NULL);
+	if (!subflow_ops->slab)
+		return -ENOMEM;
+
+	subflow_ops->destructor = subflow_req_destructor;
+
+	return 0;
+}
+
+void __init mptcp_subflow_init(void)
+{
+	subflow_request_sock_ops = tcp_request_sock_ops;
+	subflow_request_sock_ops.slab_name = "request_sock_subflow_v4";
+	if (subflow_ops_init(&subflow_request_sock_ops) != 0)
+		panic("MPTCP: failed to init subflow request sock ops\n");
+
+	subflow_request_sock_ipv4_ops = tcp_request_sock_ipv4_ops;
+	subflow_request_sock_ipv4_ops.init_req = subflow_v4_init_req;
+
+	subflow_specific = ipv4_specific;
+	subflow_specific.conn_request = subflow_v4_conn_request;
+	subflow_specific.syn_recv_sock = subflow_syn_recv_sock;
+
+#if IS_ENABLED(CONFIG_MPTCP_IPV6)
+	subflow6_request_sock_ops = tcp6_request_sock_ops;
+	subflow6_request_sock_ops.slab_name = "request_sock_subflow_v6";
+	if (subflow_ops_init(&subflow6_request_sock_ops) != 0)
+		panic("MPTCP: failed to init subflow v6 request sock ops\n");
+
+	subflow_request_sock_ipv6_ops = tcp_request_sock_ipv6_ops;
+	subflow_request_sock_ipv6_ops.init_req = subflow_v6_init_req;
+
+	subflow_v6_specific = ipv6_specific;
+	subflow_v6_specific.conn_request = subflow_v6_conn_request;
+	subflow_v6_specific.syn_recv_sock = subflow_syn_recv_sock;
+#endif
+
+	if (tcp_register_ulp(&subflow_ulp_ops) != 0)
+		panic("MPTCP: failed to register subflows to ULP\n");
+}
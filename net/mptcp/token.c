@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Multipath TCP token management
+ *
+ * Every MPTCP connection is identified locally by a 32-bit token,
+ * derived from the local key. MP_JOIN SYNs carry the token of the
+ * connection they want to join, so established connections are kept on
+ * a hash table keyed by token.
+ *
+ * Passive connections get a key when the MP_CAPABLE SYN is received,
+ * but are hashed only when the request socket is turned into a full
+ * socket. Keys are regenerated until the token is unique among the
+ * hashed connections; a request racing with another one for the same
+ * token is caught when the second one is hashed.
+ */
+
+#include <linux/kernel.h>
+#include <linux/hashtable.h>
+#include <linux/random.h>
+#include <linux/spinlock.h>
+#include <net/sock.h>
+
+#include "protocol.h"
+
+#define MPTCP_TOKEN_HASH_BITS	12
+
+static DEFINE_HASHTABLE(mptcp_token_hash, MPTCP_TOKEN_HASH_BITS);
+static DEFINE_SPINLOCK(mptcp_token_lock);
+
+static struct mptcp_sock *__token_lookup(u32 token)
+{
+	struct mptcp_sock *msk;
+
+	hash_for_each_possible(mptcp_token_hash, msk, token_node, token)
+		if (msk->token == token)
+			return msk;
+	return NULL;
+}
+
+static bool token_in_use(u32 token)
+{
+	bool ret;
+
+	spin_lock_bh(&mptcp_token_lock);
+	ret = !!__token_lookup(token);
+	spin_unlock_bh(&mptcp_token_lock);
+	return ret;
+}
+
+static void token_new_key(u64 *key, u32 *token, u64 *idsn)
+{
+	do {
+		*key = get_random_u64();
+		mptcp_crypto_key_sha(*key, token, idsn);
+	} while (token_in_use(*token));
+}
+
+/**
+ * mptcp_token_new_request - create a key and token for a passive connection
+ * @req: the request socket of the MP_CAPABLE SYN
+ *
+ * The token is not hashed: see mptcp_token_new_accept().
+ */
+int mptcp_token_new_request(struct request_sock *req)
+{
+	struct mptcp_subflow_request_sock *subflow_req = mptcp_subflow_rsk(req);
+
+	token_new_key(&subflow_req->local_key, &subflow_req->token,
+		      &subflow_req->idsn);
+	return 0;
+}
+
+/**
+ * mptcp_token_new_connect - create and hash a token for an active connection
+ * @sk: the first subflow of the connection
+ */
+int mptcp_token_new_connect(struct sock *sk)
+{
+	struct mptcp_subflow_context *subflow = mptcp_subflow_ctx(sk);
+	struct mptcp_sock *msk = mptcp_sk(subflow->conn);
+
+	spin_lock_bh(&mptcp_token_lock);
+	do {
+		subflow->local_key = get_random_u64();
+		mptcp_crypto_key_sha(subflow->local_key, &subflow->token,
+				     &subflow->idsn);
+	} while (__token_lookup(subflow->token));
+
+	msk->local_key = subflow->local_key;
+	msk->token = subflow->token;
+	msk->write_seq = subflow->idsn + 1;
+	atomic64_set(&msk->snd_una, msk->write_seq);
+	hash_add(mptcp_token_hash, &msk->token_node, msk->token);
+	spin_unlock_bh(&mptcp_token_lock);
+
+	return 0;
+}
+
+/**
+ * mptcp_token_new_accept - hash the token of a passive connection
+ * @token: token created by mptcp_token_new_request()
+ * @conn: the new MPTCP socket
+ *
+ * If another connection got the same token in the meantime, the new one
+ * is not hashed and can't be joined by additional subflows.
+ */
+void mptcp_token_new_accept(u32 token, struct sock *conn)
+{
+	struct mptcp_sock *msk = mptcp_sk(conn);
+
+	spin_lock_bh(&mptcp_token_lock);
+	if (!__token_lookup(token))
+		hash_add(mptcp_token_hash, &msk->token_node, token);
+	spin_unlock_bh(&mptcp_token_lock);
+}
+
+/**
+ * mptcp_token_get_sock - find the connection owning a token
+ * @token: token carried by a MP_JOIN SYN
+ *
+ * Returns the MPTCP socket with a reference held, or NULL.
+ */
+struct mptcp_sock *mptcp_token_get_sock(u32 token)
+{
+	struct mptcp_sock *msk;
+
+	spin_lock_bh(&mptcp_token_lock);
+	msk = __token_lookup(token);
+	if (msk)
+		sock_hold((struct sock *)msk);
+	spin_unlock_bh(&mptcp_token_lock);
+
+	return msk;
+}
+
+/**
+ * mptcp_token_destroy - remove a connection from the token hash
+ * @msk: the MPTCP socket being closed
+ */
+void mptcp_token_destroy(struct mptcp_sock *msk)
+{
+	spin_lock_bh(&mptcp_token_lock);
+	if (hash_hashed(&msk->token_node))
+		hash_del(&msk->token_node);
+	spin_unlock_bh(&mptcp_token_lock);
+}
@@ -2212,7 +2212,9 @@ ctnetlink_ct_stat_cpu_fill_info(struct sk_buff *skb, u32 portid, u32 seq,
 	    nla_put_be32(skb, CTA_STATS_EARLY_DROP, htonl(st->early_drop)) ||
 	    nla_put_be32(skb, CTA_STATS_ERROR, htonl(st->error)) ||
 	    nla_put_be32(skb, CTA_STATS_SEARCH_RESTART,
-				htonl(st->search_restart)))
+				htonl(st->search_restart)) ||
+	    nla_put_be32(skb, CTA_STATS_GC_SCANNED, htonl(st->gc_scanned)) ||
+	    nla_put_be32(skb, CTA_STATS_GC_EXPIRED, htonl(st->gc_expired)))
 		goto nla_put_failure;
 
 	nlmsg_end(skb, nlh);
@@ -11,6 +11,7 @@
 #include <net/netfilter/nf_conntrack.h>
 #include <net/netfilter/nf_conntrack_core.h>
 #include <net/netfilter/nf_conntrack_tuple.h>
+#include <net/netfilter/nf_conntrack_acct.h>
 
 struct flow_offload_entry {
 	struct flow_offload	flow;
@@ -54,6 +55,26 @@ flow_offload_fill_dir(struct flow_offload *flow, struct nf_conn *ct,
 	ft->iifidx = other_dst->dev->ifindex;
 	ft->oifidx = dst->dev->ifindex;
 	ft->dst_cache = dst;
+
+	/* Packets arrive on the lower device, behind vlan/pppoe headers. */
+	if (route->tuple[dir].in.ifindex) {
+		int i;
+
+		ft->iifidx = route->tuple[dir].in.ifindex;
+		for (i = 0; i < route->tuple[dir].in.num_encaps; i++) {
+			ft->encap[i].id = route->tuple[dir].in.encap[i].id;
+			ft->encap[i].proto = route->tuple[dir].in.encap[i].proto;
+		}
+		ft->encap_num = route->tuple[dir].in.num_encaps;
+	}
+
+	ft->xmit_type = route->tuple[dir].xmit_type;
+	if (ft->xmit_type == FLOW_OFFLOAD_XMIT_DIRECT) {
+		ft->out.ifidx = route->tuple[dir].out.ifindex;
+		memcpy(ft->out.h_source, route->tuple[dir].out.h_source,
+		       ETH_ALEN);
+		memcpy(ft->out.h_dest, route->tuple[dir].out.h_dest, ETH_ALEN);
+	}
 }
 
 struct flow_offload *
@@ -87,6 +108,8 @@ flow_offload_alloc(struct nf_conn *ct, struct nf_flow_route *route)
 		flow->flags |= FLOW_OFFLOAD_SNAT;
 	if (ct->status & IPS_DST_NAT)
 		flow->flags |= FLOW_OFFLOAD_DNAT;
+	if (nf_conn_acct_find(ct))
+		flow->flags |= FLOW_OFFLOAD_ACCT;
 
 	return flow;
 
@@ -197,6 +220,32 @@ int flow_offload_add(struct nf_flowtable *flow_table, struct flow_offload *flow)
 }
 EXPORT_SYMBOL_GPL(flow_offload_add);
 
+static void flow_offload_acct_flush(struct flow_offload *flow)
+{
+	struct flow_offload_entry *e;
+	struct nf_conn_acct *acct;
+	u64 packets, bytes;
+	int dir;
+
+	if (!(flow->flags & FLOW_OFFLOAD_ACCT))
+		return;
+
+	e = container_of(flow, struct flow_offload_entry, flow);
+	acct = nf_conn_acct_find(e->ct);
+	if (!acct)
+		return;
+
+	for (dir = 0; dir < FLOW_OFFLOAD_DIR_MAX; dir++) {
+		packets = atomic64_xchg(&flow->counter[dir].packets, 0);
+		if (!packets)
+			continue;
+		bytes = atomic64_xchg(&flow->counter[dir].bytes, 0);
+
+		atomic64_add(packets, &acct->counter[dir].packets);
+		atomic64_add(bytes, &acct->counter[dir].bytes);
+	}
+}
+
 static void flow_offload_del(struct nf_flowtable *flow_table,
 			     struct flow_offload *flow)
 {
@@ -209,6 +258,8 @@ static void flow_offload_del(struct nf_flowtable *flow_table,
 			       &flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].node,
 			       nf_flow_offload_rhash_params);
 
+	flow_offload_acct_flush(flow);
+
 	e = container_of(flow, struct flow_offload_entry, flow);
 	clear_bit(IPS_OFFLOAD_BIT, &e->ct->status);
 
@@ -294,6 +345,8 @@ static void nf_flow_offload_gc_step(struct flow_offload *flow, void *data)
 	if (nf_flow_has_expired(flow) ||
 	    (flow->flags & (FLOW_OFFLOAD_DYING | FLOW_OFFLOAD_TEARDOWN)))
 		flow_offload_del(flow_table, flow);
+	else
+		flow_offload_acct_flush(flow);
 }
 
 static void nf_flow_offload_work_gc(struct work_struct *work)
@@ -456,7 +509,9 @@ static void nf_flow_table_do_cleanup(struct flow_offload *flow, void *data)
 	}
 	if (net_eq(nf_ct_net(e->ct), dev_net(dev)) &&
 	    (flow->tuplehash[0].tuple.iifidx == dev->ifindex ||
-	     flow->tuplehash[1].tuple.iifidx == dev->ifindex))
+	     flow->tuplehash[1].tuple.iifidx == dev->ifindex ||
+	     flow->tuplehash[0].tuple.oifidx == dev->ifindex ||
+	     flow->tuplehash[1].tuple.oifidx == dev->ifindex))
 		flow_offload_dead(flow);
 }
 
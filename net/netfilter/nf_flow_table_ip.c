@@ -6,6 +6,9 @@
 #include <linux/ip.h>
 #include <linux/ipv6.h>
 #include <linux/netdevice.h>
+#include <linux/if_ether.h>
+#include <linux/if_pppox.h>
+#include <linux/ppp_defs.h>
 #include <net/ip.h>
 #include <net/ipv6.h>
 #include <net/ip6_route.h>
@@ -160,17 +163,187 @@ static bool ip_has_options(unsigned int thoff)
 	return thoff != sizeof(struct iphdr);
 }
 
+static void nf_flow_tuple_encap(struct sk_buff *skb,
+				struct flow_offload_tuple *tuple)
+{
+	struct vlan_hdr *vhdr;
+	struct pppoe_hdr *phdr;
+	int i = 0;
+
+	if (skb_vlan_tag_present(skb)) {
+		tuple->encap[i].id = skb_vlan_tag_get_id(skb);
+		tuple->encap[i].proto = skb->vlan_proto;
+		i++;
+	}
+
+	/* The in-band header was pulled by nf_flow_skb_encap_protocol(). */
+	switch (skb->protocol) {
+	case htons(ETH_P_8021Q):
+		vhdr = (struct vlan_hdr *)skb->data;
+		tuple->encap[i].id = ntohs(vhdr->h_vlan_TCI) & VLAN_VID_MASK;
+		tuple->encap[i].proto = skb->protocol;
+		break;
+	case htons(ETH_P_PPP_SES):
+		phdr = (struct pppoe_hdr *)skb->data;
+		tuple->encap[i].id = ntohs(phdr->sid);
+		tuple->encap[i].proto = skb->protocol;
+		break;
+	}
+}
+
+static bool nf_flow_skb_encap_protocol(struct sk_buff *skb, __be16 proto,
+				       u32 *offset)
+{
+	if (skb->protocol == proto)
+		return true;
+
+	switch (skb->protocol) {
+	case htons(ETH_P_8021Q):
+		if (nf_flow_skb_proto(skb) != proto)
+			return false;
+		*offset += VLAN_HLEN;
+		return true;
+	case htons(ETH_P_PPP_SES):
+		if (nf_flow_pppoe_proto(skb) != proto)
+			return false;
+		*offset += PPPOE_SES_HLEN;
+		return true;
+	}
+
+	return false;
+}
+
+/* Strip the headers matched by nf_flow_skb_encap_protocol() and the
+ * hardware accelerated vlan tag, if any.
+ */
+static void nf_flow_encap_pop(struct sk_buff *skb,
+			      const struct flow_offload_tuple *tuple)
+{
+	struct vlan_hdr *vhdr;
+	int i;
+
+	for (i = 0; i < tuple->encap_num; i++) {
+		if (skb_vlan_tag_present(skb)) {
+			__vlan_hwaccel_clear_tag(skb);
+			continue;
+		}
+
+		switch (skb->protocol) {
+		case htons(ETH_P_8021Q):
+			vhdr = (struct vlan_hdr *)skb->data;
+			skb->protocol = vhdr->h_vlan_encapsulated_proto;
+			skb_pull_rcsum(skb, VLAN_HLEN);
+			skb_reset_network_header(skb);
+			break;
+		case htons(ETH_P_PPP_SES):
+			skb->protocol = nf_flow_pppoe_proto(skb);
+			skb_pull_rcsum(skb, PPPOE_SES_HLEN);
+			skb_reset_network_header(skb);
+			break;
+		}
+	}
+}
+
+static int nf_flow_pppoe_push(struct sk_buff *skb, u16 id)
+{
+	int data_len = skb->len + sizeof(__be16);
+	struct pppoe_hdr *ph;
+	__be16 proto;
+
+	switch (skb->protocol) {
+	case htons(ETH_P_IP):
+		proto = htons(PPP_IP);
+		break;
+	case htons(ETH_P_IPV6):
+		proto = htons(PPP_IPV6);
+		break;
+	default:
+		return -1;
+	}
+
+	if (skb_cow_head(skb, PPPOE_SES_HLEN))
+		return -1;
+
+	__skb_push(skb, PPPOE_SES_HLEN);
+	skb_reset_network_header(skb);
+
+	ph = (struct pppoe_hdr *)skb->data;
+	ph->ver	= 1;
+	ph->type = 1;
+	ph->code = 0;
+	ph->sid	= htons(id);
+	ph->length = htons(data_len);
+	*(__be16 *)(skb->data + sizeof(*ph)) = proto;
+
+	skb->protocol = htons(ETH_P_PPP_SES);
+
+	return 0;
+}
+
+/* Send skb straight to the lower device, adding the link layer header
+ * and the vlan/pppoe headers that the reply direction was received with.
+ */
+static unsigned int nf_flow_queue_xmit(struct sk_buff *skb,
+				       struct net_device *outdev,
+				       const struct flow_offload_tuple *tuple,
+				       const struct flow_offload_tuple *other)
+{
+	int i;
+
+	for (i = 0; i < other->encap_num; i++) {
+		if (other->encap[i].proto == htons(ETH_P_PPP_SES) &&
+		    nf_flow_pppoe_push(skb, other->encap[i].id) < 0)
+			return NF_DROP;
+	}
+
+	skb->dev = outdev;
+	if (dev_hard_header(skb, outdev, ntohs(skb->protocol),
+			    tuple->out.h_dest, tuple->out.h_source,
+			    skb->len) < 0)
+		return NF_DROP;
+
+	skb_reset_mac_header(skb);
+	skb->mac_len = ETH_HLEN;
+
+	/* Innermost tag first, skb_vlan_push() moves the accelerated tag
+	 * into the packet before setting the new one.
+	 */
+	for (i = other->encap_num - 1; i >= 0; i--) {
+		if (other->encap[i].proto == htons(ETH_P_PPP_SES))
+			continue;
+		if (skb_vlan_push(skb, other->encap[i].proto,
+				  other->encap[i].id) < 0)
+			return NF_DROP;
+	}
+
+	dev_queue_xmit(skb);
+
+	return NF_STOLEN;
+}
+
+/* Based on ip_exceeds_mtu(). */
+static bool nf_flow_exceeds_mtu(const struct sk_buff *skb, unsigned int mtu)
+{
+	if (skb->len <= mtu)
+		return false;
+
+	if (skb_is_gso(skb) && skb_gso_validate_network_len(skb, mtu))
+		return false;
+
+	return true;
+}
+
 static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
-			    struct flow_offload_tuple *tuple)
+			    struct flow_offload_tuple *tuple, u32 offset)
 {
 	struct flow_ports *ports;
 	unsigned int thoff;
 	struct iphdr *iph;
 
-	if (!pskb_may_pull(skb, sizeof(*iph)))
+	if (!pskb_may_pull(skb, offset + sizeof(*iph)))
 		return -1;
 
-	iph = ip_hdr(skb);
+	iph = (struct iphdr *)(skb_network_header(skb) + offset);
 	thoff = iph->ihl * 4;
 
 	if (ip_is_fragment(iph) ||
@@ -181,10 +354,11 @@ static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
 	    iph->protocol != IPPROTO_UDP)
 		return -1;
 
-	thoff = iph->ihl * 4;
+	thoff += offset;
 	if (!pskb_may_pull(skb, thoff + sizeof(*ports)))
 		return -1;
 
+	iph = (struct iphdr *)(skb_network_header(skb) + offset);
 	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
 
 	tuple->src_v4.s_addr	= iph->saddr;
@@ -194,21 +368,11 @@ static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
 	tuple->l3proto		= AF_INET;
 	tuple->l4proto		= iph->protocol;
 	tuple->iifidx		= dev->ifindex;
+	nf_flow_tuple_encap(skb, tuple);
 
 	return 0;
 }
 
-/* Based on ip_exceeds_mtu(). */
-static bool nf_flow_exceeds_mtu(const struct sk_buff *skb, unsigned int mtu)
-{
-	if (skb->len <= mtu)
-		return false;
-
-	if (skb_is_gso(skb) && skb_gso_validate_network_len(skb, mtu))
-		return false;
-
-	return true;
-}
 
 unsigned int
 nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
@@ -220,22 +384,28 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	enum flow_offload_tuple_dir dir;
 	struct flow_offload *flow;
 	struct net_device *outdev;
+	u32 hdrsize, offset = 0;
 	struct rtable *rt;
 	unsigned int thoff;
 	struct iphdr *iph;
 	__be32 nexthop;
 
-	if (skb->protocol != htons(ETH_P_IP))
+	if (!nf_flow_skb_encap_protocol(skb, htons(ETH_P_IP), &offset))
 		return NF_ACCEPT;
 
-	if (nf_flow_tuple_ip(skb, state->in, &tuple) < 0)
+	if (nf_flow_tuple_ip(skb, state->in, &tuple, offset) < 0)
 		return NF_ACCEPT;
 
 	tuplehash = flow_offload_lookup(flow_table, &tuple);
 	if (tuplehash == NULL)
 		return NF_ACCEPT;
 
-	outdev = dev_get_by_index_rcu(state->net, tuplehash->tuple.oifidx);
+	if (tuplehash->tuple.xmit_type == FLOW_OFFLOAD_XMIT_DIRECT)
+		outdev = dev_get_by_index_rcu(state->net,
+					      tuplehash->tuple.out.ifidx);
+	else
+		outdev = dev_get_by_index_rcu(state->net,
+					      tuplehash->tuple.oifidx);
 	if (!outdev)
 		return NF_ACCEPT;
 
@@ -243,24 +413,36 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	flow = container_of(tuplehash, struct flow_offload, tuplehash[dir]);
 	rt = (struct rtable *)flow->tuplehash[dir].tuple.dst_cache;
 
-	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu)) &&
-	    (ip_hdr(skb)->frag_off & htons(IP_DF)) != 0)
+	iph = (struct iphdr *)(skb_network_header(skb) + offset);
+	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu +
+					      offset)) &&
+	    (iph->frag_off & htons(IP_DF)) != 0)
 		return NF_ACCEPT;
 
-	if (skb_try_make_writable(skb, sizeof(*iph)))
+	hdrsize = offset + sizeof(*iph);
+	if (skb_try_make_writable(skb, hdrsize))
 		return NF_DROP;
 
-	thoff = ip_hdr(skb)->ihl * 4;
-	if (nf_flow_state_check(flow, ip_hdr(skb)->protocol, skb, thoff))
+	iph = (struct iphdr *)(skb_network_header(skb) + offset);
+	thoff = offset + iph->ihl * 4;
+	if (nf_flow_state_check(flow, iph->protocol, skb, thoff))
 		return NF_ACCEPT;
 
+	nf_flow_encap_pop(skb, &tuplehash->tuple);
+	thoff -= offset;
+
 	if (nf_flow_nat_ip(flow, skb, thoff, dir) < 0)
 		return NF_DROP;
 
 	flow->timeout = (u32)jiffies + NF_FLOW_TIMEOUT;
+	flow_offload_count(flow, dir, skb->len);
 	iph = ip_hdr(skb);
 	ip_decrease_ttl(iph);
 
+	if (tuplehash->tuple.xmit_type == FLOW_OFFLOAD_XMIT_DIRECT)
+		return nf_flow_queue_xmit(skb, outdev, &tuplehash->tuple,
+					  &flow->tuplehash[!dir].tuple);
+
 	skb->dev = outdev;
 	nexthop = rt_nexthop(rt, flow->tuplehash[!dir].tuple.src_v4.s_addr);
 	skb_dst_set_noref(skb, &rt->dst);
@@ -396,25 +578,26 @@ static int nf_flow_nat_ipv6(const struct flow_offload *flow,
 }
 
 static int nf_flow_tuple_ipv6(struct sk_buff *skb, const struct net_device *dev,
-			      struct flow_offload_tuple *tuple)
+			      struct flow_offload_tuple *tuple, u32 offset)
 {
 	struct flow_ports *ports;
 	struct ipv6hdr *ip6h;
 	unsigned int thoff;
 
-	if (!pskb_may_pull(skb, sizeof(*ip6h)))
+	if (!pskb_may_pull(skb, offset + sizeof(*ip6h)))
 		return -1;
 
-	ip6h = ipv6_hdr(skb);
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + offset);
 
 	if (ip6h->nexthdr != IPPROTO_TCP &&
 	    ip6h->nexthdr != IPPROTO_UDP)
 		return -1;
 
-	thoff = sizeof(*ip6h);
+	thoff = offset + sizeof(*ip6h);
 	if (!pskb_may_pull(skb, thoff + sizeof(*ports)))
 		return -1;
 
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + offset);
 	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
 
 	tuple->src_v6		= ip6h->saddr;
@@ -424,6 +607,7 @@ static int nf_flow_tuple_ipv6(struct sk_buff *skb, const struct net_device *dev,
 	tuple->l3proto		= AF_INET6;
 	tuple->l4proto		= ip6h->nexthdr;
 	tuple->iifidx		= dev->ifindex;
+	nf_flow_tuple_encap(skb, tuple);
 
 	return 0;
 }
@@ -441,18 +625,24 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 	struct in6_addr *nexthop;
 	struct ipv6hdr *ip6h;
 	struct rt6_info *rt;
+	u32 hdrsize, offset = 0;
 
-	if (skb->protocol != htons(ETH_P_IPV6))
+	if (!nf_flow_skb_encap_protocol(skb, htons(ETH_P_IPV6), &offset))
 		return NF_ACCEPT;
 
-	if (nf_flow_tuple_ipv6(skb, state->in, &tuple) < 0)
+	if (nf_flow_tuple_ipv6(skb, state->in, &tuple, offset) < 0)
 		return NF_ACCEPT;
 
 	tuplehash = flow_offload_lookup(flow_table, &tuple);
 	if (tuplehash == NULL)
 		return NF_ACCEPT;
 
-	outdev = dev_get_by_index_rcu(state->net, tuplehash->tuple.oifidx);
+	if (tuplehash->tuple.xmit_type == FLOW_OFFLOAD_XMIT_DIRECT)
+		outdev = dev_get_by_index_rcu(state->net,
+					      tuplehash->tuple.out.ifidx);
+	else
+		outdev = dev_get_by_index_rcu(state->net,
+					      tuplehash->tuple.oifidx);
 	if (!outdev)
 		return NF_ACCEPT;
 
@@ -460,23 +650,32 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 	flow = container_of(tuplehash, struct flow_offload, tuplehash[dir]);
 	rt = (struct rt6_info *)flow->tuplehash[dir].tuple.dst_cache;
 
-	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu)))
+	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu +
+					      offset)))
 		return NF_ACCEPT;
 
-	if (nf_flow_state_check(flow, ipv6_hdr(skb)->nexthdr, skb,
-				sizeof(*ip6h)))
+	hdrsize = offset + sizeof(*ip6h);
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + offset);
+	if (nf_flow_state_check(flow, ip6h->nexthdr, skb, hdrsize))
 		return NF_ACCEPT;
 
-	if (skb_try_make_writable(skb, sizeof(*ip6h)))
+	if (skb_try_make_writable(skb, hdrsize))
 		return NF_DROP;
 
+	nf_flow_encap_pop(skb, &tuplehash->tuple);
+
 	if (nf_flow_nat_ipv6(flow, skb, dir) < 0)
 		return NF_DROP;
 
 	flow->timeout = (u32)jiffies + NF_FLOW_TIMEOUT;
+	flow_offload_count(flow, dir, skb->len);
 	ip6h = ipv6_hdr(skb);
 	ip6h->hop_limit--;
 
+	if (tuplehash->tuple.xmit_type == FLOW_OFFLOAD_XMIT_DIRECT)
+		return nf_flow_queue_xmit(skb, outdev, &tuplehash->tuple,
+					  &flow->tuplehash[!dir].tuple);
+
 	skb->dev = outdev;
 	nexthop = rt6_nexthop(rt, &flow->tuplehash[!dir].tuple.src_v6);
 	skb_dst_set_noref(skb, &rt->dst);
@@ -5,8 +5,11 @@
 #include <linux/netfilter.h>
 #include <linux/workqueue.h>
 #include <linux/spinlock.h>
+#include <linux/etherdevice.h>
+#include <linux/if_arp.h>
 #include <linux/netfilter/nf_tables.h>
 #include <net/ip.h> /* for ipv4 options. */
+#include <net/neighbour.h>
 #include <net/netfilter/nf_tables.h>
 #include <net/netfilter/nf_tables_core.h>
 #include <net/netfilter/nf_conntrack_core.h>
@@ -18,10 +21,129 @@ struct nft_flow_offload {
 	struct nft_flowtable	*flowtable;
 };
 
+static bool nft_flowtable_find_dev(const struct net_device *dev,
+				   const struct nft_flowtable *ft)
+{
+	int i;
+
+	for (i = 0; i < ft->ops_len; i++) {
+		if (ft->ops[i].dev == dev)
+			return true;
+	}
+
+	return false;
+}
+
+struct nft_forward_info {
+	const struct net_device	*indev;
+	struct {
+		u16		id;
+		__be16		proto;
+	} encap[NF_FLOW_TABLE_ENCAP_MAX];
+	u8			num_encaps;
+	u8			h_source[ETH_ALEN];
+	u8			h_dest[ETH_ALEN];
+};
+
+static int nft_dev_path_info(const struct net_device_path_stack *stack,
+			     struct nft_forward_info *info)
+{
+	const struct net_device_path *path;
+	bool has_source = false;
+	int i, j;
+
+	for (i = 0; i < stack->num_paths; i++) {
+		path = &stack->path[i];
+
+		if (!has_source && path->dev->type == ARPHRD_ETHER) {
+			memcpy(info->h_source, path->dev->dev_addr, ETH_ALEN);
+			has_source = true;
+		}
+
+		switch (path->type) {
+		case DEV_PATH_ETHERNET:
+			info->indev = path->dev;
+			break;
+		case DEV_PATH_VLAN:
+		case DEV_PATH_PPPOE:
+			if (info->num_encaps >= NF_FLOW_TABLE_ENCAP_MAX)
+				return -1;
+			/* Walking down from the upper device, so each
+			 * header found goes outside the previous ones.
+			 */
+			for (j = info->num_encaps; j > 0; j--)
+				info->encap[j] = info->encap[j - 1];
+			info->encap[0].id = path->encap.id;
+			info->encap[0].proto = path->encap.proto;
+			info->num_encaps++;
+			if (path->type == DEV_PATH_PPPOE)
+				memcpy(info->h_dest, path->encap.h_dest,
+				       ETH_ALEN);
+			break;
+		case DEV_PATH_BRIDGE:
+			break;
+		}
+	}
+
+	return has_source && info->indev ? 0 : -1;
+}
+
+/* Find the device that actually transmits packets of this direction when
+ * the route points to a vlan, bridge or ppp device. If that device is part
+ * of the flowtable, packets can be sent to it directly and the reply
+ * direction is looked up on its ingress hook, headers included.
+ */
+static void nft_dev_forward_path(struct nf_flow_route *route,
+				 const struct nf_conn *ct,
+				 enum ip_conntrack_dir dir,
+				 const struct nft_flowtable *ft)
+{
+	const struct dst_entry *dst = route->tuple[dir].dst;
+	struct nft_forward_info info = {};
+	struct net_device_path_stack stack;
+	struct neighbour *n;
+	u8 nud_state;
+	int i;
+
+	n = dst_neigh_lookup(dst, &ct->tuplehash[!dir].tuple.src.u3);
+	if (!n)
+		return;
+
+	read_lock_bh(&n->lock);
+	nud_state = n->nud_state;
+	ether_addr_copy(info.h_dest, n->ha);
+	read_unlock_bh(&n->lock);
+	neigh_release(n);
+
+	if (!(nud_state & NUD_VALID))
+		return;
+
+	if (dev_fill_forward_path(dst->dev, info.h_dest, &stack) < 0 ||
+	    stack.num_paths < 2)
+		return;
+
+	if (nft_dev_path_info(&stack, &info) < 0 ||
+	    !nft_flowtable_find_dev(info.indev, ft))
+		return;
+
+	route->tuple[!dir].in.ifindex = info.indev->ifindex;
+	for (i = 0; i < info.num_encaps; i++) {
+		route->tuple[!dir].in.encap[i].id = info.encap[i].id;
+		route->tuple[!dir].in.encap[i].proto = info.encap[i].proto;
+	}
+	route->tuple[!dir].in.num_encaps = info.num_encaps;
+
+	route->tuple[dir].out.ifindex = info.indev->ifindex;
+	memcpy(route->tuple[dir].out.h_source, info.h_source, ETH_ALEN);
+	memcpy(route->tuple[dir].out.h_dest, info.h_dest, ETH_ALEN);
+	route->tuple[dir].xmit_type = FLOW_OFFLOAD_XMIT_DIRECT;
+}
+
 static int nft_flow_route(const struct nft_pktinfo *pkt,
 			  const struct nf_conn *ct,
 			  struct nf_flow_route *route,
-			  enum ip_conntrack_dir dir)
+			  enum ip_conntrack_dir dir,
+			  const struct nft_flowtable *ft)
 {
 	struct dst_entry *this_dst = skb_dst(pkt->skb);
 	struct dst_entry *other_dst = NULL;
@@ -43,9 +165,13 @@ static int nft_flow_route(const struct nft_pktinfo *pkt,
 	if (!other_dst)
 		return -ENOENT;
 
+	memset(route, 0, sizeof(*route));
 	route->tuple[dir].dst		= this_dst;
 	route->tuple[!dir].dst		= other_dst;
 
+	nft_dev_forward_path(route, ct, dir, ft);
+	nft_dev_forward_path(route, ct, !dir, ft);
+
 	return 0;
 }
 
@@ -102,7 +228,7 @@ static void nft_flow_offload_eval(const struct nft_expr *expr,
 		goto out;
 
 	dir = CTINFO2DIR(ctinfo);
-	if (nft_flow_route(pkt, ct, &route, dir) < 0)
+	if (nft_flow_route(pkt, ct, &route, dir, priv->flowtable) < 0)
 		goto err_flow_route;
 
 	flow = flow_offload_alloc(ct, &route);
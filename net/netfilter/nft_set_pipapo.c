@@ -0,0 +1,1065 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/* PIPAPO: PIle PAcket POlicies: set for arbitrary concatenations of ranges
+ *
+ * Problem
+ * -------
+ *
+ * Match packet bytes against entries composed of ranged or non-ranged
+ * fields, for example (source address range, destination port range),
+ * without falling back to one rule per combination.
+ *
+ * Algorithm
+ * ---------
+ *
+ * Each field is split into groups of 4 bits. For each group, a lookup
+ * table holds 16 buckets, one per possible value of the group, and each
+ * bucket is a bitmap of the rules that accept that value. A range is
+ * first expanded into the minimal set of netmasks covering it, and each
+ * netmask becomes one rule of the field: groups fully covered by the
+ * netmask select the bucket of their value, groups under the wildcard
+ * part select all buckets compatible with the fixed bits.
+ *
+ * Matching a field then takes one bitwise AND of a bucket bitmap per
+ * group: bits left set are the rules of that field matching the packet.
+ * A mapping table translates every rule of a field to the range of rules
+ * it leads to in the next field, as a single entry may expand to several
+ * rules in each field. The result is used as starting bitmap for the next
+ * field, and rules surviving the last field map to set elements.
+ *
+ * The cost per packet is O(fields * groups * rules / BITS_PER_LONG) with
+ * no branches depending on rule contents, and the AND step is written as
+ * plain loops over longs so that the compiler can vectorise it.
+ *
+ * Updates
+ * -------
+ *
+ * Insertions and deletions rebuild tables, which cannot be done in place
+ * under RCU readers. The first change in a transaction clones the lookup
+ * data, further changes apply to the clone, and the ->commit() callback
+ * publishes it in place of the current copy.
+ *
+ * Element ranges are given with NFTA_SET_ELEM_KEY and
+ * NFTA_SET_ELEM_KEY_END; the field layout comes from NFTA_SET_DESC_CONCAT.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/netlink.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+#include <linux/percpu.h>
+#include <linux/bitmap.h>
+#include <linux/overflow.h>
+#include <net/ipv6.h>
+#include <net/netfilter/nf_tables.h>
+#include <net/netfilter/nf_tables_core.h>
+
+#define NFT_PIPAPO_GROUP_BITS		4
+#define NFT_PIPAPO_BUCKETS		BIT(NFT_PIPAPO_GROUP_BITS)
+#define NFT_PIPAPO_GROUPS_PER_BYTE	(BITS_PER_BYTE / NFT_PIPAPO_GROUP_BITS)
+
+/* Fields can be at most as long as an IPv6 address */
+#define NFT_PIPAPO_MAX_BYTES		(sizeof(struct in6_addr))
+
+/* Single fields are better served by nft_set_rbtree */
+#define NFT_PIPAPO_MIN_FIELDS		2
+#define NFT_PIPAPO_MAX_FIELDS		NFT_REG32_COUNT
+
+/**
+ * union nft_pipapo_map_bucket - Mapping of a rule to the next field or element
+ * @to:		First rule number in the next field
+ * @n:		Number of rules in the next field
+ * @e:		Set element, for rules in the last field
+ */
+union nft_pipapo_map_bucket {
+	struct {
+		u32 to;
+		u32 n;
+	};
+	struct nft_pipapo_elem *e;
+};
+
+/**
+ * struct nft_pipapo_field - Lookup, mapping tables and related data for a field
+ * @groups:	Number of 4-bit groups
+ * @rules:	Number of inserted rules
+ * @rules_alloc:	Number of rules the tables have room for
+ * @bsize:	Size of each bucket in lookup table, in longs
+ * @lt:		Lookup table: groups * NFT_PIPAPO_BUCKETS * bsize longs
+ * @mt:		Mapping table: one bucket per rule
+ */
+struct nft_pipapo_field {
+	int groups;
+	unsigned long rules;
+	unsigned long rules_alloc;
+	size_t bsize;
+	unsigned long *lt;
+	union nft_pipapo_map_bucket *mt;
+};
+
+/**
+ * struct nft_pipapo_match - Data used for lookup and matching
+ * @field_count:	Number of fields in set
+ * @scratch:		Per-CPU result and fill bitmaps, 2 * @bsize_max longs
+ * @bsize_max:		Room in @scratch, at least the largest field bsize
+ * @rcu:		Matching data is swapped on commits
+ * @f:			Fields, with lookup and mapping tables
+ */
+struct nft_pipapo_match {
+	int field_count;
+	unsigned long * __percpu *scratch;
+	size_t bsize_max;
+	struct rcu_head rcu;
+	struct nft_pipapo_field f[0];
+};
+
+/**
+ * struct nft_pipapo - Representation of a set
+ * @match:	Currently in-use matching data
+ * @clone:	Copy where pending changes are applied, NULL if none
+ */
+struct nft_pipapo {
+	struct nft_pipapo_match __rcu *match;
+	struct nft_pipapo_match *clone;
+};
+
+/**
+ * struct nft_pipapo_elem - API-facing representation of single set element
+ * @ext:	nftables API extensions
+ */
+struct nft_pipapo_elem {
+	struct nft_set_ext ext;
+};
+
+#define nft_pipapo_for_each_field(field, index, match)		\
+	for ((field) = (match)->f, (index) = 0;			\
+	     (index) < (match)->field_count;			\
+	     (index)++, (field)++)
+
+/* Bytes taken by a field in the key: fields start on 32-bit registers */
+static int pipapo_field_width(const struct nft_pipapo_field *f)
+{
+	return round_up(f->groups / NFT_PIPAPO_GROUPS_PER_BYTE,
+			NFT_REG32_SIZE);
+}
+
+static int pipapo_field_len(const struct nft_pipapo_field *f)
+{
+	return f->groups / NFT_PIPAPO_GROUPS_PER_BYTE;
+}
+
+/**
+ * pipapo_and_field_buckets() - Intersect buckets selected by packet data
+ * @f:		Field, with lookup table and number of groups
+ * @dst:	Bitmap of @f->bsize longs, intersected in place
+ * @data:	Packet data for this field
+ *
+ * Both groups of a byte are handled in the same pass over @dst, which
+ * halves loads and stores of the result. The inner loop has no
+ * dependency between iterations and is left to the compiler to vectorise.
+ */
+static void pipapo_and_field_buckets(const struct nft_pipapo_field *f,
+				     unsigned long *dst, const u8 *data)
+{
+	const unsigned long *lt = f->lt;
+	size_t bsize = f->bsize, k;
+	int group;
+
+	for (group = 0; group < f->groups; group += 2) {
+		const unsigned long *hi, *lo;
+		u8 v = *data++;
+
+		hi = lt + (v >> 4) * bsize;
+		lt += NFT_PIPAPO_BUCKETS * bsize;
+		lo = lt + (v & 0x0f) * bsize;
+		lt += NFT_PIPAPO_BUCKETS * bsize;
+
+		for (k = 0; k < bsize; k++)
+			dst[k] &= hi[k] & lo[k];
+	}
+}
+
+/**
+ * pipapo_refill() - Map rules matching in a field to rules of the next one
+ * @map:	Bitmap of matching rules, @len longs
+ * @len:	Length of @map in longs
+ * @rules:	Number of rules in the field
+ * @dst:	Zeroed bitmap for the next field, filled in
+ * @mt:		Mapping table of the field
+ *
+ * Return: true if at least one rule matched.
+ */
+static bool pipapo_refill(const unsigned long *map, size_t len,
+			  unsigned long rules, unsigned long *dst,
+			  const union nft_pipapo_map_bucket *mt)
+{
+	bool found = false;
+	size_t k;
+
+	for (k = 0; k < len; k++) {
+		unsigned long bitset = map[k];
+
+		while (bitset) {
+			unsigned long r = k * BITS_PER_LONG + __ffs(bitset);
+
+			bitset &= bitset - 1;
+			if (r >= rules)
+				break;
+
+			bitmap_set(dst, mt[r].to, mt[r].n);
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+static const u8 *pipapo_elem_key_end(const struct nft_pipapo_elem *e)
+{
+	if (nft_set_ext_exists(&e->ext, NFT_SET_EXT_KEY_END))
+		return (const u8 *)nft_set_ext_key_end(&e->ext)->data;
+
+	return (const u8 *)nft_set_ext_key(&e->ext)->data;
+}
+
+/**
+ * pipapo_find() - Match data against the lookup tables
+ * @set:	nftables API set representation
+ * @m:		Matching data to use
+ * @data:	Key data, fields laid out in 32-bit registers
+ * @genmask:	Only return elements active in this generation
+ * @res:	Scratch bitmap, @m->bsize_max longs
+ * @fill:	Scratch bitmap, @m->bsize_max longs
+ * @exact:	Only return an element whose start key equals @data
+ * @end:	If not NULL, only return an element whose end key equals @end
+ *
+ * Return: matching element, or NULL if none.
+ */
+static struct nft_pipapo_elem *pipapo_find(const struct nft_set *set,
+					   const struct nft_pipapo_match *m,
+					   const u8 *data, u8 genmask,
+					   unsigned long *res,
+					   unsigned long *fill,
+					   bool exact, const u8 *end)
+{
+	const struct nft_pipapo_field *f;
+	const u8 *p = data;
+	unsigned long b;
+	int i;
+
+	memset(res, 0xff, m->f[0].bsize * sizeof(*res));
+
+	nft_pipapo_for_each_field(f, i, m) {
+		pipapo_and_field_buckets(f, res, p);
+		p += pipapo_field_width(f);
+
+		if (i == m->field_count - 1)
+			break;
+
+		memset(fill, 0, f[1].bsize * sizeof(*fill));
+		if (!pipapo_refill(res, f->bsize, f->rules, fill, f->mt))
+			return NULL;
+
+		swap(res, fill);
+	}
+
+	for_each_set_bit(b, res, f->rules) {
+		struct nft_pipapo_elem *e = f->mt[b].e;
+
+		if (!nft_set_elem_active(&e->ext, genmask))
+			continue;
+		if (exact &&
+		    memcmp(nft_set_ext_key(&e->ext), data, set->klen))
+			continue;
+		if (end && memcmp(pipapo_elem_key_end(e), end, set->klen))
+			continue;
+
+		return e;
+	}
+
+	return NULL;
+}
+
+/**
+ * nft_pipapo_lookup() - Packet path lookup
+ * @net:	Network namespace
+ * @set:	nftables API set representation
+ * @key:	nftables API element representation containing key data
+ * @ext:	nftables API extension pointer, filled with matching reference
+ *
+ * Return: true on match, false otherwise.
+ */
+static bool nft_pipapo_lookup(const struct net *net, const struct nft_set *set,
+			      const u32 *key, const struct nft_set_ext **ext)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	u8 genmask = nft_genmask_cur(net);
+	const struct nft_pipapo_match *m;
+	struct nft_pipapo_elem *e = NULL;
+	unsigned long *scratch;
+
+	/* Scratch maps are per-CPU and the output path can be preempted */
+	local_bh_disable();
+
+	m = rcu_dereference(priv->match);
+	scratch = *this_cpu_ptr(m->scratch);
+	if (likely(scratch))
+		e = pipapo_find(set, m, (const u8 *)key, genmask, scratch,
+				scratch + m->bsize_max, false, NULL);
+
+	local_bh_enable();
+
+	if (!e)
+		return false;
+
+	*ext = &e->ext;
+	return true;
+}
+
+/* Control path lookup, with scratch maps allocated on the spot */
+static struct nft_pipapo_elem *pipapo_get(const struct nft_set *set,
+					  const struct nft_pipapo_match *m,
+					  const u8 *data, u8 genmask,
+					  bool exact, const u8 *end)
+{
+	struct nft_pipapo_elem *e;
+	unsigned long *res;
+
+	res = kcalloc(2 * m->bsize_max, sizeof(*res), GFP_ATOMIC);
+	if (!res)
+		return ERR_PTR(-ENOMEM);
+
+	e = pipapo_find(set, m, data, genmask, res, res + m->bsize_max,
+			exact, end);
+	kfree(res);
+
+	return e;
+}
+
+static void *nft_pipapo_get(const struct net *net, const struct nft_set *set,
+			    const struct nft_set_elem *elem, unsigned int flags)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	struct nft_pipapo_elem *e;
+
+	e = pipapo_get(set, rcu_dereference(priv->match),
+		       (const u8 *)elem->key.val.data, nft_genmask_cur(net),
+		       true, NULL);
+	if (!e)
+		return ERR_PTR(-ENOENT);
+
+	return e;
+}
+
+/**
+ * pipapo_resize() - Resize lookup and mapping tables of a field
+ * @f:		Field
+ * @rules:	Number of rules the tables must have room for
+ *
+ * Room is kept in multiples of BITS_PER_LONG rules, so most insertions
+ * and deletions don't reallocate anything. Bits and mappings beyond
+ * @f->rules are not preserved.
+ *
+ * Return: 0 on success, -ENOMEM on allocation failure.
+ */
+static int pipapo_resize(struct nft_pipapo_field *f, unsigned long rules)
+{
+	unsigned long alloc = round_up(rules, BITS_PER_LONG);
+	size_t bsize = alloc / BITS_PER_LONG, copy;
+	union nft_pipapo_map_bucket *mt = NULL;
+	unsigned long *lt = NULL;
+	int b;
+
+	if (alloc == f->rules_alloc)
+		return 0;
+
+	if (alloc) {
+		lt = kvcalloc(f->groups * NFT_PIPAPO_BUCKETS * bsize,
+			      sizeof(*lt), GFP_KERNEL);
+		mt = kvmalloc_array(alloc, sizeof(*mt), GFP_KERNEL);
+		if (!lt || !mt) {
+			kvfree(lt);
+			kvfree(mt);
+			return -ENOMEM;
+		}
+
+		copy = min(bsize, f->bsize);
+		for (b = 0; copy && b < f->groups * NFT_PIPAPO_BUCKETS; b++)
+			memcpy(lt + b * bsize, f->lt + b * f->bsize,
+			       copy * sizeof(*lt));
+
+		if (f->rules)
+			memcpy(mt, f->mt, min(f->rules, alloc) * sizeof(*mt));
+	}
+
+	kvfree(f->lt);
+	kvfree(f->mt);
+	f->lt = lt;
+	f->mt = mt;
+	f->bsize = bsize;
+	f->rules_alloc = alloc;
+
+	return 0;
+}
+
+static void pipapo_free_scratch(struct nft_pipapo_match *m)
+{
+	int cpu;
+
+	if (!m->scratch)
+		return;
+
+	for_each_possible_cpu(cpu)
+		kfree(*per_cpu_ptr(m->scratch, cpu));
+	free_percpu(m->scratch);
+}
+
+/* Grow scratch maps of a match that is not visible to the packet path */
+static int pipapo_realloc_scratch(struct nft_pipapo_match *m,
+				  size_t bsize_max)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		unsigned long *scratch;
+
+		scratch = kzalloc_node(bsize_max * sizeof(*scratch) * 2,
+				       GFP_KERNEL, cpu_to_node(cpu));
+		if (!scratch)
+			return -ENOMEM;
+
+		kfree(*per_cpu_ptr(m->scratch, cpu));
+		*per_cpu_ptr(m->scratch, cpu) = scratch;
+	}
+
+	m->bsize_max = bsize_max;
+
+	return 0;
+}
+
+static void pipapo_free_match(struct nft_pipapo_match *m)
+{
+	struct nft_pipapo_field *f;
+	int i;
+
+	pipapo_free_scratch(m);
+
+	nft_pipapo_for_each_field(f, i, m) {
+		kvfree(f->lt);
+		kvfree(f->mt);
+	}
+
+	kfree(m);
+}
+
+static void pipapo_reclaim_match(struct rcu_head *rcu)
+{
+	pipapo_free_match(container_of(rcu, struct nft_pipapo_match, rcu));
+}
+
+static struct nft_pipapo_match *pipapo_alloc_match(int field_count)
+{
+	struct nft_pipapo_match *m;
+
+	m = kzalloc(struct_size(m, f, field_count), GFP_KERNEL);
+	if (!m)
+		return NULL;
+
+	m->field_count = field_count;
+	m->scratch = alloc_percpu(unsigned long *);
+	if (!m->scratch) {
+		kfree(m);
+		return NULL;
+	}
+
+	return m;
+}
+
+/* Deep copy of lookup and mapping tables, scratch maps are allocated anew */
+static struct nft_pipapo_match *pipapo_clone(const struct nft_pipapo_match *old)
+{
+	const struct nft_pipapo_field *src;
+	struct nft_pipapo_field *dst;
+	struct nft_pipapo_match *new;
+	int i;
+
+	new = pipapo_alloc_match(old->field_count);
+	if (!new)
+		return NULL;
+
+	if (old->bsize_max && pipapo_realloc_scratch(new, old->bsize_max))
+		goto out;
+
+	dst = new->f;
+	nft_pipapo_for_each_field(src, i, old) {
+		*dst = *src;
+		dst->lt = NULL;
+		dst->mt = NULL;
+
+		if (src->rules_alloc) {
+			size_t lt_size = src->groups * NFT_PIPAPO_BUCKETS *
+					 src->bsize * sizeof(*src->lt);
+
+			dst->lt = kvmalloc(lt_size, GFP_KERNEL);
+			dst->mt = kvmalloc_array(src->rules_alloc,
+						 sizeof(*src->mt), GFP_KERNEL);
+			if (!dst->lt || !dst->mt)
+				goto out;
+
+			memcpy(dst->lt, src->lt, lt_size);
+			memcpy(dst->mt, src->mt, src->rules * sizeof(*src->mt));
+		}
+		dst++;
+	}
+
+	return new;
+
+out:
+	pipapo_free_match(new);
+	return NULL;
+}
+
+/* Matching data changes only under the commit mutex */
+static struct nft_pipapo_match *pipapo_match_protected(const struct nft_set *set)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+
+	return rcu_dereference_protected(priv->match,
+		lockdep_is_held(&read_pnet(&set->net)->nft.commit_mutex));
+}
+
+static struct nft_pipapo_match *pipapo_maybe_clone(const struct nft_set *set)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+
+	if (!priv->clone)
+		priv->clone = pipapo_clone(pipapo_match_protected(set));
+
+	return priv->clone;
+}
+
+/* Helpers for big-endian values of @len bytes, bit 0 is the least
+ * significant one.
+ */
+static bool pipapo_test_bit(const u8 *v, int bit, int len)
+{
+	return v[len - 1 - bit / BITS_PER_BYTE] & BIT(bit % BITS_PER_BYTE);
+}
+
+static void pipapo_fill_low(u8 *dst, const u8 *src, int bits, int len)
+{
+	int i;
+
+	memcpy(dst, src, len);
+	for (i = 0; i < bits; i++)
+		dst[len - 1 - i / BITS_PER_BYTE] |= BIT(i % BITS_PER_BYTE);
+}
+
+static void pipapo_inc(u8 *v, int len)
+{
+	int i;
+
+	for (i = len - 1; i >= 0; i--) {
+		if (++v[i])
+			break;
+	}
+}
+
+/**
+ * pipapo_insert_rule() - Add a netmask as new rule of a field
+ * @f:		Field, with room for one more rule
+ * @k:		Netmask base, pipapo_field_len(@f) bytes
+ * @mask_bits:	Length of the netmask, in bits
+ */
+static void pipapo_insert_rule(struct nft_pipapo_field *f, const u8 *k,
+			       int mask_bits)
+{
+	unsigned long r = f->rules++;
+	int group, b;
+
+	for (group = 0; group < f->groups; group++) {
+		unsigned long *lt = f->lt +
+				    group * NFT_PIPAPO_BUCKETS * f->bsize;
+		int fixed = clamp_t(int, mask_bits - group * NFT_PIPAPO_GROUP_BITS,
+				    0, NFT_PIPAPO_GROUP_BITS);
+		u8 v = k[group / NFT_PIPAPO_GROUPS_PER_BYTE];
+
+		v = (group % NFT_PIPAPO_GROUPS_PER_BYTE) ? v & 0x0f : v >> 4;
+
+		for (b = 0; b < NFT_PIPAPO_BUCKETS; b++) {
+			if ((b ^ v) >> (NFT_PIPAPO_GROUP_BITS - fixed))
+				continue;
+
+			__set_bit(r, lt + b * f->bsize);
+		}
+	}
+}
+
+/**
+ * pipapo_expand() - Cover a range with netmasks
+ * @f:		Field to insert rules into, NULL to only count them
+ * @start:	Start of range
+ * @end:	End of range, not smaller than @start
+ * @len:	Length of range values, bytes
+ *
+ * At every step, take the largest block aligned on the current base that
+ * doesn't go past @end, then continue after it.
+ *
+ * Return: number of netmasks needed.
+ */
+static unsigned long pipapo_expand(struct nft_pipapo_field *f,
+				   const u8 *start, const u8 *end, int len)
+{
+	u8 base[NFT_PIPAPO_MAX_BYTES], top[NFT_PIPAPO_MAX_BYTES];
+	int bits = len * BITS_PER_BYTE, step;
+	unsigned long n = 0;
+
+	memcpy(base, start, len);
+	for (;;) {
+		for (step = 0; step < bits; step++) {
+			if (pipapo_test_bit(base, step, len))
+				break;
+
+			pipapo_fill_low(top, base, step + 1, len);
+			if (memcmp(top, end, len) > 0)
+				break;
+		}
+
+		if (f)
+			pipapo_insert_rule(f, base, bits - step);
+		n++;
+
+		pipapo_fill_low(top, base, step, len);
+		if (!memcmp(top, end, len))
+			break;
+
+		memcpy(base, top, len);
+		pipapo_inc(base, len);
+	}
+
+	return n;
+}
+
+/**
+ * nft_pipapo_insert() - Validate and insert ranged elements
+ * @net:	Network namespace
+ * @set:	nftables API set representation
+ * @elem:	nftables API element representation containing key data
+ * @ext2:	Filled with pointer to &struct nft_set_ext in inserted element
+ *
+ * Return: 0 on success, error pointer on failure.
+ */
+static int nft_pipapo_insert(const struct net *net, const struct nft_set *set,
+			     const struct nft_set_elem *elem,
+			     struct nft_set_ext **ext2)
+{
+	const struct nft_set_ext *ext = nft_set_elem_ext(set, elem->priv);
+	unsigned long n[NFT_PIPAPO_MAX_FIELDS], first;
+	const u8 *start = (const u8 *)elem->key.val.data, *end;
+	struct nft_pipapo_elem *e = elem->priv, *dup;
+	u8 genmask = nft_genmask_next(net);
+	struct nft_pipapo_field *f;
+	struct nft_pipapo_match *m;
+	size_t bsize_max = 0;
+	const u8 *s, *t;
+	unsigned long r;
+	int i, err;
+
+	if (nft_set_ext_exists(ext, NFT_SET_EXT_FLAGS) &&
+	    *nft_set_ext_flags(ext) & NFT_SET_ELEM_INTERVAL_END)
+		return -EOPNOTSUPP;
+
+	if (nft_set_ext_exists(ext, NFT_SET_EXT_KEY_END))
+		end = (const u8 *)nft_set_ext_key_end(ext)->data;
+	else
+		end = start;
+
+	m = pipapo_maybe_clone(set);
+	if (!m)
+		return -ENOMEM;
+
+	s = start;
+	t = end;
+	nft_pipapo_for_each_field(f, i, m) {
+		if (memcmp(s, t, pipapo_field_len(f)) > 0)
+			return -EINVAL;
+
+		s += pipapo_field_width(f);
+		t += pipapo_field_width(f);
+	}
+
+	/* Validate: an identical entry is reported with -EEXIST so that
+	 * NLM_F_EXCL is honoured, any other overlap is refused.
+	 */
+	dup = pipapo_get(set, m, start, genmask, false, NULL);
+	if (!dup)
+		dup = pipapo_get(set, m, end, genmask, false, NULL);
+	if (IS_ERR(dup))
+		return PTR_ERR(dup);
+	if (dup) {
+		if (!memcmp(nft_set_ext_key(&dup->ext), start, set->klen) &&
+		    !memcmp(pipapo_elem_key_end(dup), end, set->klen)) {
+			*ext2 = &dup->ext;
+			return -EEXIST;
+		}
+
+		return -ENOTEMPTY;
+	}
+
+	/* Make room first, so that a failure leaves the tables untouched */
+	s = start;
+	t = end;
+	nft_pipapo_for_each_field(f, i, m) {
+		n[i] = pipapo_expand(NULL, s, t, pipapo_field_len(f));
+
+		err = pipapo_resize(f, f->rules + n[i]);
+		if (err)
+			return err;
+
+		bsize_max = max(bsize_max, f->bsize);
+		s += pipapo_field_width(f);
+		t += pipapo_field_width(f);
+	}
+
+	if (bsize_max > m->bsize_max) {
+		err = pipapo_realloc_scratch(m, bsize_max);
+		if (err)
+			return err;
+	}
+
+	/* Insert, then link each field's new rules to the next field's */
+	s = start;
+	t = end;
+	nft_pipapo_for_each_field(f, i, m) {
+		first = f->rules;
+		pipapo_expand(f, s, t, pipapo_field_len(f));
+
+		for (r = first; r < f->rules; r++) {
+			if (i == m->field_count - 1) {
+				f->mt[r].e = e;
+			} else {
+				f->mt[r].to = f[1].rules;
+				f->mt[r].n = n[i + 1];
+			}
+		}
+
+		s += pipapo_field_width(f);
+		t += pipapo_field_width(f);
+	}
+
+	return 0;
+}
+
+/* Locate the rules belonging to an element, from the last field back */
+static bool pipapo_find_rules(const struct nft_pipapo_match *m,
+			      const struct nft_pipapo_elem *e,
+			      unsigned long *first, unsigned long *n)
+{
+	int i = m->field_count - 1;
+	const struct nft_pipapo_field *f = &m->f[i];
+	unsigned long r;
+
+	for (r = 0; r < f->rules && f->mt[r].e != e; r++)
+		;
+	if (r == f->rules)
+		return false;
+
+	first[i] = r;
+	for (n[i] = 0; r < f->rules && f->mt[r].e == e; r++)
+		n[i]++;
+
+	for (i--; i >= 0; i--) {
+		f = &m->f[i];
+
+		for (r = 0; r < f->rules && f->mt[r].to != first[i + 1]; r++)
+			;
+		if (r == f->rules)
+			return false;
+
+		first[i] = r;
+		for (n[i] = 0; r < f->rules && f->mt[r].to == first[i + 1]; r++)
+			n[i]++;
+	}
+
+	return true;
+}
+
+/* Drop bits [@first, @first + @n) from @map of @len bits, closing the gap */
+static void pipapo_bitmap_cut(unsigned long *map, unsigned long first,
+			      unsigned long n, unsigned long len)
+{
+	unsigned long i;
+
+	for (i = first; i + n < len; i++)
+		__assign_bit(i, map, test_bit(i + n, map));
+
+	bitmap_clear(map, len - n, n);
+}
+
+/* Remove rules of an element from all fields and fix up mappings */
+static void pipapo_drop(struct nft_pipapo_match *m,
+			const unsigned long *first, const unsigned long *n)
+{
+	struct nft_pipapo_field *f;
+	unsigned long r;
+	int i, b;
+
+	nft_pipapo_for_each_field(f, i, m) {
+		for (b = 0; b < f->groups * NFT_PIPAPO_BUCKETS; b++)
+			pipapo_bitmap_cut(f->lt + b * f->bsize, first[i], n[i],
+					  f->rules);
+
+		memmove(&f->mt[first[i]], &f->mt[first[i] + n[i]],
+			(f->rules - first[i] - n[i]) * sizeof(*f->mt));
+		f->rules -= n[i];
+
+		if (i < m->field_count - 1) {
+			for (r = 0; r < f->rules; r++) {
+				if (f->mt[r].to > first[i + 1])
+					f->mt[r].to -= n[i + 1];
+			}
+		}
+
+		/* Shrinking is best effort, a failure keeps the extra room */
+		pipapo_resize(f, f->rules);
+	}
+}
+
+static void nft_pipapo_remove(const struct net *net, const struct nft_set *set,
+			      const struct nft_set_elem *elem)
+{
+	unsigned long first[NFT_PIPAPO_MAX_FIELDS], n[NFT_PIPAPO_MAX_FIELDS];
+	struct nft_pipapo *priv = nft_set_priv(set);
+	struct nft_pipapo_match *m = priv->clone;
+
+	/* Deactivation or insertion of this element cloned the tables */
+	if (WARN_ON_ONCE(!m || !pipapo_find_rules(m, elem->priv, first, n)))
+		return;
+
+	pipapo_drop(m, first, n);
+}
+
+static void nft_pipapo_activate(const struct net *net,
+				const struct nft_set *set,
+				const struct nft_set_elem *elem)
+{
+	struct nft_pipapo_elem *e = elem->priv;
+
+	nft_set_elem_change_active(net, set, &e->ext);
+	nft_set_elem_clear_busy(&e->ext);
+}
+
+static bool nft_pipapo_flush(const struct net *net, const struct nft_set *set,
+			     void *elem)
+{
+	struct nft_pipapo_elem *e = elem;
+
+	if (!nft_set_elem_mark_busy(&e->ext) || !nft_is_active(net, &e->ext)) {
+		nft_set_elem_change_active(net, set, &e->ext);
+		return true;
+	}
+
+	return false;
+}
+
+static void *nft_pipapo_deactivate(const struct net *net,
+				   const struct nft_set *set,
+				   const struct nft_set_elem *elem)
+{
+	struct nft_pipapo_match *m;
+	struct nft_pipapo_elem *e;
+
+	/* Removal at commit time must not fail: clone now */
+	m = pipapo_maybe_clone(set);
+	if (!m)
+		return NULL;
+
+	e = pipapo_get(set, m, (const u8 *)elem->key.val.data,
+		       nft_genmask_next(net), true,
+		       (const u8 *)elem->key_end.val.data);
+	if (IS_ERR_OR_NULL(e))
+		return NULL;
+
+	if (!nft_pipapo_flush(net, set, e))
+		return NULL;
+
+	return e;
+}
+
+/**
+ * nft_pipapo_commit() - Replace lookup data with the updated clone
+ * @set:	nftables API set representation
+ */
+static void nft_pipapo_commit(const struct nft_set *set)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	struct nft_pipapo_match *old;
+
+	if (!priv->clone)
+		return;
+
+	old = pipapo_match_protected(set);
+	rcu_assign_pointer(priv->match, priv->clone);
+	priv->clone = NULL;
+
+	call_rcu(&old->rcu, pipapo_reclaim_match);
+}
+
+static void nft_pipapo_walk(const struct nft_ctx *ctx, struct nft_set *set,
+			    struct nft_set_iter *iter)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	const struct nft_pipapo_field *f;
+	struct nft_pipapo_match *m;
+	unsigned long r;
+
+	/* Updates must see, and may touch, elements of this transaction */
+	if (iter->type == NFT_ITER_UPDATE) {
+		m = pipapo_maybe_clone(set);
+		if (!m) {
+			iter->err = -ENOMEM;
+			return;
+		}
+	}
+
+	rcu_read_lock();
+
+	if (iter->type != NFT_ITER_UPDATE)
+		m = rcu_dereference(priv->match);
+
+	f = &m->f[m->field_count - 1];
+	for (r = 0; r < f->rules; r++) {
+		struct nft_pipapo_elem *e = f->mt[r].e;
+		struct nft_set_elem elem;
+
+		/* Elements take consecutive rules in the last field */
+		if (r && e == f->mt[r - 1].e)
+			continue;
+
+		if (iter->count < iter->skip)
+			goto cont;
+		if (!nft_set_elem_active(&e->ext, iter->genmask))
+			goto cont;
+
+		elem.priv = e;
+
+		iter->err = iter->fn(ctx, set, iter, &elem);
+		if (iter->err < 0)
+			goto out;
+
+cont:
+		iter->count++;
+	}
+
+out:
+	rcu_read_unlock();
+}
+
+static u64 nft_pipapo_privsize(const struct nlattr * const nla[],
+			       const struct nft_set_desc *desc)
+{
+	return sizeof(struct nft_pipapo);
+}
+
+static bool nft_pipapo_estimate(const struct nft_set_desc *desc, u32 features,
+				struct nft_set_estimate *est)
+{
+	if (!(features & NFT_SET_INTERVAL) ||
+	    desc->field_count < NFT_PIPAPO_MIN_FIELDS ||
+	    desc->field_count > NFT_PIPAPO_MAX_FIELDS)
+		return false;
+
+	/* Ranges expand to up to 2 * bits netmasks, one bit in each bucket
+	 * of each group for each of them: use a rough upper bound.
+	 */
+	if (desc->size)
+		est->size = sizeof(struct nft_pipapo) +
+			    desc->size * (sizeof(struct nft_pipapo_elem) +
+					  desc->klen * BITS_PER_BYTE);
+	else
+		est->size = ~0;
+
+	est->lookup = NFT_SET_CLASS_O_LOG_N;
+	est->space  = NFT_SET_CLASS_O_N;
+
+	return true;
+}
+
+static int nft_pipapo_init(const struct nft_set *set,
+			   const struct nft_set_desc *desc,
+			   const struct nlattr * const nla[])
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	struct nft_pipapo_match *m;
+	struct nft_pipapo_field *f;
+	int i;
+
+	if (desc->field_count < NFT_PIPAPO_MIN_FIELDS ||
+	    desc->field_count > NFT_PIPAPO_MAX_FIELDS)
+		return -EINVAL;
+
+	for (i = 0; i < desc->field_count; i++) {
+		if (desc->field_len[i] > NFT_PIPAPO_MAX_BYTES)
+			return -EINVAL;
+	}
+
+	m = pipapo_alloc_match(desc->field_count);
+	if (!m)
+		return -ENOMEM;
+
+	nft_pipapo_for_each_field(f, i, m)
+		f->groups = desc->field_len[i] * NFT_PIPAPO_GROUPS_PER_BYTE;
+
+	RCU_INIT_POINTER(priv->match, m);
+	priv->clone = NULL;
+
+	return 0;
+}
+
+static void nft_pipapo_destroy(const struct nft_set *set)
+{
+	struct nft_pipapo *priv = nft_set_priv(set);
+	const struct nft_pipapo_field *f;
+	struct nft_pipapo_match *m;
+	unsigned long r;
+
+	rcu_barrier();
+
+	m = rcu_dereference_protected(priv->match, true);
+
+	/* The clone, if any, has the current list of elements */
+	f = &(priv->clone ? : m)->f[m->field_count - 1];
+	for (r = 0; r < f->rules; r++) {
+		if (r && f->mt[r].e == f->mt[r - 1].e)
+			continue;
+
+		nft_set_elem_destroy(set, f->mt[r].e, true);
+	}
+
+	if (priv->clone)
+		pipapo_free_match(priv->clone);
+	pipapo_free_match(m);
+}
+
+struct nft_set_type nft_set_pipapo_type __read_mostly = {
+	.owner		= THIS_MODULE,
+	.features	= NFT_SET_INTERVAL | NFT_SET_MAP | NFT_SET_OBJECT,
+	.ops		= {
+		.lookup		= nft_pipapo_lookup,
+		.insert		= nft_pipapo_insert,
+		.activate	= nft_pipapo_activate,
+		.deactivate	= nft_pipapo_deactivate,
+		.flush		= nft_pipapo_flush,
+		.remove		= nft_pipapo_remove,
+		.commit		= nft_pipapo_commit,
+		.walk		= nft_pipapo_walk,
+		.get		= nft_pipapo_get,
+		.privsize	= nft_pipapo_privsize,
+		.estimate	= nft_pipapo_estimate,
+		.init		= nft_pipapo_init,
+		.destroy	= nft_pipapo_destroy,
+		.elemsize	= offsetof(struct nft_pipapo_elem, ext),
+	},
+};
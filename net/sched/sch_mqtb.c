@@ -0,0 +1,710 @@
+/*
+ * net/sched/sch_mqtb.c	Multiqueue token bucket scheduler
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ *
+ * Rate limiting a whole device with HTB or TBF funnels every CPU through
+ * the root qdisc lock. MQTB instead attaches like mq: every TX queue gets
+ * its own leaf qdisc, serialized only by that queue's lock, and packets
+ * are classified by the TX queue chosen by XPS or ndo_select_queue.
+ *
+ * The device wide rate is a single token bucket (the budget) kept in
+ * atomics. Leaves do not touch it per packet: each CPU caches a batch of
+ * tokens and only goes back to the budget when the cache runs dry, so
+ * the shared cache line is written once per batch instead of once per
+ * packet. The price is that up to one batch per CPU may be in flight
+ * above the configured burst, so keep the batch small relative to burst.
+ *
+ * Like HTB leaves below a parent, each class (TX queue) can additionally
+ * be given its own rate and burst, enforced with a plain token bucket
+ * under the queue lock before the budget is consulted.
+ *
+ * Tokens are expressed in nanoseconds of transmission time, as in TBF.
+ * Packets larger than a bucket are charged a full bucket.
+ */
+
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/errno.h>
+#include <linux/skbuff.h>
+#include <linux/percpu.h>
+#include <linux/refcount.h>
+#include <net/netlink.h>
+#include <net/pkt_sched.h>
+#include <net/sch_generic.h>
+
+#define MQTB_DEFAULT_BURST	(64 * 1024)
+
+struct mqtb_pcpu {
+	s64		tokens;		/* cached tokens, ns */
+	u64		borrows;
+	u64		throttled;
+};
+
+struct mqtb_budget {
+	atomic64_t		tokens;		/* ns */
+	atomic64_t		t_c;		/* time check-point */
+	s64			buffer;		/* bucket depth, ns */
+	s64			batch;		/* per-CPU borrow size, ns */
+	struct psched_ratecfg	rate;
+	struct mqtb_pcpu __percpu *pcpu;
+	refcount_t		refcnt;
+};
+
+struct mqtb_sched {
+	struct Qdisc		**qdiscs;
+	struct mqtb_budget	*budget;
+	u32			burst;
+	u32			batch;
+	u32			limit;
+	struct tc_mqtb_xstats	xstats;		/* totals of replaced budgets */
+};
+
+struct mqtb_leaf {
+	struct mqtb_budget	*budget;
+	u32			limit;
+
+	/* Optional class rate, protected by the queue lock */
+	u32			burst;
+	s64			buffer;
+	s64			tokens;
+	s64			t_c;
+	struct psched_ratecfg	rate;
+
+	struct qdisc_watchdog	watchdog;
+};
+
+static const struct nla_policy mqtb_policy[TCA_MQTB_MAX + 1] = {
+	[TCA_MQTB_RATE64]	= { .type = NLA_U64 },
+	[TCA_MQTB_BURST]	= { .type = NLA_U32 },
+	[TCA_MQTB_BATCH]	= { .type = NLA_U32 },
+	[TCA_MQTB_LIMIT]	= { .type = NLA_U32 },
+};
+
+static void mqtb_ratecfg(struct psched_ratecfg *r, u64 rate64)
+{
+	struct tc_ratespec spec = { .linklayer = TC_LINKLAYER_ETHERNET };
+
+	psched_ratecfg_precompute(r, &spec, rate64);
+}
+
+static struct mqtb_budget *mqtb_budget_alloc(u64 rate64, u32 burst, u32 batch)
+{
+	struct mqtb_budget *b;
+
+	b = kzalloc(sizeof(*b), GFP_KERNEL);
+	if (!b)
+		return NULL;
+	b->pcpu = alloc_percpu(struct mqtb_pcpu);
+	if (!b->pcpu) {
+		kfree(b);
+		return NULL;
+	}
+
+	mqtb_ratecfg(&b->rate, rate64);
+	if (rate64) {
+		b->buffer = psched_l2t_ns(&b->rate, burst);
+		b->batch = psched_l2t_ns(&b->rate, batch);
+	}
+	atomic64_set(&b->tokens, b->buffer);
+	atomic64_set(&b->t_c, ktime_get_ns());
+	refcount_set(&b->refcnt, 1);
+	return b;
+}
+
+static void mqtb_budget_put(struct mqtb_budget *b)
+{
+	if (b && refcount_dec_and_test(&b->refcnt)) {
+		free_percpu(b->pcpu);
+		kfree(b);
+	}
+}
+
+static void mqtb_budget_stats(const struct mqtb_budget *b,
+			      struct tc_mqtb_xstats *st)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		const struct mqtb_pcpu *pc = per_cpu_ptr(b->pcpu, cpu);
+
+		st->borrows += pc->borrows;
+		st->throttled += pc->throttled;
+	}
+}
+
+/* Take up to @want tokens from the budget, crediting the time elapsed
+ * since the last check-point first. Only the CPU that advances the
+ * check-point credits that interval, so time is never counted twice.
+ */
+static s64 mqtb_budget_borrow(struct mqtb_budget *b, s64 want, s64 now)
+{
+	s64 last = atomic64_read(&b->t_c);
+	s64 avail, take, old;
+
+	if (now > last && atomic64_cmpxchg(&b->t_c, last, now) == last)
+		atomic64_add(min_t(s64, now - last, b->buffer), &b->tokens);
+
+	avail = atomic64_read(&b->tokens);
+	for (;;) {
+		s64 capped = min(avail, b->buffer);
+
+		if (capped <= 0)
+			return 0;
+		take = min(capped, want);
+		old = atomic64_cmpxchg(&b->tokens, avail, capped - take);
+		if (old == avail)
+			return take;
+		avail = old;
+	}
+}
+
+/* Charge @len bytes against the budget from this CPU's cache. Returns 0
+ * when the packet may go, otherwise the time to wait for the deficit.
+ * Called from the TX path with BH disabled.
+ */
+static s64 mqtb_budget_charge(struct mqtb_budget *b, unsigned int len,
+			      s64 now)
+{
+	struct mqtb_pcpu *pc;
+	s64 cost;
+
+	if (!b->rate.rate_bytes_ps)
+		return 0;
+
+	pc = this_cpu_ptr(b->pcpu);
+	cost = min_t(s64, psched_l2t_ns(&b->rate, len), b->buffer);
+	if (pc->tokens < cost) {
+		pc->tokens += mqtb_budget_borrow(b, max(b->batch,
+							cost - pc->tokens),
+						 now);
+		pc->borrows++;
+		if (pc->tokens < cost) {
+			pc->throttled++;
+			return cost - pc->tokens;
+		}
+	}
+	pc->tokens -= cost;
+	return 0;
+}
+
+static int mqtb_leaf_enqueue(struct sk_buff *skb, struct Qdisc *sch,
+			     struct sk_buff **to_free)
+{
+	struct mqtb_leaf *q = qdisc_priv(sch);
+
+	if (likely(sch->q.qlen < q->limit))
+		return qdisc_enqueue_tail(skb, sch);
+
+	return qdisc_drop(skb, sch, to_free);
+}
+
+static struct sk_buff *mqtb_leaf_dequeue(struct Qdisc *sch)
+{
+	struct mqtb_leaf *q = qdisc_priv(sch);
+	struct sk_buff *skb = qdisc_peek_head(sch);
+	s64 now, toks = 0, wait = 0;
+	unsigned int len;
+
+	if (!skb)
+		return NULL;
+
+	now = ktime_get_ns();
+	len = qdisc_pkt_len(skb);
+
+	if (q->rate.rate_bytes_ps) {
+		toks = min_t(s64, now - q->t_c, q->buffer) + q->tokens;
+		if (toks > q->buffer)
+			toks = q->buffer;
+		toks -= min_t(s64, psched_l2t_ns(&q->rate, len), q->buffer);
+		if (toks < 0)
+			wait = -toks;
+	}
+
+	if (!wait)
+		wait = mqtb_budget_charge(q->budget, len, now);
+
+	if (wait) {
+		qdisc_watchdog_schedule_ns(&q->watchdog, now + wait);
+		qdisc_qstats_overlimit(sch);
+		return NULL;
+	}
+
+	if (q->rate.rate_bytes_ps) {
+		q->t_c = now;
+		q->tokens = toks;
+	}
+	return qdisc_dequeue_head(sch);
+}
+
+static void mqtb_leaf_reset(struct Qdisc *sch)
+{
+	struct mqtb_leaf *q = qdisc_priv(sch);
+
+	qdisc_reset_queue(sch);
+	q->t_c = ktime_get_ns();
+	q->tokens = q->buffer;
+	qdisc_watchdog_cancel(&q->watchdog);
+}
+
+static int mqtb_leaf_init(struct Qdisc *sch, struct nlattr *opt,
+			  struct netlink_ext_ack *extack)
+{
+	struct mqtb_leaf *q = qdisc_priv(sch);
+
+	qdisc_watchdog_init(&q->watchdog, sch);
+	q->limit = qdisc_dev(sch)->tx_queue_len ? : 1;
+	q->t_c = ktime_get_ns();
+	return 0;
+}
+
+static void mqtb_leaf_destroy(struct Qdisc *sch)
+{
+	struct mqtb_leaf *q = qdisc_priv(sch);
+
+	qdisc_watchdog_cancel(&q->watchdog);
+	mqtb_budget_put(q->budget);
+}
+
+/* Leaves are created by the mqtb root only and are not registered. */
+static struct Qdisc_ops mqtb_leaf_qdisc_ops __read_mostly = {
+	.id		=	"mqtb_leaf",
+	.priv_size	=	sizeof(struct mqtb_leaf),
+	.enqueue	=	mqtb_leaf_enqueue,
+	.dequeue	=	mqtb_leaf_dequeue,
+	.peek		=	qdisc_peek_dequeued,
+	.init		=	mqtb_leaf_init,
+	.reset		=	mqtb_leaf_reset,
+	.destroy	=	mqtb_leaf_destroy,
+	.owner		=	THIS_MODULE,
+};
+
+static struct Qdisc *mqtb_leaf_get(struct Qdisc *sch, unsigned int ntx)
+{
+	struct mqtb_sched *priv = qdisc_priv(sch);
+	struct Qdisc *qdisc;
+
+	if (priv->qdiscs)
+		return priv->qdiscs[ntx];
+
+	qdisc = netdev_get_tx_queue(qdisc_dev(sch), ntx)->qdisc_sleeping;
+	return qdisc->ops == &mqtb_leaf_qdisc_ops ? qdisc : NULL;
+}
+
+static int mqtb_change(struct Qdisc *sch, struct nlattr *opt,
+		       struct netlink_ext_ack *extack)
+{
+	struct mqtb_sched *priv = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	struct nlattr *tb[TCA_MQTB_MAX + 1];
+	struct mqtb_budget *budget, *old;
+	u32 burst, batch, limit;
+	u64 rate64;
+	unsigned int ntx;
+	int err;
+
+	if (!opt) {
+		memset(tb, 0, sizeof(tb));
+	} else {
+		err = nla_parse_nested(tb, TCA_MQTB_MAX, opt, mqtb_policy,
+				       extack);
+		if (err < 0)
+			return err;
+	}
+
+	rate64 = priv->budget ? priv->budget->rate.rate_bytes_ps : 0;
+	if (tb[TCA_MQTB_RATE64])
+		rate64 = nla_get_u64(tb[TCA_MQTB_RATE64]);
+
+	burst = priv->burst ? : MQTB_DEFAULT_BURST;
+	if (tb[TCA_MQTB_BURST])
+		burst = nla_get_u32(tb[TCA_MQTB_BURST]);
+
+	batch = priv->batch ? : min_t(u32, burst, 4 * psched_mtu(dev));
+	if (tb[TCA_MQTB_BATCH])
+		batch = nla_get_u32(tb[TCA_MQTB_BATCH]);
+
+	limit = priv->limit;
+	if (tb[TCA_MQTB_LIMIT])
+		limit = nla_get_u32(tb[TCA_MQTB_LIMIT]);
+
+	if (!burst || !batch || batch > burst) {
+		NL_SET_ERR_MSG(extack, "Batch must be non-zero and not exceed burst");
+		return -EINVAL;
+	}
+	if (burst < psched_mtu(dev))
+		pr_warn_ratelimited("sch_mqtb: burst %u is lower than device %s mtu (%u) !\n",
+				    burst, dev->name, psched_mtu(dev));
+
+	budget = mqtb_budget_alloc(rate64, burst, batch);
+	if (!budget)
+		return -ENOMEM;
+
+	/* Each leaf only looks at its budget under its own queue lock, so
+	 * swapping it there is enough; the old one goes away with the last
+	 * leaf reference. Tokens cached in the old per-CPU slots are dropped.
+	 */
+	for (ntx = 0; ntx < dev->num_tx_queues; ntx++) {
+		struct Qdisc *qdisc = mqtb_leaf_get(sch, ntx);
+		struct mqtb_leaf *q;
+
+		if (!qdisc)
+			continue;
+		q = qdisc_priv(qdisc);
+
+		refcount_inc(&budget->refcnt);
+		spin_lock_bh(qdisc_lock(qdisc));
+		old = q->budget;
+		q->budget = budget;
+		if (limit)
+			q->limit = limit;
+		spin_unlock_bh(qdisc_lock(qdisc));
+		mqtb_budget_put(old);
+	}
+
+	old = priv->budget;
+	if (old) {
+		mqtb_budget_stats(old, &priv->xstats);
+		mqtb_budget_put(old);
+	}
+	priv->budget = budget;
+	priv->burst = burst;
+	priv->batch = batch;
+	priv->limit = limit;
+	return 0;
+}
+
+static void mqtb_destroy(struct Qdisc *sch)
+{
+	struct net_device *dev = qdisc_dev(sch);
+	struct mqtb_sched *priv = qdisc_priv(sch);
+	unsigned int ntx;
+
+	if (priv->qdiscs) {
+		for (ntx = 0;
+		     ntx < dev->num_tx_queues && priv->qdiscs[ntx];
+		     ntx++)
+			qdisc_put(priv->qdiscs[ntx]);
+		kfree(priv->qdiscs);
+	}
+	mqtb_budget_put(priv->budget);
+}
+
+static int mqtb_init(struct Qdisc *sch, struct nlattr *opt,
+		     struct netlink_ext_ack *extack)
+{
+	struct net_device *dev = qdisc_dev(sch);
+	struct mqtb_sched *priv = qdisc_priv(sch);
+	struct netdev_queue *dev_queue;
+	struct Qdisc *qdisc;
+	unsigned int ntx;
+
+	if (sch->parent != TC_H_ROOT) {
+		NL_SET_ERR_MSG(extack, "MQTB can only be attached as root qdisc");
+		return -EOPNOTSUPP;
+	}
+
+	if (!netif_is_multiqueue(dev)) {
+		NL_SET_ERR_MSG(extack, "MQTB requires a multiqueue device");
+		return -EOPNOTSUPP;
+	}
+
+	/* pre-allocate qdiscs, attachment can't fail */
+	priv->qdiscs = kcalloc(dev->num_tx_queues, sizeof(priv->qdiscs[0]),
+			       GFP_KERNEL);
+	if (!priv->qdiscs)
+		return -ENOMEM;
+
+	for (ntx = 0; ntx < dev->num_tx_queues; ntx++) {
+		dev_queue = netdev_get_tx_queue(dev, ntx);
+		qdisc = qdisc_create_dflt(dev_queue, &mqtb_leaf_qdisc_ops,
+					  TC_H_MAKE(TC_H_MAJ(sch->handle),
+						    TC_H_MIN(ntx + 1)),
+					  extack);
+		if (!qdisc)
+			return -ENOMEM;
+		priv->qdiscs[ntx] = qdisc;
+		qdisc->flags |= TCQ_F_ONETXQUEUE | TCQ_F_NOPARENT;
+	}
+
+	sch->flags |= TCQ_F_MQROOT;
+
+	return mqtb_change(sch, opt, extack);
+}
+
+static void mqtb_attach(struct Qdisc *sch)
+{
+	struct net_device *dev = qdisc_dev(sch);
+	struct mqtb_sched *priv = qdisc_priv(sch);
+	struct Qdisc *old;
+	unsigned int ntx;
+
+	/* Leaves are not hashed: they are reached through the classes. */
+	for (ntx = 0; ntx < dev->num_tx_queues; ntx++) {
+		old = dev_graft_qdisc(priv->qdiscs[ntx]->dev_queue,
+				      priv->qdiscs[ntx]);
+		if (old)
+			qdisc_put(old);
+	}
+	kfree(priv->qdiscs);
+	priv->qdiscs = NULL;
+}
+
+static int mqtb_dump(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct net_device *dev = qdisc_dev(sch);
+	struct mqtb_sched *priv = qdisc_priv(sch);
+	struct nlattr *nest;
+	struct Qdisc *qdisc;
+	unsigned int ntx;
+
+	sch->q.qlen = 0;
+	memset(&sch->bstats, 0, sizeof(sch->bstats));
+	memset(&sch->qstats, 0, sizeof(sch->qstats));
+
+	for (ntx = 0; ntx < dev->num_tx_queues; ntx++) {
+		qdisc = mqtb_leaf_get(sch, ntx);
+		if (!qdisc)
+			continue;
+
+		spin_lock_bh(qdisc_lock(qdisc));
+		sch->q.qlen		+= qdisc->q.qlen;
+		sch->bstats.bytes	+= qdisc->bstats.bytes;
+		sch->bstats.packets	+= qdisc->bstats.packets;
+		sch->qstats.qlen	+= qdisc->q.qlen;
+		sch->qstats.backlog	+= qdisc->qstats.backlog;
+		sch->qstats.drops	+= qdisc->qstats.drops;
+		sch->qstats.requeues	+= qdisc->qstats.requeues;
+		sch->qstats.overlimits	+= qdisc->qstats.overlimits;
+		spin_unlock_bh(qdisc_lock(qdisc));
+	}
+
+	nest = nla_nest_start(skb, TCA_OPTIONS);
+	if (!nest)
+		goto nla_put_failure;
+
+	if (nla_put_u64_64bit(skb, TCA_MQTB_RATE64,
+			      priv->budget->rate.rate_bytes_ps, TCA_MQTB_PAD) ||
+	    nla_put_u32(skb, TCA_MQTB_BURST, priv->burst) ||
+	    nla_put_u32(skb, TCA_MQTB_BATCH, priv->batch) ||
+	    (priv->limit && nla_put_u32(skb, TCA_MQTB_LIMIT, priv->limit)))
+		goto nla_put_failure;
+
+	return nla_nest_end(skb, nest);
+
+nla_put_failure:
+	nla_nest_cancel(skb, nest);
+	return -1;
+}
+
+static int mqtb_dump_stats(struct Qdisc *sch, struct gnet_dump *d)
+{
+	struct mqtb_sched *priv = qdisc_priv(sch);
+	struct tc_mqtb_xstats st = priv->xstats;
+
+	mqtb_budget_stats(priv->budget, &st);
+	return gnet_stats_copy_app(d, &st, sizeof(st));
+}
+
+static struct netdev_queue *mqtb_queue_get(struct Qdisc *sch,
+					   unsigned long cl)
+{
+	struct net_device *dev = qdisc_dev(sch);
+	unsigned long ntx = cl - 1;
+
+	if (ntx >= dev->num_tx_queues)
+		return NULL;
+	return netdev_get_tx_queue(dev, ntx);
+}
+
+static struct netdev_queue *mqtb_select_queue(struct Qdisc *sch,
+					      struct tcmsg *tcm)
+{
+	return mqtb_queue_get(sch, TC_H_MIN(tcm->tcm_parent));
+}
+
+static int mqtb_graft(struct Qdisc *sch, unsigned long cl, struct Qdisc *new,
+		      struct Qdisc **old, struct netlink_ext_ack *extack)
+{
+	NL_SET_ERR_MSG(extack, "MQTB classes do not take child qdiscs");
+	return -EOPNOTSUPP;
+}
+
+static struct Qdisc *mqtb_leaf(struct Qdisc *sch, unsigned long cl)
+{
+	return NULL;
+}
+
+static unsigned long mqtb_find(struct Qdisc *sch, u32 classid)
+{
+	unsigned int ntx = TC_H_MIN(classid);
+
+	if (!mqtb_queue_get(sch, ntx))
+		return 0;
+	return ntx;
+}
+
+static int mqtb_change_class(struct Qdisc *sch, u32 classid, u32 parentid,
+			     struct nlattr **tca, unsigned long *arg,
+			     struct netlink_ext_ack *extack)
+{
+	struct nlattr *tb[TCA_MQTB_MAX + 1];
+	struct psched_ratecfg rate;
+	struct Qdisc *qdisc;
+	struct mqtb_leaf *q;
+	u32 burst;
+	u64 rate64;
+	int err;
+
+	if (!*arg) {
+		NL_SET_ERR_MSG(extack, "MQTB classes are fixed to TX queues");
+		return -EOPNOTSUPP;
+	}
+
+	qdisc = mqtb_leaf_get(sch, *arg - 1);
+	if (!qdisc)
+		return -ENOENT;
+	q = qdisc_priv(qdisc);
+
+	if (!tca[TCA_OPTIONS])
+		return -EINVAL;
+	err = nla_parse_nested(tb, TCA_MQTB_MAX, tca[TCA_OPTIONS],
+			       mqtb_policy, extack);
+	if (err < 0)
+		return err;
+
+	if (tb[TCA_MQTB_BATCH]) {
+		NL_SET_ERR_MSG(extack, "Batch is a qdisc parameter");
+		return -EINVAL;
+	}
+
+	rate64 = tb[TCA_MQTB_RATE64] ? nla_get_u64(tb[TCA_MQTB_RATE64]) :
+				       q->rate.rate_bytes_ps;
+	burst = tb[TCA_MQTB_BURST] ? nla_get_u32(tb[TCA_MQTB_BURST]) :
+				     (q->burst ? : MQTB_DEFAULT_BURST);
+	if (rate64 && !burst) {
+		NL_SET_ERR_MSG(extack, "Burst must be non-zero");
+		return -EINVAL;
+	}
+	mqtb_ratecfg(&rate, rate64);
+
+	spin_lock_bh(qdisc_lock(qdisc));
+	memcpy(&q->rate, &rate, sizeof(rate));
+	q->burst = burst;
+	q->buffer = rate64 ? psched_l2t_ns(&q->rate, burst) : 0;
+	q->tokens = q->buffer;
+	q->t_c = ktime_get_ns();
+	if (tb[TCA_MQTB_LIMIT])
+		q->limit = nla_get_u32(tb[TCA_MQTB_LIMIT]) ? : 1;
+	spin_unlock_bh(qdisc_lock(qdisc));
+
+	return 0;
+}
+
+static int mqtb_dump_class(struct Qdisc *sch, unsigned long cl,
+			   struct sk_buff *skb, struct tcmsg *tcm)
+{
+	struct Qdisc *qdisc = mqtb_leaf_get(sch, cl - 1);
+	struct nlattr *nest;
+	struct mqtb_leaf *q;
+
+	tcm->tcm_parent = TC_H_ROOT;
+	tcm->tcm_handle |= TC_H_MIN(cl);
+	tcm->tcm_info = 0;
+	if (!qdisc)
+		return 0;
+	q = qdisc_priv(qdisc);
+
+	nest = nla_nest_start(skb, TCA_OPTIONS);
+	if (!nest)
+		goto nla_put_failure;
+	if ((q->rate.rate_bytes_ps &&
+	     (nla_put_u64_64bit(skb, TCA_MQTB_RATE64, q->rate.rate_bytes_ps,
+				TCA_MQTB_PAD) ||
+	      nla_put_u32(skb, TCA_MQTB_BURST, q->burst))) ||
+	    nla_put_u32(skb, TCA_MQTB_LIMIT, q->limit))
+		goto nla_put_failure;
+	return nla_nest_end(skb, nest);
+
+nla_put_failure:
+	nla_nest_cancel(skb, nest);
+	return -1;
+}
+
+static int mqtb_dump_class_stats(struct Qdisc *sch, unsigned long cl,
+				 struct gnet_dump *d)
+{
+	struct Qdisc *qdisc = mqtb_leaf_get(sch, cl - 1);
+
+	if (!qdisc)
+		return 0;
+	if (gnet_stats_copy_basic(&qdisc->running, d, NULL,
+				  &qdisc->bstats) < 0 ||
+	    gnet_stats_copy_queue(d, NULL, &qdisc->qstats,
+				  qdisc->q.qlen) < 0)
+		return -1;
+	return 0;
+}
+
+static void mqtb_walk(struct Qdisc *sch, struct qdisc_walker *arg)
+{
+	struct net_device *dev = qdisc_dev(sch);
+	unsigned int ntx;
+
+	if (arg->stop)
+		return;
+
+	arg->count = arg->skip;
+	for (ntx = arg->skip; ntx < dev->num_tx_queues; ntx++) {
+		if (arg->fn(sch, ntx + 1, arg) < 0) {
+			arg->stop = 1;
+			break;
+		}
+		arg->count++;
+	}
+}
+
+static const struct Qdisc_class_ops mqtb_class_ops = {
+	.select_queue	= mqtb_select_queue,
+	.graft		= mqtb_graft,
+	.leaf		= mqtb_leaf,
+	.find		= mqtb_find,
+	.change		= mqtb_change_class,
+	.walk		= mqtb_walk,
+	.dump		= mqtb_dump_class,
+	.dump_stats	= mqtb_dump_class_stats,
+};
+
+static struct Qdisc_ops mqtb_qdisc_ops __read_mostly = {
+	.cl_ops		= &mqtb_class_ops,
+	.id		= "mqtb",
+	.priv_size	= sizeof(struct mqtb_sched),
+	.init		= mqtb_init,
+	.destroy	= mqtb_destroy,
+	.change		= mqtb_change,
+	.attach		= mqtb_attach,
+	.dump		= mqtb_dump,
+	.dump_stats	= mqtb_dump_stats,
+	.owner		= THIS_MODULE,
+};
+
+static int __init mqtb_module_init(void)
+{
+	return register_qdisc(&mqtb_qdisc_ops);
+}
+
+static void __exit mqtb_module_exit(void)
+{
+	unregister_qdisc(&mqtb_qdisc_ops);
+}
+
+module_init(mqtb_module_init)
+module_exit(mqtb_module_exit)
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Multiqueue token bucket scheduler");
@@ -69,6 +69,7 @@
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/mutex.h>
+#include <linux/sched/signal.h>
 #include <linux/if_bridge.h>
 #include <linux/if_frad.h>
 #include <linux/if_vlan.h>
@@ -2362,6 +2363,53 @@ SYSCALL_DEFINE3(recvmsg, int, fd, struct user_msghdr __user *, msg,
  *     Linux recvmmsg interface
  */
 
+/*
+ * Sleep until the socket wait queue @wait sits on is woken up or the
+ * recvmmsg() deadline @end_time has passed, updating @timeout with the
+ * time left.  @wait was queued before the receive that failed, so data
+ * that arrived meanwhile has already marked it woken and the caller
+ * retries right away.  Nothing but a wakeup ends the sleep early, which
+ * also covers sockets poll() keeps reporting as ready while recvmsg()
+ * fails with -EAGAIN (a pending error queue, a shut down receive side).
+ *
+ * SO_RCVTIMEO (@rcvtimeo) still bounds the wait for each datagram,
+ * counted from @rcv_start.
+ *
+ * Returns 0 to retry the receive, -EAGAIN once a deadline passed and
+ * -EINTR on a pending signal.
+ */
+static int recvmmsg_wait(struct wait_queue_entry *wait,
+			 struct timespec64 *end_time,
+			 struct timespec64 *timeout,
+			 unsigned long rcv_start, long rcvtimeo)
+{
+	struct timespec64 now;
+	long left;
+
+	ktime_get_ts64(&now);
+	*timeout = timespec64_sub(*end_time, now);
+	if (timeout->tv_sec < 0 ||
+	    (timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
+		timeout->tv_sec = timeout->tv_nsec = 0;
+		return -EAGAIN;
+	}
+
+	left = timespec64_to_jiffies(timeout);
+	if (rcvtimeo != MAX_SCHEDULE_TIMEOUT) {
+		long rcv_left = (long)(rcv_start + rcvtimeo - jiffies);
+
+		if (rcv_left <= 0)
+			return -EAGAIN;
+		left = min(left, rcv_left);
+	}
+
+	if (signal_pending(current))
+		return -EINTR;
+
+	wait_woken(wait, TASK_INTERRUPTIBLE, left);
+	return 0;
+}
+
 static int do_recvmmsg(int fd, struct mmsghdr __user *mmsg,
 			  unsigned int vlen, unsigned int flags,
 			  struct timespec64 *timeout)
@@ -2373,6 +2421,10 @@ static int do_recvmmsg(int fd, struct mmsghdr __user *mmsg,
 	struct msghdr msg_sys;
 	struct timespec64 end_time;
 	struct timespec64 timeout64;
+	DEFINE_WAIT_FUNC(wait, woken_wake_function);
+	unsigned long rcv_start = 0;
+	long rcvtimeo = 0;
+	bool queued, rcv_waiting;
 
 	if (timeout &&
 	    poll_select_set_timeout(&end_time, timeout->tv_sec,
@@ -2396,32 +2448,65 @@ static int do_recvmmsg(int fd, struct mmsghdr __user *mmsg,
 	entry = mmsg;
 	compat_entry = (struct compat_mmsghdr __user *)mmsg;
 
+	/*
+	 * With a timeout, receive without blocking and sleep here instead,
+	 * queued on the socket before each receive so no wakeup is lost.
+	 */
+	queued = timeout && !(flags & MSG_DONTWAIT);
+	if (queued) {
+		rcvtimeo = sock_rcvtimeo(sock->sk, false);
+		add_wait_queue(sk_sleep(sock->sk), &wait);
+	}
+	rcv_waiting = false;
+
 	while (datagrams < vlen) {
+		unsigned int recv_flags = flags & ~MSG_WAITFORONE;
+		bool bounded = queued && !(flags & MSG_DONTWAIT);
+
+		if (bounded)
+			recv_flags |= MSG_DONTWAIT;
+
 		/*
 		 * No need to ask LSM for more than the first datagram.
 		 */
 		if (MSG_CMSG_COMPAT & flags) {
 			err = ___sys_recvmsg(sock, (struct user_msghdr __user *)compat_entry,
-					     &msg_sys, flags & ~MSG_WAITFORONE,
-					     datagrams);
-			if (err < 0)
-				break;
-			err = __put_user(err, &compat_entry->msg_len);
-			++compat_entry;
+					     &msg_sys, recv_flags, datagrams);
+			if (err >= 0) {
+				err = __put_user(err, &compat_entry->msg_len);
+				++compat_entry;
+			}
 		} else {
 			err = ___sys_recvmsg(sock,
 					     (struct user_msghdr __user *)entry,
-					     &msg_sys, flags & ~MSG_WAITFORONE,
-					     datagrams);
-			if (err < 0)
-				break;
-			err = put_user(err, &entry->msg_len);
-			++entry;
+					     &msg_sys, recv_flags, datagrams);
+			if (err >= 0) {
+				err = put_user(err, &entry->msg_len);
+				++entry;
+			}
+		}
+
+		if (err == -EAGAIN && bounded) {
+			if (!rcv_waiting) {
+				rcv_waiting = true;
+				rcv_start = jiffies;
+			}
+			err = recvmmsg_wait(&wait, &end_time, timeout,
+					    rcv_start, rcvtimeo);
+			if (!err) {
+				cond_resched();
+				continue;
+			}
+			/* Deadline or signal, return what we have so far */
+			if (datagrams)
+				err = 0;
+			break;
 		}
 
 		if (err)
 			break;
 		++datagrams;
+		rcv_waiting = false;
 
 		/* MSG_WAITFORONE turns on MSG_DONTWAIT after one packet */
 		if (flags & MSG_WAITFORONE)
@@ -2446,6 +2531,9 @@ static int do_recvmmsg(int fd, struct mmsghdr __user *mmsg,
 		cond_resched();
 	}
 
+	if (queued)
+		remove_wait_queue(sk_sleep(sock->sk), &wait);
+
 	if (err == 0)
 		goto out_put;
 
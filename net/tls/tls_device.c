@@ -140,7 +140,7 @@ static void destroy_record(struct tls_record_info *record)
 
 	while (nr_frags-- > 0) {
 		frag = &record->frags[nr_frags];
-		__skb_frag_unref(frag);
+		__skb_frag_unref(frag, false);
 	}
 	kfree(record);
 }
@@ -581,10 +581,12 @@ void handle_device_resync(struct sock *sk, u32 seq, u64 rcd_sn)
 	is_req_pending = resync_req;
 
 	if (unlikely(is_req_pending) && req_seq == seq &&
-	    atomic64_try_cmpxchg(&rx_ctx->resync_req, &resync_req, 0))
+	    atomic64_try_cmpxchg(&rx_ctx->resync_req, &resync_req, 0)) {
 		netdev->tlsdev_ops->tls_dev_resync_rx(netdev, sk,
 						      seq + TLS_HEADER_SIZE - 1,
 						      rcd_sn);
+		TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXDEVICERESYNC);
+	}
 }
 
 static int tls_device_reencrypt(struct sock *sk, struct sk_buff *skb)
@@ -60,7 +60,7 @@ static DEFINE_MUTEX(tcpv4_prot_mutex);
 static LIST_HEAD(device_list);
 static DEFINE_SPINLOCK(device_spinlock);
 static struct proto tls_prots[TLS_NUM_PROTS][TLS_NUM_CONFIG][TLS_NUM_CONFIG];
-static struct proto_ops tls_sw_proto_ops;
+static struct proto_ops tls_proto_ops[TLS_NUM_CONFIG][TLS_NUM_CONFIG];
 static void build_protos(struct proto prot[TLS_NUM_CONFIG][TLS_NUM_CONFIG],
 			 struct proto *base);
 
@@ -71,6 +71,11 @@ static void update_sk_prot(struct sock *sk, struct tls_context *ctx)
 	sk->sk_prot = &tls_prots[ip_ver][ctx->tx_conf][ctx->rx_conf];
 }
 
+static void update_sk_ops(struct sock *sk, struct tls_context *ctx)
+{
+	sk->sk_socket->ops = &tls_proto_ops[ctx->tx_conf][ctx->rx_conf];
+}
+
 int wait_on_pending_writer(struct sock *sk, long *timeo)
 {
 	int rc = 0;
@@ -266,17 +271,24 @@ static void tls_sk_proto_close(struct sock *sk, long timeout)
 		kfree(ctx->tx.rec_seq);
 		kfree(ctx->tx.iv);
 		tls_sw_free_resources_tx(sk);
+		TLS_DEC_STATS(sock_net(sk), LINUX_MIB_TLSCURRTXSW);
 	}
 
 	if (ctx->rx_conf == TLS_SW) {
 		kfree(ctx->rx.rec_seq);
 		kfree(ctx->rx.iv);
 		tls_sw_free_resources_rx(sk);
+		TLS_DEC_STATS(sock_net(sk), LINUX_MIB_TLSCURRRXSW);
 	}
 
 #ifdef CONFIG_TLS_DEVICE
-	if (ctx->rx_conf == TLS_HW)
+	if (ctx->tx_conf == TLS_HW)
+		TLS_DEC_STATS(sock_net(sk), LINUX_MIB_TLSCURRTXDEVICE);
+
+	if (ctx->rx_conf == TLS_HW) {
 		tls_device_offload_cleanup_rx(sk);
+		TLS_DEC_STATS(sock_net(sk), LINUX_MIB_TLSCURRRXDEVICE);
+	}
 
 	if (ctx->tx_conf != TLS_HW && ctx->rx_conf != TLS_HW) {
 #else
@@ -493,22 +505,36 @@ static int do_tls_setsockopt_conf(struct sock *sk, char __user *optval,
 #ifdef CONFIG_TLS_DEVICE
 		rc = tls_set_device_offload(sk, ctx);
 		conf = TLS_HW;
-		if (rc) {
+		if (!rc) {
+			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSTXDEVICE);
+			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSCURRTXDEVICE);
+		} else {
 #else
 		{
 #endif
 			rc = tls_set_sw_offload(sk, ctx, 1);
+			if (rc)
+				goto err_crypto_info;
+			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSTXSW);
+			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSCURRTXSW);
 			conf = TLS_SW;
 		}
 	} else {
 #ifdef CONFIG_TLS_DEVICE
 		rc = tls_set_device_offload_rx(sk, ctx);
 		conf = TLS_HW;
-		if (rc) {
+		if (!rc) {
+			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXDEVICE);
+			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSCURRRXDEVICE);
+		} else {
 #else
 		{
 #endif
 			rc = tls_set_sw_offload(sk, ctx, 0);
+			if (rc)
+				goto err_crypto_info;
+			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXSW);
+			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSCURRRXSW);
 			conf = TLS_SW;
 		}
 	}
@@ -521,11 +547,10 @@ static int do_tls_setsockopt_conf(struct sock *sk, char __user *optval,
 	else
 		ctx->rx_conf = conf;
 	update_sk_prot(sk, ctx);
+	update_sk_ops(sk, ctx);
 	if (tx) {
 		ctx->sk_write_space = sk->sk_write_space;
 		sk->sk_write_space = tls_write_space;
-	} else {
-		sk->sk_socket->ops = &tls_sw_proto_ops;
 	}
 	goto out;
 
@@ -695,6 +720,41 @@ static int tls_hw_hash(struct sock *sk)
 	return err;
 }
 
+/* The locked variants are used by sockmap when it redirects skbs into a
+ * socket, so a TLS socket has to encrypt those too.
+ */
+static void build_proto_ops(struct proto_ops ops[TLS_NUM_CONFIG][TLS_NUM_CONFIG],
+			    const struct proto_ops *base)
+{
+	ops[TLS_BASE][TLS_BASE] = *base;
+
+	ops[TLS_SW][TLS_BASE] = ops[TLS_BASE][TLS_BASE];
+	ops[TLS_SW][TLS_BASE].sendmsg_locked	= tls_sw_sendmsg_locked;
+	ops[TLS_SW][TLS_BASE].sendpage_locked	= tls_sw_sendpage_locked;
+
+	ops[TLS_BASE][TLS_SW] = ops[TLS_BASE][TLS_BASE];
+	ops[TLS_BASE][TLS_SW].splice_read	= tls_sw_splice_read;
+
+	ops[TLS_SW][TLS_SW] = ops[TLS_SW][TLS_BASE];
+	ops[TLS_SW][TLS_SW].splice_read		= tls_sw_splice_read;
+
+#ifdef CONFIG_TLS_DEVICE
+	/* Data pushed below the ULP would skip the device record state */
+	ops[TLS_HW][TLS_BASE] = ops[TLS_BASE][TLS_BASE];
+	ops[TLS_HW][TLS_BASE].sendmsg_locked	= NULL;
+	ops[TLS_HW][TLS_BASE].sendpage_locked	= NULL;
+
+	ops[TLS_HW][TLS_SW] = ops[TLS_HW][TLS_BASE];
+	ops[TLS_HW][TLS_SW].splice_read		= tls_sw_splice_read;
+
+	ops[TLS_BASE][TLS_HW] = ops[TLS_BASE][TLS_SW];
+
+	ops[TLS_SW][TLS_HW] = ops[TLS_SW][TLS_SW];
+
+	ops[TLS_HW][TLS_HW] = ops[TLS_HW][TLS_SW];
+#endif
+}
+
 static void build_protos(struct proto prot[TLS_NUM_CONFIG][TLS_NUM_CONFIG],
 			 struct proto *base)
 {
@@ -793,10 +853,44 @@ static struct tcp_ulp_ops tcp_tls_ulp_ops __read_mostly = {
 	.init			= tls_init,
 };
 
+static int __net_init tls_init_net(struct net *net)
+{
+	int err;
+
+	net->mib.tls_statistics = alloc_percpu(struct linux_tls_mib);
+	if (!net->mib.tls_statistics)
+		return -ENOMEM;
+
+	err = tls_proc_init(net);
+	if (err)
+		goto err_free_stats;
+
+	return 0;
+err_free_stats:
+	free_percpu(net->mib.tls_statistics);
+	return err;
+}
+
+static void __net_exit tls_exit_net(struct net *net)
+{
+	tls_proc_fini(net);
+	free_percpu(net->mib.tls_statistics);
+}
+
+static struct pernet_operations tls_proc_ops = {
+	.init = tls_init_net,
+	.exit = tls_exit_net,
+};
+
 static int __init tls_register(void)
 {
-	tls_sw_proto_ops = inet_stream_ops;
-	tls_sw_proto_ops.splice_read = tls_sw_splice_read;
+	int err;
+
+	err = register_pernet_subsys(&tls_proc_ops);
+	if (err)
+		return err;
+
+	build_proto_ops(tls_proto_ops, &inet_stream_ops);
 
 #ifdef CONFIG_TLS_DEVICE
 	tls_device_init();
@@ -812,6 +906,7 @@ static void __exit tls_unregister(void)
 #ifdef CONFIG_TLS_DEVICE
 	tls_device_cleanup();
 #endif
+	unregister_pernet_subsys(&tls_proc_ops);
 }
 
 module_init(tls_register);
@@ -168,6 +168,9 @@ static void tls_decrypt_done(struct crypto_async_request *req, int err)
 
 	/* Propagate if there was an err */
 	if (err) {
+		if (err == -EBADMSG)
+			TLS_INC_STATS(sock_net(skb->sk),
+				      LINUX_MIB_TLSDECRYPTERROR);
 		ctx->async_wait.err = err;
 		tls_err_abort(skb->sk, err);
 	} else {
@@ -241,12 +244,17 @@ static int tls_do_decryption(struct sock *sk,
 
 	ret = crypto_aead_decrypt(aead_req);
 	if (ret == -EINPROGRESS) {
-		if (async)
+		if (async) {
+			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXASYNC);
 			return ret;
+		}
 
 		ret = crypto_wait_req(ret, &ctx->async_wait);
 	}
 
+	if (ret == -EBADMSG)
+		TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSDECRYPTERROR);
+
 	if (async)
 		atomic_dec(&ctx->decrypt_pending);
 
@@ -858,7 +866,7 @@ static int tls_sw_push_pending_record(struct sock *sk, int flags)
 				   &copied, flags);
 }
 
-int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
+static int tls_sw_do_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 {
 	long timeo = sock_sndtimeo(sk, msg->msg_flags & MSG_DONTWAIT);
 	struct tls_context *tls_ctx = tls_get_ctx(sk);
@@ -879,11 +887,6 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 	int orig_size;
 	int ret = 0;
 
-	if (msg->msg_flags & ~(MSG_MORE | MSG_DONTWAIT | MSG_NOSIGNAL))
-		return -ENOTSUPP;
-
-	lock_sock(sk);
-
 	/* Wait till there is any pending write on socket */
 	if (unlikely(sk->sk_write_pending)) {
 		ret = wait_on_pending_writer(sk, &timeo);
@@ -1074,9 +1077,32 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 
 send_end:
 	ret = sk_stream_error(sk, msg->msg_flags, ret);
+	return copied ? copied : ret;
+}
 
+int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
+{
+	int ret;
+
+	if (msg->msg_flags & ~(MSG_MORE | MSG_DONTWAIT | MSG_NOSIGNAL))
+		return -ENOTSUPP;
+
+	lock_sock(sk);
+	ret = tls_sw_do_sendmsg(sk, msg, size);
 	release_sock(sk);
-	return copied ? copied : ret;
+	return ret;
+}
+
+/* Used by sockmap to redirect skbs into a TLS socket. The data has
+ * already been through a verdict program, so skip the msg policy.
+ */
+int tls_sw_sendmsg_locked(struct sock *sk, struct msghdr *msg, size_t size)
+{
+	if (msg->msg_flags & ~(MSG_MORE | MSG_DONTWAIT | MSG_NOSIGNAL))
+		return -ENOTSUPP;
+
+	msg->msg_flags |= MSG_SENDPAGE_NOPOLICY;
+	return tls_sw_do_sendmsg(sk, msg, size);
 }
 
 static int tls_sw_do_sendpage(struct sock *sk, struct page *page,
@@ -1217,6 +1243,17 @@ int tls_sw_sendpage(struct sock *sk, struct page *page,
 	return ret;
 }
 
+int tls_sw_sendpage_locked(struct sock *sk, struct page *page,
+			   int offset, size_t size, int flags)
+{
+	if (flags & ~(MSG_MORE | MSG_DONTWAIT | MSG_NOSIGNAL |
+		      MSG_SENDPAGE_NOTLAST | MSG_SENDPAGE_NOPOLICY))
+		return -ENOTSUPP;
+
+	return tls_sw_do_sendpage(sk, page, offset, size,
+				  flags | MSG_SENDPAGE_NOPOLICY);
+}
+
 static struct sk_buff *tls_wait_data(struct sock *sk, struct sk_psock *psock,
 				     int flags, long timeo, int *err)
 {
@@ -1445,6 +1482,8 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	/* Prepare and submit AEAD request */
 	err = tls_do_decryption(sk, skb, sgin, sgout, iv,
 				data_len, aead_req, async);
+	if (*zc && out_iov && (!err || err == -EINPROGRESS))
+		TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXZEROCOPY);
 	if (err == -EINPROGRESS)
 		return err;
 
@@ -1663,6 +1702,7 @@ int tls_sw_recvmsg(struct sock *sk,
 	long timeo;
 	bool is_kvec = iov_iter_is_kvec(&msg->msg_iter);
 	bool is_peek = flags & MSG_PEEK;
+	bool bpf_strp_enabled;
 	int num_async = 0;
 
 	flags |= nonblock;
@@ -1672,6 +1712,7 @@ int tls_sw_recvmsg(struct sock *sk,
 
 	psock = sk_psock_get(sk);
 	lock_sock(sk);
+	bpf_strp_enabled = sk_psock_strp_enabled(psock);
 
 	/* Process pending decrypted records. It must be non-zero-copy */
 	err = process_rx_list(ctx, msg, &control, &cmsg, 0, len, false,
@@ -1724,13 +1765,17 @@ int tls_sw_recvmsg(struct sock *sk,
 
 		to_decrypt = rxm->full_len - prot->overhead_size;
 
+		/* The verdict program needs the plaintext in the skb, so
+		 * neither zero-copy nor async decryption can be used for it.
+		 */
 		if (to_decrypt <= len && !is_kvec && !is_peek &&
 		    ctx->control == TLS_RECORD_TYPE_DATA &&
-		    prot->version != TLS_1_3_VERSION)
+		    prot->version != TLS_1_3_VERSION &&
+		    !bpf_strp_enabled)
 			zc = true;
 
 		/* Do not use async mode if record is non-data */
-		if (ctx->control == TLS_RECORD_TYPE_DATA)
+		if (ctx->control == TLS_RECORD_TYPE_DATA && !bpf_strp_enabled)
 			async_capable = ctx->async_capable;
 		else
 			async_capable = false;
@@ -1749,6 +1794,31 @@ int tls_sw_recvmsg(struct sock *sk,
 			tlm->control = ctx->control;
 		}
 
+		if (bpf_strp_enabled && tlm->control == TLS_RECORD_TYPE_DATA) {
+			int verdict;
+
+			/* Strip the record header and tag so that the
+			 * program sees, and a redirect forwards, only the
+			 * decrypted payload.
+			 */
+			if (!pskb_pull(skb, rxm->offset) ||
+			    pskb_trim(skb, rxm->full_len)) {
+				tls_err_abort(sk, ENOMEM);
+				err = -ENOMEM;
+				goto recv_end;
+			}
+			rxm->offset = 0;
+
+			verdict = sk_psock_tls_strp_read(psock, skb);
+			if (verdict != __SK_PASS) {
+				/* A redirected skb now belongs to the peer */
+				if (verdict == __SK_DROP)
+					consume_skb(skb);
+				tls_sw_advance_skb(sk, NULL, 0);
+				continue;
+			}
+		}
+
 		/* If the type of records being processed is not known yet,
 		 * set it to record type just dequeued. If it is already known,
 		 * but does not match the record type just dequeued, go to end.
@@ -2023,8 +2093,9 @@ static void tls_data_ready(struct sock *sk)
 	strp_data_ready(&ctx->strp);
 
 	psock = sk_psock_get(sk);
-	if (psock && !list_empty(&psock->ingress_msg)) {
-		ctx->saved_data_ready(sk);
+	if (psock) {
+		if (!list_empty(&psock->ingress_msg))
+			ctx->saved_data_ready(sk);
 		sk_psock_put(sk, psock);
 	}
 }
@@ -105,12 +105,21 @@ int xdp_umem_assign_dev(struct xdp_umem *umem, struct net_device *dev,
 
 	umem->dev = dev;
 	umem->queue_id = queue_id;
+
+	if (flags & XDP_USE_NEED_WAKEUP) {
+		umem->flags |= XDP_UMEM_USES_NEED_WAKEUP;
+		/* Tx needs to be explicitly woken up the first time.
+		 * Also for supporting drivers that do not implement this
+		 * feature. They will always have to call sendto().
+		 */
+		umem->need_wakeup = XDP_WAKEUP_TX;
+	}
+
 	if (force_copy)
 		/* For copy-mode, we are done. */
 		goto out_rtnl_unlock;
 
-	if (!dev->netdev_ops->ndo_bpf ||
-	    !dev->netdev_ops->ndo_xsk_async_xmit) {
+	if (!dev->netdev_ops->ndo_bpf || !dev->netdev_ops->ndo_xsk_wakeup) {
 		err = -EOPNOTSUPP;
 		goto err_unreg_umem;
 	}
@@ -198,8 +207,6 @@ static void xdp_umem_release(struct xdp_umem *umem)
 
 	xdp_umem_clear_dev(umem);
 
-	ida_simple_remove(&umem_ida, umem->id);
-
 	if (umem->fq) {
 		xskq_destroy(umem->fq);
 		umem->fq = NULL;
@@ -212,6 +219,15 @@ static void xdp_umem_release(struct xdp_umem *umem)
 
 	xsk_reuseq_destroy(umem);
 
+	if (umem->parent) {
+		/* The pinned pages belong to the parent */
+		kfree(umem->pages);
+		xdp_put_umem(umem->parent);
+		goto out;
+	}
+
+	ida_simple_remove(&umem_ida, umem->id);
+
 	xdp_umem_unpin_pages(umem);
 
 	task = get_pid_task(umem->pid, PIDTYPE_PID);
@@ -423,6 +439,49 @@ struct xdp_umem *xdp_umem_create(struct xdp_umem_reg *mr)
 	return umem;
 }
 
+/* Create a umem that shares the packet buffer of @parent, but has its own
+ * fill and completion rings and DMA mappings, so that it can be bound to
+ * another queue id and/or netdev than @parent.
+ */
+struct xdp_umem *xdp_umem_create_shared(struct xdp_umem *parent)
+{
+	struct xdp_umem *umem;
+	u32 i;
+
+	if (parent->parent)
+		parent = parent->parent;
+
+	umem = kzalloc(sizeof(*umem), GFP_KERNEL);
+	if (!umem)
+		return ERR_PTR(-ENOMEM);
+
+	umem->pages = kcalloc(parent->npgs, sizeof(*umem->pages), GFP_KERNEL);
+	if (!umem->pages) {
+		kfree(umem);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	for (i = 0; i < parent->npgs; i++)
+		umem->pages[i].addr = parent->pages[i].addr;
+
+	umem->id = parent->id;
+	umem->address = parent->address;
+	umem->chunk_mask = parent->chunk_mask;
+	umem->size = parent->size;
+	umem->headroom = parent->headroom;
+	umem->chunk_size_nohr = parent->chunk_size_nohr;
+	umem->pgs = parent->pgs;
+	umem->npgs = parent->npgs;
+	INIT_LIST_HEAD(&umem->xsk_list);
+	spin_lock_init(&umem->xsk_list_lock);
+	refcount_set(&umem->users, 1);
+
+	xdp_get_umem(parent);
+	umem->parent = parent;
+
+	return umem;
+}
+
 bool xdp_umem_validate_queues(struct xdp_umem *umem)
 {
 	return umem->fq && umem->cq;
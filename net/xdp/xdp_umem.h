@@ -16,5 +16,6 @@ void xdp_put_umem(struct xdp_umem *umem);
 void xdp_add_sk_umem(struct xdp_umem *umem, struct xdp_sock *xs);
 void xdp_del_sk_umem(struct xdp_umem *umem, struct xdp_sock *xs);
 struct xdp_umem *xdp_umem_create(struct xdp_umem_reg *mr);
+struct xdp_umem *xdp_umem_create_shared(struct xdp_umem *parent);
 
 #endif /* XDP_UMEM_H_ */
@@ -67,7 +67,8 @@ static int opt_ifindex;
 static int opt_queue;
 static int opt_poll;
 static int opt_interval = 1;
-static u32 opt_xdp_bind_flags;
+static u32 opt_xdp_bind_flags = XDP_USE_NEED_WAKEUP;
+static int opt_busy_poll;
 static __u32 prog_id;
 
 struct xsk_umem_info {
@@ -314,6 +315,11 @@ static struct xsk_socket_info *xsk_configure_socket(struct xsk_umem_info *umem)
 	if (ret)
 		exit_with_error(-ret);
 
+	if (opt_busy_poll &&
+	    setsockopt(xsk_socket__fd(xsk->xsk), SOL_SOCKET, SO_BUSY_POLL,
+		       &opt_busy_poll, sizeof(opt_busy_poll)))
+		exit_with_error(errno);
+
 	ret = bpf_get_link_xdp_id(opt_ifindex, &prog_id, opt_xdp_flags);
 	if (ret)
 		exit_with_error(-ret);
@@ -346,6 +352,8 @@ static struct option long_options[] = {
 	{"interval", required_argument, 0, 'n'},
 	{"zero-copy", no_argument, 0, 'z'},
 	{"copy", no_argument, 0, 'c'},
+	{"no-need-wakeup", no_argument, 0, 'm'},
+	{"busy-poll", required_argument, 0, 'B'},
 	{0, 0, 0, 0}
 };
 
@@ -365,6 +373,8 @@ static void usage(const char *prog)
 		"  -n, --interval=n	Specify statistics update interval (default 1 sec).\n"
 		"  -z, --zero-copy      Force zero-copy mode.\n"
 		"  -c, --copy           Force copy mode.\n"
+		"  -m, --no-need-wakeup Turn off use of driver need wakeup flag.\n"
+		"  -B, --busy-poll=n	Busy poll the socket for n usecs (SO_BUSY_POLL).\n"
 		"\n";
 	fprintf(stderr, str, prog);
 	exit(EXIT_FAILURE);
@@ -377,7 +387,7 @@ static void parse_command_line(int argc, char **argv)
 	opterr = 0;
 
 	for (;;) {
-		c = getopt_long(argc, argv, "Frtli:q:psSNn:cz", long_options,
+		c = getopt_long(argc, argv, "Frtli:q:psSNn:czmB:", long_options,
 				&option_index);
 		if (c == -1)
 			break;
@@ -420,6 +430,12 @@ static void parse_command_line(int argc, char **argv)
 		case 'F':
 			opt_xdp_flags &= ~XDP_FLAGS_UPDATE_IF_NOEXIST;
 			break;
+		case 'm':
+			opt_xdp_bind_flags &= ~XDP_USE_NEED_WAKEUP;
+			break;
+		case 'B':
+			opt_busy_poll = atoi(optarg);
+			break;
 		default:
 			usage(basename(argv[0]));
 		}
@@ -444,6 +460,17 @@ static void kick_tx(struct xsk_socket_info *xsk)
 	exit_with_error(errno);
 }
 
+static void kick_rx(struct xsk_socket_info *xsk)
+{
+	int ret;
+
+	ret = recvfrom(xsk_socket__fd(xsk->xsk), NULL, 0, MSG_DONTWAIT,
+		       NULL, NULL);
+	if (ret >= 0 || errno == ENOBUFS || errno == EAGAIN || errno == EBUSY)
+		return;
+	exit_with_error(errno);
+}
+
 static inline void complete_tx_l2fwd(struct xsk_socket_info *xsk)
 {
 	u32 idx_cq = 0, idx_fq = 0;
@@ -453,7 +480,10 @@ static inline void complete_tx_l2fwd(struct xsk_socket_info *xsk)
 	if (!xsk->outstanding_tx)
 		return;
 
-	kick_tx(xsk);
+	if (!(opt_xdp_bind_flags & XDP_USE_NEED_WAKEUP) ||
+	    xsk_ring_prod__needs_wakeup(&xsk->tx))
+		kick_tx(xsk);
+
 	ndescs = (xsk->outstanding_tx > BATCH_SIZE) ? BATCH_SIZE :
 		xsk->outstanding_tx;
 
@@ -490,7 +520,9 @@ static inline void complete_tx_only(struct xsk_socket_info *xsk)
 	if (!xsk->outstanding_tx)
 		return;
 
-	kick_tx(xsk);
+	if (!(opt_xdp_bind_flags & XDP_USE_NEED_WAKEUP) ||
+	    xsk_ring_prod__needs_wakeup(&xsk->tx))
+		kick_tx(xsk);
 
 	rcvd = xsk_ring_cons__peek(&xsk->umem->cq, BATCH_SIZE, &idx);
 	if (rcvd > 0) {
@@ -507,8 +539,12 @@ static void rx_drop(struct xsk_socket_info *xsk)
 	int ret;
 
 	rcvd = xsk_ring_cons__peek(&xsk->rx, BATCH_SIZE, &idx_rx);
-	if (!rcvd)
+	if (!rcvd) {
+		if (opt_busy_poll ||
+		    xsk_ring_prod__needs_wakeup(&xsk->umem->fq))
+			kick_rx(xsk);
 		return;
+	}
 
 	ret = xsk_ring_prod__reserve(&xsk->umem->fq, rcvd, &idx_fq);
 	while (ret != rcvd) {
@@ -613,6 +649,9 @@ static void l2fwd(struct xsk_socket_info *xsk)
 						   &idx_rx);
 			if (rcvd > 0)
 				break;
+			if (opt_busy_poll ||
+			    xsk_ring_prod__needs_wakeup(&xsk->umem->fq))
+				kick_rx(xsk);
 		}
 
 		ret = xsk_ring_prod__reserve(&xsk->tx, rcvd, &idx_tx);
@@ -0,0 +1,307 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * ublk-loop - serve a userspace block device from a file
+ *
+ *	ublk-loop [-q queues] [-d depth] [-b buf_kb] [-i dev_id] FILE
+ *
+ * Creates /dev/ublkbN backed by FILE, one thread serving each hardware
+ * queue straight out of the data buffers shared with the kernel, and
+ * removes it again on SIGINT or SIGTERM.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <linux/falloc.h>
+#include <linux/fs.h>
+#include <linux/ublk_cmd.h>
+
+struct ublk_queue {
+	int fd;
+	int q_id;
+	void *map;
+	struct ublksrv_queue_ring *ring;
+	__u32 *sqes;
+	struct ublksrv_io_cqe *cqes;
+	struct ublksrv_io_desc *descs;
+	char *bufs;
+	__u32 mask;
+	__u32 buf_size;
+	pthread_t thread;
+};
+
+static int backing_fd;
+
+static int do_rw(char *buf, size_t len, off_t off, bool write)
+{
+	while (len) {
+		ssize_t ret;
+
+		if (write)
+			ret = pwrite(backing_fd, buf, len, off);
+		else
+			ret = pread(backing_fd, buf, len, off);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!ret) {
+			if (write)
+				return -EIO;
+			/* past the end of the file reads as zeroes */
+			memset(buf, 0, len);
+			break;
+		}
+		buf += ret;
+		off += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int handle_io(const struct ublksrv_io_desc *iod, char *buf)
+{
+	off_t off = (off_t)iod->start_sector << 9;
+	size_t len = (size_t)iod->nr_sectors << 9;
+	int mode;
+
+	switch (iod->op_flags & UBLK_IO_OP_MASK) {
+	case UBLK_IO_OP_READ:
+		return do_rw(buf, len, off, false);
+	case UBLK_IO_OP_WRITE:
+		return do_rw(buf, len, off, true);
+	case UBLK_IO_OP_FLUSH:
+		return fdatasync(backing_fd) ? -errno : 0;
+	case UBLK_IO_OP_DISCARD:
+		mode = FALLOC_FL_PUNCH_HOLE;
+		break;
+	case UBLK_IO_OP_WRITE_ZEROES:
+		if (iod->op_flags & UBLK_IO_F_NOUNMAP)
+			mode = FALLOC_FL_ZERO_RANGE;
+		else
+			mode = FALLOC_FL_PUNCH_HOLE;
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+	return fallocate(backing_fd, mode | FALLOC_FL_KEEP_SIZE, off, len) ?
+		-errno : 0;
+}
+
+static void *queue_thread(void *arg)
+{
+	struct ublk_queue *q = arg;
+
+	for (;;) {
+		__u32 head, tail, cq_tail;
+
+		/* completes the last batch, then waits for the next one */
+		if (ioctl(q->fd, UBLK_IO_COMMIT_AND_FETCH, q->q_id)) {
+			if (errno == EINTR)
+				continue;
+			/* ENODEV: the device was stopped */
+			if (errno != ENODEV)
+				perror("UBLK_IO_COMMIT_AND_FETCH");
+			break;
+		}
+
+		head = q->ring->sq_head;
+		tail = __atomic_load_n(&q->ring->sq_tail, __ATOMIC_ACQUIRE);
+		cq_tail = q->ring->cq_tail;
+		while (head != tail) {
+			__u32 tag = q->sqes[head++ & q->mask];
+			struct ublksrv_io_cqe *cqe = &q->cqes[cq_tail++ & q->mask];
+
+			cqe->tag = tag;
+			cqe->result = handle_io(&q->descs[tag],
+						q->bufs + (size_t)tag * q->buf_size);
+		}
+		__atomic_store_n(&q->ring->sq_head, head, __ATOMIC_RELEASE);
+		__atomic_store_n(&q->ring->cq_tail, cq_tail, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static int map_queue(struct ublk_queue *q, int fd, int q_id, __u32 size)
+{
+	q->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		      (off_t)q_id * size);
+	if (q->map == MAP_FAILED) {
+		q->map = NULL;
+		return -1;
+	}
+
+	q->fd = fd;
+	q->q_id = q_id;
+	q->ring = q->map;
+	q->sqes = q->map + q->ring->sq_off;
+	q->cqes = q->map + q->ring->cq_off;
+	q->descs = q->map + q->ring->desc_off;
+	q->bufs = q->map + q->ring->buf_off;
+	q->mask = q->ring->ring_entries - 1;
+	q->buf_size = q->ring->buf_size;
+	return 0;
+}
+
+/* udev creates /dev/ublkcN shortly after the device is added */
+static int open_char_dev(int dev_id)
+{
+	char path[32];
+	int i, fd;
+
+	snprintf(path, sizeof(path), "/dev/ublkc%d", dev_id);
+	for (i = 0; i < 100; i++) {
+		fd = open(path, O_RDWR);
+		if (fd >= 0 || errno != ENOENT)
+			break;
+		usleep(10000);
+	}
+	if (fd < 0)
+		perror(path);
+	return fd;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-q queues] [-d depth] [-b buf_kb] [-i dev_id] FILE\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct ublksrv_ctrl_dev_info info = {
+		.dev_id = -1,
+		.nr_hw_queues = 1,
+		.queue_depth = 64,
+		.max_io_buf_bytes = 256 << 10,
+		.flags = UBLK_F_DISCARD,
+	};
+	struct ublk_queue *queues = NULL;
+	int ctrl_fd, fd = -1, nr_threads = 0;
+	unsigned long long size;
+	struct stat st;
+	sigset_t set;
+	int i, opt, sig, err = 1;
+
+	while ((opt = getopt(argc, argv, "q:d:b:i:")) != -1) {
+		switch (opt) {
+		case 'q':
+			info.nr_hw_queues = atoi(optarg);
+			break;
+		case 'd':
+			info.queue_depth = atoi(optarg);
+			break;
+		case 'b':
+			info.max_io_buf_bytes = atoi(optarg) << 10;
+			break;
+		case 'i':
+			info.dev_id = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1)
+		usage(argv[0]);
+
+	backing_fd = open(argv[optind], O_RDWR);
+	if (backing_fd < 0 || fstat(backing_fd, &st)) {
+		perror(argv[optind]);
+		return 1;
+	}
+	size = st.st_size;
+	if (S_ISBLK(st.st_mode) && ioctl(backing_fd, BLKGETSIZE64, &size)) {
+		perror("BLKGETSIZE64");
+		return 1;
+	}
+	info.dev_sectors = size >> 9;
+	if (!info.dev_sectors) {
+		fprintf(stderr, "%s: smaller than a sector\n", argv[optind]);
+		return 1;
+	}
+
+	ctrl_fd = open("/dev/ublk-control", O_RDWR);
+	if (ctrl_fd < 0) {
+		perror("/dev/ublk-control");
+		return 1;
+	}
+	if (ioctl(ctrl_fd, UBLK_CTRL_ADD_DEV, &info)) {
+		perror("UBLK_CTRL_ADD_DEV");
+		close(ctrl_fd);
+		return 1;
+	}
+
+	fd = open_char_dev(info.dev_id);
+	if (fd < 0)
+		goto out_del;
+
+	queues = calloc(info.nr_hw_queues, sizeof(*queues));
+	if (!queues)
+		goto out_close;
+	for (i = 0; i < info.nr_hw_queues; i++) {
+		if (map_queue(&queues[i], fd, i, info.queue_map_size)) {
+			perror("mmap");
+			goto out_unmap;
+		}
+	}
+
+	/* only the main thread takes the signals */
+	sigemptyset(&set);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	for (; nr_threads < info.nr_hw_queues; nr_threads++) {
+		if (pthread_create(&queues[nr_threads].thread, NULL,
+				   queue_thread, &queues[nr_threads])) {
+			fprintf(stderr, "creating queue thread failed\n");
+			goto out_stop;
+		}
+	}
+
+	if (ioctl(ctrl_fd, UBLK_CTRL_START_DEV, info.dev_id)) {
+		perror("UBLK_CTRL_START_DEV");
+		goto out_stop;
+	}
+	printf("serving %s as /dev/ublkb%d, %u queues of depth %u\n",
+	       argv[optind], info.dev_id, info.nr_hw_queues, info.queue_depth);
+	fflush(stdout);
+
+	sigwait(&set, &sig);
+	err = 0;
+
+out_stop:
+	/* flushes the disk through the queue threads, then lets them go */
+	if (ioctl(ctrl_fd, UBLK_CTRL_STOP_DEV, info.dev_id))
+		perror("UBLK_CTRL_STOP_DEV");
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(queues[i].thread, NULL);
+out_unmap:
+	for (i = 0; i < info.nr_hw_queues; i++) {
+		if (queues[i].map)
+			munmap(queues[i].map, info.queue_map_size);
+	}
+	free(queues);
+out_close:
+	close(fd);
+out_del:
+	if (ioctl(ctrl_fd, UBLK_CTRL_DEL_DEV, info.dev_id))
+		perror("UBLK_CTRL_DEL_DEV");
+	close(ctrl_fd);
+	close(backing_fd);
+	return err;
+}
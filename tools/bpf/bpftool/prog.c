@@ -29,6 +29,8 @@ static const char * const attach_type_strings[] = {
 	[BPF_SK_SKB_STREAM_VERDICT] = "stream_verdict",
 	[BPF_SK_MSG_VERDICT] = "msg_verdict",
 	[BPF_FLOW_DISSECTOR] = "flow_dissector",
+	[BPF_RPS] = "rps",
+	[BPF_SK_LOOKUP] = "sk_lookup",
 	[__MAX_BPF_ATTACH_TYPE] = NULL,
 };
 
@@ -830,7 +832,8 @@ static int parse_attach_detach_args(int argc, char **argv, int *progfd,
 		return -EINVAL;
 	}
 
-	if (*attach_type == BPF_FLOW_DISSECTOR) {
+	if (*attach_type == BPF_FLOW_DISSECTOR || *attach_type == BPF_RPS ||
+	    *attach_type == BPF_SK_LOOKUP) {
 		*mapfd = -1;
 		return 0;
 	}
@@ -1202,12 +1205,12 @@ static int do_help(int argc, char **argv)
 		"                 tracepoint | raw_tracepoint | xdp | perf_event | cgroup/skb |\n"
 		"                 cgroup/sock | cgroup/dev | lwt_in | lwt_out | lwt_xmit |\n"
 		"                 lwt_seg6local | sockops | sk_skb | sk_msg | lirc_mode2 |\n"
-		"                 sk_reuseport | flow_dissector |\n"
+		"                 sk_reuseport | flow_dissector | rps | sk_lookup |\n"
 		"                 cgroup/bind4 | cgroup/bind6 | cgroup/post_bind4 |\n"
 		"                 cgroup/post_bind6 | cgroup/connect4 | cgroup/connect6 |\n"
 		"                 cgroup/sendmsg4 | cgroup/sendmsg6 }\n"
 		"       ATTACH_TYPE := { msg_verdict | stream_verdict | stream_parser |\n"
-		"                        flow_dissector }\n"
+		"                        flow_dissector | rps | sk_lookup }\n"
 		"       " HELP_SPEC_OPTIONS "\n"
 		"",
 		bin_name, argv[-2], bin_name, argv[-2], bin_name, argv[-2],
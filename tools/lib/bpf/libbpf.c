@@ -1676,6 +1676,9 @@ static bool bpf_prog_type__needs_kver(enum bpf_prog_type type)
 	case BPF_PROG_TYPE_LIRC_MODE2:
 	case BPF_PROG_TYPE_SK_REUSEPORT:
 	case BPF_PROG_TYPE_FLOW_DISSECTOR:
+	case BPF_PROG_TYPE_STRUCT_OPS:
+	case BPF_PROG_TYPE_RPS:
+	case BPF_PROG_TYPE_SK_LOOKUP:
 	case BPF_PROG_TYPE_UNSPEC:
 	case BPF_PROG_TYPE_TRACEPOINT:
 	case BPF_PROG_TYPE_RAW_TRACEPOINT:
@@ -2605,6 +2608,10 @@ static const struct {
 						BPF_LIRC_MODE2),
 	BPF_APROG_SEC("flow_dissector",		BPF_PROG_TYPE_FLOW_DISSECTOR,
 						BPF_FLOW_DISSECTOR),
+	BPF_APROG_SEC("rps",			BPF_PROG_TYPE_RPS,
+						BPF_RPS),
+	BPF_APROG_SEC("sk_lookup",		BPF_PROG_TYPE_SK_LOOKUP,
+						BPF_SK_LOOKUP),
 	BPF_EAPROG_SEC("cgroup/bind4",		BPF_PROG_TYPE_CGROUP_SOCK_ADDR,
 						BPF_CGROUP_INET4_BIND),
 	BPF_EAPROG_SEC("cgroup/bind6",		BPF_PROG_TYPE_CGROUP_SOCK_ADDR,
@@ -2617,6 +2624,9 @@ static const struct {
 						BPF_CGROUP_UDP4_SENDMSG),
 	BPF_EAPROG_SEC("cgroup/sendmsg6",	BPF_PROG_TYPE_CGROUP_SOCK_ADDR,
 						BPF_CGROUP_UDP6_SENDMSG),
+	/* registered through a BPF_MAP_TYPE_STRUCT_OPS map, not attached */
+	BPF_PROG_SEC_IMPL("struct_ops/tcp_ca",	BPF_PROG_TYPE_STRUCT_OPS,
+			  BPF_STRUCT_OPS_TCP_CONGESTION, 0, 0),
 };
 
 #undef BPF_PROG_SEC_IMPL
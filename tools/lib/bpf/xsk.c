@@ -56,6 +56,11 @@ struct xsk_umem {
 struct xsk_socket {
 	struct xsk_ring_cons *rx;
 	struct xsk_ring_prod *tx;
+	/* Own fill and completion rings, used when sharing the umem with
+	 * a socket on another queue id or netdev.
+	 */
+	struct xsk_ring_prod *fill;
+	struct xsk_ring_cons *comp;
 	__u64 outstanding_tx;
 	struct xsk_umem *umem;
 	struct xsk_socket_config config;
@@ -75,6 +80,22 @@ struct xsk_nl_info {
 	int fd;
 };
 
+/* Up until and including Linux 5.0, the mmap offsets did not carry the
+ * ring flags field.
+ */
+struct xdp_ring_offset_v1 {
+	__u64 producer;
+	__u64 consumer;
+	__u64 desc;
+};
+
+struct xdp_mmap_offsets_v1 {
+	struct xdp_ring_offset_v1 rx;
+	struct xdp_ring_offset_v1 tx;
+	struct xdp_ring_offset_v1 fr;
+	struct xdp_ring_offset_v1 cr;
+};
+
 /* For 32-bit systems, we need to use mmap2 as the offsets are 64-bit.
  * Unfortunately, it is not part of glibc.
  */
@@ -145,106 +166,181 @@ static void xsk_set_xdp_socket_config(struct xsk_socket_config *cfg,
 	cfg->bind_flags = usr_cfg->bind_flags;
 }
 
-int xsk_umem__create(struct xsk_umem **umem_ptr, void *umem_area, __u64 size,
-		     struct xsk_ring_prod *fill, struct xsk_ring_cons *comp,
-		     const struct xsk_umem_config *usr_config)
+static void xsk_mmap_offsets_v1(struct xdp_mmap_offsets *off)
+{
+	struct xdp_mmap_offsets_v1 off_v1;
+
+	/* getsockopt on a kernel <= 5.0 has no flags fields.
+	 * Copy over the offsets to the correct places in the >=5.1 format
+	 * and put the flags where they would have been on that kernel.
+	 */
+	memcpy(&off_v1, off, sizeof(off_v1));
+
+	off->rx.producer = off_v1.rx.producer;
+	off->rx.consumer = off_v1.rx.consumer;
+	off->rx.desc = off_v1.rx.desc;
+	off->rx.flags = off_v1.rx.consumer + sizeof(__u32);
+
+	off->tx.producer = off_v1.tx.producer;
+	off->tx.consumer = off_v1.tx.consumer;
+	off->tx.desc = off_v1.tx.desc;
+	off->tx.flags = off_v1.tx.consumer + sizeof(__u32);
+
+	off->fr.producer = off_v1.fr.producer;
+	off->fr.consumer = off_v1.fr.consumer;
+	off->fr.desc = off_v1.fr.desc;
+	off->fr.flags = off_v1.fr.consumer + sizeof(__u32);
+
+	off->cr.producer = off_v1.cr.producer;
+	off->cr.consumer = off_v1.cr.consumer;
+	off->cr.desc = off_v1.cr.desc;
+	off->cr.flags = off_v1.cr.consumer + sizeof(__u32);
+}
+
+static int xsk_get_mmap_offsets(int fd, struct xdp_mmap_offsets *off)
 {
-	struct xdp_mmap_offsets off;
-	struct xdp_umem_reg mr;
-	struct xsk_umem *umem;
 	socklen_t optlen;
-	void *map;
 	int err;
 
-	if (!umem_area || !umem_ptr || !fill || !comp)
-		return -EFAULT;
-	if (!size && !xsk_page_aligned(umem_area))
-		return -EINVAL;
+	optlen = sizeof(*off);
+	err = getsockopt(fd, SOL_XDP, XDP_MMAP_OFFSETS, off, &optlen);
+	if (err)
+		return -errno;
 
-	umem = calloc(1, sizeof(*umem));
-	if (!umem)
-		return -ENOMEM;
+	if (optlen == sizeof(*off))
+		return 0;
 
-	umem->fd = socket(AF_XDP, SOCK_RAW, 0);
-	if (umem->fd < 0) {
-		err = -errno;
-		goto out_umem_alloc;
+	if (optlen == sizeof(struct xdp_mmap_offsets_v1)) {
+		xsk_mmap_offsets_v1(off);
+		return 0;
 	}
 
-	umem->umem_area = umem_area;
-	xsk_set_umem_config(&umem->config, usr_config);
+	return -EINVAL;
+}
 
-	mr.addr = (uintptr_t)umem_area;
-	mr.len = size;
-	mr.chunk_size = umem->config.frame_size;
-	mr.headroom = umem->config.frame_headroom;
+static int xsk_create_umem_rings(struct xsk_umem *umem, int fd,
+				 struct xsk_ring_prod *fill,
+				 struct xsk_ring_cons *comp)
+{
+	struct xdp_mmap_offsets off;
+	void *map;
+	int err;
 
-	err = setsockopt(umem->fd, SOL_XDP, XDP_UMEM_REG, &mr, sizeof(mr));
-	if (err) {
-		err = -errno;
-		goto out_socket;
-	}
-	err = setsockopt(umem->fd, SOL_XDP, XDP_UMEM_FILL_RING,
+	err = setsockopt(fd, SOL_XDP, XDP_UMEM_FILL_RING,
 			 &umem->config.fill_size,
 			 sizeof(umem->config.fill_size));
-	if (err) {
-		err = -errno;
-		goto out_socket;
-	}
-	err = setsockopt(umem->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING,
+	if (err)
+		return -errno;
+
+	err = setsockopt(fd, SOL_XDP, XDP_UMEM_COMPLETION_RING,
 			 &umem->config.comp_size,
 			 sizeof(umem->config.comp_size));
-	if (err) {
-		err = -errno;
-		goto out_socket;
-	}
+	if (err)
+		return -errno;
 
-	optlen = sizeof(off);
-	err = getsockopt(umem->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen);
-	if (err) {
-		err = -errno;
-		goto out_socket;
-	}
+	err = xsk_get_mmap_offsets(fd, &off);
+	if (err)
+		return err;
 
 	map = xsk_mmap(NULL, off.fr.desc +
 		       umem->config.fill_size * sizeof(__u64),
 		       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
-		       umem->fd, XDP_UMEM_PGOFF_FILL_RING);
-	if (map == MAP_FAILED) {
-		err = -errno;
-		goto out_socket;
-	}
+		       fd, XDP_UMEM_PGOFF_FILL_RING);
+	if (map == MAP_FAILED)
+		return -errno;
 
-	umem->fill = fill;
 	fill->mask = umem->config.fill_size - 1;
 	fill->size = umem->config.fill_size;
 	fill->producer = map + off.fr.producer;
 	fill->consumer = map + off.fr.consumer;
 	fill->ring = map + off.fr.desc;
+	fill->flags = map + off.fr.flags;
 	fill->cached_cons = umem->config.fill_size;
 
 	map = xsk_mmap(NULL,
 		       off.cr.desc + umem->config.comp_size * sizeof(__u64),
 		       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
-		       umem->fd, XDP_UMEM_PGOFF_COMPLETION_RING);
+		       fd, XDP_UMEM_PGOFF_COMPLETION_RING);
 	if (map == MAP_FAILED) {
 		err = -errno;
 		goto out_mmap;
 	}
 
-	umem->comp = comp;
 	comp->mask = umem->config.comp_size - 1;
 	comp->size = umem->config.comp_size;
 	comp->producer = map + off.cr.producer;
 	comp->consumer = map + off.cr.consumer;
 	comp->ring = map + off.cr.desc;
+	comp->flags = map + off.cr.flags;
 
-	*umem_ptr = umem;
 	return 0;
 
 out_mmap:
-	munmap(umem->fill,
+	munmap(fill->ring - off.fr.desc,
+	       off.fr.desc + umem->config.fill_size * sizeof(__u64));
+	return err;
+}
+
+static void xsk_delete_umem_rings(struct xsk_umem *umem, int fd,
+				  struct xsk_ring_prod *fill,
+				  struct xsk_ring_cons *comp)
+{
+	struct xdp_mmap_offsets off;
+
+	if (xsk_get_mmap_offsets(fd, &off))
+		return;
+
+	munmap(fill->ring - off.fr.desc,
 	       off.fr.desc + umem->config.fill_size * sizeof(__u64));
+	munmap(comp->ring - off.cr.desc,
+	       off.cr.desc + umem->config.comp_size * sizeof(__u64));
+}
+
+int xsk_umem__create(struct xsk_umem **umem_ptr, void *umem_area, __u64 size,
+		     struct xsk_ring_prod *fill, struct xsk_ring_cons *comp,
+		     const struct xsk_umem_config *usr_config)
+{
+	struct xdp_umem_reg mr;
+	struct xsk_umem *umem;
+	int err;
+
+	if (!umem_area || !umem_ptr || !fill || !comp)
+		return -EFAULT;
+	if (!size && !xsk_page_aligned(umem_area))
+		return -EINVAL;
+
+	umem = calloc(1, sizeof(*umem));
+	if (!umem)
+		return -ENOMEM;
+
+	umem->fd = socket(AF_XDP, SOCK_RAW, 0);
+	if (umem->fd < 0) {
+		err = -errno;
+		goto out_umem_alloc;
+	}
+
+	umem->umem_area = umem_area;
+	xsk_set_umem_config(&umem->config, usr_config);
+
+	mr.addr = (uintptr_t)umem_area;
+	mr.len = size;
+	mr.chunk_size = umem->config.frame_size;
+	mr.headroom = umem->config.frame_headroom;
+
+	err = setsockopt(umem->fd, SOL_XDP, XDP_UMEM_REG, &mr, sizeof(mr));
+	if (err) {
+		err = -errno;
+		goto out_socket;
+	}
+	err = xsk_create_umem_rings(umem, umem->fd, fill, comp);
+	if (err)
+		goto out_socket;
+
+	umem->fill = fill;
+	umem->comp = comp;
+	*umem_ptr = umem;
+	return 0;
+
 out_socket:
 	close(umem->fd);
 out_umem_alloc:
@@ -513,26 +609,24 @@ static int xsk_setup_xdp_prog(struct xsk_socket *xsk)
 	return err;
 }
 
-int xsk_socket__create(struct xsk_socket **xsk_ptr, const char *ifname,
-		       __u32 queue_id, struct xsk_umem *umem,
-		       struct xsk_ring_cons *rx, struct xsk_ring_prod *tx,
-		       const struct xsk_socket_config *usr_config)
+int xsk_socket__create_shared(struct xsk_socket **xsk_ptr,
+			      const char *ifname, __u32 queue_id,
+			      struct xsk_umem *umem,
+			      struct xsk_ring_cons *rx,
+			      struct xsk_ring_prod *tx,
+			      struct xsk_ring_prod *fill,
+			      struct xsk_ring_cons *comp,
+			      const struct xsk_socket_config *usr_config)
 {
 	struct sockaddr_xdp sxdp = {};
 	struct xdp_mmap_offsets off;
 	struct xsk_socket *xsk;
-	socklen_t optlen;
 	void *map;
 	int err;
 
-	if (!umem || !xsk_ptr || !rx || !tx)
+	if (!umem || !xsk_ptr || !rx || !tx || !fill || !comp)
 		return -EFAULT;
 
-	if (umem->refcount) {
-		pr_warning("Error: shared umems not supported by libbpf.\n");
-		return -EBUSY;
-	}
-
 	xsk = calloc(1, sizeof(*xsk));
 	if (!xsk)
 		return -ENOMEM;
@@ -559,6 +653,17 @@ int xsk_socket__create(struct xsk_socket **xsk_ptr, const char *ifname,
 
 	xsk_set_xdp_socket_config(&xsk->config, usr_config);
 
+	/* Sockets bound to another queue id or netdev than the one owning
+	 * the umem bring their own fill and completion rings.
+	 */
+	if (xsk->fd != umem->fd && fill != umem->fill) {
+		err = xsk_create_umem_rings(umem, xsk->fd, fill, comp);
+		if (err)
+			goto out_socket;
+		xsk->fill = fill;
+		xsk->comp = comp;
+	}
+
 	if (rx) {
 		err = setsockopt(xsk->fd, SOL_XDP, XDP_RX_RING,
 				 &xsk->config.rx_size,
@@ -578,12 +683,9 @@ int xsk_socket__create(struct xsk_socket **xsk_ptr, const char *ifname,
 		}
 	}
 
-	optlen = sizeof(off);
-	err = getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen);
-	if (err) {
-		err = -errno;
+	err = xsk_get_mmap_offsets(xsk->fd, &off);
+	if (err)
 		goto out_socket;
-	}
 
 	if (rx) {
 		map = xsk_mmap(NULL, off.rx.desc +
@@ -601,6 +703,7 @@ int xsk_socket__create(struct xsk_socket **xsk_ptr, const char *ifname,
 		rx->producer = map + off.rx.producer;
 		rx->consumer = map + off.rx.consumer;
 		rx->ring = map + off.rx.desc;
+		rx->flags = map + off.rx.flags;
 	}
 	xsk->rx = rx;
 
@@ -620,6 +723,7 @@ int xsk_socket__create(struct xsk_socket **xsk_ptr, const char *ifname,
 		tx->producer = map + off.tx.producer;
 		tx->consumer = map + off.tx.consumer;
 		tx->ring = map + off.tx.desc;
+		tx->flags = map + off.tx.flags;
 		tx->cached_cons = xsk->config.tx_size;
 	}
 	xsk->tx = tx;
@@ -627,7 +731,12 @@ int xsk_socket__create(struct xsk_socket **xsk_ptr, const char *ifname,
 	sxdp.sxdp_family = PF_XDP;
 	sxdp.sxdp_ifindex = xsk->ifindex;
 	sxdp.sxdp_queue_id = xsk->queue_id;
-	sxdp.sxdp_flags = xsk->config.bind_flags;
+	if (xsk->fd != umem->fd) {
+		sxdp.sxdp_flags = XDP_SHARED_UMEM;
+		sxdp.sxdp_shared_umem_fd = umem->fd;
+	} else {
+		sxdp.sxdp_flags = xsk->config.bind_flags;
+	}
 
 	err = bind(xsk->fd, (struct sockaddr *)&sxdp, sizeof(sxdp));
 	if (err) {
@@ -655,6 +764,8 @@ int xsk_socket__create(struct xsk_socket **xsk_ptr, const char *ifname,
 		       off.rx.desc +
 		       xsk->config.rx_size * sizeof(struct xdp_desc));
 out_socket:
+	if (xsk->fill)
+		xsk_delete_umem_rings(umem, xsk->fd, xsk->fill, xsk->comp);
 	if (--umem->refcount)
 		close(xsk->fd);
 out_xsk_alloc:
@@ -662,26 +773,28 @@ int xsk_socket__create(struct xsk_socket **xsk_ptr, const char *ifname,
 	return err;
 }
 
-int xsk_umem__delete(struct xsk_umem *umem)
+int xsk_socket__create(struct xsk_socket **xsk_ptr, const char *ifname,
+		       __u32 queue_id, struct xsk_umem *umem,
+		       struct xsk_ring_cons *rx, struct xsk_ring_prod *tx,
+		       const struct xsk_socket_config *usr_config)
 {
-	struct xdp_mmap_offsets off;
-	socklen_t optlen;
-	int err;
+	if (!umem)
+		return -EFAULT;
 
+	return xsk_socket__create_shared(xsk_ptr, ifname, queue_id, umem,
+					 rx, tx, umem->fill, umem->comp,
+					 usr_config);
+}
+
+int xsk_umem__delete(struct xsk_umem *umem)
+{
 	if (!umem)
 		return 0;
 
 	if (umem->refcount)
 		return -EBUSY;
 
-	optlen = sizeof(off);
-	err = getsockopt(umem->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen);
-	if (!err) {
-		munmap(umem->fill->ring,
-		       off.fr.desc + umem->config.fill_size * sizeof(__u64));
-		munmap(umem->comp->ring,
-		       off.cr.desc + umem->config.comp_size * sizeof(__u64));
-	}
+	xsk_delete_umem_rings(umem, umem->fd, umem->fill, umem->comp);
 
 	close(umem->fd);
 	free(umem);
@@ -692,7 +805,6 @@ int xsk_umem__delete(struct xsk_umem *umem)
 void xsk_socket__delete(struct xsk_socket *xsk)
 {
 	struct xdp_mmap_offsets off;
-	socklen_t optlen;
 	int err;
 
 	if (!xsk)
@@ -700,8 +812,7 @@ void xsk_socket__delete(struct xsk_socket *xsk)
 
 	(void)xsk_update_bpf_maps(xsk, 0, 0);
 
-	optlen = sizeof(off);
-	err = getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen);
+	err = xsk_get_mmap_offsets(xsk->fd, &off);
 	if (!err) {
 		if (xsk->rx)
 			munmap(xsk->rx->ring,
@@ -713,6 +824,9 @@ void xsk_socket__delete(struct xsk_socket *xsk)
 			       xsk->config.tx_size * sizeof(struct xdp_desc));
 	}
 
+	if (xsk->fill)
+		xsk_delete_umem_rings(xsk->umem, xsk->fd, xsk->fill, xsk->comp);
+
 	xsk->umem->refcount--;
 	/* Do not close an fd that also has an associated umem connected
 	 * to it.
@@ -182,6 +182,16 @@ static struct bpf_tcp_sock *(*bpf_tcp_sock)(struct bpf_sock *sk) =
 	(void *) BPF_FUNC_tcp_sock;
 static int (*bpf_skb_ecn_set_ce)(void *ctx) =
 	(void *) BPF_FUNC_skb_ecn_set_ce;
+static unsigned long long (*bpf_xdp_get_buff_len)(void *ctx) =
+	(void *) BPF_FUNC_xdp_get_buff_len;
+static int (*bpf_xdp_load_bytes)(void *ctx, int off, void *to, int len) =
+	(void *) BPF_FUNC_xdp_load_bytes;
+static int (*bpf_xdp_store_bytes)(void *ctx, int off, void *from, int len) =
+	(void *) BPF_FUNC_xdp_store_bytes;
+static int (*bpf_tcp_send_ack)(void *ctx, __u32 rcv_nxt) =
+	(void *) BPF_FUNC_tcp_send_ack;
+static int (*bpf_sk_assign)(void *ctx, void *map, void *key, __u64 flags) =
+	(void *) BPF_FUNC_sk_assign;
 
 /* llvm builtin functions that eBPF C program may use to
  * emit BPF_LD_ABS and BPF_LD_IND instructions
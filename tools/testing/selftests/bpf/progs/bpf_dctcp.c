@@ -0,0 +1,251 @@
+// SPDX-License-Identifier: GPL-2.0
+/* DCTCP as BPF_STRUCT_OPS_TCP_CONGESTION programs, a port of
+ * net/ipv4/tcp_dctcp.c with the default module parameters. Connections
+ * without ECN fall back to reno, as with the C version.
+ */
+#include <stddef.h>
+#include <linux/bpf.h>
+#include <linux/types.h>
+#include "bpf_helpers.h"
+#include "test_bpf_tcp_ca.h"
+
+#define DCTCP_MAX_ALPHA		1024U
+#define DCTCP_SHIFT_G		4	/* g = 1/2^4 */
+
+/* kernel constants the programs need */
+#define TCP_CLOSE		7
+#define TCP_LISTEN		10
+#define TCP_ECN_OK		1
+#define TCP_ECN_DEMAND_CWR	4
+#define CA_EVENT_ECN_NO_CE	4
+#define CA_EVENT_ECN_IS_CE	5
+#define CA_ACK_WIN_UPDATE	(1 << 1)
+#define CA_ACK_ECE		(1 << 2)
+#define ICSK_ACK_TIMER		2
+
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+
+struct dctcp {
+	__u32 acked_bytes_ecn;
+	__u32 acked_bytes_total;
+	__u32 prior_snd_una;
+	__u32 prior_rcv_nxt;
+	__u32 dctcp_alpha;
+	__u32 next_seq;
+	__u32 ce_state;
+	__u32 loss_cwnd;
+};
+
+struct bpf_map_def SEC("maps") stats_map = {
+	.type = BPF_MAP_TYPE_ARRAY,
+	.key_size = sizeof(__u32),
+	.value_size = sizeof(struct bpf_tcp_ca_stats),
+	.max_entries = 1,
+};
+
+static __always_inline struct bpf_tcp_ca_stats *stats(void)
+{
+	__u32 key = 0;
+
+	return bpf_map_lookup_elem(&stats_map, &key);
+}
+
+static __always_inline void count(struct bpf_tcp_ca *ctx)
+{
+	struct bpf_tcp_ca_stats *st = stats();
+
+	if (st && ctx->op < __BPF_TCP_CA_OP_MAX)
+		__sync_fetch_and_add(&st->calls[ctx->op], 1);
+}
+
+static __always_inline struct dctcp *ca_priv(struct bpf_tcp_ca *ctx)
+{
+	return (struct dctcp *)ctx->priv;
+}
+
+static __always_inline void dctcp_reset(struct bpf_tcp_ca *ctx,
+					struct dctcp *ca)
+{
+	ca->next_seq = ctx->snd_nxt;
+
+	ca->acked_bytes_ecn = 0;
+	ca->acked_bytes_total = 0;
+}
+
+SEC("struct_ops/tcp_ca/init")
+int dctcp_init(struct bpf_tcp_ca *ctx)
+{
+	struct dctcp *ca = ca_priv(ctx);
+	struct bpf_tcp_ca_stats *st;
+
+	count(ctx);
+
+	if ((ctx->ecn_flags & TCP_ECN_OK) ||
+	    ctx->state == TCP_LISTEN || ctx->state == TCP_CLOSE) {
+		ca->prior_snd_una = ctx->snd_una;
+		ca->prior_rcv_nxt = ctx->rcv_nxt;
+
+		ca->dctcp_alpha = DCTCP_MAX_ALPHA;
+
+		ca->loss_cwnd = 0;
+		ca->ce_state = 0;
+
+		dctcp_reset(ctx, ca);
+		return 0;
+	}
+
+	/* No ECN support? Fall back to Reno, which also clears ECT. */
+	st = stats();
+	if (st)
+		__sync_fetch_and_add(&st->fallbacks, 1);
+	ctx->actions = BPF_TCP_CA_ACT_FALLBACK_RENO;
+	return 0;
+}
+
+SEC("struct_ops/tcp_ca/ssthresh")
+__u32 dctcp_ssthresh(struct bpf_tcp_ca *ctx)
+{
+	struct dctcp *ca = ca_priv(ctx);
+	__u32 cwnd = ctx->snd_cwnd;
+
+	count(ctx);
+
+	ca->loss_cwnd = cwnd;
+	return max(cwnd - ((cwnd * ca->dctcp_alpha) >> 11U), 2U);
+}
+
+SEC("struct_ops/tcp_ca/in_ack_event")
+int dctcp_update_alpha(struct bpf_tcp_ca *ctx)
+{
+	struct dctcp *ca = ca_priv(ctx);
+	__u32 acked_bytes = ctx->snd_una - ca->prior_snd_una;
+	__u32 flags = ctx->ack_flags;
+
+	count(ctx);
+
+	/* If ack did not advance snd_una, count dupack as MSS size.
+	 * If ack did update window, do not count it at all.
+	 */
+	if (acked_bytes == 0 && !(flags & CA_ACK_WIN_UPDATE))
+		acked_bytes = ctx->rcv_mss;
+	if (acked_bytes) {
+		ca->acked_bytes_total += acked_bytes;
+		ca->prior_snd_una = ctx->snd_una;
+
+		if (flags & CA_ACK_ECE)
+			ca->acked_bytes_ecn += acked_bytes;
+	}
+
+	/* Expired RTT */
+	if ((__s32)(ctx->snd_una - ca->next_seq) >= 0) {
+		__u64 bytes_ecn = ca->acked_bytes_ecn;
+		__u32 alpha = ca->dctcp_alpha;
+
+		/* alpha = (1 - g) * alpha + g * F, with min_not_zero() */
+		alpha -= (alpha >> DCTCP_SHIFT_G) ?: alpha;
+		if (bytes_ecn) {
+			bytes_ecn <<= (10 - DCTCP_SHIFT_G);
+			bytes_ecn /= max(1U, ca->acked_bytes_total);
+
+			alpha = min(alpha + (__u32)bytes_ecn, DCTCP_MAX_ALPHA);
+		}
+		ca->dctcp_alpha = alpha;
+		dctcp_reset(ctx, ca);
+	}
+	return 0;
+}
+
+static __always_inline void dctcp_ece_ack_cwr(struct bpf_tcp_ca *ctx,
+					      __u32 ce_state)
+{
+	if (ce_state == 1)
+		ctx->ecn_flags |= TCP_ECN_DEMAND_CWR;
+	else
+		ctx->ecn_flags &= ~TCP_ECN_DEMAND_CWR;
+}
+
+SEC("struct_ops/tcp_ca/cwnd_event")
+int dctcp_cwnd_event(struct bpf_tcp_ca *ctx)
+{
+	struct dctcp *ca = ca_priv(ctx);
+	struct bpf_tcp_ca_stats *st;
+	__u32 new_ce_state;
+
+	count(ctx);
+
+	if (ctx->event != CA_EVENT_ECN_IS_CE &&
+	    ctx->event != CA_EVENT_ECN_NO_CE)
+		return 0;
+
+	new_ce_state = ctx->event == CA_EVENT_ECN_IS_CE;
+	if (ca->ce_state != new_ce_state) {
+		/* CE state has changed, force an immediate ACK to
+		 * reflect the new CE state. If an ACK was delayed,
+		 * send that first to reflect the prior CE state.
+		 */
+		if (ctx->ack_pending & ICSK_ACK_TIMER) {
+			dctcp_ece_ack_cwr(ctx, ca->ce_state);
+			bpf_tcp_send_ack(ctx, ca->prior_rcv_nxt);
+		}
+		ctx->actions |= BPF_TCP_CA_ACT_ACK_NOW;
+
+		st = stats();
+		if (st)
+			__sync_fetch_and_add(&st->ce_changes, 1);
+	}
+	ca->prior_rcv_nxt = ctx->rcv_nxt;
+	ca->ce_state = new_ce_state;
+	dctcp_ece_ack_cwr(ctx, new_ce_state);
+	return 0;
+}
+
+/* tcp_reno_cong_avoid() */
+SEC("struct_ops/tcp_ca/cong_avoid")
+int dctcp_cong_avoid(struct bpf_tcp_ca *ctx)
+{
+	__u32 acked = ctx->acked;
+	__u32 cwnd, w;
+
+	count(ctx);
+
+	if (!ctx->is_cwnd_limited)
+		return 0;
+
+	/* tcp_slow_start() */
+	if (ctx->snd_cwnd < ctx->snd_ssthresh) {
+		cwnd = min(ctx->snd_cwnd + acked, ctx->snd_ssthresh);
+		acked -= cwnd - ctx->snd_cwnd;
+		ctx->snd_cwnd = min(cwnd, ctx->snd_cwnd_clamp);
+		if (!acked)
+			return 0;
+	}
+
+	/* tcp_cong_avoid_ai() */
+	w = ctx->snd_cwnd;
+	if (ctx->snd_cwnd_cnt >= w) {
+		ctx->snd_cwnd_cnt = 0;
+		ctx->snd_cwnd++;
+	}
+	ctx->snd_cwnd_cnt += acked;
+	if (ctx->snd_cwnd_cnt >= w) {
+		__u32 delta = ctx->snd_cwnd_cnt / w;
+
+		ctx->snd_cwnd_cnt -= delta * w;
+		ctx->snd_cwnd += delta;
+	}
+	ctx->snd_cwnd = min(ctx->snd_cwnd, ctx->snd_cwnd_clamp);
+	return 0;
+}
+
+SEC("struct_ops/tcp_ca/undo_cwnd")
+__u32 dctcp_cwnd_undo(struct bpf_tcp_ca *ctx)
+{
+	struct dctcp *ca = ca_priv(ctx);
+
+	count(ctx);
+
+	return max(ctx->snd_cwnd, ca->loss_cwnd);
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <netinet/in.h>
+
+#include "bpf_helpers.h"
+#include "bpf_endian.h"
+#include "test_rps.h"
+
+/* UDP destination port, in host order, to target CPU */
+struct bpf_map_def SEC("maps") port_cpu_map = {
+	.type = BPF_MAP_TYPE_HASH,
+	.key_size = sizeof(__u16),
+	.value_size = sizeof(__u32),
+	.max_entries = 16,
+};
+
+struct bpf_map_def SEC("maps") stats_map = {
+	.type = BPF_MAP_TYPE_ARRAY,
+	.key_size = sizeof(__u32),
+	.value_size = sizeof(__u64),
+	.max_entries = __NR_RPS_STATS,
+};
+
+SEC("rps")
+int steer_by_port(struct __sk_buff *skb)
+{
+	struct bpf_flow_keys *keys = skb->flow_keys;
+	__u32 idx = RPS_STAT_FALLBACK;
+	__u32 *cpu;
+	__u64 *cnt;
+	__u16 port;
+	int ret = -1;
+
+	if (keys->addr_proto == ETH_P_IP && keys->ip_proto == IPPROTO_UDP) {
+		port = bpf_ntohs(keys->dport);
+		cpu = bpf_map_lookup_elem(&port_cpu_map, &port);
+		if (cpu) {
+			idx = RPS_STAT_STEERED;
+			ret = *cpu;
+		}
+	}
+
+	cnt = bpf_map_lookup_elem(&stats_map, &idx);
+	if (cnt)
+		__sync_fetch_and_add(cnt, 1);
+
+	return ret;
+}
+
+char _license[] SEC("license") = "GPL";
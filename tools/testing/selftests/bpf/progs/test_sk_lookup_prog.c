@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <linux/bpf.h>
+#include <netinet/in.h>
+
+#include "bpf_helpers.h"
+#include "test_sk_lookup.h"
+
+struct bpf_map_def SEC("maps") redir_map = {
+	.type = BPF_MAP_TYPE_REUSEPORT_SOCKARRAY,
+	.key_size = sizeof(__u32),
+	.value_size = sizeof(__u64),
+	.max_entries = __NR_REDIR,
+};
+
+SEC("sk_lookup")
+int redir_port_range(struct bpf_sk_lookup *ctx)
+{
+	__u32 key;
+
+	if (ctx->local_port == DROP_PORT)
+		return SK_DROP;
+	if (ctx->local_port < REDIR_PORT_LO || ctx->local_port > REDIR_PORT_HI)
+		return SK_PASS;
+
+	key = ctx->protocol == IPPROTO_TCP ? REDIR_TCP : REDIR_UDP;
+	/* on failure the regular lookup runs, and finds nothing */
+	bpf_sk_assign(ctx, &redir_map, &key, 0);
+	return SK_PASS;
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,443 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Register the BPF DCTCP of progs/bpf_dctcp.c as "bpf_dctcp" through a
+ * BPF_MAP_TYPE_STRUCT_OPS map and run transfers with it over the
+ * loopback device of a private network namespace:
+ *
+ * - between two bpf_dctcp sockets, which negotiate ECN and must keep
+ *   bpf_dctcp, compared with the same transfer over the C dctcp when
+ *   that is available;
+ * - with netem marking packets CE on lo, where bpf_dctcp must echo the
+ *   marks and reduce its window through its ssthresh program, to within
+ *   a factor of the C dctcp under the same marking;
+ * - against a peer that refuses ECN, where it must fall back to reno;
+ * - after deleting the map element, when bpf_dctcp must be gone.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include <linux/bpf.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "bpf_rlimit.h"
+#include "bpf_util.h"
+#include "test_bpf_tcp_ca.h"
+
+#define CA_NAME		"bpf_dctcp"
+#define TOTAL_BYTES	(8 * 1024 * 1024)
+#define TCP_ECN_SYSCTL	"/proc/sys/net/ipv4/tcp_ecn"
+#define TCP_INFINITE_SSTHRESH	0x7fffffff
+/* marks about one in ten of the ECT packets CE, drops as many others */
+#define CE_QDISC	"tc qdisc add dev lo root netem loss 10% ecn"
+/* how far apart the ssthresh of both DCTCPs may end up under CE */
+#define CE_SSTHRESH_FACTOR	4
+
+static const char * const prog_titles[__BPF_TCP_CA_OP_MAX] = {
+	[BPF_TCP_CA_OP_INIT]		= "struct_ops/tcp_ca/init",
+	[BPF_TCP_CA_OP_SSTHRESH]	= "struct_ops/tcp_ca/ssthresh",
+	[BPF_TCP_CA_OP_CONG_AVOID]	= "struct_ops/tcp_ca/cong_avoid",
+	[BPF_TCP_CA_OP_CWND_EVENT]	= "struct_ops/tcp_ca/cwnd_event",
+	[BPF_TCP_CA_OP_IN_ACK_EVENT]	= "struct_ops/tcp_ca/in_ack_event",
+	[BPF_TCP_CA_OP_UNDO_CWND]	= "struct_ops/tcp_ca/undo_cwnd",
+};
+
+struct transfer {
+	const char *cli_ca;
+	const char *srv_ca;
+	char cli_ca_after[16];
+	struct tcp_info cli_info;
+	size_t received;
+	int lfd;
+};
+
+static int create_struct_ops_map(void)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = BPF_MAP_TYPE_STRUCT_OPS;
+	attr.key_size = sizeof(__u32);
+	attr.value_size = sizeof(struct bpf_tcp_congestion_ops);
+	attr.max_entries = 1;
+	attr.struct_ops_type = BPF_STRUCT_OPS_TCP_CONGESTION;
+
+	return syscall(__NR_bpf, BPF_MAP_CREATE, &attr, sizeof(attr));
+}
+
+static int set_ca(int fd, const char *ca)
+{
+	if (!ca)
+		return 0;
+	return setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, ca, strlen(ca));
+}
+
+static bool ca_available(const char *ca)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	bool ok;
+
+	ok = fd >= 0 && !set_ca(fd, ca);
+	if (fd >= 0)
+		close(fd);
+	return ok;
+}
+
+static void *server(void *arg)
+{
+	struct transfer *t = arg;
+	char buf[65536];
+	ssize_t len;
+	int fd;
+
+	fd = accept(t->lfd, NULL, NULL);
+	if (fd < 0)
+		return NULL;
+
+	while ((len = recv(fd, buf, sizeof(buf), 0)) > 0)
+		t->received += len;
+
+	close(fd);
+	return NULL;
+}
+
+static int run_transfer(struct transfer *t)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+	static char buf[65536];
+	size_t chunk, sent = 0;
+	pthread_t thread;
+	int fd = -1;
+	ssize_t ret;
+
+	t->received = 0;
+	t->lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (t->lfd < 0 || set_ca(t->lfd, t->srv_ca) ||
+	    bind(t->lfd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    getsockname(t->lfd, (struct sockaddr *)&addr, &len) ||
+	    listen(t->lfd, 1)) {
+		perror("server socket");
+		goto err;
+	}
+
+	if (pthread_create(&thread, NULL, server, t)) {
+		perror("pthread_create");
+		goto err;
+	}
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0 || set_ca(fd, t->cli_ca) ||
+	    connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror("client socket");
+		shutdown(t->lfd, SHUT_RDWR);
+		pthread_join(thread, NULL);
+		goto err;
+	}
+
+	while (sent < TOTAL_BYTES) {
+		chunk = TOTAL_BYTES - sent;
+		if (chunk > sizeof(buf))
+			chunk = sizeof(buf);
+		ret = send(fd, buf, chunk, 0);
+		if (ret <= 0) {
+			perror("send");
+			break;
+		}
+		sent += ret;
+	}
+
+	len = sizeof(t->cli_ca_after);
+	getsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, t->cli_ca_after, &len);
+	len = sizeof(t->cli_info);
+	getsockopt(fd, IPPROTO_TCP, TCP_INFO, &t->cli_info, &len);
+
+	shutdown(fd, SHUT_WR);
+	pthread_join(thread, NULL);
+	close(fd);
+	close(t->lfd);
+
+	if (t->received != TOTAL_BYTES) {
+		printf("FAIL: %s: received %zu of %u bytes\n", t->cli_ca,
+		       t->received, TOTAL_BYTES);
+		return -1;
+	}
+	return 0;
+err:
+	if (fd >= 0)
+		close(fd);
+	if (t->lfd >= 0)
+		close(t->lfd);
+	return -1;
+}
+
+/* Run a transfer with both ends on @ca while lo marks packets CE; the
+ * sender must have left slow start with a reduced window.
+ */
+static int run_ce_transfer(struct transfer *t, const char *ca)
+{
+	t->cli_ca = ca;
+	t->srv_ca = ca;
+	if (run_transfer(t))
+		return -1;
+
+	printf("%s with CE marks: cwnd %u ssthresh %u\n", ca,
+	       t->cli_info.tcpi_snd_cwnd, t->cli_info.tcpi_snd_ssthresh);
+	if (!(t->cli_info.tcpi_options & TCPI_OPT_ECN) ||
+	    t->cli_info.tcpi_snd_ssthresh >= TCP_INFINITE_SSTHRESH) {
+		printf("FAIL: %s did not reduce its window on CE\n", ca);
+		return -1;
+	}
+	return 0;
+}
+
+static int test_ce_marking(int stats_fd)
+{
+	struct bpf_tcp_ca_stats before = {}, after = {};
+	struct transfer t = {};
+	__u32 bpf_ssthresh;
+	__u32 key = 0;
+	int err = -1;
+
+	if (system(CE_QDISC " 2> /dev/null")) {
+		printf("netem: not available, skipping CE marking\n");
+		return 0;
+	}
+
+	if (bpf_map_lookup_elem(stats_fd, &key, &before) ||
+	    run_ce_transfer(&t, CA_NAME) ||
+	    bpf_map_lookup_elem(stats_fd, &key, &after))
+		goto out;
+
+	/* the receiver echoed the marks, the sender cut its window */
+	if (after.ce_changes == before.ce_changes ||
+	    after.calls[BPF_TCP_CA_OP_SSTHRESH] ==
+	    before.calls[BPF_TCP_CA_OP_SSTHRESH]) {
+		printf("FAIL: %s: %llu CE changes, %llu ssthresh calls\n",
+		       CA_NAME, after.ce_changes - before.ce_changes,
+		       after.calls[BPF_TCP_CA_OP_SSTHRESH] -
+		       before.calls[BPF_TCP_CA_OP_SSTHRESH]);
+		goto out;
+	}
+	bpf_ssthresh = t.cli_info.tcpi_snd_ssthresh;
+
+	if (!ca_available("dctcp")) {
+		printf("dctcp: not available, skipping CE comparison\n");
+		err = 0;
+		goto out;
+	}
+	if (run_ce_transfer(&t, "dctcp"))
+		goto out;
+
+	if (bpf_ssthresh > t.cli_info.tcpi_snd_ssthresh * CE_SSTHRESH_FACTOR ||
+	    t.cli_info.tcpi_snd_ssthresh > bpf_ssthresh * CE_SSTHRESH_FACTOR) {
+		printf("FAIL: ssthresh %u of %s and %u of dctcp differ by more than %dx\n",
+		       bpf_ssthresh, CA_NAME, t.cli_info.tcpi_snd_ssthresh,
+		       CE_SSTHRESH_FACTOR);
+		goto out;
+	}
+	err = 0;
+out:
+	system("tc qdisc del dev lo root 2> /dev/null");
+	return err;
+}
+
+static int write_sysctl(const char *path, const char *val)
+{
+	FILE *f = fopen(path, "w");
+	int err;
+
+	if (!f)
+		return -1;
+	err = fputs(val, f) < 0;
+	return fclose(f) || err ? -1 : 0;
+}
+
+static int read_sysctl(const char *path, char *val, int size)
+{
+	FILE *f = fopen(path, "r");
+	int err;
+
+	if (!f)
+		return -1;
+	err = !fgets(val, size, f);
+	fclose(f);
+	return err ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct bpf_prog_load_attr attr = {
+		.file = "./bpf_dctcp.o",
+		.prog_type = BPF_PROG_TYPE_UNSPEC,
+	};
+	struct bpf_tcp_congestion_ops ops = {
+		.name = CA_NAME,
+		.flags = BPF_TCP_CA_NEEDS_ECN,
+	};
+	struct bpf_tcp_ca_stats st = {};
+	struct transfer t = {};
+	__u32 *ops_fds = &ops.init;
+	int map_fd = -1, stats_fd;
+	struct bpf_object *obj;
+	char ecn_sysctl[16];
+	int i, ret, prog_fd;
+	int err = 1;
+	__u32 key = 0;
+
+	/* the CE run changes the qdisc of lo, keep that to ourselves */
+	if (unshare(CLONE_NEWNET) || system("ip link set dev lo up")) {
+		printf("FAIL: setting up a network namespace\n");
+		return 1;
+	}
+
+	if (bpf_prog_load_xattr(&attr, &obj, &prog_fd)) {
+		printf("FAIL: loading %s\n", attr.file);
+		return 1;
+	}
+
+	for (i = 0; i < __BPF_TCP_CA_OP_MAX; i++) {
+		struct bpf_program *prog;
+
+		if (!prog_titles[i])
+			continue;
+		prog = bpf_object__find_program_by_title(obj, prog_titles[i]);
+		if (!prog) {
+			printf("FAIL: no program %s\n", prog_titles[i]);
+			goto out;
+		}
+		ops_fds[i] = bpf_program__fd(prog);
+	}
+
+	stats_fd = bpf_map__fd(bpf_object__find_map_by_name(obj, "stats_map"));
+	if (stats_fd < 0) {
+		printf("FAIL: no stats_map\n");
+		goto out;
+	}
+
+	map_fd = create_struct_ops_map();
+	if (map_fd < 0) {
+		printf("FAIL: creating struct_ops map: %s\n", strerror(errno));
+		goto out;
+	}
+
+	if (bpf_map_update_elem(map_fd, &key, &ops, BPF_ANY)) {
+		printf("FAIL: registering %s: %s\n", CA_NAME, strerror(errno));
+		goto out;
+	}
+
+	/* a second registration of the same table must fail */
+	if (!bpf_map_update_elem(map_fd, &key, &ops, BPF_ANY) ||
+	    errno != EBUSY) {
+		printf("FAIL: second update did not fail with EBUSY\n");
+		goto out;
+	}
+
+	/* lookup reports program ids */
+	memset(&ops, 0, sizeof(ops));
+	if (bpf_map_lookup_elem(map_fd, &key, &ops) ||
+	    strcmp(ops.name, CA_NAME) || !ops.init || !ops.cong_avoid ||
+	    ops.release || ops.pkts_acked) {
+		printf("FAIL: lookup of the registered table\n");
+		goto out;
+	}
+
+	t.cli_ca = CA_NAME;
+	t.srv_ca = CA_NAME;
+	if (run_transfer(&t))
+		goto out;
+	if (strcmp(t.cli_ca_after, CA_NAME)) {
+		printf("FAIL: ECN connection ended up with %s\n",
+		       t.cli_ca_after);
+		goto out;
+	}
+
+	if (bpf_map_lookup_elem(stats_fd, &key, &st) ||
+	    st.calls[BPF_TCP_CA_OP_INIT] < 2 ||
+	    !st.calls[BPF_TCP_CA_OP_CONG_AVOID] ||
+	    !st.calls[BPF_TCP_CA_OP_IN_ACK_EVENT] ||
+	    !st.calls[BPF_TCP_CA_OP_CWND_EVENT] || st.fallbacks) {
+		printf("FAIL: unexpected operation counts\n");
+		goto out;
+	}
+	printf("bpf_dctcp: init %llu cong_avoid %llu in_ack_event %llu cwnd_event %llu, cwnd %u ssthresh %u\n",
+	       st.calls[BPF_TCP_CA_OP_INIT],
+	       st.calls[BPF_TCP_CA_OP_CONG_AVOID],
+	       st.calls[BPF_TCP_CA_OP_IN_ACK_EVENT],
+	       st.calls[BPF_TCP_CA_OP_CWND_EVENT],
+	       t.cli_info.tcpi_snd_cwnd, t.cli_info.tcpi_snd_ssthresh);
+
+	/* the C version, if it is there, for comparison */
+	t.cli_ca = "dctcp";
+	t.srv_ca = "dctcp";
+	if (!ca_available("dctcp")) {
+		printf("dctcp: not available, skipping comparison\n");
+	} else {
+		struct tcp_info bpf_info = t.cli_info;
+
+		if (run_transfer(&t))
+			goto out;
+		printf("dctcp: cwnd %u ssthresh %u\n",
+		       t.cli_info.tcpi_snd_cwnd, t.cli_info.tcpi_snd_ssthresh);
+		if ((bpf_info.tcpi_options & TCPI_OPT_ECN) !=
+		    (t.cli_info.tcpi_options & TCPI_OPT_ECN)) {
+			printf("FAIL: ECN negotiated differently than dctcp\n");
+			goto out;
+		}
+	}
+
+	if (test_ce_marking(stats_fd))
+		goto out;
+
+	/* a peer refusing ECN makes bpf_dctcp fall back to reno */
+	if (read_sysctl(TCP_ECN_SYSCTL, ecn_sysctl, sizeof(ecn_sysctl)) ||
+	    write_sysctl(TCP_ECN_SYSCTL, "0")) {
+		printf("FAIL: setting %s\n", TCP_ECN_SYSCTL);
+		goto out;
+	}
+	t.cli_ca = CA_NAME;
+	t.srv_ca = "reno";
+	ret = run_transfer(&t);
+	write_sysctl(TCP_ECN_SYSCTL, ecn_sysctl);
+	if (ret)
+		goto out;
+	if (strcmp(t.cli_ca_after, "reno")) {
+		printf("FAIL: connection without ECN kept %s\n",
+		       t.cli_ca_after);
+		goto out;
+	}
+
+	if (bpf_map_delete_elem(map_fd, &key)) {
+		printf("FAIL: unregistering %s: %s\n", CA_NAME,
+		       strerror(errno));
+		goto out;
+	}
+	if (ca_available(CA_NAME)) {
+		printf("FAIL: %s still selectable after delete\n", CA_NAME);
+		goto out;
+	}
+
+	printf("PASSED!\n");
+	err = 0;
+out:
+	if (map_fd >= 0)
+		close(map_fd);
+	bpf_object__close(obj);
+	return err;
+}
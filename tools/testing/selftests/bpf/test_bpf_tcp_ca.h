@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#ifndef _TEST_BPF_TCP_CA_H
+#define _TEST_BPF_TCP_CA_H
+
+struct bpf_tcp_ca_stats {
+	__u64 calls[__BPF_TCP_CA_OP_MAX];	/* per BPF_TCP_CA_OP_* */
+	__u64 ce_changes;			/* CE state flips seen */
+	__u64 fallbacks;			/* connections without ECN */
+};
+#endif
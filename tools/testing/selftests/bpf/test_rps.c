@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Attach the BPF_PROG_TYPE_RPS program of progs/test_rps_kern.c to a
+ * private network namespace and check, over loopback, that:
+ *
+ * - UDP datagrams to a port in port_cpu_map are processed on the CPU
+ *   the map names, for every CPU we may run on;
+ * - datagrams to other ports, and to a port mapped to a CPU that does
+ *   not exist, are still delivered by the default RPS path;
+ * - only one program can be attached, and detaching it works once.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include <linux/bpf.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "bpf_rlimit.h"
+#include "test_rps.h"
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU	49
+#endif
+
+#define MSG		"steer me"
+#define BAD_CPU		(1U << 20)
+
+static int lo_up(void)
+{
+	struct ifreq ifr = {};
+	int fd, err;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return -1;
+
+	strcpy(ifr.ifr_name, "lo");
+	err = ioctl(fd, SIOCGIFFLAGS, &ifr);
+	if (!err) {
+		ifr.ifr_flags |= IFF_UP;
+		err = ioctl(fd, SIOCSIFFLAGS, &ifr);
+	}
+	close(fd);
+	return err;
+}
+
+static int udp_socket(struct sockaddr_in *addr)
+{
+	socklen_t len = sizeof(*addr);
+	int fd;
+
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr->sin_port = 0;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)addr, sizeof(*addr)) ||
+	    getsockname(fd, (struct sockaddr *)addr, &len)) {
+		perror("udp socket");
+		return -1;
+	}
+	return fd;
+}
+
+/* Send one datagram from @tx to @rx, return the CPU that received it.
+ * The sockets are connected to each other, UDP only records the
+ * incoming CPU of connected sockets.
+ */
+static int send_recv(int tx, int rx)
+{
+	char buf[sizeof(MSG)];
+	socklen_t len = sizeof(int);
+	int cpu = -1;
+
+	if (send(tx, MSG, sizeof(MSG), 0) != sizeof(MSG)) {
+		perror("send");
+		return -1;
+	}
+	if (recv(rx, buf, sizeof(buf), 0) != sizeof(MSG)) {
+		perror("recv");
+		return -1;
+	}
+	if (getsockopt(rx, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len)) {
+		perror("getsockopt SO_INCOMING_CPU");
+		return -1;
+	}
+	return cpu;
+}
+
+static __u64 read_stat(int stats_fd, __u32 idx)
+{
+	__u64 val = 0;
+
+	bpf_map_lookup_elem(stats_fd, &idx, &val);
+	return val;
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in rx_addr, tx_addr;
+	int prog_fd, port_fd, stats_fd;
+	int rx = -1, tx = -1, got;
+	struct bpf_object *obj;
+	__u64 steered, fallback;
+	bool attached = false;
+	cpu_set_t cpus;
+	__u32 cpu;
+	__u16 port;
+	int err = 1;
+
+	if (unshare(CLONE_NEWNET) || lo_up()) {
+		perror("setting up netns");
+		return 1;
+	}
+
+	if (sched_getaffinity(0, sizeof(cpus), &cpus)) {
+		perror("sched_getaffinity");
+		return 1;
+	}
+
+	if (bpf_prog_load("./test_rps_kern.o", BPF_PROG_TYPE_RPS, &obj,
+			  &prog_fd)) {
+		printf("FAIL: loading test_rps_kern.o\n");
+		return 1;
+	}
+
+	port_fd = bpf_map__fd(bpf_object__find_map_by_name(obj,
+							   "port_cpu_map"));
+	stats_fd = bpf_map__fd(bpf_object__find_map_by_name(obj, "stats_map"));
+	if (port_fd < 0 || stats_fd < 0) {
+		printf("FAIL: missing maps\n");
+		goto out;
+	}
+
+	if (bpf_prog_attach(prog_fd, 0, BPF_RPS, 0)) {
+		printf("FAIL: attach: %s\n", strerror(errno));
+		goto out;
+	}
+	attached = true;
+
+	if (!bpf_prog_attach(prog_fd, 0, BPF_RPS, 0) || errno != EEXIST) {
+		printf("FAIL: second attach did not fail with EEXIST\n");
+		goto out;
+	}
+
+	rx = udp_socket(&rx_addr);
+	tx = udp_socket(&tx_addr);
+	if (rx < 0 || tx < 0 ||
+	    connect(rx, (struct sockaddr *)&tx_addr, sizeof(tx_addr)) ||
+	    connect(tx, (struct sockaddr *)&rx_addr, sizeof(rx_addr))) {
+		printf("FAIL: connecting sockets\n");
+		goto out;
+	}
+	port = ntohs(rx_addr.sin_port);
+
+	/* no entry for the port yet, the default path delivers it */
+	if (send_recv(tx, rx) < 0 || !read_stat(stats_fd, RPS_STAT_FALLBACK)) {
+		printf("FAIL: unmapped port\n");
+		goto out;
+	}
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &cpus))
+			continue;
+
+		if (bpf_map_update_elem(port_fd, &port, &cpu, BPF_ANY)) {
+			printf("FAIL: port_cpu_map update\n");
+			goto out;
+		}
+		got = send_recv(tx, rx);
+		if (got != cpu) {
+			printf("FAIL: steered to CPU %u, received on %d\n",
+			       cpu, got);
+			goto out;
+		}
+	}
+
+	steered = read_stat(stats_fd, RPS_STAT_STEERED);
+	if (steered < CPU_COUNT(&cpus)) {
+		printf("FAIL: %llu packets steered for %d CPUs\n", steered,
+		       CPU_COUNT(&cpus));
+		goto out;
+	}
+
+	/* a CPU that does not exist leaves the packet to RPS */
+	cpu = BAD_CPU;
+	if (bpf_map_update_elem(port_fd, &port, &cpu, BPF_ANY) ||
+	    send_recv(tx, rx) < 0) {
+		printf("FAIL: invalid CPU\n");
+		goto out;
+	}
+
+	fallback = read_stat(stats_fd, RPS_STAT_FALLBACK);
+	printf("rps: %llu packets steered over %d CPUs, %llu left to RPS\n",
+	       steered, CPU_COUNT(&cpus), fallback);
+
+	attached = false;
+	if (bpf_prog_detach(0, BPF_RPS)) {
+		printf("FAIL: detach: %s\n", strerror(errno));
+		goto out;
+	}
+	if (!bpf_prog_detach(0, BPF_RPS) || errno != ENOENT) {
+		printf("FAIL: second detach did not fail with ENOENT\n");
+		goto out;
+	}
+
+	printf("PASS\n");
+	err = 0;
+out:
+	if (attached)
+		bpf_prog_detach(0, BPF_RPS);
+	if (tx >= 0)
+		close(tx);
+	if (rx >= 0)
+		close(rx);
+	bpf_object__close(obj);
+	return err;
+}
@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __TEST_RPS_H
+#define __TEST_RPS_H
+
+enum rps_stats_idx {
+	RPS_STAT_STEERED,
+	RPS_STAT_FALLBACK,
+	__NR_RPS_STATS,
+};
+
+#endif
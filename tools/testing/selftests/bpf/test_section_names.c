@@ -89,6 +89,13 @@ static struct sec_name_test tests[] = {
 		{0, BPF_PROG_TYPE_FLOW_DISSECTOR, 0},
 		{0, BPF_FLOW_DISSECTOR},
 	},
+	{"rps", {0, BPF_PROG_TYPE_RPS, 0}, {0, BPF_RPS} },
+	{"sk_lookup", {0, BPF_PROG_TYPE_SK_LOOKUP, 0}, {0, BPF_SK_LOOKUP} },
+	{
+		"struct_ops/tcp_ca",
+		{0, BPF_PROG_TYPE_STRUCT_OPS, BPF_STRUCT_OPS_TCP_CONGESTION},
+		{-EINVAL, 0},
+	},
 	{
 		"cgroup/bind4",
 		{0, BPF_PROG_TYPE_CGROUP_SOCK_ADDR, BPF_CGROUP_INET4_BIND},
@@ -0,0 +1,257 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Attach the BPF_PROG_TYPE_SK_LOOKUP program of
+ * progs/test_sk_lookup_prog.c to a private network namespace, in which
+ * one TCP listener and one UDP socket, both bound to a single port, have
+ * to serve a whole range of addresses and ports:
+ *
+ * - connections and datagrams to any port of the range and any loopback
+ *   address reach them;
+ * - the program's drop port is refused, and ports outside of the range
+ *   are looked up as usual;
+ * - only one program can be attached, and once it is detached the range
+ *   is gone again.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <linux/bpf.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "bpf_rlimit.h"
+#include "bpf_util.h"
+#include "test_sk_lookup.h"
+
+#define MSG		"looked up"
+
+static int lo_up(void)
+{
+	struct ifreq ifr = {};
+	int fd, err;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return -1;
+
+	strcpy(ifr.ifr_name, "lo");
+	err = ioctl(fd, SIOCGIFFLAGS, &ifr);
+	if (!err) {
+		ifr.ifr_flags |= IFF_UP;
+		err = ioctl(fd, SIOCSIFFLAGS, &ifr);
+	}
+	close(fd);
+	return err;
+}
+
+static void make_addr(struct sockaddr_in *addr, const char *ip, int port)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_port = htons(port);
+	inet_pton(AF_INET, ip, &addr->sin_addr);
+}
+
+/* reuseport sockarray only takes sockets of a reuseport group */
+static int bound_socket(int type)
+{
+	struct timeval tv = { .tv_sec = 1 };
+	struct sockaddr_in addr;
+	int fd, one = 1;
+
+	make_addr(&addr, "127.0.0.1", 0);
+	fd = socket(AF_INET, type, 0);
+	if (fd < 0 ||
+	    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) ||
+	    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) ||
+	    bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    (type == SOCK_STREAM && listen(fd, 8))) {
+		perror("bound socket");
+		return -1;
+	}
+	return fd;
+}
+
+/* connect to @ip:@port, return 0 if @lfd accepted it at that address */
+static int tcp_connect(int lfd, const char *ip, int port)
+{
+	struct sockaddr_in addr, local;
+	socklen_t len = sizeof(local);
+	int fd, afd, err = -1;
+
+	make_addr(&addr, ip, port);
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+		goto out;
+
+	afd = accept(lfd, NULL, NULL);
+	if (afd < 0)
+		goto out;
+	if (!getsockname(afd, (struct sockaddr *)&local, &len) &&
+	    local.sin_addr.s_addr == addr.sin_addr.s_addr &&
+	    local.sin_port == addr.sin_port)
+		err = 0;
+	close(afd);
+out:
+	close(fd);
+	return err;
+}
+
+/* send to @ip:@port, return 0 if @ufd received it */
+static int udp_send(int ufd, const char *ip, int port)
+{
+	struct sockaddr_in addr;
+	char buf[sizeof(MSG)];
+	int fd, err = -1;
+
+	make_addr(&addr, ip, port);
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return -1;
+	if (sendto(fd, MSG, sizeof(MSG), 0, (struct sockaddr *)&addr,
+		   sizeof(addr)) != sizeof(MSG))
+		goto out;
+	if (recv(ufd, buf, sizeof(buf), 0) == sizeof(MSG) &&
+	    !memcmp(buf, MSG, sizeof(MSG)))
+		err = 0;
+out:
+	close(fd);
+	return err;
+}
+
+static bool refused(const char *ip, int port)
+{
+	struct sockaddr_in addr;
+	bool ret;
+	int fd;
+
+	make_addr(&addr, ip, port);
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return false;
+	ret = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) &&
+	      errno == ECONNREFUSED;
+	close(fd);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	static const char * const ips[] = { "127.0.0.1", "127.0.0.2",
+					    "127.1.2.3" };
+	static const int ports[] = { REDIR_PORT_LO, 7042, REDIR_PORT_HI };
+	int prog_fd, map_fd, lfd = -1, ufd = -1;
+	struct bpf_object *obj;
+	bool attached = false;
+	__u32 key;
+	__u64 val;
+	int i, j;
+	int err = 1;
+
+	if (unshare(CLONE_NEWNET) || lo_up()) {
+		perror("setting up netns");
+		return 1;
+	}
+
+	if (bpf_prog_load("./test_sk_lookup_prog.o", BPF_PROG_TYPE_SK_LOOKUP,
+			  &obj, &prog_fd)) {
+		printf("FAIL: loading test_sk_lookup_prog.o\n");
+		return 1;
+	}
+
+	map_fd = bpf_map__fd(bpf_object__find_map_by_name(obj, "redir_map"));
+	lfd = bound_socket(SOCK_STREAM);
+	ufd = bound_socket(SOCK_DGRAM);
+	if (map_fd < 0 || lfd < 0 || ufd < 0)
+		goto out;
+
+	key = REDIR_TCP;
+	val = lfd;
+	if (bpf_map_update_elem(map_fd, &key, &val, BPF_ANY)) {
+		printf("FAIL: adding listener: %s\n", strerror(errno));
+		goto out;
+	}
+	key = REDIR_UDP;
+	val = ufd;
+	if (bpf_map_update_elem(map_fd, &key, &val, BPF_ANY)) {
+		printf("FAIL: adding UDP socket: %s\n", strerror(errno));
+		goto out;
+	}
+
+	if (bpf_prog_attach(prog_fd, 0, BPF_SK_LOOKUP, 0)) {
+		printf("FAIL: attach: %s\n", strerror(errno));
+		goto out;
+	}
+	attached = true;
+
+	if (!bpf_prog_attach(prog_fd, 0, BPF_SK_LOOKUP, 0) ||
+	    errno != EEXIST) {
+		printf("FAIL: second attach did not fail with EEXIST\n");
+		goto out;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(ips); i++) {
+		for (j = 0; j < ARRAY_SIZE(ports); j++) {
+			if (tcp_connect(lfd, ips[i], ports[j])) {
+				printf("FAIL: TCP %s:%d not redirected\n",
+				       ips[i], ports[j]);
+				goto out;
+			}
+			if (udp_send(ufd, ips[i], ports[j])) {
+				printf("FAIL: UDP %s:%d not redirected\n",
+				       ips[i], ports[j]);
+				goto out;
+			}
+		}
+	}
+
+	if (!refused("127.0.0.1", DROP_PORT)) {
+		printf("FAIL: drop port not refused\n");
+		goto out;
+	}
+	if (!refused("127.0.0.1", REDIR_PORT_HI + 2)) {
+		printf("FAIL: port outside of the range not refused\n");
+		goto out;
+	}
+
+	attached = false;
+	if (bpf_prog_detach(0, BPF_SK_LOOKUP)) {
+		printf("FAIL: detach: %s\n", strerror(errno));
+		goto out;
+	}
+	if (!bpf_prog_detach(0, BPF_SK_LOOKUP) || errno != ENOENT) {
+		printf("FAIL: second detach did not fail with ENOENT\n");
+		goto out;
+	}
+	if (!refused("127.0.0.1", REDIR_PORT_LO)) {
+		printf("FAIL: range still served after detach\n");
+		goto out;
+	}
+
+	printf("PASS\n");
+	err = 0;
+out:
+	if (attached)
+		bpf_prog_detach(0, BPF_SK_LOOKUP);
+	if (ufd >= 0)
+		close(ufd);
+	if (lfd >= 0)
+		close(lfd);
+	bpf_object__close(obj);
+	return err;
+}
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __TEST_SK_LOOKUP_H
+#define __TEST_SK_LOOKUP_H
+
+/* Local ports [REDIR_PORT_LO, REDIR_PORT_HI] go to the sockets in
+ * redir_map, DROP_PORT is refused.
+ */
+#define REDIR_PORT_LO	7000
+#define REDIR_PORT_HI	7099
+#define DROP_PORT	7100
+
+enum redir_idx {
+	REDIR_TCP,
+	REDIR_UDP,
+	__NR_REDIR,
+};
+
+#endif
@@ -1704,6 +1704,15 @@ static int __test_suite(int cg_fd, char *bpf_file)
 	if (err)
 		goto out;
 
+	/* Tests the basic commands again with kTLS on both ends, the stream
+	 * verdict program then runs on the decrypted records.
+	 */
+	ktls = 1;
+	err = test_txmsg(cg_fd);
+	ktls = 0;
+	if (err)
+		goto out;
+
 out:
 	printf("Summary: %i PASSED %i FAILED\n", passed, failed);
 	if (cleanup < 0) {
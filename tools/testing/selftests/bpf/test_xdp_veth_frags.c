@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Send jumbo frames over a veth pair whose receiving end runs a
+ * multi-buffer XDP program that trims the fragments off with
+ * bpf_xdp_adjust_tail(), then check that:
+ *
+ * - the frames really were copied to page_pool backed multi-buffers;
+ * - every page the pool handed out came back to it, including the
+ *   trimmed fragments, as counted by the rx_pp_* ethtool stats;
+ * - the device can be deleted afterwards.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/socket.h>
+
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/bpf.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "bpf_rlimit.h"
+
+#define TX_DEV		"veth_frags0"
+#define RX_DEV		"veth_frags1"
+#define FRAME_LEN	6000
+#define TRIM_LEN	3000
+#define NR_FRAMES	64
+
+/* frames longer than a page lose their last TRIM_LEN bytes */
+static const struct bpf_insn prog[] = {
+	BPF_MOV64_REG(BPF_REG_6, BPF_REG_1),
+	BPF_EMIT_CALL(BPF_FUNC_xdp_get_buff_len),
+	BPF_JMP_IMM(BPF_JLT, BPF_REG_0, 4096, 3),
+	BPF_MOV64_REG(BPF_REG_1, BPF_REG_6),
+	BPF_MOV64_IMM(BPF_REG_2, -TRIM_LEN),
+	BPF_EMIT_CALL(BPF_FUNC_xdp_adjust_tail),
+	BPF_MOV64_IMM(BPF_REG_0, XDP_PASS),
+	BPF_EXIT_INSN(),
+};
+
+struct pp_stats {
+	unsigned long long out;		/* pages handed out by the pool */
+	unsigned long long back;	/* pages given back to it */
+};
+
+static int read_pp_stats(struct pp_stats *st)
+{
+	static const char * const out_names[] = {
+		"rx_pp_alloc_fast", "rx_pp_alloc_slow",
+		"rx_pp_alloc_slow_ho", "rx_pp_alloc_refill",
+	};
+	static const char * const back_names[] = {
+		"rx_pp_recycle_cached", "rx_pp_recycle_ring",
+		"rx_pp_recycle_ring_full", "rx_pp_recycle_released_ref",
+	};
+	unsigned long long val;
+	char line[256], name[64];
+	int i, found = 0;
+	FILE *f;
+
+	memset(st, 0, sizeof(*st));
+	f = popen("ethtool -S " RX_DEV, "r");
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, " %63[^:]: %llu", name, &val) != 2)
+			continue;
+		for (i = 0; i < sizeof(out_names) / sizeof(out_names[0]); i++) {
+			if (!strcmp(name, out_names[i])) {
+				st->out += val;
+				found++;
+			}
+		}
+		for (i = 0; i < sizeof(back_names) / sizeof(back_names[0]); i++) {
+			if (!strcmp(name, back_names[i])) {
+				st->back += val;
+				found++;
+			}
+		}
+	}
+
+	if (pclose(f) || !found)
+		return -1;
+	return 0;
+}
+
+static int send_frames(int ifindex)
+{
+	struct sockaddr_ll addr = {
+		.sll_family = AF_PACKET,
+		.sll_ifindex = ifindex,
+		.sll_halen = ETH_ALEN,
+	};
+	static unsigned char frame[FRAME_LEN];
+	struct ethhdr *eth = (struct ethhdr *)frame;
+	int fd, i;
+
+	/* nobody handles ETH_P_802_EX1 so the stack frees the frames */
+	memset(eth->h_dest, 0xff, ETH_ALEN);
+	eth->h_proto = htons(ETH_P_802_EX1);
+	memset(frame + ETH_HLEN, 0x5a, sizeof(frame) - ETH_HLEN);
+
+	fd = socket(AF_PACKET, SOCK_RAW, 0);
+	if (fd < 0) {
+		perror("socket(AF_PACKET)");
+		return -1;
+	}
+
+	for (i = 0; i < NR_FRAMES; i++) {
+		if (sendto(fd, frame, sizeof(frame), 0,
+			   (struct sockaddr *)&addr, sizeof(addr)) != sizeof(frame)) {
+			perror("sendto");
+			close(fd);
+			return -1;
+		}
+	}
+
+	close(fd);
+	return 0;
+}
+
+int main(void)
+{
+	struct pp_stats st;
+	int prog_fd, ifindex, i;
+	char log[4096];
+
+	if (unshare(CLONE_NEWNET)) {
+		perror("unshare(CLONE_NEWNET)");
+		return 1;
+	}
+
+	if (system("ip link add " TX_DEV " mtu 9000 type veth peer name "
+		   RX_DEV " mtu 9000") ||
+	    system("ip link set " TX_DEV " up") ||
+	    system("ip link set " RX_DEV " up")) {
+		printf("FAIL: cannot create the veth pair\n");
+		return 1;
+	}
+
+	prog_fd = bpf_verify_program(BPF_PROG_TYPE_XDP, prog,
+				     sizeof(prog) / sizeof(prog[0]),
+				     BPF_F_XDP_HAS_FRAGS, "GPL", 0,
+				     log, sizeof(log), 1);
+	if (prog_fd < 0) {
+		printf("FAIL: loading the XDP program: %s\n%s",
+		       strerror(errno), log);
+		return 1;
+	}
+
+	ifindex = if_nametoindex(RX_DEV);
+	if (!ifindex || bpf_set_link_xdp_fd(ifindex, prog_fd, 0)) {
+		printf("FAIL: attaching the XDP program to " RX_DEV "\n");
+		return 1;
+	}
+
+	if (send_frames(if_nametoindex(TX_DEV)))
+		return 1;
+
+	/* NAPI and the frees behind it run asynchronously */
+	for (i = 0; i < 50; i++) {
+		if (read_pp_stats(&st)) {
+			printf("FAIL: no page_pool stats on " RX_DEV "\n");
+			return 1;
+		}
+		if (st.out >= 2 * NR_FRAMES && st.out == st.back)
+			break;
+		usleep(100000);
+	}
+
+	if (st.out < 2 * NR_FRAMES) {
+		printf("FAIL: %llu pages allocated for %d multi-buffer frames\n",
+		       st.out, NR_FRAMES);
+		return 1;
+	}
+	if (st.out != st.back) {
+		printf("FAIL: %llu of %llu pages not returned to the page_pool\n",
+		       st.out - st.back, st.out);
+		return 1;
+	}
+
+	/* with pages still in flight, this leaves the pool behind */
+	if (system("ip link del " TX_DEV)) {
+		printf("FAIL: deleting the veth pair\n");
+		return 1;
+	}
+
+	close(prog_fd);
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IPv6 TCP sender and receiver for big_tcp.sh.
+ *
+ * The receiver accepts one connection and copies the received stream
+ * to stdout, the sender copies stdin to the connection and then waits
+ * for the receiver to close it.
+ *
+ *	big_tcp [-p port] -l <address> > file
+ *	big_tcp [-p port] <address> < file
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <error.h>
+#include <netdb.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+/* more than 64KB per write, so that the sender can build big skbs */
+#define BUF_SIZE (256 * 1024)
+
+static const char *port = "12000";
+static bool listen_mode;
+
+static void usage(void)
+{
+	error(1, 0, "usage: big_tcp [-p port] [-l] <address>");
+}
+
+static int sock_setup(const char *host, bool server)
+{
+	struct addrinfo hints = {
+		.ai_family = AF_INET6,
+		.ai_socktype = SOCK_STREAM,
+		.ai_flags = server ? AI_PASSIVE : 0,
+	};
+	struct addrinfo *ai;
+	int one = 1;
+	int fd, err;
+
+	err = getaddrinfo(host, port, &hints, &ai);
+	if (err)
+		error(1, 0, "getaddrinfo %s: %s", host, gai_strerror(err));
+
+	fd = socket(ai->ai_family, SOCK_STREAM, IPPROTO_TCP);
+	if (fd < 0)
+		error(1, errno, "socket");
+
+	if (server) {
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)))
+			error(1, errno, "setsockopt SO_REUSEADDR");
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen))
+			error(1, errno, "bind");
+		if (listen(fd, 1))
+			error(1, errno, "listen");
+	} else {
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen))
+			error(1, errno, "connect");
+	}
+
+	freeaddrinfo(ai);
+	return fd;
+}
+
+static void write_all(int fd, const char *buf, ssize_t len)
+{
+	while (len > 0) {
+		ssize_t ret = write(fd, buf, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			error(1, errno, "write");
+		}
+		buf += ret;
+		len -= ret;
+	}
+}
+
+/* copy @in to @out until EOF */
+static void copy_stream(int in, int out)
+{
+	static char buf[BUF_SIZE];
+	ssize_t len;
+
+	for (;;) {
+		len = read(in, buf, sizeof(buf));
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			error(1, errno, "read");
+		}
+		if (!len)
+			break;
+
+		write_all(out, buf, len);
+	}
+}
+
+static void run_receiver(const char *host)
+{
+	int lfd, fd;
+
+	lfd = sock_setup(host, true);
+
+	/* tell the script we are ready */
+	fprintf(stderr, "listening\n");
+
+	fd = accept(lfd, NULL, NULL);
+	if (fd < 0)
+		error(1, errno, "accept");
+
+	copy_stream(fd, STDOUT_FILENO);
+
+	close(fd);
+	close(lfd);
+}
+
+static void run_sender(const char *host)
+{
+	char buf[1];
+	int fd;
+
+	fd = sock_setup(host, false);
+
+	copy_stream(STDIN_FILENO, fd);
+	if (shutdown(fd, SHUT_WR))
+		error(1, errno, "shutdown");
+
+	/* wait for the receiver to have read everything */
+	if (read(fd, buf, sizeof(buf)) < 0)
+		error(1, errno, "read");
+
+	close(fd);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "lp:")) != -1) {
+		switch (c) {
+		case 'l':
+			listen_mode = true;
+			break;
+		case 'p':
+			port = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (optind != argc - 1)
+		usage();
+
+	if (listen_mode)
+		run_receiver(argv[optind]);
+	else
+		run_sender(argv[optind]);
+
+	return 0;
+}
@@ -0,0 +1,107 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Send a file over IPv6 TCP with GSO packets larger than 64KB (big TCP)
+# and check that the data made it intact, without checksum errors:
+#
+#  ns1 veth0 ---- veth0 ns2
+#  fc00::1           fc00::2
+#
+# The sender's veth0 allows big GSO packets but has TSO and checksum
+# offload disabled, so each of them is segmented by tcp_gso_segment()
+# and the segments get their checksums computed in software.  The
+# receiver verifies them, a wrong checksum shows up in InCsumErrors.
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+ret=0
+
+sfx=$(mktemp -u "XXXXXXXX")
+ns1="ns1-$sfx"
+ns2="ns2-$sfx"
+
+size_kb=${SIZE_KB:-16384}
+gso_max_size=196608
+port=12000
+
+tmpin=$(mktemp)
+tmpout=$(mktemp)
+tmperr=$(mktemp)
+
+cleanup() {
+	ip netns pids $ns1 2>/dev/null | xargs -r kill 2>/dev/null
+	ip netns pids $ns2 2>/dev/null | xargs -r kill 2>/dev/null
+	ip netns del $ns1 2>/dev/null
+	ip netns del $ns2 2>/dev/null
+	rm -f "$tmpin" "$tmpout" "$tmperr"
+}
+trap cleanup EXIT
+
+for tool in ip ethtool; do
+	if ! command -v $tool > /dev/null 2>&1; then
+		echo "SKIP: Could not run test without $tool tool"
+		exit $ksft_skip
+	fi
+done
+
+if [ ! -x ./big_tcp ]; then
+	echo "SKIP: big_tcp not built"
+	exit $ksft_skip
+fi
+
+ip netns add $ns1
+if [ $? -ne 0 ]; then
+	echo "SKIP: Could not create net namespace"
+	exit $ksft_skip
+fi
+ip netns add $ns2
+
+ip link add veth0 netns $ns1 type veth peer name veth0 netns $ns2
+ip -net $ns1 addr add fc00::1/64 dev veth0 nodad
+ip -net $ns2 addr add fc00::2/64 dev veth0 nodad
+ip -net $ns1 link set veth0 up
+ip -net $ns2 link set veth0 up
+
+if ! ip -net $ns1 link set veth0 gso_max_size $gso_max_size 2>/dev/null; then
+	echo "SKIP: gso_max_size above 64KB not supported"
+	exit $ksft_skip
+fi
+ip netns exec $ns1 ethtool -K veth0 tso off tx off > /dev/null 2>&1
+
+csum_errors() {
+	ip netns exec $ns2 awk '/^Tcp: [0-9]/ { print $NF }' /proc/net/snmp
+}
+
+dd if=/dev/urandom of="$tmpin" bs=1024 count=$size_kb 2> /dev/null
+
+ip netns exec $ns2 ./big_tcp -p $port -l :: \
+	> "$tmpout" 2> "$tmperr" &
+spid=$!
+
+for i in $(seq 50); do
+	grep -q listening "$tmperr" && break
+	sleep 0.1
+done
+
+timeout 60 ip netns exec $ns1 ./big_tcp -p $port fc00::2 \
+	< "$tmpin"
+rc=$?
+wait $spid
+src=$?
+
+if [ $rc -ne 0 ] || [ $src -ne 0 ] || ! cmp -s "$tmpin" "$tmpout"; then
+	echo "FAIL: big TCP: client $rc server $src, data mismatch or error"
+	ret=1
+else
+	echo "PASS: big TCP: data intact"
+fi
+
+errors=$(csum_errors)
+if [ "$errors" != "0" ]; then
+	echo "FAIL: big TCP: $errors segments with a bad checksum"
+	ret=1
+else
+	echo "PASS: big TCP: no checksum errors"
+fi
+
+exit $ret
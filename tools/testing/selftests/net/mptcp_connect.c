@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Minimal Multipath TCP client and server, used by mptcp_connect.sh.
+ *
+ * The server accepts one connection and copies the received stream to
+ * stdout, the client copies stdin to the connection and then waits for
+ * the server to close it.
+ *
+ *	mptcp_connect [-6] [-t] [-p port] -l <address> > file
+ *	mptcp_connect [-6] [-t] [-p port] <address> < file
+ *
+ * -t uses plain TCP instead of MPTCP.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <error.h>
+#include <netdb.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#ifndef IPPROTO_MPTCP
+#define IPPROTO_MPTCP 262
+#endif
+
+#define BUF_SIZE 65536
+
+static int family = AF_INET;
+static int proto = IPPROTO_MPTCP;
+static const char *port = "12000";
+static bool listen_mode;
+
+static void usage(void)
+{
+	error(1, 0, "usage: mptcp_connect [-6] [-t] [-p port] [-l] <address>");
+}
+
+static int sock_setup(const char *host, bool server)
+{
+	struct addrinfo hints = {
+		.ai_family = family,
+		.ai_socktype = SOCK_STREAM,
+		.ai_flags = server ? AI_PASSIVE : 0,
+	};
+	struct addrinfo *ai;
+	int one = 1;
+	int fd, err;
+
+	err = getaddrinfo(host, port, &hints, &ai);
+	if (err)
+		error(1, 0, "getaddrinfo %s: %s", host, gai_strerror(err));
+
+	fd = socket(ai->ai_family, SOCK_STREAM, proto);
+	if (fd < 0) {
+		if (errno == EPROTONOSUPPORT || errno == ENOPROTOOPT)
+			exit(4);
+		error(1, errno, "socket");
+	}
+
+	if (server) {
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)))
+			error(1, errno, "setsockopt SO_REUSEADDR");
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen))
+			error(1, errno, "bind");
+		if (listen(fd, 1))
+			error(1, errno, "listen");
+	} else {
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen))
+			error(1, errno, "connect");
+	}
+
+	freeaddrinfo(ai);
+	return fd;
+}
+
+static void write_all(int fd, const char *buf, ssize_t len)
+{
+	while (len > 0) {
+		ssize_t ret = write(fd, buf, len);
+
+		if (ret < 0)
+			error(1, errno, "write");
+		buf += ret;
+		len -= ret;
+	}
+}
+
+/* copy @in to @out until EOF, returns the number of bytes copied */
+static size_t copy_stream(int in, int out)
+{
+	static char buf[BUF_SIZE];
+	size_t total = 0;
+	ssize_t len;
+
+	for (;;) {
+		len = read(in, buf, sizeof(buf));
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			error(1, errno, "read");
+		}
+		if (!len)
+			break;
+
+		write_all(out, buf, len);
+		total += len;
+	}
+	return total;
+}
+
+static void run_server(const char *host)
+{
+	int lfd, fd;
+
+	lfd = sock_setup(host, true);
+
+	/* tell the script we are ready */
+	fprintf(stderr, "listening\n");
+
+	fd = accept(lfd, NULL, NULL);
+	if (fd < 0)
+		error(1, errno, "accept");
+
+	copy_stream(fd, STDOUT_FILENO);
+
+	close(fd);
+	close(lfd);
+}
+
+static void run_client(const char *host)
+{
+	char buf[1];
+	int fd;
+
+	fd = sock_setup(host, false);
+
+	copy_stream(STDIN_FILENO, fd);
+	if (shutdown(fd, SHUT_WR))
+		error(1, errno, "shutdown");
+
+	/* wait for the server to have read everything */
+	if (read(fd, buf, sizeof(buf)) < 0)
+		error(1, errno, "read");
+
+	close(fd);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "6tlp:")) != -1) {
+		switch (c) {
+		case '6':
+			family = AF_INET6;
+			break;
+		case 't':
+			proto = IPPROTO_TCP;
+			break;
+		case 'l':
+			listen_mode = true;
+			break;
+		case 'p':
+			port = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (optind != argc - 1)
+		usage();
+
+	if (listen_mode)
+		run_server(argv[optind]);
+	else
+		run_client(argv[optind]);
+
+	return 0;
+}
@@ -0,0 +1,153 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Transfer a file over Multipath TCP between two namespaces connected by
+# two links, and check that the data made it intact and that the second
+# link carried a share of it:
+#
+#  ns1 veth0 ---- veth0 ns2
+#  10.0.1.1          10.0.1.2
+#  ns1 veth1 ---- veth1 ns2
+#  10.0.2.1          10.0.2.2
+#
+# The connection is opened on the first link, the client's path manager
+# adds a subflow from its second address. Fallback to TCP is checked
+# with a plain TCP peer on either side.
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+ret=0
+
+sfx=$(mktemp -u "XXXXXXXX")
+ns1="ns1-$sfx"
+ns2="ns2-$sfx"
+
+size_kb=${SIZE_KB:-8192}
+port=12000
+
+tmpin=$(mktemp)
+tmpout=$(mktemp)
+tmperr=$(mktemp)
+
+cleanup() {
+	ip netns pids $ns1 2>/dev/null | xargs -r kill 2>/dev/null
+	ip netns pids $ns2 2>/dev/null | xargs -r kill 2>/dev/null
+	ip netns del $ns1 2>/dev/null
+	ip netns del $ns2 2>/dev/null
+	rm -f "$tmpin" "$tmpout" "$tmperr"
+}
+trap cleanup EXIT
+
+if ! command -v ip > /dev/null 2>&1; then
+	echo "SKIP: Could not run test without ip tool"
+	exit $ksft_skip
+fi
+
+if [ ! -x ./mptcp_connect ]; then
+	echo "SKIP: mptcp_connect not built"
+	exit $ksft_skip
+fi
+
+ip netns add $ns1
+if [ $? -ne 0 ]; then
+	echo "SKIP: Could not create net namespace"
+	exit $ksft_skip
+fi
+ip netns add $ns2
+
+if ! ip netns exec $ns1 sysctl -q net.mptcp.enabled=1 2>/dev/null; then
+	echo "SKIP: MPTCP not supported"
+	exit $ksft_skip
+fi
+
+for i in 0 1; do
+	ip link add veth$i netns $ns1 type veth peer name veth$i netns $ns2
+	ip -net $ns1 addr add 10.0.$((i + 1)).1/24 dev veth$i
+	ip -net $ns2 addr add 10.0.$((i + 1)).2/24 dev veth$i
+	ip -net $ns1 link set veth$i up
+	ip -net $ns2 link set veth$i up
+	# some latency, so that both subflows get a share of the data
+	tc -net $ns1 qdisc add dev veth$i root netem delay 5ms 2>/dev/null
+done
+ip -net $ns1 link set lo up
+ip -net $ns2 link set lo up
+
+# the second address must reach the server through the second link
+ip -net $ns1 route add 10.0.1.2/32 dev veth1 src 10.0.2.1 table 100
+ip -net $ns1 rule add from 10.0.2.1 table 100
+
+dd if=/dev/urandom of="$tmpin" bs=1024 count=$size_kb 2> /dev/null
+
+tx_bytes() {
+	ip netns exec $ns1 cat /sys/class/net/$1/statistics/tx_bytes
+}
+
+# run_one <name> <server flags> <client flags>
+run_one() {
+	local name=$1
+	local srv_flags=$2
+	local cli_flags=$3
+	local i
+
+	port=$((port + 1))
+	: > "$tmperr"
+	ip netns exec $ns2 ./mptcp_connect $srv_flags -p $port -l 0.0.0.0 \
+		> "$tmpout" 2> "$tmperr" &
+	local spid=$!
+
+	for i in $(seq 50); do
+		grep -q listening "$tmperr" && break
+		sleep 0.1
+	done
+
+	timeout 60 ip netns exec $ns1 ./mptcp_connect $cli_flags -p $port \
+		10.0.1.2 < "$tmpin"
+	local rc=$?
+	wait $spid
+	local src=$?
+
+	if [ $rc -eq $ksft_skip ] || [ $src -eq $ksft_skip ]; then
+		echo "SKIP: $name: MPTCP sockets not supported"
+		return $ksft_skip
+	fi
+
+	if [ $rc -ne 0 ] || [ $src -ne 0 ] || ! cmp -s "$tmpin" "$tmpout"; then
+		echo "FAIL: $name: client $rc server $src, data mismatch or error"
+		ret=1
+		return 1
+	fi
+
+	echo "PASS: $name"
+	return 0
+}
+
+before=$(tx_bytes veth1)
+run_one "mptcp to mptcp" "" ""
+rc=$?
+[ $rc -eq $ksft_skip ] && exit $ksft_skip
+after=$(tx_bytes veth1)
+
+if [ $rc -eq 0 ]; then
+	sent=$((size_kb * 1024))
+	second=$((after - before))
+	if [ $second -gt $((sent / 10)) ]; then
+		echo "PASS: second subflow carried $second of $sent bytes"
+	else
+		echo "FAIL: second subflow carried $second of $sent bytes"
+		ret=1
+	fi
+fi
+
+run_one "tcp client to mptcp server" "" "-t"
+run_one "mptcp client to tcp server" "-t" ""
+
+ip netns exec $ns1 sysctl -q net.mptcp.enabled=0
+ip netns exec $ns1 ./mptcp_connect -p $port 10.0.1.2 < /dev/null 2> /dev/null
+if [ $? -eq $ksft_skip ]; then
+	echo "PASS: net.mptcp.enabled=0 refuses MPTCP sockets"
+else
+	echo "FAIL: MPTCP socket created with net.mptcp.enabled=0"
+	ret=1
+fi
+
+exit $ret
@@ -17,12 +17,18 @@
  * PF_RDS
  * - SOCK_SEQPACKET
  *
+ * PF_UNIX
+ * - SOCK_STREAM
+ *
  * Start this program on two connected hosts, one in send mode and
- * the other with option '-r' to put it in receiver mode.
+ * the other with option '-r' to put it in receiver mode. PF_UNIX uses
+ * an abstract address, so both must run in the same network namespace.
  *
  * If zerocopy mode ('-z') is enabled, the sender will verify that
  * the kernel queues completions on the error queue for all zerocopy
- * transfers.
+ * transfers. With '-n' the sender instead collects completions with
+ * an SCM_ZC_NOTIFICATION cmsg on each sendmsg call, and only reads
+ * the error queue while it waits for buffer space.
  */
 
 #define _GNU_SOURCE
@@ -54,6 +60,7 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <linux/rds.h>
@@ -74,6 +81,10 @@
 #define MSG_ZEROCOPY	0x4000000
 #endif
 
+#ifndef SCM_ZC_NOTIFICATION
+#define SCM_ZC_NOTIFICATION	68
+#endif
+
 static int  cfg_cork;
 static bool cfg_cork_mixed;
 static int  cfg_cpu		= -1;		/* default: pin to last cpu */
@@ -86,6 +97,7 @@ static int  cfg_runtime_ms	= 4200;
 static int  cfg_verbose;
 static int  cfg_waittime_ms	= 500;
 static bool cfg_zerocopy;
+static bool cfg_zc_notify;
 
 static socklen_t cfg_alen;
 static struct sockaddr_storage cfg_dst_addr;
@@ -93,9 +105,15 @@ static struct sockaddr_storage cfg_src_addr;
 
 static char payload[IP_MAXPACKET];
 static long packets, bytes, completions, expected_completions;
+static long errqueue_reads, cmsg_notifications;
 static int  zerocopied = -1;
 static uint32_t next_completion;
 
+static char zc_buf[sizeof(struct zc_info) +
+		   SOCK_ZC_INFO_MAX * sizeof(struct zc_info_elem)]
+		   __attribute__((aligned(8)));
+static char rx_buf[1 << 16];
+
 static unsigned long gettimeofday_ms(void)
 {
 	struct timeval tv;
@@ -181,11 +199,68 @@ static void add_zcopy_cookie(struct msghdr *msg, uint32_t cookie)
 	memcpy(CMSG_DATA(cm), &cookie, sizeof(cookie));
 }
 
+static void add_zc_notification(struct msghdr *msg, struct zc_info *zc)
+{
+	uint64_t addr = (unsigned long)zc;
+	struct cmsghdr *cm;
+
+	zc->size = SOCK_ZC_INFO_MAX;
+	zc->count = 0;
+
+	cm = (void *)msg->msg_control;
+	cm->cmsg_len = CMSG_LEN(sizeof(addr));
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_ZC_NOTIFICATION;
+	memcpy(CMSG_DATA(cm), &addr, sizeof(addr));
+}
+
+static void do_completion_range(uint32_t lo, uint32_t hi, int zerocopy)
+{
+	uint32_t range = hi - lo + 1;
+
+	/* Detect notification gaps. These should not happen often, if at all.
+	 * Gaps can occur due to drops, reordering and retransmissions.
+	 */
+	if (lo != next_completion)
+		fprintf(stderr, "gap: %u..%u does not append to %u\n",
+			lo, hi, next_completion);
+	next_completion = hi + 1;
+
+	if (zerocopied == -1)
+		zerocopied = zerocopy;
+	else if (zerocopied != zerocopy) {
+		fprintf(stderr, "serr: inconsistent\n");
+		zerocopied = zerocopy;
+	}
+
+	if (cfg_verbose >= 2)
+		fprintf(stderr, "completed: %u (h=%u l=%u)\n",
+			range, hi, lo);
+
+	completions += range;
+}
+
+static void do_process_zc_info(struct zc_info *zc)
+{
+	int i;
+
+	if (zc->count > zc->size)
+		error(1, 0, "zc_info: count %u > size %u", zc->count, zc->size);
+
+	for (i = 0; i < zc->count; i++)
+		do_completion_range(zc->arr[i].lo, zc->arr[i].hi,
+				    zc->arr[i].zerocopy);
+
+	cmsg_notifications += zc->count;
+}
+
 static bool do_sendmsg(int fd, struct msghdr *msg, bool do_zerocopy, int domain)
 {
+	struct zc_info *zc = (void *)zc_buf;
 	int ret, len, i, flags;
 	static uint32_t cookie;
-	char ckbuf[CMSG_SPACE(sizeof(cookie))];
+	char ckbuf[CMSG_SPACE(sizeof(uint64_t))];
+	bool zc_notify = false;
 
 	len = 0;
 	for (i = 0; i < msg->msg_iovlen; i++)
@@ -199,10 +274,23 @@ static bool do_sendmsg(int fd, struct msghdr *msg, bool do_zerocopy, int domain)
 			msg->msg_controllen = CMSG_SPACE(sizeof(cookie));
 			msg->msg_control = (struct cmsghdr *)ckbuf;
 			add_zcopy_cookie(msg, ++cookie);
+		} else if (cfg_zc_notify) {
+			msg->msg_controllen = CMSG_SPACE(sizeof(uint64_t));
+			msg->msg_control = (struct cmsghdr *)ckbuf;
+			add_zc_notification(msg, zc);
+			zc_notify = true;
 		}
 	}
 
 	ret = sendmsg(fd, msg, flags);
+
+	/* completions may be returned even if no data could be sent */
+	if (zc_notify) {
+		do_process_zc_info(zc);
+		msg->msg_control = NULL;
+		msg->msg_controllen = 0;
+	}
+
 	if (ret == -1 && errno == EAGAIN)
 		return false;
 	if (ret == -1)
@@ -297,6 +385,7 @@ static void setup_sockaddr(int domain, const char *str_addr,
 {
 	struct sockaddr_in6 *addr6 = (void *) sockaddr;
 	struct sockaddr_in *addr4 = (void *) sockaddr;
+	struct sockaddr_un *addrun = (void *) sockaddr;
 
 	switch (domain) {
 	case PF_INET:
@@ -315,6 +404,13 @@ static void setup_sockaddr(int domain, const char *str_addr,
 		    inet_pton(AF_INET6, str_addr, &(addr6->sin6_addr)) != 1)
 			error(1, 0, "ipv6 parse error: %s", str_addr);
 		break;
+	case PF_UNIX:
+		/* abstract address, derived from the port */
+		memset(addrun, 0, sizeof(*addrun));
+		addrun->sun_family = AF_UNIX;
+		snprintf(addrun->sun_path + 1, sizeof(addrun->sun_path) - 1,
+			 "msg_zerocopy.%d", cfg_port);
+		break;
 	default:
 		error(1, 0, "illegal domain");
 	}
@@ -395,9 +491,8 @@ static bool do_recv_completion(int fd, int domain)
 	struct sock_extended_err *serr;
 	struct msghdr msg = {};
 	struct cmsghdr *cm;
-	uint32_t hi, lo, range;
-	int ret, zerocopy;
 	char control[100];
+	int ret;
 
 	if (domain == PF_RDS)
 		return do_recvmsg_completion(fd);
@@ -413,12 +508,15 @@ static bool do_recv_completion(int fd, int domain)
 	if (msg.msg_flags & MSG_CTRUNC)
 		error(1, errno, "recvmsg notification: truncated");
 
+	errqueue_reads++;
+
 	cm = CMSG_FIRSTHDR(&msg);
 	if (!cm)
 		error(1, 0, "cmsg: no cmsg");
 	if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
 	      (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR) ||
-	      (cm->cmsg_level == SOL_PACKET && cm->cmsg_type == PACKET_TX_TIMESTAMP)))
+	      (cm->cmsg_level == SOL_PACKET && cm->cmsg_type == PACKET_TX_TIMESTAMP) ||
+	      (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_ZEROCOPY)))
 		error(1, 0, "serr: wrong type: %d.%d",
 		      cm->cmsg_level, cm->cmsg_type);
 
@@ -429,31 +527,8 @@ static bool do_recv_completion(int fd, int domain)
 	if (serr->ee_errno != 0)
 		error(1, 0, "serr: wrong error code: %u", serr->ee_errno);
 
-	hi = serr->ee_data;
-	lo = serr->ee_info;
-	range = hi - lo + 1;
-
-	/* Detect notification gaps. These should not happen often, if at all.
-	 * Gaps can occur due to drops, reordering and retransmissions.
-	 */
-	if (lo != next_completion)
-		fprintf(stderr, "gap: %u..%u does not append to %u\n",
-			lo, hi, next_completion);
-	next_completion = hi + 1;
-
-	zerocopy = !(serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
-	if (zerocopied == -1)
-		zerocopied = zerocopy;
-	else if (zerocopied != zerocopy) {
-		fprintf(stderr, "serr: inconsistent\n");
-		zerocopied = zerocopy;
-	}
-
-	if (cfg_verbose >= 2)
-		fprintf(stderr, "completed: %u (h=%u l=%u)\n",
-			range, hi, lo);
-
-	completions += range;
+	do_completion_range(serr->ee_info, serr->ee_data,
+			    !(serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED));
 	return true;
 }
 
@@ -566,6 +641,9 @@ static void do_tx(int domain, int type, int protocol)
 	fprintf(stderr, "tx=%lu (%lu MB) txc=%lu zc=%c\n",
 		packets, bytes >> 20, completions,
 		zerocopied == 1 ? 'y' : 'n');
+	if (cfg_zerocopy)
+		fprintf(stderr, "notifications: errqueue=%lu cmsg=%lu\n",
+			errqueue_reads, cmsg_notifications);
 }
 
 static int do_setup_rx(int domain, int type, int protocol)
@@ -587,7 +665,8 @@ static int do_setup_rx(int domain, int type, int protocol)
 
 	do_setsockopt(fd, SOL_SOCKET, SO_RCVBUF, 1 << 21);
 	do_setsockopt(fd, SOL_SOCKET, SO_RCVLOWAT, 1 << 16);
-	do_setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, 1);
+	if (domain != PF_UNIX)
+		do_setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, 1);
 
 	if (bind(fd, (void *) &cfg_dst_addr, cfg_alen))
 		error(1, errno, "bind");
@@ -602,12 +681,15 @@ static int do_setup_rx(int domain, int type, int protocol)
 }
 
 /* Flush all outstanding bytes for the tcp receive queue */
-static void do_flush_tcp(int fd)
+static void do_flush_tcp(int fd, int domain)
 {
 	int ret;
 
-	/* MSG_TRUNC flushes up to len bytes */
-	ret = recv(fd, NULL, 1 << 21, MSG_TRUNC | MSG_DONTWAIT);
+	/* MSG_TRUNC flushes up to len bytes, AF_UNIX must copy */
+	if (domain == PF_UNIX)
+		ret = recv(fd, rx_buf, sizeof(rx_buf), MSG_DONTWAIT);
+	else
+		ret = recv(fd, NULL, 1 << 21, MSG_TRUNC | MSG_DONTWAIT);
 	if (ret == -1 && errno == EAGAIN)
 		return;
 	if (ret == -1)
@@ -660,7 +742,7 @@ static void do_rx(int domain, int type, int protocol)
 	tstop = gettimeofday_ms() + cfg_runtime_ms + cfg_receiver_wait_ms;
 	do {
 		if (type == SOCK_STREAM)
-			do_flush_tcp(fd);
+			do_flush_tcp(fd, domain);
 		else
 			do_flush_datagram(fd, type);
 
@@ -709,7 +791,7 @@ static void parse_opts(int argc, char **argv)
 
 	cfg_payload_len = max_payload_len;
 
-	while ((c = getopt(argc, argv, "46c:C:D:i:mp:rs:S:t:vz")) != -1) {
+	while ((c = getopt(argc, argv, "46c:C:D:i:mnp:rs:S:t:vz")) != -1) {
 		switch (c) {
 		case '4':
 			if (cfg_family != PF_UNSPEC)
@@ -740,6 +822,9 @@ static void parse_opts(int argc, char **argv)
 		case 'm':
 			cfg_cork_mixed = true;
 			break;
+		case 'n':
+			cfg_zc_notify = true;
+			break;
 		case 'p':
 			cfg_port = strtoul(optarg, NULL, 0);
 			break;
@@ -771,6 +856,12 @@ static void parse_opts(int argc, char **argv)
 		if (!cfg_rx && !saddr)
 			error(1, 0, "-S <client addr> required for PF_RDS\n");
 	}
+	if (strcmp(cfg_test, "unix") == 0) {
+		cfg_family = PF_UNIX;
+		cfg_alen = sizeof(struct sockaddr_un);
+		daddr = NULL;
+		saddr = NULL;
+	}
 	setup_sockaddr(cfg_family, daddr, &cfg_dst_addr);
 	setup_sockaddr(cfg_family, saddr, &cfg_src_addr);
 
@@ -778,6 +869,8 @@ static void parse_opts(int argc, char **argv)
 		error(1, 0, "-s: payload exceeds max (%d)", max_payload_len);
 	if (cfg_cork_mixed && (!cfg_zerocopy || !cfg_cork))
 		error(1, 0, "-m: cork_mixed requires corking and zerocopy");
+	if (cfg_zc_notify && !cfg_zerocopy)
+		error(1, 0, "-n: notifications require zerocopy");
 
 	if (optind != argc - 1)
 		usage(argv[0]);
@@ -805,6 +898,8 @@ int main(int argc, char **argv)
 		do_test(cfg_family, SOCK_DGRAM, 0);
 	else if (!strcmp(cfg_test, "rds"))
 		do_test(PF_RDS, SOCK_SEQPACKET, 0);
+	else if (!strcmp(cfg_test, "unix"))
+		do_test(PF_UNIX, SOCK_STREAM, 0);
 	else
 		error(1, 0, "unknown cfg_test %s", cfg_test);
 
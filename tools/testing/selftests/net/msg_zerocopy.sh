@@ -1,7 +1,8 @@
 #!/bin/bash
 #
 # Send data between two processes across namespaces
-# Run twice: once without and once with zerocopy
+# Run three times: without zerocopy, with zerocopy and with zerocopy
+# completions returned on sendmsg
 
 set -e
 
@@ -27,13 +28,14 @@ if [[ "$#" -eq "0" ]]; then
 	$0 6 tcp -t 1
 	$0 4 udp -t 1
 	$0 6 udp -t 1
+	$0 4 unix -t 1
 	echo "OK. All tests passed"
 	exit 0
 fi
 
 # Argument parsing
 if [[ "$#" -lt "2" ]]; then
-	echo "Usage: $0 [4|6] [tcp|udp|raw|raw_hdrincl|packet|packet_dgram] <args>"
+	echo "Usage: $0 [4|6] [tcp|udp|raw|raw_hdrincl|packet|packet_dgram|unix] <args>"
 	exit 1
 fi
 
@@ -69,6 +71,13 @@ case "${TXMODE}" in
 	;;
 esac
 
+# AF_UNIX abstract addresses are local to a network namespace
+if [[ "${TXMODE}" == "unix" ]]; then
+	readonly RXNS="${NS1}"
+else
+	readonly RXNS="${NS2}"
+fi
+
 # Start of state changes: install cleanup handler
 save_sysctl_mem="$(sysctl -n ${path_sysctl_mem})"
 
@@ -111,7 +120,7 @@ do_test() {
 	local readonly ARGS="$1"
 
 	echo "ipv${IP} ${TXMODE} ${ARGS}"
-	ip netns exec "${NS2}" "${BIN}" "-${IP}" -i "${DEV}" -t 2 -C 2 -S "${SADDR}" -D "${DADDR}" ${ARGS} -r "${RXMODE}" &
+	ip netns exec "${RXNS}" "${BIN}" "-${IP}" -i "${DEV}" -t 2 -C 2 -S "${SADDR}" -D "${DADDR}" ${ARGS} -r "${RXMODE}" &
 	sleep 0.2
 	ip netns exec "${NS1}" "${BIN}" "-${IP}" -i "${DEV}" -t 1 -C 3 -S "${SADDR}" -D "${DADDR}" ${ARGS} "${TXMODE}"
 	wait
@@ -119,4 +128,5 @@ do_test() {
 
 do_test "${EXTRA_ARGS}"
 do_test "-z ${EXTRA_ARGS}"
+do_test "-z -n ${EXTRA_ARGS}"
 echo ok
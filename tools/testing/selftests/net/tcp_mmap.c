@@ -134,7 +134,7 @@ void hash_zone(void *zone, unsigned int length)
 
 void *child_thread(void *arg)
 {
-	unsigned long total_mmap = 0, total = 0;
+	unsigned long total_mmap = 0, total_copybuf = 0, total = 0;
 	struct tcp_zerocopy_receive zc;
 	unsigned long delta_usec;
 	int flags = MAP_SHARED;
@@ -169,9 +169,12 @@ void *child_thread(void *arg)
 			socklen_t zc_len = sizeof(zc);
 			int res;
 
+			memset(&zc, 0, sizeof(zc));
 			zc.address = (__u64)addr;
 			zc.length = chunk_size;
-			zc.recv_skip_hint = 0;
+			/* let the kernel copy what it cannot map */
+			zc.copybuf_address = (__u64)buffer;
+			zc.copybuf_len = chunk_size;
 			res = getsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE,
 					 &zc, &zc_len);
 			if (res == -1)
@@ -184,6 +187,13 @@ void *child_thread(void *arg)
 					hash_zone(addr, zc.length);
 				total += zc.length;
 			}
+			if (zc.copybuf_len > 0) {
+				assert(zc.copybuf_len <= chunk_size);
+				total_copybuf += zc.copybuf_len;
+				if (xflg)
+					hash_zone(buffer, zc.copybuf_len);
+				total += zc.copybuf_len;
+			}
 			if (zc.recv_skip_hint) {
 				assert(zc.recv_skip_hint <= chunk_size);
 				lu = read(fd, buffer, zc.recv_skip_hint);
@@ -221,10 +231,11 @@ void *child_thread(void *arg)
 		unsigned long mb = total >> 20;
 		total_usec = 1000000*ru.ru_utime.tv_sec + ru.ru_utime.tv_usec +
 			     1000000*ru.ru_stime.tv_sec + ru.ru_stime.tv_usec;
-		printf("received %lg MB (%lg %% mmap'ed) in %lg s, %lg Gbit\n"
+		printf("received %lg MB (%lg %% mmap'ed, %lg %% copybuf) in %lg s, %lg Gbit\n"
 		       "  cpu usage user:%lg sys:%lg, %lg usec per MB, %lu c-switches\n",
 				total / (1024.0 * 1024.0),
 				100.0*total_mmap/total,
+				100.0*total_copybuf/total,
 				(double)delta_usec / 1000000.0,
 				throughput,
 				(double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1000000.0,
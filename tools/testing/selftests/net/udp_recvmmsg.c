@@ -0,0 +1,252 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Check that the recvmmsg() timeout bounds the whole call, also while
+ * the socket is empty or reported readable without anything to read,
+ * that a shorter SO_RCVTIMEO still applies, and that UDP_GRO coalesced
+ * datagrams are handed out by recvmmsg() with their segment size.
+ *
+ * All traffic goes over loopback, run in a private netns if in doubt.
+ */
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <error.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT		103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO			104
+#endif
+
+#ifndef SOL_UDP
+#define SOL_UDP			17
+#endif
+
+#define NUM_MSGS		8
+#define MSG_LEN			64
+#define GSO_SIZE		1000
+#define GSO_SEGS		8
+
+/* how late recvmmsg() may return after its timeout */
+#define SLACK_MS		50
+
+static char rbuf[NUM_MSGS][GSO_SIZE * GSO_SEGS];
+static char sbuf[GSO_SIZE * GSO_SEGS];
+static int failed;
+
+static long now_ms(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		error(1, errno, "clock_gettime");
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void socket_pair(int *rx, int *tx)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+
+	*rx = socket(AF_INET, SOCK_DGRAM, 0);
+	if (*rx < 0)
+		error(1, errno, "socket rx");
+	if (bind(*rx, (void *)&addr, sizeof(addr)))
+		error(1, errno, "bind");
+	if (getsockname(*rx, (void *)&addr, &len))
+		error(1, errno, "getsockname");
+
+	*tx = socket(AF_INET, SOCK_DGRAM, 0);
+	if (*tx < 0)
+		error(1, errno, "socket tx");
+	if (connect(*tx, (void *)&addr, sizeof(addr)))
+		error(1, errno, "connect");
+}
+
+static void send_msgs(int fd, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		if (send(fd, sbuf, MSG_LEN, 0) != MSG_LEN)
+			error(1, errno, "send");
+}
+
+static void check(const char *name, bool ok, long elapsed)
+{
+	fprintf(stderr, "%-44s %4ld ms %s\n", name, elapsed,
+		ok ? "ok" : "FAIL");
+	if (!ok)
+		failed = 1;
+}
+
+/* send @num datagrams, then wait for NUM_MSGS with a @timeout_ms timeout */
+static void run_timeout(const char *name, int num, int timeout_ms)
+{
+	struct timespec timeout = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_nsec = (timeout_ms % 1000) * 1000000L,
+	};
+	struct mmsghdr msgs[NUM_MSGS];
+	struct iovec iov[NUM_MSGS];
+	long start, elapsed;
+	int rx, tx, ret, i;
+	bool ok;
+
+	socket_pair(&rx, &tx);
+	send_msgs(tx, num);
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < NUM_MSGS; i++) {
+		iov[i].iov_base = rbuf[i];
+		iov[i].iov_len = MSG_LEN;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	start = now_ms();
+	ret = recvmmsg(rx, msgs, NUM_MSGS, 0, &timeout);
+	elapsed = now_ms() - start;
+
+	if (num == NUM_MSGS) {
+		/* a full batch must not wait for the timeout */
+		ok = ret == NUM_MSGS && elapsed < timeout_ms;
+	} else {
+		ok = elapsed >= timeout_ms && elapsed <= timeout_ms + SLACK_MS;
+		if (num)
+			ok &= ret == num;
+		else
+			ok &= ret == -1 && errno == EAGAIN;
+	}
+	check(name, ok, elapsed);
+
+	close(tx);
+	close(rx);
+}
+
+/*
+ * Nothing to read: after shutdown(SHUT_RD) poll() keeps reporting the
+ * socket readable, and a SO_RCVTIMEO below the recvmmsg() timeout must
+ * end the wait first.  Either way the call fails with EAGAIN on time.
+ */
+static void run_empty(const char *name, bool shut_rd, int rcvtimeo_ms,
+		      int timeout_ms)
+{
+	struct timespec timeout = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_nsec = (timeout_ms % 1000) * 1000000L,
+	};
+	struct timeval tv = {
+		.tv_sec = rcvtimeo_ms / 1000,
+		.tv_usec = (rcvtimeo_ms % 1000) * 1000,
+	};
+	struct iovec iov = { .iov_base = rbuf[0], .iov_len = MSG_LEN };
+	struct mmsghdr msg = {
+		.msg_hdr.msg_iov = &iov,
+		.msg_hdr.msg_iovlen = 1,
+	};
+	int expect_ms = rcvtimeo_ms ? rcvtimeo_ms : timeout_ms;
+	long start, elapsed;
+	int rx, tx, ret;
+
+	socket_pair(&rx, &tx);
+	if (shut_rd && shutdown(rx, SHUT_RD))
+		error(1, errno, "shutdown");
+	if (rcvtimeo_ms &&
+	    setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
+		error(1, errno, "setsockopt SO_RCVTIMEO");
+
+	start = now_ms();
+	ret = recvmmsg(rx, &msg, 1, 0, &timeout);
+	elapsed = now_ms() - start;
+
+	check(name, ret == -1 && errno == EAGAIN && elapsed >= expect_ms &&
+		    elapsed <= expect_ms + SLACK_MS, elapsed);
+
+	close(tx);
+	close(rx);
+}
+
+/* coalesced datagrams must come out whole, with their gso_size */
+static void run_gro(void)
+{
+	char ctrl[NUM_MSGS][CMSG_SPACE(sizeof(int))];
+	struct timespec timeout = { .tv_nsec = 100000000L };
+	struct mmsghdr msgs[NUM_MSGS];
+	struct iovec iov[NUM_MSGS];
+	int rx, tx, ret, i, one = 1;
+	int gso_size = GSO_SIZE;
+	long start, elapsed;
+	bool ok;
+
+	socket_pair(&rx, &tx);
+	if (setsockopt(rx, SOL_UDP, UDP_GRO, &one, sizeof(one))) {
+		fprintf(stderr, "%-44s SKIP\n", "recvmmsg UDP_GRO");
+		goto out;
+	}
+	if (setsockopt(tx, SOL_UDP, UDP_SEGMENT, &gso_size, sizeof(gso_size)))
+		error(1, errno, "setsockopt UDP_SEGMENT");
+
+	for (i = 0; i < 2; i++)
+		if (send(tx, sbuf, sizeof(sbuf), 0) != sizeof(sbuf))
+			error(1, errno, "send gso");
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < NUM_MSGS; i++) {
+		iov[i].iov_base = rbuf[i];
+		iov[i].iov_len = sizeof(rbuf[i]);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = ctrl[i];
+		msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i]);
+	}
+
+	start = now_ms();
+	ret = recvmmsg(rx, msgs, NUM_MSGS, MSG_WAITFORONE, &timeout);
+	elapsed = now_ms() - start;
+
+	ok = ret == 2;
+	for (i = 0; ok && i < ret; i++) {
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+		int seg = 0;
+
+		for (; cmsg; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg))
+			if (cmsg->cmsg_level == SOL_UDP &&
+			    cmsg->cmsg_type == UDP_GRO)
+				memcpy(&seg, CMSG_DATA(cmsg), sizeof(seg));
+
+		ok = msgs[i].msg_len == sizeof(sbuf) && seg == GSO_SIZE;
+	}
+	check("recvmmsg UDP_GRO", ok, elapsed);
+
+out:
+	close(tx);
+	close(rx);
+}
+
+int main(int argc, char **argv)
+{
+	run_timeout("recvmmsg timeout, empty socket", 0, 100);
+	run_timeout("recvmmsg timeout, partial batch", NUM_MSGS / 2, 100);
+	run_timeout("recvmmsg timeout, full batch", NUM_MSGS, 100);
+	run_empty("recvmmsg timeout, receive side shut down", true, 0, 100);
+	run_empty("recvmmsg timeout, shorter SO_RCVTIMEO", false, 50, 500);
+	run_gro();
+
+	return failed;
+}
@@ -0,0 +1,182 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Measure the forwarding rate of a router with and without the
+# nf_tables flowtable software fast path.
+#
+# ns1 is attached to a bridge on the router, ns2 sits behind a vlan:
+#
+#  ns1 veth0 ---- veth0 [br0] nsr1 [veth1.10] veth1 ---- veth0.10 ns2
+#  10.0.1.99         10.0.1.1         10.0.2.1              10.0.2.99
+#
+# The flowtable is attached to the lower devices of br0 and veth1.10, so
+# offloaded packets bypass the bridge and vlan devices as well as the
+# forward hook. UDP packets are sent from ns1 to ns2 with iperf3 and the
+# rate is taken from the receive counter of ns2.
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+ret=0
+
+sfx=$(mktemp -u "XXXXXXXX")
+ns1="ns1-$sfx"
+ns2="ns2-$sfx"
+nsr1="nsr1-$sfx"
+
+duration=${DURATION:-5}
+pktsize=${PKTSIZE:-64}
+
+cleanup() {
+	ip netns pids $ns1 2>/dev/null | xargs -r kill 2>/dev/null
+	ip netns pids $ns2 2>/dev/null | xargs -r kill 2>/dev/null
+	ip netns del $ns1 2>/dev/null
+	ip netns del $ns2 2>/dev/null
+	ip netns del $nsr1 2>/dev/null
+}
+trap cleanup EXIT
+
+for prog in ip nft iperf3; do
+	if ! command -v $prog > /dev/null 2>&1; then
+		echo "SKIP: Could not run test without $prog tool"
+		exit $ksft_skip
+	fi
+done
+
+ip netns add $nsr1
+if [ $? -ne 0 ]; then
+	echo "SKIP: Could not create net namespace"
+	exit $ksft_skip
+fi
+ip netns add $ns1
+ip netns add $ns2
+
+ip link add veth0 netns $nsr1 type veth peer name veth0 netns $ns1
+ip link add veth1 netns $nsr1 type veth peer name veth0 netns $ns2
+
+ip -net $nsr1 link add br0 type bridge
+if [ $? -ne 0 ]; then
+	echo "SKIP: Could not add bridge device"
+	exit $ksft_skip
+fi
+ip -net $nsr1 link set veth0 master br0
+ip -net $nsr1 link add link veth1 name veth1.10 type vlan id 10
+if [ $? -ne 0 ]; then
+	echo "SKIP: Could not add vlan device"
+	exit $ksft_skip
+fi
+ip -net $ns2 link add link veth0 name veth0.10 type vlan id 10
+
+for dev in lo veth0 veth1 br0 veth1.10; do
+	ip -net $nsr1 link set $dev up
+done
+for ns in $ns1 $ns2; do
+	ip -net $ns link set lo up
+	ip -net $ns link set veth0 up
+done
+ip -net $ns2 link set veth0.10 up
+
+ip -net $nsr1 addr add 10.0.1.1/24 dev br0
+ip -net $nsr1 addr add 10.0.2.1/24 dev veth1.10
+ip -net $ns1 addr add 10.0.1.99/24 dev veth0
+ip -net $ns2 addr add 10.0.2.99/24 dev veth0.10
+ip -net $ns1 route add default via 10.0.1.1
+ip -net $ns2 route add default via 10.0.2.1
+
+ip netns exec $nsr1 sysctl -q net.ipv4.ip_forward=1
+ip netns exec $nsr1 sysctl -q net.netfilter.nf_conntrack_acct=1 2>/dev/null
+
+load_ruleset() {
+	local offload=$1
+	local rule=""
+
+	[ $offload -eq 1 ] && rule="meta l4proto { tcp, udp } flow add @f1"
+
+	ip netns exec $nsr1 nft -f - <<EOF
+flush ruleset
+table inet filter {
+	flowtable f1 {
+		hook ingress priority 0
+		devices = { veth0, veth1 }
+	}
+
+	chain forward {
+		type filter hook forward priority 0; policy accept;
+		$rule
+		counter
+	}
+}
+EOF
+}
+
+forward_packets() {
+	ip netns exec $nsr1 nft list chain inet filter forward |
+		awk '/counter packets/ { for (i = 1; i < NF; i++) if ($i == "packets") print $(i + 1) }'
+}
+
+rx_packets() {
+	ip netns exec $ns2 cat /sys/class/net/veth0.10/statistics/rx_packets
+}
+
+# Prints the rate seen by ns2 in packets per second.
+run_one() {
+	local before after
+
+	ip netns exec $ns2 iperf3 -s -1 -D -B 10.0.2.99
+	sleep 1
+
+	before=$(rx_packets)
+	ip netns exec $ns1 iperf3 -c 10.0.2.99 -u -b 0 -l $pktsize \
+		-t $duration > /dev/null 2>&1
+	after=$(rx_packets)
+
+	echo $(( (after - before) / duration ))
+}
+
+ping_check() {
+	ip netns exec $ns1 ping -c 1 -q -W 2 10.0.2.99 > /dev/null
+	if [ $? -ne 0 ]; then
+		echo "FAIL: ns1 cannot reach ns2"
+		exit 1
+	fi
+}
+
+if ! load_ruleset 0; then
+	echo "SKIP: Could not load ruleset with flowtable"
+	exit $ksft_skip
+fi
+ping_check
+
+pps_slow=$(run_one)
+echo "PASS: forward path: $pps_slow pps"
+
+load_ruleset 1
+ping_check
+
+pps_fast=$(run_one)
+fwd=$(forward_packets)
+rcvd=$(( pps_fast * duration ))
+
+# Only the packets seen before the flow was offloaded go through the
+# forward hook.
+if [ $rcvd -gt 0 ] && [ $fwd -lt $(( rcvd / 10 )) ]; then
+	echo "PASS: flowtable fast path: $pps_fast pps ($fwd packets via forward hook)"
+else
+	echo "FAIL: flowtable fast path: $pps_fast pps ($fwd packets via forward hook)"
+	ret=1
+fi
+
+# Conntrack counters of offloaded flows are updated by the flowtable
+# garbage collector, once per second.
+if command -v conntrack > /dev/null 2>&1; then
+	sleep 2
+	acct=$(ip netns exec $nsr1 conntrack -L -p udp -d 10.0.2.99 2>/dev/null |
+		awk '{ for (i = 1; i <= NF; i++) if ($i ~ /^packets=/) { split($i, a, "="); if (a[2] > max) max = a[2] } } END { print max + 0 }')
+	if [ $acct -gt $(( rcvd / 2 )) ]; then
+		echo "PASS: conntrack counters include offloaded packets"
+	else
+		echo "FAIL: conntrack counters: $acct packets, expected about $rcvd"
+		ret=1
+	fi
+fi
+
+exit $ret